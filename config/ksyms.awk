@@ -0,0 +1,14 @@
+# turns `nm -n` output of the kernel into the C symbol table of ksyms.h
+BEGIN {
+    print "/* generated by config/ksyms.awk, do not edit */"
+    print "#include \"ksyms.h\""
+    print "const KSYM ksym_table[] = {"
+}
+$2 == "T" || $2 == "t" {
+    printf "    { 0x%s, \"%s\" },\n", $1, $3
+    count++
+}
+END {
+    print "};"
+    printf "const uint32 ksym_table_size = %d;\n", count
+}
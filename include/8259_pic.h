@@ -25,6 +25,11 @@
  */
 void pic8259_init();
 
+/**
+ * mask every line, once the IO-APIC delivers device interrupts
+ */
+void pic8259_disable();
+
 /**
  * send end of interrupt command to PIC 8259
  */
@@ -0,0 +1,260 @@
+/**
+ * ACPI table discovery
+ * for more, see the ACPI specification, chapter 5.2
+ */
+
+#ifndef ACPI_H
+#define ACPI_H
+
+#include "types.h"
+#include "cpu.h"
+
+#define ACPI_MAX_IOAPICS        4
+#define ACPI_MAX_OVERRIDES      16
+
+// MADT entry types
+#define MADT_LOCAL_APIC         0
+#define MADT_IO_APIC            1
+#define MADT_IRQ_OVERRIDE       2
+
+#define MADT_CPU_ENABLED        0x1
+#define MADT_PCAT_COMPAT        0x1     // a legacy 8259 pair is installed
+
+// generic address spaces
+#define ACPI_GAS_MEMORY         0
+#define ACPI_GAS_IO             1
+
+// FADT flags
+#define FADT_TMR_VAL_EXT        (1 << 8)    // the PM timer has 32 bits, not 24
+#define FADT_RESET_REG_SUP      (1 << 10)
+
+// PM1 control register
+#define ACPI_PM1_SCI_EN         (1 << 0)    // ACPI mode, not legacy SMM
+#define ACPI_PM1_SLP_TYP_SHIFT  10
+#define ACPI_PM1_SLP_EN         (1 << 13)
+
+#define ACPI_PM_TIMER_HZ        3579545
+
+// HPET event timer block id
+#define HPET_ID_COMPARATORS(id) ((((id) >> 8) & 0x1F) + 1)
+#define HPET_ID_COUNTER_64      (1 << 13)
+
+typedef struct {
+    char signature[8];          // "RSD PTR "
+    uint8 checksum;
+    char oem_id[6];
+    uint8 revision;             // 0 for ACPI 1.0, 2 when the extended fields exist
+    uint32 rsdt_address;
+    uint32 length;
+    uint32 xsdt_address_low, xsdt_address_high;
+    uint8 extended_checksum;
+    uint8 reserved[3];
+} __attribute__((packed)) ACPI_RSDP;
+
+// common header of every system description table
+typedef struct {
+    char signature[4];
+    uint32 length;              // including this header
+    uint8 revision;
+    uint8 checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32 oem_revision;
+    uint32 creator_id;
+    uint32 creator_revision;
+} __attribute__((packed)) ACPI_SDT_HEADER;
+
+typedef struct {
+    ACPI_SDT_HEADER header;
+    uint32 lapic_address;
+    uint32 flags;
+    // variable length entries follow
+} __attribute__((packed)) ACPI_MADT;
+
+// register in memory or I/O space
+typedef struct {
+    uint8 address_space;        // ACPI_GAS_*
+    uint8 bit_width;
+    uint8 bit_offset;
+    uint8 access_size;
+    uint32 address_low, address_high;
+} __attribute__((packed)) ACPI_GAS;
+
+// fixed ACPI description table, fields past the header length are absent
+typedef struct {
+    ACPI_SDT_HEADER header;
+    uint32 firmware_ctrl;
+    uint32 dsdt;
+    uint8 reserved1;
+    uint8 preferred_pm_profile;
+    uint16 sci_irq;
+    uint32 smi_cmd;             // port to write acpi_enable to, 0 when always in ACPI mode
+    uint8 acpi_enable;
+    uint8 acpi_disable;
+    uint8 s4bios_req;
+    uint8 pstate_cnt;
+    uint32 pm1a_evt_blk;
+    uint32 pm1b_evt_blk;
+    uint32 pm1a_cnt_blk;
+    uint32 pm1b_cnt_blk;
+    uint32 pm2_cnt_blk;
+    uint32 pm_tmr_blk;
+    uint32 gpe0_blk;
+    uint32 gpe1_blk;
+    uint8 pm1_evt_len;
+    uint8 pm1_cnt_len;
+    uint8 pm2_cnt_len;
+    uint8 pm_tmr_len;
+    uint8 gpe0_blk_len;
+    uint8 gpe1_blk_len;
+    uint8 gpe1_base;
+    uint8 cst_cnt;
+    uint16 p_lvl2_lat;
+    uint16 p_lvl3_lat;
+    uint16 flush_size;
+    uint16 flush_stride;
+    uint8 duty_offset;
+    uint8 duty_width;
+    uint8 day_alarm;
+    uint8 month_alarm;
+    uint8 century;
+    uint16 iapc_boot_arch;
+    uint8 reserved2;
+    uint32 flags;               // FADT_*
+    ACPI_GAS reset_reg;         // ACPI 2.0 from here on
+    uint8 reset_value;
+    uint16 arm_boot_arch;
+    uint8 minor_version;
+    uint32 x_firmware_ctrl_low, x_firmware_ctrl_high;
+    uint32 x_dsdt_low, x_dsdt_high;
+} __attribute__((packed)) ACPI_FADT;
+
+typedef struct {
+    ACPI_SDT_HEADER header;
+    uint32 event_timer_block_id;
+    ACPI_GAS address;
+    uint8 number;
+    uint16 min_tick;            // smallest periodic rate without lost interrupts
+    uint8 page_protection;
+} __attribute__((packed)) ACPI_HPET;
+
+// PCI express memory mapped configuration space, one entry per segment
+typedef struct {
+    ACPI_SDT_HEADER header;
+    uint8 reserved[8];
+    // ACPI_MCFG_ENTRY follow
+} __attribute__((packed)) ACPI_MCFG;
+
+typedef struct {
+    uint32 address_low, address_high;
+    uint16 segment;
+    uint8 start_bus;
+    uint8 end_bus;
+    uint32 reserved;
+} __attribute__((packed)) ACPI_MCFG_ENTRY;
+
+typedef struct {
+    uint8 id;
+    uint32 address;
+    uint32 gsi_base;            // first global system interrupt it handles
+} ACPI_IOAPIC;
+
+// an ISA irq wired to a different global system interrupt
+typedef struct {
+    uint8 irq;
+    uint32 gsi;
+    uint16 flags;               // polarity and trigger mode
+} ACPI_IRQ_OVERRIDE;
+
+// what the MADT tells about interrupt controllers and processors
+typedef struct {
+    uint32 lapic_address;
+    BOOL pic_present;
+    uint32 cpu_count;
+    uint8 cpu_apic_ids[CPU_MAX];
+    uint32 ioapic_count;
+    ACPI_IOAPIC ioapics[ACPI_MAX_IOAPICS];
+    uint32 override_count;
+    ACPI_IRQ_OVERRIDE overrides[ACPI_MAX_OVERRIDES];
+} ACPI_MADT_INFO;
+
+// what the FADT and the DSDT tell about power management
+typedef struct {
+    uint16 sci_irq;
+    uint32 smi_cmd;
+    uint8 acpi_enable;
+    uint16 pm1a_cnt;            // ports, pm1b_cnt is 0 when there is no second block
+    uint16 pm1b_cnt;
+    uint16 pm_timer;            // 0 without a PM timer
+    BOOL pm_timer_32;
+    BOOL s5_found;              // \_S5_ was found in the DSDT
+    uint8 s5_typ_a;             // SLP_TYP values for soft off
+    uint8 s5_typ_b;
+    BOOL reset_supported;
+    ACPI_GAS reset_reg;
+    uint8 reset_value;
+} ACPI_FADT_INFO;
+
+// ECAM window of PCI segment 0
+typedef struct {
+    uint32 address;             // physical, of bus 0 even if start_bus is higher
+    uint8 start_bus;
+    uint8 end_bus;
+} ACPI_MCFG_INFO;
+
+// the first HPET block
+typedef struct {
+    uint32 address;             // physical, memory space
+    uint8 number;
+    uint8 comparators;
+    BOOL counter_64;
+    uint16 vendor_id;
+    uint16 min_tick;
+} ACPI_HPET_INFO;
+
+/**
+ * locate the root table and parse the MADT, FADT, HPET and MCFG, FALSE without ACPI
+ */
+BOOL acpi_init(void);
+
+/**
+ * mapped table with the given 4 character signature, NULL if absent
+ */
+ACPI_SDT_HEADER *acpi_find_table(const char *signature);
+
+/**
+ * mapped table by index in the root table, NULL past the last
+ */
+ACPI_SDT_HEADER *acpi_table_get(uint32 index);
+
+/**
+ * parsed MADT, NULL if there is none
+ */
+const ACPI_MADT_INFO *acpi_madt(void);
+
+/**
+ * parsed FADT, NULL if there is none
+ */
+const ACPI_FADT_INFO *acpi_fadt(void);
+
+/**
+ * parsed HPET table, NULL if there is none
+ */
+const ACPI_HPET_INFO *acpi_hpet(void);
+
+/**
+ * ECAM window of PCI segment 0 from the MCFG, NULL if there is none
+ */
+const ACPI_MCFG_INFO *acpi_mcfg(void);
+
+/**
+ * enter S5 soft off, only returns when that failed
+ */
+void acpi_power_off(void);
+
+/**
+ * reset through the FADT reset register, only returns when that failed
+ */
+void acpi_reset(void);
+
+#endif
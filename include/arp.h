@@ -0,0 +1,56 @@
+/**
+ * ARP: IPv4 next hops to ethernet addresses
+ * for more, see RFC 826
+ */
+
+#ifndef ARP_H
+#define ARP_H
+
+#include "types.h"
+#include "net.h"
+
+#define ARP_CACHE_SIZE          16
+#define ARP_LIFETIME_MS         60000   // a resolved entry is asked again after
+#define ARP_RETRY_MS            1000    // between requests for an unresolved one
+
+#define ARP_HTYPE_ETHERNET      1
+#define ARP_OP_REQUEST          1
+#define ARP_OP_REPLY            2
+
+typedef struct {
+    uint16 htype;
+    uint16 ptype;
+    uint8 hlen;
+    uint8 plen;
+    uint16 op;
+    uint8 sha[ETH_ALEN];
+    IP_ADDR spa;
+    uint8 tha[ETH_ALEN];
+    IP_ADDR tpa;
+} __attribute__((packed)) ARP_PACKET;
+
+typedef struct {
+    IP_ADDR addr;               // 0 if the entry is free
+    uint8 mac[ETH_ALEN];
+    BOOL resolved;
+    uint64 updated;             // clock_ns() of the reply, or of the last request
+    NETBUF *pending;            // the latest packet waiting for the reply
+} ARP_ENTRY;
+
+/**
+ * an ARP packet arrived, buf starts at it
+ */
+void arp_receive(NETBUF *buf);
+
+/**
+ * send the IP packet in buf to next_hop, holding it until the address is
+ * resolved. buf is gone afterwards either way
+ */
+BOOL arp_output(NETBUF *buf, IP_ADDR next_hop);
+
+/**
+ * copy of cache entry index, FALSE past the last
+ */
+BOOL arp_entry(uint32 index, ARP_ENTRY *entry);
+
+#endif
@@ -0,0 +1,61 @@
+/**
+ * Microbenchmarks of the kernel's hot paths
+ * every benchmark runs warmup samples, then BENCH_REPS timed samples of a
+ * batch of operations with interrupts off, and reports cycles per operation
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "types.h"
+
+#define BENCH_WARMUP            8
+#define BENCH_REPS              101     // odd, so the median is a sample
+#define BENCH_WAKEUP_NAME       "hrtimer_wakeup_ns"
+#define BENCH_WAKEUP_US         500     // sleep of every wakeup sample
+
+// runs ops operations of the benchmark
+typedef void (*BENCH_FN)(uint32 ops);
+
+typedef struct {
+    const char *name;
+    BENCH_FN fn;
+    uint32 ops;                 // operations per sample
+    const char *routine;        // dispatched routine to bind for the run, or NULL
+    const char *variant;
+} BENCH;
+
+// cycles per operation over the samples
+typedef struct {
+    uint32 min;
+    uint32 median;
+    uint32 p99;
+} BENCH_RESULT;
+
+/**
+ * number of benchmarks in the suite
+ */
+uint32 bench_count(void);
+
+/**
+ * benchmark at index, NULL past the last
+ */
+const BENCH *bench_get(uint32 index);
+
+/**
+ * FALSE when bench times a variant the cpu can't run
+ */
+BOOL bench_available(const BENCH *bench);
+
+/**
+ * time bench, also writing a key=value line of the result to the serial port
+ */
+void bench_run(const BENCH *bench, BENCH_RESULT *result);
+
+/**
+ * how many ns after their deadline BENCH_REPS sleeps of BENCH_WAKEUP_US
+ * get to run again, reported like a benchmark named BENCH_WAKEUP_NAME
+ */
+void bench_wakeup_latency(BENCH_RESULT *result);
+
+#endif
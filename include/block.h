@@ -0,0 +1,110 @@
+/**
+ * Block layer: disks by name, and requests that are queued per disk and
+ * handed to its driver in batches, completing in interrupt context
+ */
+
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include "types.h"
+#include "spinlock.h"
+#include "waitq.h"
+
+#define BLOCK_MAX_DEVICES       4
+#define BLOCK_SECTOR_SIZE       512
+#define BLOCK_NAME_SIZE         8
+
+// request status
+#define BLOCK_PENDING           1
+#define BLOCK_OK                0
+#define BLOCK_EIO               -1
+#define BLOCK_EUNSUPPORTED      -2
+#define BLOCK_ERANGE            -3
+
+typedef enum {
+    BLOCK_READ,
+    BLOCK_WRITE,
+    BLOCK_FLUSH,
+} BLOCK_OP;
+
+struct BLOCK_REQUEST;
+struct BLOCK_DEVICE;
+
+typedef void (*BLOCK_DONE)(struct BLOCK_REQUEST *req, sint32 status);
+
+typedef struct BLOCK_REQUEST {
+    BLOCK_OP op;
+    uint64 sector;
+    uint32 count;               // sectors
+    void *buffer;               // identity mapped kernel memory of count sectors
+    volatile sint32 status;     // BLOCK_PENDING until done
+    BLOCK_DONE done;            // in interrupt context before status is set, NULL to only wake waiters
+    void *data;
+    struct BLOCK_REQUEST *next; // batch link, then the queue's
+} BLOCK_REQUEST;
+
+// takes requests off the front of list while the device has room, and
+// returns the first one it didn't take. every next link is read before the
+// device may see a request, the one notification comes last
+typedef BLOCK_REQUEST *(*BLOCK_SUBMIT)(struct BLOCK_DEVICE *dev, BLOCK_REQUEST *list);
+
+typedef struct BLOCK_DEVICE {
+    char name[BLOCK_NAME_SIZE];
+    uint64 sectors;
+    BOOL read_only;
+    BLOCK_SUBMIT submit;
+    void *driver_data;
+    SPINLOCK lock;              // the queue
+    BLOCK_REQUEST *queue;       // waiting for room in the device
+    BLOCK_REQUEST *queue_tail;
+    WAITQ waiters;
+    uint32 requests;
+    uint32 batches;             // submit calls that took requests
+    uint32 notifications;       // doorbells the driver rang for them
+} BLOCK_DEVICE;
+
+/**
+ * add dev, named and sized by its driver
+ */
+BOOL block_register(BLOCK_DEVICE *dev);
+
+/**
+ * device by index, NULL past the last
+ */
+BLOCK_DEVICE *block_get(uint32 index);
+
+/**
+ * device with name, NULL if there is none
+ */
+BLOCK_DEVICE *block_find(const char *name);
+
+/**
+ * queue the requests linked from batch and start as many as the device
+ * has room for, with one notification. requests outside the disk fail now
+ */
+void block_submit(BLOCK_DEVICE *dev, BLOCK_REQUEST *batch);
+
+/**
+ * called by drivers in interrupt context once req is done, then
+ * block_kick() when they have room again
+ */
+void block_complete(BLOCK_DEVICE *dev, BLOCK_REQUEST *req, sint32 status);
+
+/**
+ * hand queued requests to the driver
+ */
+void block_kick(BLOCK_DEVICE *dev);
+
+/**
+ * sleep until req is done, returns its status
+ */
+sint32 block_wait(BLOCK_DEVICE *dev, BLOCK_REQUEST *req);
+
+/**
+ * synchronous count sectors from sector into buffer
+ */
+sint32 block_read(BLOCK_DEVICE *dev, uint64 sector, uint32 count, void *buffer);
+
+sint32 block_write(BLOCK_DEVICE *dev, uint64 sector, uint32 count, const void *buffer);
+
+#endif
@@ -0,0 +1,72 @@
+/**
+ * Clocksources: free running counters the kernel reads time from.
+ * the HPET main counter and the time stamp counter register one each, the
+ * TSC rate is measured against the HPET, or PIT channel 2 without one, and
+ * the source with the best rating becomes the system clock
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "types.h"
+
+#define CLOCK_SOURCES           4
+#define CLOCK_CALIBRATE_MS      10
+
+#define NSEC_PER_SEC            1000000000
+#define NSEC_PER_MSEC           1000000
+#define NSEC_PER_USEC           1000
+
+// higher is preferred
+#define CLOCK_RATING_TSC        100     // may change rate with power states
+#define CLOCK_RATING_HPET       200
+#define CLOCK_RATING_TSC_STABLE 300     // invariant TSC
+
+typedef uint64 (*CLOCK_READ)(void);
+
+typedef struct {
+    const char *name;
+    uint32 rating;
+    CLOCK_READ read;
+    uint64 mask;                // narrower counters wrap at it
+    uint64 hz;
+    uint32 mult;                // ns = cycles * mult >> shift
+    uint32 shift;
+} CLOCKSOURCE;
+
+/**
+ * register the HPET and the TSC and pick the system clock, after acpi_init()
+ */
+void clock_init(void);
+
+/**
+ * add source counting at hz, it becomes the system clock if rated higher
+ */
+BOOL clock_register(CLOCKSOURCE *source, uint64 hz);
+
+/**
+ * the system clock, NULL before clock_init()
+ */
+const CLOCKSOURCE *clock_current(void);
+
+/**
+ * registered source by index, NULL past the last
+ */
+const CLOCKSOURCE *clock_get(uint32 index);
+
+/**
+ * nanoseconds since clock_init(), 0 before it
+ */
+uint64 clock_ns(void);
+
+/**
+ * cycles of source in nanoseconds
+ */
+uint64 clock_cycles_to_ns(const CLOCKSOURCE *source, uint64 cycles);
+
+/**
+ * measured time stamp counter frequency in Hz
+ */
+uint64 clock_tsc_hz(void);
+
+#endif
@@ -9,6 +9,9 @@
 #define SCROLL_UP     1
 #define SCROLL_DOWN   2
 
+// receives every character its task prints while set, instead of the screen
+typedef void (*CONSOLE_SINK)(char ch);
+
 void console_clear(VGA_COLOR_TYPE fore_color, VGA_COLOR_TYPE back_color);
 
 //initialize console
@@ -23,6 +26,10 @@ void console_ungetchar_bound(uint8 n);
 void console_gotoxy(uint16 x, uint16 y);
 
 void console_putstr(const char *str);
+
+// redirect the current task's console output to sink, NULL restores the screen
+void console_set_sink(CONSOLE_SINK sink);
+
 void printf(const char *format, ...);
 
 // Announce function - prints prefixed message with OS tag
@@ -0,0 +1,84 @@
+/**
+ * CPU instruction helpers: cpuid, model specific registers, time stamp counter
+ */
+
+#ifndef CPU_H
+#define CPU_H
+
+#include "types.h"
+
+// processors the kernel brings up, the rest are left halted
+#define CPU_MAX                 8
+
+// cpuid leaf 1 feature bits
+#define CPUID_FEAT_EDX_TSC      (1 << 4)
+#define CPUID_FEAT_EDX_MSR      (1 << 5)
+#define CPUID_FEAT_EDX_SEP      (1 << 11)
+
+// model specific registers
+#define MSR_SYSENTER_CS         0x174
+#define MSR_SYSENTER_ESP        0x175
+#define MSR_SYSENTER_EIP        0x176
+
+static inline void cpu_cpuid(uint32 leaf, uint32 *eax, uint32 *ebx, uint32 *ecx, uint32 *edx) {
+    asm volatile("cpuid"
+                 : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                 : "0"(leaf), "2"(0));
+}
+
+static inline void cpu_wrmsr(uint32 msr, uint32 low, uint32 high) {
+    asm volatile("wrmsr" :: "c"(msr), "a"(low), "d"(high));
+}
+
+static inline void cpu_rdmsr(uint32 msr, uint32 *low, uint32 *high) {
+    asm volatile("rdmsr" : "=a"(*low), "=d"(*high) : "c"(msr));
+}
+
+static inline uint32 cpu_read_cr0(void) {
+    uint32 cr0;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    return cr0;
+}
+
+static inline void cpu_write_cr0(uint32 cr0) {
+    asm volatile("mov %0, %%cr0" :: "r"(cr0) : "memory");
+}
+
+static inline uint32 cpu_read_cr4(void) {
+    uint32 cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+    return cr4;
+}
+
+static inline void cpu_write_cr4(uint32 cr4) {
+    asm volatile("mov %0, %%cr4" :: "r"(cr4) : "memory");
+}
+
+// n / d without libgcc's 64 bit division, the remainder goes to rem unless NULL
+static inline uint64 cpu_div64(uint64 n, uint32 d, uint32 *rem) {
+    uint32 high = (uint32)(n >> 32), low;
+    uint32 r = high % d;
+
+    // divl wants the high half below d, so it goes in two steps
+    high /= d;
+    asm("divl %4" : "=a"(low), "=d"(r) : "a"((uint32)n), "d"(r), "rm"(d));
+    if (rem)
+        *rem = r;
+    return ((uint64)high << 32) | low;
+}
+
+// cycles since reset, counts at a constant rate on newer cpus
+static inline uint64 cpu_rdtsc(void) {
+    uint64 tsc;
+    asm volatile("rdtsc" : "=A"(tsc));
+    return tsc;
+}
+
+// rdtsc that waits for the instructions before it, check CPU_FEAT_RDTSCP
+static inline uint64 cpu_rdtscp(void) {
+    uint64 tsc;
+    asm volatile("rdtscp" : "=A"(tsc) :: "ecx");
+    return tsc;
+}
+
+#endif
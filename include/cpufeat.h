@@ -0,0 +1,114 @@
+/**
+ * CPU feature registry and runtime dispatch
+ * cpuid is decoded once at boot. routines with several implementations
+ * call through a function pointer, bound to the best variant the cpu runs
+ */
+
+#ifndef CPUFEAT_H
+#define CPUFEAT_H
+
+#include "types.h"
+
+#define CPU_DISPATCH_TABLES     4
+
+typedef enum {
+    CPU_FEAT_NONE,              // what the portable variants need, always set
+    CPU_FEAT_TSC,
+    CPU_FEAT_MSR,
+    CPU_FEAT_APIC,
+    CPU_FEAT_SEP,
+    CPU_FEAT_FXSR,
+    CPU_FEAT_SSE,
+    CPU_FEAT_SSE2,
+    CPU_FEAT_HTT,
+    CPU_FEAT_SSE3,
+    CPU_FEAT_MONITOR,
+    CPU_FEAT_SSSE3,
+    CPU_FEAT_PCID,
+    CPU_FEAT_SSE41,
+    CPU_FEAT_SSE42,
+    CPU_FEAT_X2APIC,
+    CPU_FEAT_POPCNT,
+    CPU_FEAT_XSAVE,
+    CPU_FEAT_AVX,               // the cpu has it, the kernel doesn't enable XSAVE
+    CPU_FEAT_HYPERVISOR,
+    CPU_FEAT_AVX2,
+    CPU_FEAT_ERMS,              // fast rep movsb and rep stosb
+    CPU_FEAT_INVPCID,
+    CPU_FEAT_FSRM,              // fast rep movsb for short copies too
+    CPU_FEAT_NX,
+    CPU_FEAT_RDTSCP,
+    CPU_FEAT_INVARIANT_TSC,     // constant rate in every power state
+    CPU_FEAT_COUNT
+} CPU_FEATURE;
+
+typedef struct {
+    char vendor[13];
+    char brand[49];
+    uint32 family;
+    uint32 model;
+    uint32 stepping;
+    uint32 max_leaf;
+    uint32 max_ext_leaf;
+    uint32 present[(CPU_FEAT_COUNT + 31) / 32];
+} CPU_INFO;
+
+// one implementation of a dispatched routine
+typedef struct {
+    const char *name;
+    CPU_FEATURE needs;
+    void *fn;
+} CPU_VARIANT;
+
+// routine whose entry point calls through slot
+typedef struct {
+    const char *name;
+    void **slot;
+    const CPU_VARIANT *variants;    // default first, one of them needs only CPU_FEAT_NONE
+    uint32 variant_count;
+    const CPU_VARIANT *chosen;      // NULL until bound
+} CPU_DISPATCH;
+
+/**
+ * decode cpuid, first thing at boot
+ */
+void cpu_features_init(void);
+
+/**
+ * what cpuid reported
+ */
+const CPU_INFO *cpu_info(void);
+
+/**
+ * TRUE when the cpu has feature
+ */
+BOOL cpu_has(CPU_FEATURE feature);
+
+/**
+ * lowercase name of feature, as in /proc/cpuinfo
+ */
+const char *cpu_feature_name(CPU_FEATURE feature);
+
+/**
+ * bind every routine of table to the first variant the cpu has the
+ * features for, and list the table for cpu_dispatch_get()
+ */
+void cpu_dispatch_register(CPU_DISPATCH *table, uint32 count);
+
+/**
+ * dispatched routine by index over all tables, NULL past the last
+ */
+const CPU_DISPATCH *cpu_dispatch_get(uint32 index);
+
+/**
+ * dispatched routine called name, NULL if no table has it
+ */
+const CPU_DISPATCH *cpu_dispatch_find(const char *name);
+
+/**
+ * bind routine to its variant called variant, FALSE if either is unknown
+ * or the cpu lacks the feature the variant needs
+ */
+BOOL cpu_dispatch_bind(const char *routine, const char *variant);
+
+#endif
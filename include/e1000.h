@@ -0,0 +1,109 @@
+/**
+ * Intel 8254x gigabit ethernet, as QEMU's e1000 models it
+ * for more, see the PCI/PCI-X Family of Gigabit Ethernet Controllers
+ * Software Developer's Manual
+ */
+
+#ifndef E1000_H
+#define E1000_H
+
+#include "types.h"
+
+#define E1000_RX_DESCS      128     // 16 bytes each, both rings fit a page
+#define E1000_TX_DESCS      128
+#define E1000_MAX_NICS      2
+
+// registers
+#define E1000_CTRL          0x0000
+#define E1000_STATUS        0x0008
+#define E1000_EERD          0x0014
+#define E1000_ICR           0x00C0
+#define E1000_ITR           0x00C4
+#define E1000_IMS           0x00D0
+#define E1000_IMC           0x00D8
+#define E1000_RCTL          0x0100
+#define E1000_TCTL          0x0400
+#define E1000_TIPG          0x0410
+#define E1000_RDBAL         0x2800
+#define E1000_RDBAH         0x2804
+#define E1000_RDLEN         0x2808
+#define E1000_RDH           0x2810
+#define E1000_RDT           0x2818
+#define E1000_RDTR          0x2820
+#define E1000_RADV          0x282C
+#define E1000_TDBAL         0x3800
+#define E1000_TDBAH         0x3804
+#define E1000_TDLEN         0x3808
+#define E1000_TDH           0x3810
+#define E1000_TDT           0x3818
+#define E1000_MTA           0x5200  // 128 entries
+#define E1000_RAL           0x5400
+#define E1000_RAH           0x5404
+
+#define E1000_CTRL_LRST     (1 << 3)
+#define E1000_CTRL_ASDE     (1 << 5)
+#define E1000_CTRL_SLU      (1 << 6)
+#define E1000_CTRL_ILOS     (1 << 7)
+#define E1000_CTRL_RST      (1 << 26)
+#define E1000_CTRL_PHY_RST  (1 << 31)
+
+#define E1000_EERD_START    0x01
+#define E1000_EERD_DONE     0x10
+#define E1000_EERD_ADDR_SHIFT 8
+#define E1000_EERD_DATA_SHIFT 16
+
+#define E1000_RAH_AV        (1 << 31)
+
+// interrupt causes
+#define E1000_ICR_TXDW      0x01
+#define E1000_ICR_LSC       0x04
+#define E1000_ICR_RXDMT0    0x10
+#define E1000_ICR_RXO       0x40
+#define E1000_ICR_RXT0      0x80
+
+// at most one interrupt per 256 ns * E1000_ITR_INTERVAL, about 8000 a second
+#define E1000_ITR_INTERVAL  488
+
+#define E1000_RCTL_EN       (1 << 1)
+#define E1000_RCTL_BAM      (1 << 15)   // accept broadcast
+#define E1000_RCTL_SECRC    (1 << 26)   // strip the CRC
+// BSIZE 00 is 2048 byte buffers; without long packets the NIC writes 1522 at most
+
+#define E1000_TCTL_EN       (1 << 1)
+#define E1000_TCTL_PSP      (1 << 3)    // pad short packets
+#define E1000_TCTL_CT       (0x0F << 4)
+#define E1000_TCTL_COLD     (0x40 << 12)
+#define E1000_TIPG_DEFAULT  0x0060200A
+
+#define E1000_RXD_STAT_DD   0x01
+#define E1000_RXD_STAT_EOP  0x02
+#define E1000_TXD_CMD_EOP   0x01
+#define E1000_TXD_CMD_IFCS  0x02
+#define E1000_TXD_CMD_RS    0x08
+#define E1000_TXD_STAT_DD   0x01
+
+typedef struct {
+    uint32 addr_low, addr_high;
+    uint16 length;
+    uint16 checksum;
+    volatile uint8 status;
+    uint8 errors;
+    uint16 special;
+} __attribute__((packed)) E1000_RX_DESC;
+
+typedef struct {
+    uint32 addr_low, addr_high;
+    uint16 length;
+    uint8 cso;
+    uint8 cmd;
+    volatile uint8 status;
+    uint8 css;
+    uint16 special;
+} __attribute__((packed)) E1000_TX_DESC;
+
+/**
+ * register the driver, NICs are probed by pci_register_driver()
+ */
+void e1000_init(void);
+
+#endif
@@ -0,0 +1,63 @@
+/**
+ * ELF32 executable loader
+ * for more, see the System V ABI, chapter 4 and 5
+ */
+
+#ifndef ELF_H
+#define ELF_H
+
+#include "types.h"
+#include "vm.h"
+#include "filesystem.h"
+
+#define ELF_MAGIC       0x464C457F  // "\x7FELF" read as little endian
+#define ELF_CLASS_32    1
+#define ELF_DATA_LSB    1
+#define ELF_TYPE_EXEC   2
+#define ELF_MACHINE_386 3
+
+#define ELF_PT_LOAD     1
+
+#define ELF_PF_X        0x1
+#define ELF_PF_W        0x2
+#define ELF_PF_R        0x4
+
+typedef struct {
+    uint32 magic;
+    uint8 class;
+    uint8 data;
+    uint8 version;
+    uint8 pad[9];
+    uint16 type;
+    uint16 machine;
+    uint32 elf_version;
+    uint32 entry;
+    uint32 phoff;           // program header table offset
+    uint32 shoff;
+    uint32 flags;
+    uint16 ehsize;
+    uint16 phentsize;
+    uint16 phnum;
+    uint16 shentsize;
+    uint16 shnum;
+    uint16 shstrndx;
+} __attribute__((packed)) ELF32_HEADER;
+
+typedef struct {
+    uint32 type;
+    uint32 offset;
+    uint32 vaddr;
+    uint32 paddr;
+    uint32 filesz;
+    uint32 memsz;
+    uint32 flags;           // ELF_PF_*
+    uint32 align;
+} __attribute__((packed)) ELF32_PROGRAM_HEADER;
+
+/**
+ * add a lazily paged region to as for every PT_LOAD segment of file,
+ * entry gets the start address and image_end the end of the highest segment
+ */
+BOOL elf_load(ADDRESS_SPACE *as, FileNode *file, uint32 *entry, uint32 *image_end);
+
+#endif
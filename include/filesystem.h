@@ -15,6 +15,9 @@ typedef struct FileNode {
     struct FileNode* parent;
     struct FileNode* children[MAX_FILES];
     uint32 child_count;
+    uint8* data;        // file contents, NULL for directories and empty files
+    uint32 capacity;    // allocated size of data
+    uint32 version;     // bumped on every change, invalidates cached pages
 } FileNode;
 
 // Filesystem operations
@@ -26,6 +29,12 @@ void fs_ls(const char* path);
 FileNode* fs_get_current_dir(void);
 void fs_print_working_directory(void);
 
+// File operations
+FileNode* fs_create_file(const char* path);
+int fs_write(FileNode* node, const void* buffer, uint32 size, BOOL append);
+int fs_write_at(FileNode* node, uint32 offset, const void* buffer, uint32 size);
+int fs_read(FileNode* node, uint32 offset, void* buffer, uint32 size);
+
 // Path manipulation
 char* fs_get_absolute_path(const char* relative_path);
 FileNode* fs_path_to_node(const char* path);
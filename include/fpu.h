@@ -0,0 +1,75 @@
+/**
+ * x87 and SSE state of tasks, saved lazily
+ * CR0.TS is set whenever a cpu switches to a task whose registers aren't
+ * loaded, so a task that never touches the FPU never pays for saving it
+ */
+
+#ifndef FPU_H
+#define FPU_H
+
+#include "types.h"
+
+struct TASK;
+
+#define FPU_AREA_SIZE           512     // FXSAVE image, FNSAVE needs 108
+#define FPU_AREA_ALIGN          16
+#define FPU_NM_VECTOR           7       // device not available
+
+#define CR0_MP                  (1 << 1)
+#define CR0_EM                  (1 << 2)
+#define CR0_TS                  (1 << 3)
+#define CR0_NE                  (1 << 5)
+#define CR4_OSFXSR              (1 << 9)
+#define CR4_OSXMMEXCPT          (1 << 10)
+
+#define FPU_FCW_DEFAULT         0x037F  // all x87 exceptions masked
+#define FPU_MXCSR_DEFAULT       0x1F80  // all SSE exceptions masked
+#define FPU_KERNEL_XMM          4       // xmm0 to xmm3
+
+// what fpu_kernel_end() puts back
+typedef struct {
+    uint8 xmm[FPU_KERNEL_XMM][16];
+    uint32 flags;
+    BOOL ts;
+} FPU_KERNEL_STATE;
+
+/**
+ * enable SSE when the cpu has it, take over #NM, and set up the boot cpu
+ */
+void fpu_init(void);
+
+/**
+ * same for an application processor, after fpu_init() on the boot cpu
+ */
+void fpu_init_cpu(void);
+
+/**
+ * TRUE when FXSAVE and SSE are enabled
+ */
+BOOL fpu_sse_enabled(void);
+
+/**
+ * let the kernel use xmm0 to xmm3 until fpu_kernel_end(), with interrupts
+ * off. whichever task's registers they hold get them back unchanged
+ */
+void fpu_kernel_begin(FPU_KERNEL_STATE *state);
+
+void fpu_kernel_end(FPU_KERNEL_STATE *state);
+
+/**
+ * called by the scheduler before switching to next: leave the registers
+ * as they are, next gets them back on its first FPU instruction
+ */
+void fpu_switch(struct TASK *next);
+
+/**
+ * give the child of a fork a copy of the parent's state
+ */
+BOOL fpu_fork(struct TASK *parent, struct TASK *child);
+
+/**
+ * forget task as the owner of this cpu's registers, it is exiting
+ */
+void fpu_exit(struct TASK *task);
+
+#endif
@@ -6,8 +6,18 @@
 #define GDT_H
 
 #include "types.h"
+#include "cpu.h"
 
-#define NO_GDT_DESCRIPTORS     8
+// null, kernel and user code/data, then one TSS per cpu
+#define GDT_TSS_BASE           5
+#define NO_GDT_DESCRIPTORS     (GDT_TSS_BASE + CPU_MAX)
+
+// segment selectors, user ones with requested privilege level 3
+#define KERNEL_CODE_SELECTOR   0x08
+#define KERNEL_DATA_SELECTOR   0x10
+#define USER_CODE_SELECTOR     0x1B
+#define USER_DATA_SELECTOR     0x23
+#define TSS_SELECTOR(cpu)      ((GDT_TSS_BASE + (cpu)) * 8)
 
 typedef struct {
     uint16 segment_limit;  // segment limit first 0-15 bits
@@ -23,8 +33,23 @@ typedef struct {
     uint32 base_address;  // base address of the first GDT segment
 } __attribute__((packed)) GDT_PTR;
 
+// task state segment, only used to find the kernel stack on a ring 3 -> 0 switch
+typedef struct {
+    uint32 prev_tss;
+    uint32 esp0;        // kernel stack pointer loaded on privilege change
+    uint32 ss0;         // kernel stack segment
+    uint32 esp1, ss1, esp2, ss2;
+    uint32 cr3, eip, eflags;
+    uint32 eax, ecx, edx, ebx, esp, ebp, esi, edi;
+    uint32 es, cs, ss, ds, fs, gs;
+    uint32 ldt;
+    uint16 trap;
+    uint16 iomap_base;
+} __attribute__((packed)) TSS;
+
 // asm gdt functions, define in load_gdt.asm
 extern void load_gdt(uint32 gdt_ptr);
+extern void load_tss(uint16 selector);
 
 /**
  * fill entries of GDT 
@@ -34,4 +59,14 @@ void gdt_set_entry(int index, uint32 base, uint32 limit, uint8 access, uint8 gra
 // initialize GDT
 void gdt_init();
 
+/**
+ * load the GDT and the cpu's own TSS on an application processor
+ */
+void gdt_load_cpu(uint32 cpu);
+
+/**
+ * set stack used when an interrupt or syscall enters the kernel from ring 3 on cpu
+ */
+void tss_set_kernel_stack(uint32 cpu, uint32 esp0);
+
 #endif
@@ -0,0 +1,44 @@
+/**
+ * High Precision Event Timer: a free running main counter at a fixed rate
+ * of at least 10 MHz, found through the ACPI HPET table.
+ * for more, see the IA-PC HPET specification
+ */
+
+#ifndef HPET_H
+#define HPET_H
+
+#include "types.h"
+
+#define HPET_MMIO_SIZE          1024
+
+// register offsets
+#define HPET_CAPABILITIES       0x000   // counter period in femtoseconds in the high half
+#define HPET_CONFIG             0x010
+#define HPET_COUNTER            0x0F0
+
+#define HPET_CAP_COUNTER_64     (1 << 13)
+#define HPET_CONFIG_ENABLE      0x1
+#define HPET_MAX_PERIOD_FS      100000000   // 10 MHz
+#define FSEC_PER_SEC            1000000000000000ULL
+
+/**
+ * map and start the main counter, FALSE without a usable HPET
+ */
+BOOL hpet_init(void);
+
+/**
+ * main counter, 0 before hpet_init()
+ */
+uint64 hpet_read(void);
+
+/**
+ * counter frequency in Hz, 0 without a HPET
+ */
+uint64 hpet_hz(void);
+
+/**
+ * TRUE when the main counter has 64 bits, otherwise it wraps at 32
+ */
+BOOL hpet_counter_64(void);
+
+#endif
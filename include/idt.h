@@ -33,4 +33,9 @@ void idt_set_entry(int index, uint32 base, uint16 seg_sel, uint8 flags);
 
 void idt_init();
 
+/**
+ * load the shared IDT on an application processor
+ */
+void idt_load_cpu(void);
+
 #endif
@@ -0,0 +1,46 @@
+/**
+ * Addresses, byte order and checksums of IPv4
+ * nothing here touches a NIC, so it also builds for the host tests
+ */
+
+#ifndef INET_H
+#define INET_H
+
+#include "types.h"
+
+#define IP_PROTO_ICMP           1
+#define IP_PROTO_UDP            17
+
+// addresses are kept in network byte order
+typedef uint32 IP_ADDR;
+
+#define IP4(a, b, c, d)         ((uint32)(a) | (uint32)(b) << 8 | (uint32)(c) << 16 | (uint32)(d) << 24)
+#define IP_BROADCAST            0xFFFFFFFF
+
+static inline uint16 htons(uint16 value) {
+    return (uint16)(value << 8 | value >> 8);
+}
+
+static inline uint32 htonl(uint32 value) {
+    return __builtin_bswap32(value);
+}
+
+#define ntohs(value)            htons(value)
+#define ntohl(value)            htonl(value)
+
+/**
+ * dotted quad to an address, FALSE if str isn't one
+ */
+BOOL ip_parse(const char *str, IP_ADDR *addr);
+
+/**
+ * checksum of a TCP or UDP segment, with the pseudo header in front
+ */
+uint16 ip_pseudo_checksum(IP_ADDR src, IP_ADDR dst, uint8 proto, const void *data, uint16 len);
+
+/**
+ * checksum field of a UDP segment of len bytes whose own field is 0
+ */
+uint16 udp_checksum(IP_ADDR src, IP_ADDR dst, const void *segment, uint16 len);
+
+#endif
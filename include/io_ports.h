@@ -33,4 +33,10 @@ uint32 inportl(uint16 port);
  */
 void outportl(uint16 port, uint32 data);
 
+/**
+ * busy wait roughly us microseconds, a write to the unused
+ * POST code port 0x80 takes about one
+ */
+void io_wait_us(uint32 us);
+
 #endif
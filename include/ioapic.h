@@ -0,0 +1,59 @@
+/**
+ * IO-APIC: routes device interrupts to the local APICs,
+ * replacing the 8259 pair once it is set up
+ * for more, see the 82093AA IO-APIC datasheet
+ */
+
+#ifndef IOAPIC_H
+#define IOAPIC_H
+
+#include "types.h"
+
+// indirect register access through a select and a window register
+#define IOAPIC_REGSEL           0x00
+#define IOAPIC_WINDOW           0x10
+
+#define IOAPIC_REG_ID           0x00
+#define IOAPIC_REG_VERSION      0x01    // bits 16-23: highest redirection entry
+#define IOAPIC_REG_REDIRECT     0x10    // two registers per entry
+
+// redirection entry, low dword
+#define IOAPIC_ACTIVE_LOW       0x02000
+#define IOAPIC_LEVEL            0x08000
+#define IOAPIC_MASKED           0x10000
+
+// MPS INTI flags of an interrupt source override
+#define ACPI_POLARITY_MASK      0x3
+#define ACPI_POLARITY_LOW       0x3
+#define ACPI_TRIGGER_MASK       0xC
+#define ACPI_TRIGGER_LEVEL      0xC
+
+#define IOAPIC_LEGACY_IRQS      16
+
+/**
+ * route the ISA irqs through the IO-APICs of the MADT to the boot cpu
+ * and mask the 8259, FALSE (and the 8259 stays) without an IO-APIC
+ */
+BOOL ioapic_init(void);
+
+/**
+ * TRUE once device interrupts come through the IO-APIC
+ */
+BOOL ioapic_active(void);
+
+/**
+ * deliver ISA irq to the cpu with the given index
+ */
+BOOL ioapic_set_affinity(uint8 irq, uint32 cpu);
+
+/**
+ * index of the cpu ISA irq is delivered to
+ */
+uint32 ioapic_affinity(uint8 irq);
+
+/**
+ * mask or unmask ISA irq
+ */
+void ioapic_mask(uint8 irq, BOOL masked);
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * IPv4 and ICMP echo
+ * for more, see RFC 791 and RFC 792
+ */
+
+#ifndef IP_H
+#define IP_H
+
+#include "types.h"
+#include "net.h"
+
+#define IP_VERSION_IHL          0x45    // version 4, no options
+#define IP_TTL                  64
+#define IP_FRAGMENT_MASK        0x3FFF  // more fragments and the offset
+#define IP_MAX_PAYLOAD          (ETH_MAX_FRAME - ETH_HEADER_SIZE - sizeof(IP_HEADER))
+
+#define ICMP_ECHO_REPLY         0
+#define ICMP_ECHO_REQUEST       8
+#define ICMP_PING_ID            0x534D
+#define ICMP_PING_DATA          32
+
+typedef struct {
+    uint8 version_ihl;
+    uint8 tos;
+    uint16 len;
+    uint16 id;
+    uint16 fragment;
+    uint8 ttl;
+    uint8 proto;
+    uint16 checksum;
+    IP_ADDR src;
+    IP_ADDR dst;
+} __attribute__((packed)) IP_HEADER;
+
+typedef struct {
+    uint8 type;
+    uint8 code;
+    uint16 checksum;
+    uint16 id;
+    uint16 seq;
+} __attribute__((packed)) ICMP_ECHO;
+
+/**
+ * an IP packet arrived, buf starts at its header
+ */
+void ip_receive(NETBUF *buf);
+
+/**
+ * put an IP header in front of the payload in buf and send it to dst,
+ * buf is gone afterwards either way
+ */
+BOOL ip_send(NETBUF *buf, IP_ADDR dst, uint8 proto);
+
+/**
+ * send echo request seq to dst and wait for the reply,
+ * returns the round trip in microseconds or -1 after timeout_ms
+ */
+sint32 icmp_ping(IP_ADDR dst, uint16 seq, uint32 timeout_ms);
+
+#endif
@@ -19,6 +19,42 @@ typedef struct {
 // ISR function prototype
 typedef void (*ISR)(REGISTERS *);
 
+// interrupt accounting: the 16 ISA irqs, the local APIC vectors from 0xF0,
+// then the MSI vectors
+#define IRQ_STAT_SLOTS          48
+#define IRQ_STAT_APIC_BASE      0xF0
+#define IRQ_STAT_MSI_SLOT       32
+#define IRQ_HIST_BUCKETS        16      // handler cycles, powers of two from 2^8
+
+#define ISR_SHARED_HANDLERS     4       // drivers on one INTx line
+
+typedef struct {
+    uint32 count;
+    uint64 cycles;              // spent in the handler, EOI included
+    uint32 max_cycles;
+    uint64 last_tsc;            // time stamp of the latest occurrence
+    uint32 histogram[IRQ_HIST_BUCKETS];
+} IRQ_STATS;
+
+#define EFLAGS_IF   0x200   // interrupt enable flag
+
+/**
+ * disable interrupts, returning the previous eflags for irq_restore()
+ */
+static inline uint32 irq_save(void) {
+    uint32 flags;
+    asm volatile("pushf\n\tpop %0\n\tcli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+/**
+ * re-enable interrupts if they were on when irq_save() was called
+ */
+static inline void irq_restore(uint32 flags) {
+    if (flags & EFLAGS_IF)
+        asm volatile("sti" ::: "memory");
+}
+
 /**
  * register given handler to interrupt handlers at given num
  */
@@ -41,6 +77,37 @@ void isr_exception_handler(REGISTERS reg);
  */
 void isr_irq_handler(REGISTERS *reg);
 
+/**
+ * hand out a free MSI vector for handler, -1 when all are taken
+ */
+sint32 isr_alloc_vector(ISR handler);
+
+/**
+ * give a vector from isr_alloc_vector() back
+ */
+void isr_free_vector(uint32 vector);
+
+/**
+ * add handler to the ones called for a level triggered line, FALSE if the
+ * line has an unshared handler or no room for another
+ */
+BOOL isr_share_interrupt_handler(uint32 line, ISR handler);
+
+/**
+ * counters of vector summed over the cpus, FALSE if it isn't tracked
+ */
+BOOL isr_irq_stats(uint32 vector, IRQ_STATS *stats);
+
+/**
+ * zero every interrupt counter
+ */
+void isr_irq_stats_reset(void);
+
+/**
+ * collect the handler time histograms too, off by default
+ */
+void isr_irq_histogram(BOOL enable);
+
 
 // defined in exception.asm
 extern void exception_0();
@@ -94,6 +161,25 @@ extern void irq_12();
 extern void irq_13();
 extern void irq_14();
 extern void irq_15();
+extern void apic_irq_80();
+extern void apic_irq_81();
+extern void apic_irq_82();
+extern void apic_irq_83();
+extern void apic_irq_84();
+extern void apic_irq_85();
+extern void apic_irq_86();
+extern void apic_irq_87();
+extern void apic_irq_88();
+extern void apic_irq_89();
+extern void apic_irq_90();
+extern void apic_irq_91();
+extern void apic_irq_92();
+extern void apic_irq_93();
+extern void apic_irq_94();
+extern void apic_irq_95();
+extern void apic_irq_240();
+extern void apic_irq_241();
+extern void apic_spurious();
 
 // IRQ default constants
 #define IRQ_BASE            0x20
@@ -113,6 +199,11 @@ extern void irq_15();
 #define IRQ13_FPU           0x0D
 #define IRQ14_HARD_DISK     0x0E
 #define IRQ15_RESERVED      0x0F
+#define IRQ_LEGACY_END      (IRQ_BASE + 16)     // vectors above come from the local APIC
+
+// message signalled interrupts, every device gets its own
+#define MSI_VECTOR_BASE     0x50
+#define MSI_VECTORS         16
 
 
 #endif
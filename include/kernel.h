@@ -15,6 +15,15 @@ extern uint8 __kernel_rodata_section_end;
 extern uint8 __kernel_bss_section_start;
 extern uint8 __kernel_bss_section_end;
 
+// read cpu brand, print it and the basic cpuid leaves when print is set
+int cpuid_info(int print);
+
+// power off through ACPI S5, or the hypervisor's fixed port without it
+void shutdown();
+
+// reset through the ACPI reset register, or the keyboard controller
+void reboot();
+
 #endif
 
 
@@ -1,6 +1,8 @@
 #ifndef KEYBOARD_H
 #define KEYBOARD_H
 
+#include "types.h"
+
 #define KEYBOARD_DATA_PORT      0x60
 #define KEYBOARD_STATUS_PORT    0x64
 #define KEYBOARD_COMMAND_PORT   0x64
@@ -95,6 +97,12 @@
 #define SCAN_CODE_KEY_F11         0x57
 #define SCAN_CODE_KEY_F12         0x58
 
+// key press delivered from the interrupt handler to readers
+typedef struct {
+    char ch;            // translated character, 0 for non-printing keys
+    uint8 scancode;
+} KEY_EVENT;
+
 void keyboard_init();
 
 // Get raw keyboard scan code without blocking
@@ -109,5 +117,8 @@ char kb_get_scancode();
 // get key with special handling for control keys
 int kb_getkey();
 
+// Non-blocking character read, 0 when no key is queued
+char keyboard_read();
+
 #endif
 
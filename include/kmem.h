@@ -0,0 +1,28 @@
+/**
+ * Kernel allocator: per-cpu magazines of small objects in front of the
+ * shared heap, after Bonwick and Adams, "Magazines and Vmem" (2001)
+ */
+
+#ifndef KMEM_H
+#define KMEM_H
+
+#include "types.h"
+
+#define KMEM_CLASSES        8       // 16 to 2048 bytes, powers of two
+#define KMEM_MIN_SIZE       16
+#define KMEM_MAGAZINE_SIZE  15      // objects per magazine
+#define KMEM_DEPOT_MAX      8       // full magazines kept per class before flushing
+
+typedef struct {
+    uint32 size;                // object size of the class
+    uint32 hits;                // served from a cpu's magazines
+    uint32 misses;              // went to the depot or the heap
+    uint32 full;                // full magazines in the depot
+} KMEM_STATS;
+
+/**
+ * counters of size class
+ */
+void kmem_stats(uint32 class, KMEM_STATS *stats);
+
+#endif
@@ -0,0 +1,31 @@
+/**
+ * Kernel symbol table, generated from the first link of the kernel by
+ * config/ksyms.awk and linked into the second (see the Makefile)
+ */
+
+#ifndef KSYMS_H
+#define KSYMS_H
+
+#include "types.h"
+
+typedef struct {
+    uint32 addr;
+    const char *name;
+} KSYM;
+
+/**
+ * number of functions in the table, 0 when the kernel was linked without one
+ */
+uint32 ksym_count(void);
+
+/**
+ * function at index, in address order
+ */
+const KSYM *ksym_get(uint32 index);
+
+/**
+ * index of the function containing addr, -1 outside the kernel's code
+ */
+sint32 ksym_index(uint32 addr);
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ * Local APIC, one per cpu: its id, end of interrupt and inter processor interrupts
+ * for more, see Intel SDM volume 3, chapter 10
+ */
+
+#ifndef LAPIC_H
+#define LAPIC_H
+
+#include "types.h"
+
+#define LAPIC_DEFAULT_BASE      0xFEE00000
+
+// register offsets
+#define LAPIC_ID                0x020
+#define LAPIC_VERSION           0x030
+#define LAPIC_TPR               0x080   // task priority
+#define LAPIC_EOI               0x0B0
+#define LAPIC_SVR               0x0F0   // spurious interrupt vector
+#define LAPIC_ESR               0x280   // error status
+#define LAPIC_ICR_LOW           0x300   // interrupt command
+#define LAPIC_ICR_HIGH          0x310
+#define LAPIC_LVT_TIMER         0x320
+#define LAPIC_LVT_LINT0         0x350
+#define LAPIC_LVT_LINT1         0x360
+#define LAPIC_LVT_ERROR         0x370
+#define LAPIC_TIMER_INITIAL     0x380
+#define LAPIC_TIMER_CURRENT     0x390
+#define LAPIC_TIMER_DIVIDE      0x3E0
+
+#define LAPIC_SVR_ENABLE        0x100
+#define LAPIC_LVT_MASKED        0x10000
+#define LAPIC_TIMER_PERIODIC    0x20000
+#define LAPIC_TIMER_DIVIDE_16   0x3
+
+// interrupt command bits
+#define LAPIC_ICR_FIXED         0x00000
+#define LAPIC_ICR_INIT          0x00500
+#define LAPIC_ICR_STARTUP       0x00600
+#define LAPIC_ICR_PENDING       0x01000 // delivery status
+#define LAPIC_ICR_ASSERT        0x04000
+#define LAPIC_ICR_LEVEL         0x08000
+
+// vectors above the 8259 range
+#define IPI_RESCHEDULE_VECTOR   0xF0    // wake a cpu to look at its run queue
+#define LAPIC_TIMER_VECTOR      0xF1    // the kernel tick, see timer.h
+#define LAPIC_SPURIOUS_VECTOR   0xFF
+
+/**
+ * map the local APIC registers at phys and enable the boot cpu's
+ */
+void lapic_init(uint32 phys);
+
+/**
+ * enable the local APIC of the calling cpu
+ */
+void lapic_init_cpu(void);
+
+/**
+ * TRUE once lapic_init() ran
+ */
+BOOL lapic_present(void);
+
+/**
+ * APIC id of the calling cpu
+ */
+uint8 lapic_id(void);
+
+/**
+ * acknowledge the interrupt being handled
+ */
+void lapic_eoi(void);
+
+/**
+ * send vector to the cpu with the given APIC id
+ */
+void lapic_send_ipi(uint8 apic_id, uint8 vector);
+
+/**
+ * INIT, then two STARTUP IPIs making the cpu run real mode code at page
+ */
+void lapic_start_cpu(uint8 apic_id, uint32 page);
+
+/**
+ * make the calling cpu's timer count down from count at bus clock / 16,
+ * raising vector every time it reaches 0, or once if periodic is FALSE
+ */
+void lapic_timer_start(uint8 vector, uint32 count, BOOL periodic);
+
+/**
+ * remaining count of the calling cpu's timer
+ */
+uint32 lapic_timer_current(void);
+
+/**
+ * stop the calling cpu's timer
+ */
+void lapic_timer_stop(void);
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * Typed message queues
+ * bounded FIFO of fixed size messages with blocking send/receive
+ */
+
+#ifndef MSGQ_H
+#define MSGQ_H
+
+#include "types.h"
+#include "waitq.h"
+
+typedef struct {
+    uint8 *buffer;
+    uint32 msg_size;        // bytes per message
+    uint32 capacity;        // maximum queued messages
+    uint32 head;            // index of the oldest message
+    volatile uint32 count;  // queued messages
+    BOOL owns_buffer;       // buffer came from msgq_create()
+    WAITQ receivers;        // waiting for a message
+    WAITQ senders;          // waiting for a free slot
+} MSGQ;
+
+/**
+ * set up a queue over caller provided storage of msg_size * capacity bytes
+ */
+void msgq_init(MSGQ *q, void *storage, uint32 msg_size, uint32 capacity);
+
+/**
+ * allocate a queue and its storage from the heap
+ */
+MSGQ *msgq_create(uint32 msg_size, uint32 capacity);
+
+void msgq_destroy(MSGQ *q);
+
+/**
+ * copy msg into the queue, sleeping while it is full
+ */
+void msgq_send(MSGQ *q, const void *msg);
+
+/**
+ * copy the oldest message into msg, sleeping while the queue is empty
+ */
+void msgq_receive(MSGQ *q, void *msg);
+
+/**
+ * non-blocking variants, safe from interrupt handlers,
+ * return FALSE when the queue is full / empty
+ */
+BOOL msgq_try_send(MSGQ *q, const void *msg);
+BOOL msgq_try_receive(MSGQ *q, void *msg);
+
+#endif
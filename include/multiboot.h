@@ -0,0 +1,45 @@
+/**
+ * Multiboot information passed by GRUB in ebx
+ * for more, see https://www.gnu.org/software/grub/manual/multiboot/multiboot.html
+ */
+
+#ifndef MULTIBOOT_H
+#define MULTIBOOT_H
+
+#include "types.h"
+
+#define MULTIBOOT_INFO_MEMORY   0x001   // mem_lower/mem_upper are valid
+#define MULTIBOOT_INFO_CMDLINE  0x004   // cmdline is valid
+#define MULTIBOOT_INFO_MODS     0x008   // mods_count/mods_addr are valid
+#define MULTIBOOT_INFO_MEM_MAP  0x040   // mmap_length/mmap_addr are valid
+
+#define MULTIBOOT_MEMORY_AVAILABLE  1
+
+typedef struct {
+    uint32 flags;
+    uint32 mem_lower;       // KB of memory below 1MB
+    uint32 mem_upper;       // KB of memory above 1MB
+    uint32 boot_device;
+    uint32 cmdline;
+    uint32 mods_count;
+    uint32 mods_addr;       // array of MULTIBOOT_MODULE
+    uint32 syms[4];
+    uint32 mmap_length;
+    uint32 mmap_addr;       // list of MULTIBOOT_MMAP_ENTRY
+} __attribute__((packed)) MULTIBOOT_INFO;
+
+typedef struct {
+    uint32 mod_start;
+    uint32 mod_end;
+    uint32 cmdline;         // string given after the module path in grub.cfg
+    uint32 reserved;
+} __attribute__((packed)) MULTIBOOT_MODULE;
+
+typedef struct {
+    uint32 size;            // size of the entry, not counting this field
+    uint32 addr_low, addr_high;
+    uint32 len_low, len_high;
+    uint32 type;
+} __attribute__((packed)) MULTIBOOT_MMAP_ENTRY;
+
+#endif
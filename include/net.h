@@ -0,0 +1,65 @@
+/**
+ * IPv4 networking over the first NIC: ethernet framing and the address
+ * the interface has. above it sit arp.h, ip.h and udp.h, addresses and
+ * byte order are in inet.h
+ */
+
+#ifndef NET_H
+#define NET_H
+
+#include "types.h"
+#include "netdev.h"
+#include "inet.h"
+
+#define ETH_TYPE_IP             0x0800
+#define ETH_TYPE_ARP            0x0806
+
+// what QEMU's user networking hands out
+#define NET_DEFAULT_ADDR        IP4(10, 0, 2, 15)
+#define NET_DEFAULT_NETMASK     IP4(255, 255, 255, 0)
+#define NET_DEFAULT_GATEWAY     IP4(10, 0, 2, 2)
+
+typedef struct {
+    uint8 dst[ETH_ALEN];
+    uint8 src[ETH_ALEN];
+    uint16 type;
+} __attribute__((packed)) ETH_HEADER;
+
+typedef struct {
+    NET_DEVICE *dev;            // NULL without a NIC
+    IP_ADDR addr;
+    IP_ADDR netmask;
+    IP_ADDR gateway;
+} NET_CONFIG;
+
+typedef struct {
+    uint32 ip_in, ip_out, ip_dropped;
+    uint32 icmp_echo;           // requests answered
+    uint32 udp_in, udp_out, udp_dropped;
+    uint32 arp_requests, arp_replies;
+} NET_STATS;
+
+/**
+ * take the frames of the first NIC with the default address, after the
+ * NIC drivers probed. FALSE without a NIC
+ */
+BOOL net_init(void);
+
+/**
+ * the interface's address
+ */
+NET_CONFIG *net_config(void);
+
+void net_configure(IP_ADDR addr, IP_ADDR netmask, IP_ADDR gateway);
+
+/**
+ * counters of every layer
+ */
+NET_STATS *net_stats(void);
+
+/**
+ * put an ethernet header in front of buf and send it, buf is gone afterwards
+ */
+BOOL net_send(NETBUF *buf, const uint8 *dst, uint16 type);
+
+#endif
@@ -0,0 +1,58 @@
+/**
+ * Packet buffers: a fixed pool of DMA-able buffers that carry a frame from
+ * the NIC ring through the protocol stack, or back down, without a copy
+ */
+
+#ifndef NETBUF_H
+#define NETBUF_H
+
+#include "types.h"
+
+#define NETBUF_COUNT        512
+#define NETBUF_SIZE         2048    // two per page frame, never crossing one
+#define NETBUF_HEADROOM     64      // room to push headers in front of the data
+
+struct NET_DEVICE;
+
+typedef struct NETBUF {
+    uint8 *head;                // NETBUF_SIZE bytes, physically contiguous
+    uint8 *data;                // first byte of the frame
+    uint32 len;
+    struct NET_DEVICE *dev;     // received on
+    struct NETBUF *next;        // free list, then whoever owns the buffer
+} NETBUF;
+
+/**
+ * take the pool's page frames, before the NIC drivers probe
+ */
+BOOL netbuf_init(void);
+
+/**
+ * empty buffer with NETBUF_HEADROOM free in front, NULL when the pool is dry.
+ * safe from interrupt handlers
+ */
+NETBUF *netbuf_alloc(void);
+
+void netbuf_free(NETBUF *buf);
+
+/**
+ * grow the frame by len bytes at the front, returns the new start
+ */
+uint8 *netbuf_push(NETBUF *buf, uint32 len);
+
+/**
+ * strip len bytes off the front, returns the new start
+ */
+uint8 *netbuf_pull(NETBUF *buf, uint32 len);
+
+/**
+ * bytes after the frame's start that still fit the buffer
+ */
+uint32 netbuf_tailroom(const NETBUF *buf);
+
+/**
+ * buffers left in the pool, and allocations that found it empty
+ */
+void netbuf_stats(uint32 *free_bufs, uint32 *failed);
+
+#endif
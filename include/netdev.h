@@ -0,0 +1,89 @@
+/**
+ * Network devices: NICs by name, the task that polls each of them, and
+ * the hook that takes received frames up the stack
+ */
+
+#ifndef NETDEV_H
+#define NETDEV_H
+
+#include "types.h"
+#include "netbuf.h"
+#include "waitq.h"
+
+#define NETDEV_MAX_DEVICES      2
+#define NETDEV_NAME_SIZE        8
+#define NETDEV_BUDGET           64      // frames per poll before other tasks run
+#define ETH_ALEN                6
+#define ETH_HEADER_SIZE         14
+#define ETH_MIN_FRAME           60      // without the CRC the NIC appends
+#define ETH_MAX_FRAME           1514
+
+struct NET_DEVICE;
+
+// takes buf, FALSE when the ring is full and buf is still the caller's
+typedef BOOL (*NETDEV_TRANSMIT)(struct NET_DEVICE *dev, NETBUF *buf);
+
+// hand up to budget received frames to netdev_receive() and reclaim
+// transmitted buffers, returns the frames received
+typedef uint32 (*NETDEV_POLL)(struct NET_DEVICE *dev, uint32 budget);
+
+// turn the device's interrupts on or off. turning them on returns TRUE
+// when frames arrived that no interrupt will announce
+typedef BOOL (*NETDEV_IRQ)(struct NET_DEVICE *dev, BOOL on);
+
+// gets every received frame, in the poll task, and owns it afterwards
+typedef void (*NETDEV_RECEIVE)(struct NET_DEVICE *dev, NETBUF *buf);
+
+typedef struct NET_DEVICE {
+    char name[NETDEV_NAME_SIZE];
+    uint8 mac[ETH_ALEN];
+    const char *driver;
+    NETDEV_TRANSMIT transmit;
+    NETDEV_POLL poll;
+    NETDEV_IRQ irq;
+    void *driver_data;
+    WAITQ poll_wait;
+    volatile BOOL poll_scheduled;   // interrupts stay off while set
+    uint32 rx_packets, rx_bytes, rx_dropped;
+    uint32 tx_packets, tx_bytes, tx_dropped;
+    uint32 interrupts;
+    uint32 polls;
+} NET_DEVICE;
+
+/**
+ * add dev as eth0, eth1, ... and start its poll task
+ */
+BOOL netdev_register(NET_DEVICE *dev);
+
+/**
+ * device by index, NULL past the last
+ */
+NET_DEVICE *netdev_get(uint32 index);
+
+/**
+ * device with name, NULL if there is none
+ */
+NET_DEVICE *netdev_find(const char *name);
+
+/**
+ * called by drivers from their interrupt handler: turn the device's
+ * interrupts off and let the poll task drain it
+ */
+void netdev_schedule(NET_DEVICE *dev);
+
+/**
+ * called by drivers from poll for a frame they received into buf
+ */
+void netdev_receive(NET_DEVICE *dev, NETBUF *buf);
+
+/**
+ * send the frame in buf, which is gone afterwards either way
+ */
+BOOL netdev_transmit(NET_DEVICE *dev, NETBUF *buf);
+
+/**
+ * let handler take received frames, they are dropped without one
+ */
+void netdev_set_receive(NETDEV_RECEIVE handler);
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * x86 two level paging
+ *
+ * kernel space : 0x00000000 - 0x3FFFFFFF identity mapped memory
+ *                0xC0000000 - 0xFFFFFFFF identity mapped device memory
+ * user space   : 0x40000000 - 0xBFFFFFFF private to each address space
+ */
+
+#ifndef PAGING_H
+#define PAGING_H
+
+#include "types.h"
+#include "pmm.h"
+
+#define PAGE_PRESENT        0x001
+#define PAGE_WRITE          0x002
+#define PAGE_USER           0x004
+#define PAGE_WRITE_THROUGH  0x008
+#define PAGE_NO_CACHE       0x010
+#define PAGE_ACCESSED       0x020
+#define PAGE_DIRTY          0x040
+#define PAGE_COW            0x200   // available to software: copy on write
+#define PAGE_FLAGS_MASK     0xFFF
+
+#define USER_BASE           0x40000000
+#define USER_TOP            0xC0000000
+
+#define PDE_INDEX(virt)     ((virt) >> 22)
+#define PTE_INDEX(virt)     (((virt) >> 12) & 0x3FF)
+
+// page fault error code bits
+#define PF_PRESENT          0x1     // protection violation, not a missing page
+#define PF_WRITE            0x2
+#define PF_USER             0x4
+
+/**
+ * identity map physical memory into the kernel directory and turn paging on
+ */
+void paging_init(void);
+
+/**
+ * directory holding the kernel mappings every address space shares
+ */
+uint32 *paging_kernel_directory(void);
+
+/**
+ * map page virt to frame phys, allocating a page table if needed
+ */
+BOOL paging_map(uint32 *directory, uint32 virt, uint32 phys, uint32 flags);
+
+/**
+ * remove mapping of virt, returns the page table entry it had (0 if none)
+ */
+uint32 paging_unmap(uint32 *directory, uint32 virt);
+
+/**
+ * page table entry for virt, 0 when unmapped
+ */
+uint32 paging_get_entry(uint32 *directory, uint32 virt);
+
+/**
+ * identity map uncached device memory in the kernel directory,
+ * pages that are already mapped are left alone
+ */
+void paging_map_mmio(uint32 phys, uint32 size);
+
+/**
+ * copy a kernel directory entry that appeared after directory was created,
+ * returns FALSE if the kernel doesn't map virt either
+ */
+BOOL paging_sync_kernel(uint32 *directory, uint32 virt);
+
+/**
+ * load directory into cr3 unless it is already active
+ */
+void paging_switch(uint32 *directory);
+
+uint32 *paging_current_directory(void);
+
+static inline void paging_invalidate(uint32 virt) {
+    asm volatile("invlpg (%0)" :: "r"(virt) : "memory");
+}
+
+#endif
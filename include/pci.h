@@ -0,0 +1,182 @@
+/**
+ * PCI bus: configuration space, device enumeration and driver matching
+ * for more, see the PCI Local Bus and PCI Express Base specifications
+ */
+
+#ifndef PCI_H
+#define PCI_H
+
+#include "types.h"
+#include "isr.h"
+
+#define PCI_MAX_DEVICES         64
+#define PCI_MAX_DRIVERS         8
+#define PCI_BARS                6
+#define PCI_ANY_ID              0xFFFF
+
+// configuration mechanism #1
+#define PCI_CONFIG_ADDRESS      0xCF8
+#define PCI_CONFIG_DATA         0xCFC
+#define PCI_CONFIG_ENABLE       0x80000000
+#define PCI_CONFIG_SIZE         256     // 4096 through ECAM
+#define PCI_ECAM_SIZE           4096
+
+// configuration header
+#define PCI_VENDOR_ID           0x00
+#define PCI_DEVICE_ID           0x02
+#define PCI_COMMAND             0x04
+#define PCI_STATUS              0x06
+#define PCI_REVISION            0x08
+#define PCI_PROG_IF             0x09
+#define PCI_SUBCLASS            0x0A
+#define PCI_CLASS               0x0B
+#define PCI_HEADER_TYPE         0x0E
+#define PCI_BAR0                0x10
+#define PCI_SECONDARY_BUS       0x19    // bridges
+#define PCI_SUBSYSTEM_VENDOR    0x2C
+#define PCI_SUBSYSTEM_ID        0x2E
+#define PCI_CAPABILITIES        0x34
+#define PCI_IRQ_LINE            0x3C
+#define PCI_IRQ_PIN             0x3D
+
+#define PCI_COMMAND_IO          0x0001
+#define PCI_COMMAND_MEMORY      0x0002
+#define PCI_COMMAND_MASTER      0x0004
+#define PCI_COMMAND_INTX_OFF    0x0400
+#define PCI_STATUS_CAPABILITIES 0x0010
+#define PCI_HEADER_MULTI        0x80
+#define PCI_HEADER_BRIDGE       0x01
+
+#define PCI_BAR_IO              0x1
+#define PCI_BAR_64              0x4     // memory BAR type bits 2:1 = 10
+#define PCI_BAR_PREFETCH        0x8
+
+// capabilities
+#define PCI_CAP_MSI             0x05
+#define PCI_CAP_VENDOR          0x09
+#define PCI_CAP_MSIX            0x11
+
+#define PCI_MSI_CONTROL         2
+#define PCI_MSI_ADDRESS         4
+#define PCI_MSI_ENABLE          0x0001
+#define PCI_MSI_64              0x0080
+#define PCI_MSI_MME_MASK        0x0070  // vectors enabled, log2
+
+#define PCI_MSIX_CONTROL        2
+#define PCI_MSIX_TABLE          4       // offset in a BAR, BAR index in bits 2:0
+#define PCI_MSIX_SIZE_MASK      0x07FF
+#define PCI_MSIX_FUNCTION_MASK  0x4000
+#define PCI_MSIX_ENABLE         0x8000
+#define PCI_MSIX_ENTRY_SIZE     16
+#define PCI_MSIX_VECTOR_MASKED  0x1
+
+// message address and data for the local APICs
+#define MSI_ADDRESS_BASE        0xFEE00000
+#define MSI_ADDRESS_DEST_SHIFT  12
+
+typedef struct {
+    uint32 base;                // physical address or port, 0 if unused
+    uint32 size;
+    BOOL io;
+    BOOL prefetchable;
+} PCI_BAR;
+
+struct PCI_DRIVER;
+
+typedef struct {
+    uint8 bus;
+    uint8 slot;
+    uint8 func;
+    uint16 vendor_id;
+    uint16 device_id;
+    uint16 subsystem_id;
+    uint8 class_code;
+    uint8 subclass;
+    uint8 prog_if;
+    uint8 revision;
+    uint8 header_type;
+    uint8 irq_line;             // legacy INTx as the firmware routed it
+    uint8 irq_pin;
+    PCI_BAR bars[PCI_BARS];
+    volatile uint8 *ecam;       // mapped configuration space, NULL for port access
+    uint8 msi_cap;              // offset of the capability, 0 if absent
+    uint8 msix_cap;
+    const struct PCI_DRIVER *driver;
+    void *driver_data;
+} PCI_DEVICE;
+
+typedef struct {
+    uint16 vendor_id;           // PCI_ANY_ID matches all
+    uint16 device_id;
+} PCI_ID;
+
+// probe is called for every device matching one of ids, TRUE claims it
+typedef struct PCI_DRIVER {
+    const char *name;
+    const PCI_ID *ids;          // ends with { 0, 0 }
+    BOOL (*probe)(PCI_DEVICE *dev);
+} PCI_DRIVER;
+
+/**
+ * enumerate the devices on every bus reachable from bus 0, after acpi_init()
+ */
+void pci_init(void);
+
+/**
+ * device by index, NULL past the last
+ */
+PCI_DEVICE *pci_get(uint32 index);
+
+/**
+ * first device with vendor and device id, NULL if there is none
+ */
+PCI_DEVICE *pci_find(uint16 vendor_id, uint16 device_id);
+
+/**
+ * configuration space of dev, offsets past 255 only through ECAM
+ */
+uint8 pci_read8(const PCI_DEVICE *dev, uint32 offset);
+
+uint16 pci_read16(const PCI_DEVICE *dev, uint32 offset);
+
+uint32 pci_read32(const PCI_DEVICE *dev, uint32 offset);
+
+void pci_write8(const PCI_DEVICE *dev, uint32 offset, uint8 value);
+
+void pci_write16(const PCI_DEVICE *dev, uint32 offset, uint16 value);
+
+void pci_write32(const PCI_DEVICE *dev, uint32 offset, uint32 value);
+
+/**
+ * turn on I/O and memory decoding, and bus mastering for DMA
+ */
+void pci_enable(PCI_DEVICE *dev, BOOL bus_master);
+
+/**
+ * identity map memory BAR bar uncached, NULL for an I/O or unusable BAR.
+ * the device decodes it once pci_enable() was called
+ */
+void *pci_map_bar(PCI_DEVICE *dev, uint32 bar);
+
+/**
+ * offset of the first capability with id, 0 if dev has none
+ */
+uint8 pci_find_capability(const PCI_DEVICE *dev, uint8 id);
+
+/**
+ * let dev raise one message signalled interrupt at handler on cpu.
+ * returns the vector, or -1 without MSI or free vectors
+ */
+sint32 pci_enable_msi(PCI_DEVICE *dev, ISR handler, uint32 cpu);
+
+/**
+ * same for entry of the MSI-X table, its other entries stay masked
+ */
+sint32 pci_enable_msix(PCI_DEVICE *dev, uint32 entry, ISR handler, uint32 cpu);
+
+/**
+ * offer every unclaimed device to driver, at pci_init() if it hasn't run yet
+ */
+BOOL pci_register_driver(const PCI_DRIVER *driver);
+
+#endif
@@ -0,0 +1,64 @@
+/**
+ * In-kernel pipe buffers
+ */
+
+#ifndef PIPE_H
+#define PIPE_H
+
+#include "types.h"
+#include "waitq.h"
+
+#define PIPE_DEFAULT_SIZE   4096
+
+typedef struct {
+    uint8 *buffer;
+    uint32 capacity;
+    uint32 head;            // next byte to read
+    volatile uint32 count;  // bytes currently buffered
+    volatile BOOL write_closed;  // no more data will come, readers get end of file
+    volatile BOOL read_closed;   // nobody reads anymore, writers fail
+    WAITQ readers;          // waiting for data
+    WAITQ writers;          // waiting for space
+} PIPE;
+
+/**
+ * allocate a pipe with a ring buffer of given capacity
+ */
+PIPE *pipe_create(uint32 capacity);
+
+/**
+ * free pipe and its buffer
+ */
+void pipe_destroy(PIPE *pipe);
+
+/**
+ * blocking write of size bytes, returns bytes written,
+ * short (or -1 if nothing was written) once the read end is closed
+ */
+int pipe_write(PIPE *pipe, const void *buffer, uint32 size);
+
+/**
+ * blocking read, waits until some data is buffered,
+ * returns bytes read or 0 at end of file
+ */
+int pipe_read(PIPE *pipe, void *buffer, uint32 size);
+
+/**
+ * non-blocking variants, safe from interrupt handlers,
+ * return the number of bytes actually transferred
+ */
+uint32 pipe_try_write(PIPE *pipe, const void *buffer, uint32 size);
+uint32 pipe_try_read(PIPE *pipe, void *buffer, uint32 size);
+
+/**
+ * close one end and wake whoever waits on the other
+ */
+void pipe_close_write(PIPE *pipe);
+void pipe_close_read(PIPE *pipe);
+
+/**
+ * number of bytes ready to be read
+ */
+uint32 pipe_available(PIPE *pipe);
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * Physical memory manager, hands out reference counted 4KB page frames
+ */
+
+#ifndef PMM_H
+#define PMM_H
+
+#include "types.h"
+#include "multiboot.h"
+
+#define PAGE_SIZE           4096
+#define PAGE_MASK           (~(PAGE_SIZE - 1))
+#define PAGE_ALIGN_DOWN(a)  ((a) & PAGE_MASK)
+#define PAGE_ALIGN_UP(a)    (((a) + PAGE_SIZE - 1) & PAGE_MASK)
+
+// managed memory, identity mapped by the kernel
+#define PMM_MAX_MEMORY      0x40000000
+#define PMM_MAX_FRAMES      (PMM_MAX_MEMORY / PAGE_SIZE)
+// kernel image, boot stack and the heap in utils.c live below this
+#define PMM_RESERVED_END    0x800000
+
+/**
+ * build the frame map from the multiboot memory map,
+ * keeping the kernel, heap and boot modules reserved
+ */
+void pmm_init(MULTIBOOT_INFO *mbi);
+
+/**
+ * physical address of a free frame, 0 when memory ran out
+ */
+uint32 pmm_alloc_frame(void);
+
+/**
+ * drop a reference to frame, it is free once the last one is gone
+ */
+void pmm_free_frame(uint32 frame);
+
+/**
+ * take another reference to an allocated frame
+ */
+void pmm_ref_frame(uint32 frame);
+
+/**
+ * number of references to frame, 1 means the caller owns it alone
+ */
+uint32 pmm_frame_refs(uint32 frame);
+
+/**
+ * end of usable physical memory
+ */
+uint32 pmm_memory_end(void);
+
+uint32 pmm_free_frames(void);
+
+#endif
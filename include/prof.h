@@ -0,0 +1,44 @@
+/**
+ * Sampling profiler: records the interrupted eip on every kernel tick of
+ * every cpu and bins the samples by function of the kernel symbol table
+ */
+
+#ifndef PROF_H
+#define PROF_H
+
+#include "types.h"
+
+#define PROF_SAMPLES            4096    // per cpu, 16 s at TIMER_HZ
+
+typedef struct {
+    const char *name;
+    uint32 samples;
+} PROF_ENTRY;
+
+typedef struct {
+    uint32 samples;             // kernel samples recorded
+    uint32 user;                // ticks that interrupted ring 3
+    uint32 unknown;             // kernel samples outside the symbol table
+    uint32 dropped;             // ticks after a cpu's buffer filled up
+} PROF_SUMMARY;
+
+/**
+ * hook the profiler into the kernel tick, it starts stopped
+ */
+void prof_init(void);
+
+void prof_start(void);
+void prof_stop(void);
+BOOL prof_running(void);
+
+/**
+ * throw the samples away
+ */
+void prof_reset(void);
+
+/**
+ * fill top with the max functions that got the most samples, returns how many
+ */
+uint32 prof_report(PROF_ENTRY *top, uint32 max, PROF_SUMMARY *summary);
+
+#endif
@@ -0,0 +1,20 @@
+/**
+ * Remote shell: command lines in UDP datagrams, run by the shell,
+ * their output sent back to whoever asked
+ */
+
+#ifndef RSHELL_H
+#define RSHELL_H
+
+#include "types.h"
+
+#define RSHELL_PORT             2323
+#define RSHELL_CHUNK            1024    // output bytes per reply datagram
+#define RSHELL_PROMPT           "smetana$ "
+
+/**
+ * start the task serving RSHELL_PORT
+ */
+void rshell_init(void);
+
+#endif
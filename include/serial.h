@@ -0,0 +1,47 @@
+/**
+ * 16550 UART on COM1, for output a host can capture,
+ * like qemu -serial file:log
+ * for more, see https://wiki.osdev.org/Serial_Ports
+ */
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include "types.h"
+
+#define SERIAL_COM1             0x3F8
+#define SERIAL_BAUD_BASE        115200
+
+// register offsets from the port base
+#define SERIAL_DATA             0       // divisor low byte while DLAB is set
+#define SERIAL_IER              1       // divisor high byte while DLAB is set
+#define SERIAL_FCR              2
+#define SERIAL_LCR              3
+#define SERIAL_MCR              4
+#define SERIAL_LSR              5
+
+#define SERIAL_LCR_8N1          0x03
+#define SERIAL_LCR_DLAB         0x80
+#define SERIAL_FCR_ENABLE       0xC7    // enable and clear the FIFOs, 14 byte threshold
+#define SERIAL_MCR_NORMAL       0x0F    // DTR, RTS, OUT1, OUT2
+#define SERIAL_MCR_LOOPBACK     0x1E
+#define SERIAL_LSR_THR_EMPTY    0x20
+
+/**
+ * set COM1 to baud 8N1, FALSE if no UART answers
+ */
+BOOL serial_init(uint32 baud);
+
+/**
+ * TRUE once serial_init() found the UART
+ */
+BOOL serial_present(void);
+
+void serial_putchar(char ch);
+
+/**
+ * write s in one piece, lines from different cpus don't mix
+ */
+void serial_write(const char *s);
+
+#endif
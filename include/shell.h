@@ -0,0 +1,75 @@
+/**
+ * Smetana Interactive Shell
+ */
+
+#ifndef SHELL_H
+#define SHELL_H
+
+#include "types.h"
+#include "pipe.h"
+
+#define SHELL_LINE_MAX      255
+#define SHELL_MAX_TOKENS    32
+#define SHELL_MAX_ARGS      16
+#define SHELL_MAX_STAGES    4
+#define SHELL_MAX_DEPTH     4       // nesting of `source`
+#define SHELL_PIPE_SIZE     8192
+#define SHELL_BLK_BATCH     32      // requests per batch of `blk bench`
+#define SHELL_BLK_SECTORS   8       // sectors per request
+
+typedef enum {
+    TOKEN_WORD,
+    TOKEN_PIPE,         // |
+    TOKEN_REDIRECT,     // >
+    TOKEN_APPEND        // >>
+} SHELL_TOKEN_TYPE;
+
+typedef struct {
+    SHELL_TOKEN_TYPE type;
+    char *text;         // word text, NULL for operators
+} SHELL_TOKEN;
+
+// builtin command prototype
+typedef void (*SHELL_HANDLER)(int argc, char **argv);
+
+typedef struct {
+    const char *name;
+    const char *usage;
+    const char *description;
+    SHELL_HANDLER handler;
+} SHELL_COMMAND;
+
+/**
+ * split line into tokens, honouring '' and "" quoting and \ escapes,
+ * words are copied into storage which must hold 2 * strlen(line) + 1 bytes.
+ * returns number of tokens or -1 on syntax error
+ */
+int shell_tokenize(const char *line, char *storage, SHELL_TOKEN *tokens, int max_tokens);
+
+/**
+ * run one command line, including pipelines and > / >> redirection
+ */
+void shell_execute(const char *line);
+
+/**
+ * run line with its output going to out instead of the screen, for the
+ * remote shell. it waits for a command of the console to finish first
+ */
+void shell_execute_into(const char *line, PIPE *out);
+
+/**
+ * run every line of a script file, returns FALSE if it can't be read
+ */
+BOOL shell_source(const char *path);
+
+/**
+ * pipe feeding the running command, NULL when it has no input
+ */
+PIPE *shell_stdin(void);
+
+/**
+ * interactive prompt loop, never returns
+ */
+void shell_run(void);
+
+#endif
@@ -0,0 +1,59 @@
+/**
+ * Symmetric multiprocessing: per-cpu data and application processor startup
+ */
+
+#ifndef SMP_H
+#define SMP_H
+
+#include "types.h"
+#include "cpu.h"
+
+struct TASK;
+
+// per-cpu data, run queue fields are protected by the task lock (see waitq.h)
+typedef struct CPU {
+    uint32 index;               // 0 is the boot cpu
+    uint8 apic_id;
+    volatile BOOL online;
+    struct TASK *current;
+    struct TASK *idle;          // runs when the queue is empty, never queued
+    struct TASK *ready_head;
+    struct TASK *ready_tail;
+    uint32 ready_count;
+    uint32 switches;            // context switches so far
+    uint8 *boot_stack;          // stack the cpu started on, its idle task's
+    struct TASK *fpu_owner;     // task whose state is in the FPU registers
+} CPU;
+
+/**
+ * find the processors in the ACPI MADT and start them,
+ * falls back to the boot cpu alone without ACPI
+ */
+void smp_init(void);
+
+/**
+ * index of the calling cpu
+ */
+uint32 smp_cpu_index(void);
+
+/**
+ * data of the calling cpu, call with interrupts off to stay on it
+ */
+CPU *smp_current(void);
+
+/**
+ * cpu by index, NULL past the last one started
+ */
+CPU *smp_cpu(uint32 index);
+
+/**
+ * number of cpus running
+ */
+uint32 smp_cpu_count(void);
+
+/**
+ * interrupt cpu so it looks at its run queue, nothing for the calling cpu
+ */
+void smp_kick(CPU *cpu);
+
+#endif
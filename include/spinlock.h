@@ -0,0 +1,94 @@
+/**
+ * Ticket spinlocks for state shared between cpus
+ * cpus get the lock in the order they asked for it. the _irqsave
+ * variants also keep interrupt handlers on this cpu out.
+ * every lock counts how often it was taken and contended, see lockstat
+ */
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "types.h"
+#include "isr.h"
+
+// contention counters, updated by the holder of the lock
+typedef struct LOCK_STATS {
+    const char *name;
+    uint32 acquired;
+    uint32 contended;           // acquisitions that had to wait
+    uint32 spins;               // pause loops spent waiting
+    volatile uint32 listed;     // linked into the lockstat list
+    struct LOCK_STATS *next;
+} LOCK_STATS;
+
+#define LOCK_STATS_INIT(name)   { name, 0, 0, 0, 0, NULL }
+
+typedef struct {
+    volatile uint32 next;       // ticket handed to the next cpu asking
+    volatile uint32 serving;    // ticket that holds the lock
+    LOCK_STATS stats;
+} SPINLOCK;
+
+#define SPINLOCK_INIT(name)     { 0, 0, LOCK_STATS_INIT(name) }
+
+/**
+ * make stats show up in lockstat, defined in sync.c
+ */
+void lockstat_register(LOCK_STATS *stats);
+
+// count an acquisition, the lock is held
+static inline void lockstat_acquired(LOCK_STATS *stats, uint32 spins) {
+    stats->acquired++;
+    if (spins) {
+        stats->contended++;
+        stats->spins += spins;
+    }
+    if (!stats->listed)
+        lockstat_register(stats);
+}
+
+static inline void spin_init(SPINLOCK *lock, const char *name) {
+    lock->next = 0;
+    lock->serving = 0;
+    lock->stats = (LOCK_STATS)LOCK_STATS_INIT(name);
+}
+
+static inline void spin_lock(SPINLOCK *lock) {
+    uint32 ticket = __sync_fetch_and_add(&lock->next, 1);
+    uint32 spins = 0;
+
+    // a plain read while waiting, so the cache line isn't bounced around
+    while (lock->serving != ticket) {
+        asm volatile("pause");
+        spins++;
+    }
+    lockstat_acquired(&lock->stats, spins);
+}
+
+static inline BOOL spin_trylock(SPINLOCK *lock) {
+    uint32 ticket = lock->serving;
+
+    if (!__sync_bool_compare_and_swap(&lock->next, ticket, ticket + 1))
+        return FALSE;
+    lockstat_acquired(&lock->stats, 0);
+    return TRUE;
+}
+
+static inline void spin_unlock(SPINLOCK *lock) {
+    // only the holder writes serving, x86 keeps the stores in order
+    asm volatile("" ::: "memory");
+    lock->serving = lock->serving + 1;
+}
+
+static inline uint32 spin_lock_irqsave(SPINLOCK *lock) {
+    uint32 flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(SPINLOCK *lock, uint32 flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+#endif
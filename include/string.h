@@ -2,6 +2,13 @@
 #define STRING_H
 
 #include "types.h"
+#include "cpufeat.h"
+
+// memset, memcpy, strlen, strcmp, strchr, strstr and ip_checksum, bound
+// in kmain once SSE is on. until then, and in host builds, they run the
+// portable C variants
+extern CPU_DISPATCH g_string_dispatch[];
+extern const uint32 g_string_dispatch_count;
 
 void *memset(void *dst, int c, uint32 n);
 void *memcpy(void *dst, const void *src, uint32 n);
@@ -18,9 +25,15 @@ int isalpha(char c);
 char upper(char c);
 char lower(char c);
 void itoa(char *buf, int base, int d);
+int atoi(const char *s);
 char *strstr(const char *in, const char *str);
 char *strchr(const char *str, char c);
 char *strtok(char *str, const char *delim);
 
+/**
+ * internet checksum of RFC 1071, ready to store in a header
+ */
+uint16 ip_checksum(const void *data, uint32 n);
+
 #endif
 
@@ -0,0 +1,89 @@
+/**
+ * Synchronization beyond spinlocks: reader-writer spinlocks, and mutexes
+ * and semaphores that put the waiting task to sleep instead of spinning
+ */
+
+#ifndef SYNC_H
+#define SYNC_H
+
+#include "types.h"
+#include "spinlock.h"
+#include "waitq.h"
+
+struct TASK;
+
+// any number of readers or one writer, waiting writers hold off new readers
+typedef struct {
+    volatile sint32 state;      // readers inside, -1 while a writer is
+    volatile uint32 writers;    // writers waiting
+    LOCK_STATS stats;
+} RWLOCK;
+
+#define RWLOCK_INIT(name)       { 0, 0, LOCK_STATS_INIT(name) }
+
+// sleeping lock owned by a task, not for interrupt handlers
+typedef struct {
+    struct TASK *owner;
+    WAITQ waiters;
+    LOCK_STATS stats;
+} MUTEX;
+
+#define MUTEX_INIT(name)        { NULL, { NULL }, LOCK_STATS_INIT(name) }
+
+// counting semaphore, sem_up() is safe from interrupt handlers
+typedef struct {
+    sint32 count;
+    WAITQ waiters;
+    LOCK_STATS stats;
+} SEMAPHORE;
+
+#define SEMAPHORE_INIT(name, count) { count, { NULL }, LOCK_STATS_INIT(name) }
+
+void rwlock_init(RWLOCK *lock, const char *name);
+void read_lock(RWLOCK *lock);
+void read_unlock(RWLOCK *lock);
+void write_lock(RWLOCK *lock);
+void write_unlock(RWLOCK *lock);
+
+void mutex_init(MUTEX *mutex, const char *name);
+
+/**
+ * take mutex, sleeping while another task holds it
+ */
+void mutex_lock(MUTEX *mutex);
+
+/**
+ * take mutex if it is free, FALSE otherwise
+ */
+BOOL mutex_trylock(MUTEX *mutex);
+
+void mutex_unlock(MUTEX *mutex);
+
+void sem_init(SEMAPHORE *sem, const char *name, sint32 count);
+
+/**
+ * take one unit, sleeping while there is none
+ */
+void sem_down(SEMAPHORE *sem);
+
+/**
+ * take one unit if there is one, FALSE otherwise
+ */
+BOOL sem_trydown(SEMAPHORE *sem);
+
+/**
+ * give back one unit and wake a sleeper
+ */
+void sem_up(SEMAPHORE *sem);
+
+/**
+ * first lock that was taken so far, follow ->next for the others
+ */
+LOCK_STATS *lockstat_list(void);
+
+/**
+ * zero the counters of every listed lock
+ */
+void lockstat_reset(void);
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * System calls from ring 3
+ *
+ * int 0x80 : eax = number, ebx, ecx, edx = arguments, result in eax
+ * sysenter : eax = number, ebx, esi, edi = arguments, result in eax,
+ *            ecx = user stack and edx = return address, restored on sysexit
+ */
+
+#ifndef SYSCALL_H
+#define SYSCALL_H
+
+#include "types.h"
+
+#define SYSCALL_VECTOR      0x80
+
+#define SYS_EXIT            0
+#define SYS_READ            1
+#define SYS_WRITE           2
+#define SYS_OPEN            3
+#define SYS_CLOSE           4
+#define SYS_SBRK            5
+#define SYS_YIELD           6
+#define SYS_FORK            7
+#define SYS_WAIT            8
+#define SYS_SLEEP           9
+#define NO_SYSCALLS         10
+
+// open() flags
+#define O_RDONLY            0x0000
+#define O_WRONLY            0x0001
+#define O_RDWR              0x0002
+#define O_ACCMODE           0x0003
+#define O_CREAT             0x0040
+#define O_TRUNC             0x0200
+#define O_APPEND            0x0400
+
+// passed to a user entry point
+#define USER_FLAG_SYSENTER  0x01    // sysenter/sysexit may be used
+
+#define STDIN_FILENO        0
+#define STDOUT_FILENO       1
+#define STDERR_FILENO       2
+
+// asm entry points, defined in syscall.asm
+extern void syscall_int80();
+extern void syscall_sysenter();
+
+/**
+ * install the int 0x80 gate and, when supported, the sysenter MSRs
+ */
+void syscall_init(void);
+
+/**
+ * program the sysenter MSRs, which every cpu has its own copy of
+ */
+void syscall_init_cpu(void);
+
+/**
+ * kernel stack to enter on from ring 3 on this cpu, updated on every task switch
+ */
+void syscall_set_kernel_stack(uint32 esp0);
+
+/**
+ * USER_FLAG_* describing the syscall paths available
+ */
+uint32 syscall_user_flags(void);
+
+/**
+ * run syscall number with up to three arguments, returns value for eax
+ */
+uint32 syscall_dispatch(uint32 number, uint32 arg1, uint32 arg2, uint32 arg3);
+
+#endif
@@ -0,0 +1,142 @@
+/**
+ * Kernel tasks and the per-cpu round robin schedulers
+ */
+
+#ifndef TASK_H
+#define TASK_H
+
+#include "types.h"
+#include "waitq.h"
+#include "filesystem.h"
+#include "vm.h"
+#include "isr.h"
+#include "smp.h"
+#include "console.h"
+
+#define TASK_NAME_LEN           16
+#define TASK_KERNEL_STACK_SIZE  8192
+#define TASK_MAX_FILES          8
+
+typedef enum {
+    TASK_READY,
+    TASK_RUNNING,
+    TASK_BLOCKED,
+    TASK_ZOMBIE         // exited, waiting for task_wait() to reap it
+} TASK_STATE;
+
+// open file of a task, a NULL node is the console
+typedef struct {
+    BOOL used;
+    FileNode *node;
+    uint32 offset;
+    uint32 flags;
+} TASK_FILE;
+
+// kernel thread body
+typedef void (*TASK_ENTRY)(void *arg);
+
+typedef struct TASK {
+    uint32 id;
+    char name[TASK_NAME_LEN];
+    volatile TASK_STATE state;
+    uint32 esp;                 // saved kernel stack pointer while switched out
+    uint8 *kernel_stack;        // NULL for the boot task
+    CPU *cpu;                   // the cpu whose run queue the task is on
+    uint32 lock_depth;          // task lock nesting while switched out
+    uint8 *fpu_state;           // FPU save area, NULL until the first FPU instruction
+    TASK_ENTRY entry;
+    void *arg;
+
+    // user mode state
+    uint32 user_entry;          // program entry, called with USER_FLAG_* from syscall.h
+    ADDRESS_SPACE *as;          // NULL for kernel threads
+    REGISTERS *syscall_regs;    // user frame of the syscall in progress
+    TASK_FILE files[TASK_MAX_FILES];
+    CONSOLE_SINK console_sink;  // where the task prints, NULL for the screen
+
+    int exit_code;
+    WAITQ exit_waiters;
+    struct TASK *parent;        // NULL once the creator has exited
+    struct TASK *children;      // not yet reaped by task_wait()
+    struct TASK *sibling;       // next in the parent's children
+    struct TASK *next;          // run queue link
+} TASK;
+
+// asm context switch, defined in switch.asm
+extern void task_switch(uint32 *old_esp, uint32 new_esp);
+extern void enter_usermode(uint32 eip, uint32 esp);
+// return path of syscall.asm, pops a REGISTERS frame into ring 3
+extern void syscall_return();
+
+/**
+ * adopt the boot context as the first task of the boot cpu
+ */
+void task_init(void);
+
+/**
+ * adopt the startup context of an application processor as its idle task
+ */
+void task_init_cpu(CPU *cpu);
+
+/**
+ * idle loop of a cpu: run whatever gets queued, halt until an interrupt otherwise
+ */
+void task_idle(void);
+
+/**
+ * currently running task, NULL before task_init()
+ */
+TASK *task_current(void);
+
+/**
+ * create a kernel thread running entry(arg), it starts out ready
+ */
+TASK *task_create_kernel(const char *name, TASK_ENTRY entry, void *arg);
+
+/**
+ * same as task_create_kernel(), on the given cpu instead of the next one in turn
+ */
+TASK *task_create_kernel_on(CPU *cpu, const char *name, TASK_ENTRY entry, void *arg);
+
+/**
+ * create a task that runs ELF executable program in ring 3
+ */
+TASK *task_create_user(const char *name, FileNode *program);
+
+/**
+ * duplicate the current user task, the child returns from the
+ * syscall in reg with 0 and shares memory copy on write
+ */
+TASK *task_fork(REGISTERS *reg);
+
+/**
+ * child of the current task with the given id, NULL if there is none
+ */
+TASK *task_find_child(uint32 id);
+
+/**
+ * give the cpu to the next ready task
+ */
+void task_yield(void);
+
+/**
+ * stop running until task_wakeup(), call with the task lock held
+ */
+void task_block(void);
+
+/**
+ * make a blocked task ready again on its cpu, safe from interrupt handlers
+ */
+void task_wakeup(TASK *task);
+
+/**
+ * terminate the current task
+ */
+void task_exit(int code);
+
+/**
+ * sleep until task exits, free it and return its exit code
+ */
+int task_wait(TASK *task);
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ * Kernel timer: the local APIC timer of every cpu fires only for the next
+ * hrtimer due on that cpu, or periodically while someone keeps the tick.
+ * time comes from the clocksource, so nothing is lost while the timer is
+ * off. without a local APIC, PIT channel 0 ticks on the boot cpu alone
+ * and hrtimers fire at its resolution
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "types.h"
+#include "isr.h"
+
+#define TIMER_HZ                250
+#define TIMER_TICK_HOOKS        4
+
+// 8253/8254 programmable interval timer, for more see https://wiki.osdev.org/PIT
+#define PIT_FREQUENCY           1193182
+#define PIT_CHANNEL0            0x40
+#define PIT_CHANNEL2            0x42
+#define PIT_COMMAND             0x43
+#define PIT_GATE                0x61    // keyboard controller port B
+
+// command byte: channel, lobyte then hibyte access, mode
+#define PIT_SELECT_CHANNEL0     0x00
+#define PIT_SELECT_CHANNEL2     0x80
+#define PIT_ACCESS_LOHI         0x30
+#define PIT_MODE_ONESHOT        0x00    // mode 0, interrupt on terminal count
+#define PIT_MODE_RATE           0x04    // mode 2, rate generator
+
+#define PIT_GATE_CHANNEL2       0x01
+#define PIT_GATE_SPEAKER        0x02
+#define PIT_GATE_OUT2           0x20    // channel 2 output
+
+struct HRTIMER;
+typedef void (*HRTIMER_FN)(struct HRTIMER *timer);
+
+// one-shot timer in its owner's memory, which must outlive it while queued
+typedef struct HRTIMER {
+    uint64 expires;             // clock_ns() to fire at
+    HRTIMER_FN fn;              // in interrupt context, on the cpu that started it
+    void *data;
+    uint32 cpu;
+    volatile BOOL queued;
+    struct HRTIMER *next;
+} HRTIMER;
+
+/**
+ * calibrate and arm the timer on every cpu online, after clock_init()
+ */
+void timer_init(void);
+
+/**
+ * call hook from every timer interrupt on every cpu, in interrupt context.
+ * they come every tick only while timer_keep_tick() holds it
+ */
+BOOL timer_register_tick(ISR hook);
+
+/**
+ * run the periodic tick on every cpu while keep calls outnumber the others
+ */
+void timer_keep_tick(BOOL keep);
+
+/**
+ * prepare timer to call fn with data
+ */
+void hrtimer_init(HRTIMER *timer, HRTIMER_FN fn, void *data);
+
+/**
+ * fire timer on the calling cpu once clock_ns() reaches expires, moving it
+ * if it is already queued there
+ */
+void hrtimer_start(HRTIMER *timer, uint64 expires);
+
+/**
+ * take timer off its queue, from the cpu that started it.
+ * FALSE if it already fired or was never started
+ */
+BOOL hrtimer_cancel(HRTIMER *timer);
+
+/**
+ * put the current task to sleep until clock_ns() reaches expires,
+ * not before timer_init()
+ */
+void timer_sleep_until(uint64 expires);
+
+/**
+ * put the current task to sleep for ms milliseconds, not before timer_init()
+ */
+void timer_sleep(uint32 ms);
+
+/**
+ * TIMER_HZ ticks since clock_init(), counted even while the timer is off
+ */
+uint32 timer_ticks(void);
+
+/**
+ * local APIC timer counts per tick, 0 when the PIT drives the tick
+ */
+uint32 timer_lapic_count(void);
+
+/**
+ * time stamp counter frequency in kHz, measured by clock_init()
+ */
+uint32 timer_tsc_khz(void);
+
+#endif
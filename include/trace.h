@@ -0,0 +1,74 @@
+/**
+ * Trace ring: every cpu records timestamped events into its own ring,
+ * overwriting the oldest ones. Tracepoints are TRACE() macros, one load
+ * and a branch while tracing is off; build with -DNO_TRACE to drop them
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "types.h"
+
+#define TRACE_RING_SIZE         2048    // records per cpu, a power of two
+
+typedef enum {
+    TRACE_IRQ_ENTER,            // vector, interrupted eip
+    TRACE_IRQ_EXIT,             // vector
+    TRACE_SWITCH,               // previous task id, next task id
+    TRACE_ALLOC,                // size, object
+    TRACE_FREE,                 // object
+    TRACE_FS_CREATE,            // node
+    TRACE_FS_READ,              // node, bytes
+    TRACE_FS_WRITE,             // node, bytes
+    TRACE_EVENTS
+} TRACE_EVENT;
+
+typedef struct {
+    uint64 tsc;
+    uint32 event;
+    uint32 a;
+    uint32 b;
+} TRACE_RECORD;
+
+extern volatile BOOL g_trace_enabled;
+
+#ifdef NO_TRACE
+#define TRACE(event, a, b)      do { } while (0)
+#else
+#define TRACE(event, a, b) \
+    do { \
+        if (g_trace_enabled) \
+            trace_record(event, (uint32)(a), (uint32)(b)); \
+    } while (0)
+#endif
+
+/**
+ * allocate a ring for every cpu online, tracing starts off
+ */
+void trace_init(void);
+
+/**
+ * append a record to the calling cpu's ring, use TRACE() instead
+ */
+void trace_record(uint32 event, uint32 a, uint32 b);
+
+void trace_enable(BOOL enable);
+
+/**
+ * empty every ring
+ */
+void trace_clear(void);
+
+/**
+ * records in the ring of cpu, at most TRACE_RING_SIZE
+ */
+uint32 trace_count(uint32 cpu);
+
+/**
+ * stop tracing and write every ring to the serial port, oldest first,
+ * as `T <cpu> <tsc high> <tsc low> <event> <a> <b>` lines
+ * that tools/trace2json.awk turns into Chrome trace JSON
+ */
+void trace_dump(void);
+
+#endif
@@ -1,11 +1,14 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#ifndef NULL
 #define NULL 0
+#endif
 
 typedef unsigned char uint8;
 typedef unsigned short uint16;
 typedef unsigned int uint32;
+typedef unsigned long long uint64;
 typedef signed char sint8;
 typedef signed short sint16;
 typedef signed int sint32;
@@ -0,0 +1,61 @@
+/**
+ * UDP sockets
+ * for more, see RFC 768
+ */
+
+#ifndef UDP_H
+#define UDP_H
+
+#include "types.h"
+#include "net.h"
+#include "ip.h"
+#include "spinlock.h"
+
+#define UDP_MAX_SOCKETS         8
+#define UDP_QUEUE_MAX           32      // datagrams waiting per socket
+#define UDP_MAX_PAYLOAD         (IP_MAX_PAYLOAD - sizeof(UDP_HEADER))
+
+typedef struct {
+    uint16 src_port;
+    uint16 dst_port;
+    uint16 len;
+    uint16 checksum;
+} __attribute__((packed)) UDP_HEADER;
+
+typedef struct {
+    uint16 port;                // 0 while the socket is free
+    SPINLOCK lock;
+    NETBUF *queue;              // received, still starting at the IP header
+    NETBUF *queue_tail;
+    uint32 queued;
+    WAITQ waiters;
+    uint32 dropped;             // datagrams that found the queue full
+} UDP_SOCKET;
+
+/**
+ * socket bound to port, NULL if the port is taken or no socket is left
+ */
+UDP_SOCKET *udp_open(uint16 port);
+
+/**
+ * unbind sock and drop what it still holds, nobody may be waiting in it
+ */
+void udp_close(UDP_SOCKET *sock);
+
+/**
+ * sleep until a datagram arrives, and return the buffer it came in with
+ * data at its payload. the caller frees it
+ */
+NETBUF *udp_recv(UDP_SOCKET *sock, IP_ADDR *src, uint16 *src_port);
+
+/**
+ * send len bytes of data from sock's port to port at dst
+ */
+BOOL udp_sendto(UDP_SOCKET *sock, IP_ADDR dst, uint16 port, const void *data, uint32 len);
+
+/**
+ * a UDP datagram arrived, buf starts at its IP header
+ */
+void udp_receive(NETBUF *buf);
+
+#endif
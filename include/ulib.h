@@ -0,0 +1,54 @@
+/**
+ * User mode runtime: syscall wrappers for ring 3 programs
+ */
+
+#ifndef ULIB_H
+#define ULIB_H
+
+#include "types.h"
+#include "syscall.h"
+
+/**
+ * call first from a program entry point with the flags it received
+ */
+void ulib_init(uint32 flags);
+
+/**
+ * USER_FLAG_* the kernel started the program with
+ */
+uint32 ulib_flags(void);
+
+/**
+ * provided by every program, called from _start() with the runtime set up
+ */
+int main(void);
+
+void exit(int code);
+int read(int fd, void *buffer, uint32 size);
+int write(int fd, const void *buffer, uint32 size);
+int open(const char *path, uint32 flags);
+int close(int fd);
+void *sbrk(int increment);
+void yield(void);
+
+/**
+ * copy this program, returns 0 in the child and the child's id in the parent
+ */
+int fork(void);
+
+/**
+ * wait for child id to exit, returns its exit code
+ */
+int wait(int id);
+
+/**
+ * give the cpu up for ms milliseconds
+ */
+void sleep_ms(uint32 ms);
+
+/**
+ * write a NUL terminated string to stdout
+ */
+int puts(const char *str);
+
+#endif
@@ -3,9 +3,18 @@
 
 #include "types.h"
 
+// Position heap after kernel
+#define HEAP_START 0x400000
+#define HEAP_SIZE  0x400000
+#define HEAP_END   (HEAP_START + HEAP_SIZE)
+
 void init_heap(void);
+// malloc() and free() are defined in kmem.c
 void* malloc(uint32 size);
 void free(void* ptr);
+// the shared heap they refill from, one lock for all cpus
+void* heap_alloc(uint32 size);
+void heap_free(void* ptr);
 void* memset(void* ptr, int value, uint32 num);
 int abs(int n);  // Add abs function
 
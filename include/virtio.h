@@ -0,0 +1,207 @@
+/**
+ * Virtio over PCI: the legacy I/O port transport and the modern one of
+ * virtio 1.0 capabilities, and split virtqueues on top of either.
+ * for more, see the Virtual I/O Device (VIRTIO) specification
+ */
+
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include "types.h"
+#include "pci.h"
+#include "spinlock.h"
+
+#define VIRTIO_VENDOR_ID        0x1AF4
+
+// device status
+#define VIRTIO_STATUS_ACKNOWLEDGE   0x01
+#define VIRTIO_STATUS_DRIVER        0x02
+#define VIRTIO_STATUS_DRIVER_OK     0x04
+#define VIRTIO_STATUS_FEATURES_OK   0x08
+#define VIRTIO_STATUS_FAILED        0x80
+
+// feature bits of the high word
+#define VIRTIO_F_VERSION_1      0x1     // bit 32
+
+// legacy transport, registers in I/O BAR 0
+#define VIRTIO_LEGACY_DEVICE_FEATURES   0x00
+#define VIRTIO_LEGACY_DRIVER_FEATURES   0x04
+#define VIRTIO_LEGACY_QUEUE_PFN         0x08
+#define VIRTIO_LEGACY_QUEUE_SIZE        0x0C
+#define VIRTIO_LEGACY_QUEUE_SELECT      0x0E
+#define VIRTIO_LEGACY_QUEUE_NOTIFY      0x10
+#define VIRTIO_LEGACY_STATUS            0x12
+#define VIRTIO_LEGACY_ISR               0x13
+#define VIRTIO_LEGACY_CONFIG_VECTOR     0x14    // only while MSI-X is on
+#define VIRTIO_LEGACY_QUEUE_VECTOR      0x16
+#define VIRTIO_LEGACY_CONFIG            0x14    // device config, 0x18 with MSI-X on
+#define VIRTIO_LEGACY_CONFIG_MSIX       0x18
+#define VIRTIO_LEGACY_QUEUE_ALIGN       4096
+
+// modern transport, vendor capabilities pointing into the BARs
+#define VIRTIO_PCI_CAP_COMMON   1
+#define VIRTIO_PCI_CAP_NOTIFY   2
+#define VIRTIO_PCI_CAP_ISR      3
+#define VIRTIO_PCI_CAP_DEVICE   4
+#define VIRTIO_PCI_CAP_TYPE     3       // offsets in the capability
+#define VIRTIO_PCI_CAP_BAR      4
+#define VIRTIO_PCI_CAP_OFFSET   8
+#define VIRTIO_PCI_CAP_MULTIPLIER 16    // notify capability only
+
+// common configuration structure
+#define VIRTIO_COMMON_DEVICE_FEATURE_SELECT 0x00
+#define VIRTIO_COMMON_DEVICE_FEATURE        0x04
+#define VIRTIO_COMMON_DRIVER_FEATURE_SELECT 0x08
+#define VIRTIO_COMMON_DRIVER_FEATURE        0x0C
+#define VIRTIO_COMMON_MSIX_CONFIG           0x10
+#define VIRTIO_COMMON_STATUS                0x14
+#define VIRTIO_COMMON_QUEUE_SELECT          0x16
+#define VIRTIO_COMMON_QUEUE_SIZE            0x18
+#define VIRTIO_COMMON_QUEUE_MSIX_VECTOR     0x1A
+#define VIRTIO_COMMON_QUEUE_ENABLE          0x1C
+#define VIRTIO_COMMON_QUEUE_NOTIFY_OFF      0x1E
+#define VIRTIO_COMMON_QUEUE_DESC            0x20
+#define VIRTIO_COMMON_QUEUE_DRIVER          0x28
+#define VIRTIO_COMMON_QUEUE_DEVICE          0x30
+
+#define VIRTIO_NO_VECTOR        0xFFFF
+#define VIRTIO_ISR_QUEUE        0x1
+
+// split virtqueue
+#define VIRTQ_MAX_SIZE          256
+#define VIRTQ_DESC_F_NEXT       0x1
+#define VIRTQ_DESC_F_WRITE      0x2     // the device writes the buffer
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 0x1
+#define VIRTQ_USED_F_NO_NOTIFY  0x1
+
+typedef struct {
+    uint32 addr_low, addr_high;
+    uint32 len;
+    uint16 flags;
+    uint16 next;
+} __attribute__((packed)) VIRTQ_DESC;
+
+typedef struct {
+    uint16 flags;
+    uint16 idx;
+    uint16 ring[];
+} __attribute__((packed)) VIRTQ_AVAIL;
+
+typedef struct {
+    uint32 id;                  // head of the finished chain
+    uint32 len;                 // bytes the device wrote
+} __attribute__((packed)) VIRTQ_USED_ELEM;
+
+typedef struct {
+    uint16 flags;
+    uint16 idx;
+    VIRTQ_USED_ELEM ring[];
+} __attribute__((packed)) VIRTQ_USED;
+
+// one buffer of a chain, in identity mapped kernel memory
+typedef struct {
+    void *addr;
+    uint32 len;
+    BOOL device_writes;
+} VIRTQ_BUFFER;
+
+typedef struct {
+    uint16 index;
+    uint16 size;
+    VIRTQ_DESC *desc;
+    VIRTQ_AVAIL *avail;
+    volatile VIRTQ_USED *used;
+    uint16 free_head;           // descriptors not in a chain, linked by next
+    uint16 free_count;
+    uint16 last_used;           // used ring entries seen so far
+    uint16 added;               // chains made available since the last kick
+    void *tokens[VIRTQ_MAX_SIZE];   // by chain head
+    uint8 *memory;
+    uint32 notify_off;          // modern: queue_notify_off * multiplier
+    SPINLOCK lock;
+    uint32 kicks;               // notifications actually sent
+} VIRTQ;
+
+typedef struct {
+    PCI_DEVICE *pci;
+    BOOL modern;
+    uint16 io;                  // legacy: port of BAR 0
+    volatile uint8 *common;     // modern: mapped structures
+    volatile uint8 *notify;
+    volatile uint8 *isr;
+    volatile uint8 *config;
+    uint32 notify_multiplier;
+    BOOL msix;                  // queue interrupts through MSI-X entry 0
+    sint32 vector;              // -1 until interrupts are set up
+    uint32 features;            // negotiated, low word
+} VIRTIO_DEVICE;
+
+/**
+ * find the transport of pci, reset the device and acknowledge it
+ */
+BOOL virtio_init(VIRTIO_DEVICE *vdev, PCI_DEVICE *pci);
+
+/**
+ * accept the features of wanted the device offers, FALSE if it refuses
+ */
+BOOL virtio_negotiate(VIRTIO_DEVICE *vdev, uint32 wanted);
+
+/**
+ * send queue interrupts to handler: MSI-X entry 0 when the device has it,
+ * else its legacy INTx line, shared with other drivers. before the queues
+ * are set up
+ */
+BOOL virtio_setup_interrupt(VIRTIO_DEVICE *vdev, ISR handler);
+
+/**
+ * allocate and register queue index, at most VIRTQ_MAX_SIZE entries
+ */
+BOOL virtio_setup_queue(VIRTIO_DEVICE *vdev, VIRTQ *vq, uint16 index);
+
+/**
+ * the device may run
+ */
+void virtio_driver_ok(VIRTIO_DEVICE *vdev);
+
+/**
+ * mark the device failed, it is left alone afterwards
+ */
+void virtio_fail(VIRTIO_DEVICE *vdev);
+
+/**
+ * device specific configuration
+ */
+uint32 virtio_config32(VIRTIO_DEVICE *vdev, uint32 offset);
+
+uint8 virtio_config8(VIRTIO_DEVICE *vdev, uint32 offset);
+
+/**
+ * read and clear the interrupt status, 0 when the interrupt wasn't ours
+ */
+uint8 virtio_isr(VIRTIO_DEVICE *vdev);
+
+/**
+ * make a chain of count buffers available with token, the ones the device
+ * reads first. FALSE without enough free descriptors. vq->lock is held
+ */
+BOOL virtq_add(VIRTQ *vq, const VIRTQ_BUFFER *buffers, uint32 count, void *token);
+
+/**
+ * publish the chains added since the last kick and notify the device once,
+ * unless it asked not to be. vq->lock is held
+ */
+void virtq_kick(VIRTIO_DEVICE *vdev, VIRTQ *vq);
+
+/**
+ * token of the next chain the device finished, NULL if there is none.
+ * its descriptors are free again. vq->lock is held
+ */
+void *virtq_get(VIRTQ *vq, uint32 *len);
+
+/**
+ * ask the device to interrupt for finished chains or not, only a hint.
+ * turning them on returns TRUE when chains finished that it won't announce
+ */
+BOOL virtq_interrupts(VIRTQ *vq, BOOL on);
+
+#endif
@@ -0,0 +1,33 @@
+/**
+ * virtio-blk disks as block devices vda, vdb, ...
+ */
+
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include "types.h"
+
+#define VIRTIO_BLK_MAX_DISKS    2
+
+// feature bits
+#define VIRTIO_BLK_F_RO         (1 << 5)
+#define VIRTIO_BLK_F_FLUSH      (1 << 9)
+
+// request types
+#define VIRTIO_BLK_T_IN         0
+#define VIRTIO_BLK_T_OUT        1
+#define VIRTIO_BLK_T_FLUSH      4
+
+// status the device writes
+#define VIRTIO_BLK_S_OK         0
+#define VIRTIO_BLK_S_IOERR      1
+#define VIRTIO_BLK_S_UNSUPP     2
+
+#define VIRTIO_BLK_CONFIG_CAPACITY  0   // 64 bit, in 512 byte sectors
+
+/**
+ * register the driver, disks are probed by pci_register_driver()
+ */
+void virtio_blk_init(void);
+
+#endif
@@ -0,0 +1,26 @@
+/**
+ * virtio-net NICs
+ */
+
+#ifndef VIRTIO_NET_H
+#define VIRTIO_NET_H
+
+#include "types.h"
+
+#define VIRTIO_NET_MAX_NICS     2
+#define VIRTIO_NET_QUEUE_RX     0
+#define VIRTIO_NET_QUEUE_TX     1
+
+#define VIRTIO_NET_F_MAC        (1 << 5)
+#define VIRTIO_NET_CONFIG_MAC   0
+
+// struct virtio_net_hdr, num_buffers only with VIRTIO_F_VERSION_1
+#define VIRTIO_NET_HEADER_LEGACY    10
+#define VIRTIO_NET_HEADER_MODERN    12
+
+/**
+ * register the driver, NICs are probed by pci_register_driver()
+ */
+void virtio_net_init(void);
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * User address spaces
+ * regions are described by VMAs and only get frames when first touched,
+ * frames can be shared read only or copy on write
+ */
+
+#ifndef VM_H
+#define VM_H
+
+#include "types.h"
+#include "paging.h"
+#include "filesystem.h"
+
+#define VMA_READ    0x1
+#define VMA_WRITE   0x2
+#define VMA_EXEC    0x4
+
+// user stack, grows down from USER_TOP and is paged in on demand
+#define VM_STACK_SIZE   0x100000
+#define VM_STACK_BOTTOM (USER_TOP - VM_STACK_SIZE)
+
+// region of user memory, [start, end) page aligned
+typedef struct VMA {
+    uint32 start;
+    uint32 end;
+    uint32 flags;           // VMA_*
+    FileNode *file;         // NULL for zero filled memory
+    uint32 file_offset;     // file position backing start
+    uint32 file_size;       // bytes backed by the file, the rest is zero filled
+    struct VMA *next;       // sorted by start
+} VMA;
+
+typedef struct {
+    uint32 *directory;
+    VMA *vmas;
+    VMA *heap;              // grown by vm_sbrk()
+    uint32 brk;             // current program break
+} ADDRESS_SPACE;
+
+/**
+ * register the page fault handler
+ */
+void vm_init(void);
+
+/**
+ * empty address space sharing the kernel mappings
+ */
+ADDRESS_SPACE *vm_create(void);
+
+/**
+ * copy of as for a forked task, writable pages are shared copy on write
+ */
+ADDRESS_SPACE *vm_clone(ADDRESS_SPACE *parent);
+
+/**
+ * free every frame, page table and region of as
+ */
+void vm_destroy(ADDRESS_SPACE *as);
+
+/**
+ * add region [start, end), backed by file_size bytes of file at file_offset.
+ * NULL if it overlaps an existing region or leaves user space
+ */
+VMA *vm_add_region(ADDRESS_SPACE *as, uint32 start, uint32 end, uint32 flags,
+                   FileNode *file, uint32 file_offset, uint32 file_size);
+
+/**
+ * start an empty heap at brk
+ */
+BOOL vm_set_break(ADDRESS_SPACE *as, uint32 brk);
+
+/**
+ * move the program break by increment, returns the old break or -1
+ */
+uint32 vm_sbrk(ADDRESS_SPACE *as, sint32 increment);
+
+/**
+ * resolve a fault at addr if a region covers it, returns FALSE for bad accesses
+ */
+BOOL vm_handle_fault(ADDRESS_SPACE *as, uint32 addr, uint32 error);
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * Wait queues, where code sleeps until another context
+ * (usually an interrupt handler) signals that its condition may hold
+ */
+
+#ifndef WAITQ_H
+#define WAITQ_H
+
+#include "types.h"
+#include "isr.h"
+
+struct TASK;
+
+/**
+ * scheduler lock, defined in task.c: disables interrupts on this cpu and
+ * keeps other cpus off run queues and wait queues, nests on the same cpu.
+ * returns the eflags for task_unlock()
+ */
+uint32 task_lock(void);
+void task_unlock(uint32 flags);
+
+typedef struct WAITQ_ENTRY {
+    volatile BOOL woken;
+    struct TASK *task;          // sleeping task, NULL before tasks exist
+    struct WAITQ_ENTRY *next;
+} WAITQ_ENTRY;
+
+typedef struct {
+    WAITQ_ENTRY *head;
+} WAITQ;
+
+void waitq_init(WAITQ *wq);
+
+/**
+ * sleep until woken, must be called with the task lock held
+ * and returns with it held again
+ */
+void waitq_sleep(WAITQ *wq);
+
+/**
+ * wake the longest waiting sleeper, safe from interrupt handlers
+ */
+void waitq_wake_one(WAITQ *wq);
+
+/**
+ * wake every sleeper, safe from interrupt handlers
+ */
+void waitq_wake_all(WAITQ *wq);
+
+/**
+ * sleep on wq until condition is true, the condition is checked
+ * under the task lock so a wakeup can't slip in between check and sleep
+ */
+#define waitq_wait_event(wq, condition)     \
+    do {                                    \
+        uint32 __flags = task_lock();       \
+        while (!(condition))                \
+            waitq_sleep(wq);                \
+        task_unlock(__flags);               \
+    } while (0)
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * Work pool: short jobs run by one worker thread per cpu
+ * every cpu queues its jobs on a Chase-Lev deque, workers run their
+ * own jobs newest first and steal the oldest from other cpus when idle
+ */
+
+#ifndef WORK_H
+#define WORK_H
+
+#include "types.h"
+#include "waitq.h"
+
+#define WORK_DEQUE_SIZE     256     // power of two
+
+typedef void (*WORK_FN)(void *arg);
+
+// a job, owned by the submitter until work_wait() returns
+typedef struct {
+    WORK_FN fn;
+    void *arg;
+    volatile BOOL done;
+    WAITQ waiters;
+} WORK;
+
+// body of work_parallel_for(), runs for indices [begin, end)
+typedef void (*WORK_RANGE_FN)(uint32 begin, uint32 end, void *arg);
+
+/**
+ * start a worker thread on every cpu
+ */
+void work_init(void);
+
+/**
+ * prepare work to run fn(arg)
+ */
+void work_setup(WORK *work, WORK_FN fn, void *arg);
+
+/**
+ * queue work on this cpu, safe from interrupt handlers.
+ * runs it right away when the deque is full
+ */
+void work_submit(WORK *work);
+
+/**
+ * wait until work has run, running queued jobs meanwhile
+ */
+void work_wait(WORK *work);
+
+/**
+ * call fn over [begin, end) in chunks of at least grain indices
+ * spread over the workers, returns once every chunk is done
+ */
+void work_parallel_for(uint32 begin, uint32 end, uint32 grain, WORK_RANGE_FN fn, void *arg);
+
+/**
+ * jobs run and jobs stolen from other cpus by the workers of cpu
+ */
+void work_stats(uint32 cpu, uint32 *run, uint32 *stolen);
+
+#endif
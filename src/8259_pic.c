@@ -41,6 +41,14 @@ void pic8259_init() {
     outportb(PIC2_DATA, a2);
 }
 
+/**
+ * mask every line, once the IO-APIC delivers device interrupts
+ */
+void pic8259_disable() {
+    outportb(PIC1_DATA, 0xFF);
+    outportb(PIC2_DATA, 0xFF);
+}
+
 /**
  * send end of interrupt command to PIC 8259
  */
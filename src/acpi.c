@@ -0,0 +1,386 @@
+/**
+ * ACPI table discovery
+ * finds the RSDP in the BIOS areas, walks the RSDT/XSDT and parses the
+ * MADT for processors and interrupt controllers, the FADT for the power
+ * management ports, the HPET table and the MCFG. soft off needs the SLP_TYP values
+ * of the \_S5_ package in the DSDT; it is a plain constant on every
+ * firmware seen, so it is scanned for instead of running an AML interpreter
+ */
+
+#include "acpi.h"
+#include "paging.h"
+#include "string.h"
+#include "io_ports.h"
+#include "isr.h"
+
+#define BDA_EBDA_SEGMENT    0x40E       // BIOS data area: EBDA segment
+#define BIOS_ROM_START      0xE0000
+#define BIOS_ROM_END        0x100000
+
+// AML opcodes of Name(_S5_, Package() { a, b, ... })
+#define AML_ZERO_OP         0x00
+#define AML_ONE_OP          0x01
+#define AML_NAME_OP         0x08
+#define AML_BYTE_PREFIX     0x0A
+#define AML_PACKAGE_OP      0x12
+#define AML_ROOT_CHAR       '\\'
+
+#define ACPI_PM1_SLP_TYP_MASK   (7 << ACPI_PM1_SLP_TYP_SHIFT)
+#define ACPI_ENABLE_TIMEOUT_MS  300
+
+static ACPI_SDT_HEADER *g_root = NULL;
+static BOOL g_xsdt = FALSE;
+static ACPI_MADT_INFO g_madt;
+static BOOL g_madt_found = FALSE;
+static ACPI_FADT_INFO g_fadt;
+static BOOL g_fadt_found = FALSE;
+static ACPI_HPET_INFO g_hpet;
+static BOOL g_hpet_found = FALSE;
+static ACPI_MCFG_INFO g_mcfg;
+static BOOL g_mcfg_found = FALSE;
+
+static BOOL acpi_checksum(const void *table, uint32 length) {
+    const uint8 *bytes = (const uint8 *)table;
+    uint8 sum = 0;
+    uint32 i;
+
+    for (i = 0; i < length; i++)
+        sum += bytes[i];
+    return sum == 0;
+}
+
+static ACPI_RSDP *acpi_scan_rsdp(uint32 start, uint32 end) {
+    uint32 addr;
+
+    // the RSDP sits on a 16 byte boundary
+    for (addr = start; addr + sizeof(ACPI_RSDP) <= end; addr += 16) {
+        ACPI_RSDP *rsdp = (ACPI_RSDP *)addr;
+
+        if (memcmp((uint8 *)rsdp->signature, (uint8 *)"RSD PTR ", 8) == 0 && acpi_checksum(rsdp, 20))
+            return rsdp;
+    }
+    return NULL;
+}
+
+static ACPI_RSDP *acpi_find_rsdp(void) {
+    uint32 ebda;
+
+    // the BIOS data area is in page 0, which is kept unmapped
+    paging_map(paging_kernel_directory(), 0, 0, PAGE_PRESENT);
+    ebda = (uint32)*(uint16 *)BDA_EBDA_SEGMENT << 4;
+    paging_unmap(paging_kernel_directory(), 0);
+
+    if (ebda >= PAGE_SIZE && ebda < BIOS_ROM_START) {
+        ACPI_RSDP *rsdp = acpi_scan_rsdp(ebda, ebda + 1024);
+        if (rsdp)
+            return rsdp;
+    }
+    return acpi_scan_rsdp(BIOS_ROM_START, BIOS_ROM_END);
+}
+
+// tables may live in reserved memory past the identity mapped RAM
+static ACPI_SDT_HEADER *acpi_map_table(uint32 phys) {
+    ACPI_SDT_HEADER *header = (ACPI_SDT_HEADER *)phys;
+
+    if (phys == 0)
+        return NULL;
+    paging_map_mmio(phys, sizeof(ACPI_SDT_HEADER));
+    paging_map_mmio(phys, header->length);
+    if (!acpi_checksum(header, header->length))
+        return NULL;
+    return header;
+}
+
+static void acpi_parse_madt(ACPI_MADT *madt) {
+    uint8 *entry = (uint8 *)(madt + 1);
+    uint8 *end = (uint8 *)madt + madt->header.length;
+
+    memset(&g_madt, 0, sizeof(g_madt));
+    g_madt.lapic_address = madt->lapic_address;
+    g_madt.pic_present = (madt->flags & MADT_PCAT_COMPAT) ? TRUE : FALSE;
+
+    while (entry + 2 <= end && entry[1] >= 2) {
+        switch (entry[0]) {
+        case MADT_LOCAL_APIC:
+            // acpi processor id, apic id, flags
+            if ((*(uint32 *)(entry + 4) & MADT_CPU_ENABLED) && g_madt.cpu_count < CPU_MAX)
+                g_madt.cpu_apic_ids[g_madt.cpu_count++] = entry[3];
+            break;
+        case MADT_IO_APIC:
+            if (g_madt.ioapic_count < ACPI_MAX_IOAPICS) {
+                ACPI_IOAPIC *ioapic = &g_madt.ioapics[g_madt.ioapic_count++];
+
+                ioapic->id = entry[2];
+                ioapic->address = *(uint32 *)(entry + 4);
+                ioapic->gsi_base = *(uint32 *)(entry + 8);
+            }
+            break;
+        case MADT_IRQ_OVERRIDE:
+            if (g_madt.override_count < ACPI_MAX_OVERRIDES) {
+                ACPI_IRQ_OVERRIDE *override = &g_madt.overrides[g_madt.override_count++];
+
+                override->irq = entry[3];
+                override->gsi = *(uint32 *)(entry + 4);
+                override->flags = *(uint16 *)(entry + 8);
+            }
+            break;
+        }
+        entry += entry[1];
+    }
+    g_madt_found = TRUE;
+}
+
+// an integer element of a package, p is advanced past it
+static BOOL aml_integer(const uint8 **p, const uint8 *end, uint8 *value) {
+    if (*p >= end)
+        return FALSE;
+    if (**p == AML_BYTE_PREFIX) {
+        if (*p + 1 >= end)
+            return FALSE;
+        (*p)++;
+    } else if (**p != AML_ZERO_OP && **p != AML_ONE_OP) {
+        return FALSE;
+    }
+    *value = *(*p)++;
+    return TRUE;
+}
+
+// SLP_TYPa and SLP_TYPb of the \_S5_ package
+static BOOL acpi_parse_s5(ACPI_SDT_HEADER *dsdt) {
+    const uint8 *aml = (const uint8 *)(dsdt + 1);
+    const uint8 *end = (const uint8 *)dsdt + dsdt->length;
+    const uint8 *p;
+
+    for (p = aml + 2; p + 4 < end; p++) {
+        if (memcmp((uint8 *)p, (uint8 *)"_S5_", 4) != 0)
+            continue;
+        if (p[-1] != AML_NAME_OP && (p[-2] != AML_NAME_OP || p[-1] != AML_ROOT_CHAR))
+            continue;
+        p += 4;
+        if (*p++ != AML_PACKAGE_OP || p >= end)
+            return FALSE;
+        // the package length takes up to 3 more bytes, then the element count
+        p += (*p >> 6) + 2;
+        return aml_integer(&p, end, &g_fadt.s5_typ_a) && aml_integer(&p, end, &g_fadt.s5_typ_b);
+    }
+    return FALSE;
+}
+
+// the ACPI 2.0 fields exist only in tables that long
+#define FADT_HAS(fadt, field) \
+    ((fadt)->header.length >= __builtin_offsetof(ACPI_FADT, field) + sizeof((fadt)->field))
+
+static void acpi_parse_fadt(ACPI_FADT *fadt) {
+    ACPI_SDT_HEADER *dsdt = NULL;
+
+    memset(&g_fadt, 0, sizeof(g_fadt));
+    g_fadt.sci_irq = fadt->sci_irq;
+    g_fadt.smi_cmd = fadt->smi_cmd;
+    g_fadt.acpi_enable = fadt->acpi_enable;
+    g_fadt.pm1a_cnt = (uint16)fadt->pm1a_cnt_blk;
+    g_fadt.pm1b_cnt = (uint16)fadt->pm1b_cnt_blk;
+    if (fadt->pm_tmr_len == 4)
+        g_fadt.pm_timer = (uint16)fadt->pm_tmr_blk;
+    g_fadt.pm_timer_32 = (fadt->flags & FADT_TMR_VAL_EXT) ? TRUE : FALSE;
+
+    if (FADT_HAS(fadt, reset_value) && (fadt->flags & FADT_RESET_REG_SUP)) {
+        g_fadt.reset_supported = TRUE;
+        g_fadt.reset_reg = fadt->reset_reg;
+        g_fadt.reset_value = fadt->reset_value;
+    }
+
+    if (FADT_HAS(fadt, x_dsdt_high) && fadt->x_dsdt_high == 0 && fadt->x_dsdt_low)
+        dsdt = acpi_map_table(fadt->x_dsdt_low);
+    if (!dsdt)
+        dsdt = acpi_map_table(fadt->dsdt);
+    if (dsdt)
+        g_fadt.s5_found = acpi_parse_s5(dsdt);
+    g_fadt_found = TRUE;
+}
+
+static void acpi_parse_hpet(ACPI_HPET *hpet) {
+    // the counter is only usable from here when it is in memory below 4GB
+    if (hpet->address.address_space != ACPI_GAS_MEMORY || hpet->address.address_high != 0
+            || hpet->address.address_low == 0)
+        return;
+    g_hpet.address = hpet->address.address_low;
+    g_hpet.number = hpet->number;
+    g_hpet.comparators = HPET_ID_COMPARATORS(hpet->event_timer_block_id);
+    g_hpet.counter_64 = (hpet->event_timer_block_id & HPET_ID_COUNTER_64) ? TRUE : FALSE;
+    g_hpet.vendor_id = hpet->event_timer_block_id >> 16;
+    g_hpet.min_tick = hpet->min_tick;
+    g_hpet_found = TRUE;
+}
+
+static void acpi_parse_mcfg(ACPI_MCFG *mcfg) {
+    ACPI_MCFG_ENTRY *entry = (ACPI_MCFG_ENTRY *)(mcfg + 1);
+    ACPI_MCFG_ENTRY *end = (ACPI_MCFG_ENTRY *)((uint8 *)mcfg + mcfg->header.length);
+
+    for (; entry + 1 <= end; entry++) {
+        if (entry->segment != 0 || entry->address_high != 0)
+            continue;
+        g_mcfg.address = entry->address_low;
+        g_mcfg.start_bus = entry->start_bus;
+        g_mcfg.end_bus = entry->end_bus;
+        g_mcfg_found = TRUE;
+        return;
+    }
+}
+
+/**
+ * locate the root table and parse the MADT, FADT, HPET and MCFG, FALSE without ACPI
+ */
+BOOL acpi_init(void) {
+    ACPI_RSDP *rsdp = acpi_find_rsdp();
+    ACPI_MADT *madt;
+    ACPI_FADT *fadt;
+    ACPI_HPET *hpet;
+    ACPI_MCFG *mcfg;
+
+    if (!rsdp)
+        return FALSE;
+
+    // the XSDT has 64 bit pointers, only usable here when they are below 4GB
+    if (rsdp->revision >= 2 && rsdp->xsdt_address_high == 0 && rsdp->xsdt_address_low) {
+        g_root = acpi_map_table(rsdp->xsdt_address_low);
+        g_xsdt = g_root != NULL;
+    }
+    if (!g_root)
+        g_root = acpi_map_table(rsdp->rsdt_address);
+    if (!g_root)
+        return FALSE;
+
+    madt = (ACPI_MADT *)acpi_find_table("APIC");
+    if (madt)
+        acpi_parse_madt(madt);
+    fadt = (ACPI_FADT *)acpi_find_table("FACP");
+    if (fadt)
+        acpi_parse_fadt(fadt);
+    hpet = (ACPI_HPET *)acpi_find_table("HPET");
+    if (hpet)
+        acpi_parse_hpet(hpet);
+    mcfg = (ACPI_MCFG *)acpi_find_table("MCFG");
+    if (mcfg)
+        acpi_parse_mcfg(mcfg);
+    return TRUE;
+}
+
+/**
+ * mapped table by index in the root table, NULL past the last
+ */
+ACPI_SDT_HEADER *acpi_table_get(uint32 index) {
+    uint32 entry_size = g_xsdt ? 8 : 4;
+    uint32 *entry;
+
+    if (!g_root || index >= (g_root->length - sizeof(ACPI_SDT_HEADER)) / entry_size)
+        return NULL;
+    entry = (uint32 *)((uint8 *)(g_root + 1) + index * entry_size);
+    if (g_xsdt && entry[1] != 0)
+        return NULL;
+    return acpi_map_table(entry[0]);
+}
+
+/**
+ * mapped table with the given 4 character signature, NULL if absent
+ */
+ACPI_SDT_HEADER *acpi_find_table(const char *signature) {
+    uint32 entry_size = g_xsdt ? 8 : 4;
+    uint32 count, i;
+
+    if (!g_root)
+        return NULL;
+
+    count = (g_root->length - sizeof(ACPI_SDT_HEADER)) / entry_size;
+    for (i = 0; i < count; i++) {
+        ACPI_SDT_HEADER *header = acpi_table_get(i);
+
+        if (header && memcmp((uint8 *)header->signature, (uint8 *)signature, 4) == 0)
+            return header;
+    }
+    return NULL;
+}
+
+/**
+ * parsed MADT, NULL if there is none
+ */
+const ACPI_MADT_INFO *acpi_madt(void) {
+    return g_madt_found ? &g_madt : NULL;
+}
+
+/**
+ * parsed FADT, NULL if there is none
+ */
+const ACPI_FADT_INFO *acpi_fadt(void) {
+    return g_fadt_found ? &g_fadt : NULL;
+}
+
+/**
+ * parsed HPET table, NULL if there is none
+ */
+const ACPI_HPET_INFO *acpi_hpet(void) {
+    return g_hpet_found ? &g_hpet : NULL;
+}
+
+/**
+ * ECAM window of PCI segment 0 from the MCFG, NULL if there is none
+ */
+const ACPI_MCFG_INFO *acpi_mcfg(void) {
+    return g_mcfg_found ? &g_mcfg : NULL;
+}
+
+// switch from legacy to ACPI mode unless the firmware already did
+static BOOL acpi_enable_mode(void) {
+    uint32 ms;
+
+    if (inports(g_fadt.pm1a_cnt) & ACPI_PM1_SCI_EN)
+        return TRUE;
+    if (!g_fadt.smi_cmd || !g_fadt.acpi_enable)
+        return FALSE;
+    outportb(g_fadt.smi_cmd, g_fadt.acpi_enable);
+    for (ms = 0; ms < ACPI_ENABLE_TIMEOUT_MS; ms++) {
+        if (inports(g_fadt.pm1a_cnt) & ACPI_PM1_SCI_EN)
+            return TRUE;
+        io_wait_us(1000);
+    }
+    return FALSE;
+}
+
+static void acpi_sleep_type(uint16 port, uint8 type) {
+    uint16 value = inports(port) & ~(ACPI_PM1_SLP_TYP_MASK | ACPI_PM1_SLP_EN);
+
+    outports(port, value | (type << ACPI_PM1_SLP_TYP_SHIFT) | ACPI_PM1_SLP_EN);
+}
+
+/**
+ * enter S5 soft off, only returns when that failed
+ */
+void acpi_power_off(void) {
+    uint32 flags;
+
+    if (!g_fadt_found || !g_fadt.s5_found || !g_fadt.pm1a_cnt || !acpi_enable_mode())
+        return;
+    flags = irq_save();
+    acpi_sleep_type(g_fadt.pm1a_cnt, g_fadt.s5_typ_a);
+    if (g_fadt.pm1b_cnt)
+        acpi_sleep_type(g_fadt.pm1b_cnt, g_fadt.s5_typ_b);
+    // the chipset takes a moment to cut power
+    io_wait_us(10000);
+    irq_restore(flags);
+}
+
+/**
+ * reset through the FADT reset register, only returns when that failed
+ */
+void acpi_reset(void) {
+    const ACPI_GAS *reg = &g_fadt.reset_reg;
+
+    if (!g_fadt_found || !g_fadt.reset_supported || reg->address_high != 0)
+        return;
+    if (reg->address_space == ACPI_GAS_IO) {
+        outportb((uint16)reg->address_low, g_fadt.reset_value);
+    } else if (reg->address_space == ACPI_GAS_MEMORY) {
+        paging_map_mmio(reg->address_low, 1);
+        *(volatile uint8 *)reg->address_low = g_fadt.reset_value;
+    }
+    io_wait_us(10000);
+}
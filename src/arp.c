@@ -0,0 +1,163 @@
+/**
+ * ARP cache
+ * a packet for an unresolved next hop waits in its entry, a newer one
+ * replacing it, and leaves with the reply. requests are answered in the
+ * buffer they came in
+ */
+
+#include "arp.h"
+#include "clock.h"
+#include "spinlock.h"
+#include "string.h"
+
+static ARP_ENTRY g_cache[ARP_CACHE_SIZE];
+static SPINLOCK g_arp_lock = SPINLOCK_INIT("arp");
+
+// entry of addr, or the one to take for it: a free one, else the oldest
+static ARP_ENTRY *arp_slot(IP_ADDR addr, BOOL *found) {
+    ARP_ENTRY *victim = &g_cache[0];
+    uint32 i;
+
+    for (i = 0; i < ARP_CACHE_SIZE; i++) {
+        if (g_cache[i].addr == addr) {
+            *found = TRUE;
+            return &g_cache[i];
+        }
+        if (victim->addr && (!g_cache[i].addr || g_cache[i].updated < victim->updated))
+            victim = &g_cache[i];
+    }
+    *found = FALSE;
+    return victim;
+}
+
+static void arp_request(IP_ADDR addr) {
+    NETBUF *buf = netbuf_alloc();
+    NET_CONFIG *config = net_config();
+    ARP_PACKET *arp;
+
+    if (!buf)
+        return;
+    arp = (ARP_PACKET *)buf->data;
+    buf->len = sizeof(ARP_PACKET);
+    arp->htype = htons(ARP_HTYPE_ETHERNET);
+    arp->ptype = htons(ETH_TYPE_IP);
+    arp->hlen = ETH_ALEN;
+    arp->plen = sizeof(IP_ADDR);
+    arp->op = htons(ARP_OP_REQUEST);
+    memcpy(arp->sha, config->dev->mac, ETH_ALEN);
+    arp->spa = config->addr;
+    memset(arp->tha, 0, ETH_ALEN);
+    arp->tpa = addr;
+    net_stats()->arp_requests++;
+    net_send(buf, NULL, ETH_TYPE_ARP);
+}
+
+/**
+ * an ARP packet arrived, buf starts at it
+ */
+void arp_receive(NETBUF *buf) {
+    ARP_PACKET *arp = (ARP_PACKET *)buf->data;
+    NET_CONFIG *config = net_config();
+    NETBUF *pending = NULL;
+    ARP_ENTRY *entry;
+    uint8 mac[ETH_ALEN];
+    BOOL found, for_us;
+    uint32 flags;
+
+    if (buf->len < sizeof(ARP_PACKET) || ntohs(arp->htype) != ARP_HTYPE_ETHERNET
+            || ntohs(arp->ptype) != ETH_TYPE_IP || arp->hlen != ETH_ALEN || arp->plen != sizeof(IP_ADDR)
+            || arp->spa == 0) {
+        netbuf_free(buf);
+        return;
+    }
+    for_us = arp->tpa == config->addr;
+    memcpy(mac, arp->sha, ETH_ALEN);
+
+    // the sender is remembered if it asks us, or if we asked it
+    flags = spin_lock_irqsave(&g_arp_lock);
+    entry = arp_slot(arp->spa, &found);
+    if (found || for_us) {
+        if (!found && entry->pending) {
+            netbuf_free(entry->pending);
+            entry->pending = NULL;
+        }
+        entry->addr = arp->spa;
+        memcpy(entry->mac, mac, ETH_ALEN);
+        entry->resolved = TRUE;
+        entry->updated = clock_ns();
+        pending = entry->pending;
+        entry->pending = NULL;
+    }
+    spin_unlock_irqrestore(&g_arp_lock, flags);
+    if (pending)
+        net_send(pending, mac, ETH_TYPE_IP);
+
+    if (!for_us || ntohs(arp->op) != ARP_OP_REQUEST) {
+        netbuf_free(buf);
+        return;
+    }
+    arp->op = htons(ARP_OP_REPLY);
+    memcpy(arp->tha, mac, ETH_ALEN);
+    arp->tpa = arp->spa;
+    memcpy(arp->sha, config->dev->mac, ETH_ALEN);
+    arp->spa = config->addr;
+    buf->len = sizeof(ARP_PACKET);
+    net_stats()->arp_replies++;
+    net_send(buf, mac, ETH_TYPE_ARP);
+}
+
+/**
+ * send the IP packet in buf to next_hop, holding it until the address is
+ * resolved. buf is gone afterwards either way
+ */
+BOOL arp_output(NETBUF *buf, IP_ADDR next_hop) {
+    uint64 now = clock_ns();
+    NETBUF *dropped = NULL;
+    ARP_ENTRY *entry;
+    uint8 mac[ETH_ALEN];
+    BOOL found, ask = FALSE;
+    uint32 flags;
+
+    flags = spin_lock_irqsave(&g_arp_lock);
+    entry = arp_slot(next_hop, &found);
+    if (found && entry->resolved && now - entry->updated < (uint64)ARP_LIFETIME_MS * NSEC_PER_MSEC) {
+        memcpy(mac, entry->mac, ETH_ALEN);
+        spin_unlock_irqrestore(&g_arp_lock, flags);
+        return net_send(buf, mac, ETH_TYPE_IP);
+    }
+
+    if (!found || entry->resolved) {
+        dropped = entry->pending;
+        entry->addr = next_hop;
+        entry->resolved = FALSE;
+        entry->pending = NULL;
+        ask = TRUE;
+    } else if (now - entry->updated >= (uint64)ARP_RETRY_MS * NSEC_PER_MSEC) {
+        ask = TRUE;
+    }
+    if (ask)
+        entry->updated = now;
+    if (entry->pending)
+        dropped = entry->pending;
+    entry->pending = buf;
+    spin_unlock_irqrestore(&g_arp_lock, flags);
+
+    netbuf_free(dropped);
+    if (ask)
+        arp_request(next_hop);
+    return TRUE;
+}
+
+/**
+ * copy of cache entry index, FALSE past the last
+ */
+BOOL arp_entry(uint32 index, ARP_ENTRY *entry) {
+    uint32 flags;
+
+    if (index >= ARP_CACHE_SIZE)
+        return FALSE;
+    flags = spin_lock_irqsave(&g_arp_lock);
+    *entry = g_cache[index];
+    spin_unlock_irqrestore(&g_arp_lock, flags);
+    return TRUE;
+}
@@ -44,5 +44,7 @@ _start:
     extern kmain
     push ebx
     call kmain
+    cli
 loop:
+    hlt
     jmp loop
@@ -56,4 +56,38 @@ IRQ 13, 45
 IRQ 14, 46
 IRQ 15, 47
 
+; local APIC vectors, pushed as dwords since they don't fit a signed byte
+%macro APIC_IRQ 1
+  global apic_irq_%1
+  apic_irq_%1:
+    cli
+    push byte 0
+    push dword %1
+    jmp irq_handler
+%endmacro
 
+; MSI_VECTOR_BASE to MSI_VECTOR_BASE + MSI_VECTORS - 1, handed out by isr_alloc_vector()
+APIC_IRQ 80
+APIC_IRQ 81
+APIC_IRQ 82
+APIC_IRQ 83
+APIC_IRQ 84
+APIC_IRQ 85
+APIC_IRQ 86
+APIC_IRQ 87
+APIC_IRQ 88
+APIC_IRQ 89
+APIC_IRQ 90
+APIC_IRQ 91
+APIC_IRQ 92
+APIC_IRQ 93
+APIC_IRQ 94
+APIC_IRQ 95
+
+APIC_IRQ 240              ; IPI_RESCHEDULE_VECTOR
+APIC_IRQ 241              ; LAPIC_TIMER_VECTOR
+
+; spurious interrupts must not be acknowledged
+global apic_spurious
+apic_spurious:
+    iret
@@ -1,5 +1,6 @@
 section .text
     global load_gdt
+    global load_tss
 
 load_gdt:
     mov eax, [esp + 4]  ; get gdt pointer
@@ -30,3 +31,7 @@ load_gdt:
 far_jump:
     ret
 
+load_tss:
+    mov ax, [esp + 4]   ; get tss selector
+    ltr ax              ; load task register
+    ret
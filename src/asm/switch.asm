@@ -0,0 +1,46 @@
+section .text
+    global task_switch
+    global enter_usermode
+
+; void task_switch(uint32 *old_esp, uint32 new_esp)
+; save callee saved registers on the current stack, store its pointer
+; and resume the task whose stack was saved at new_esp
+task_switch:
+    mov eax, [esp + 4]  ; where to store the old stack pointer
+    mov edx, [esp + 8]  ; stack pointer of the task to resume
+
+    push ebp
+    push ebx
+    push esi
+    push edi
+
+    mov [eax], esp
+    mov esp, edx
+
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret
+
+; void enter_usermode(uint32 eip, uint32 esp)
+; build an interrupt frame for ring 3 and iret into it
+enter_usermode:
+    mov ecx, [esp + 4]  ; user entry point
+    mov edx, [esp + 8]  ; user stack pointer
+
+    mov ax, 0x23        ; user data segment
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+
+    push 0x23           ; ss
+    push edx            ; esp
+    pushf
+    pop eax
+    or eax, 0x200       ; interrupts on in user mode
+    push eax            ; eflags
+    push 0x1B           ; cs, user code segment
+    push ecx            ; eip
+    iret
@@ -0,0 +1,79 @@
+section .text
+    extern syscall_handler
+    global syscall_int80
+    global syscall_sysenter
+    global syscall_return
+
+; int 0x80 trap gate, builds the same frame as irq.asm
+; so the handler gets a REGISTERS pointer and can set eax
+syscall_int80:
+    push byte 0           ; no error code
+    push 128              ; interrupt number
+    pusha                 ; push all registers
+    mov ax, ds
+    push eax              ; save ds
+
+    mov ax, 0x10          ; load kernel data segment
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+
+    push esp
+    call syscall_handler
+    add esp, 4
+
+; also where a forked task first returns to ring 3
+syscall_return:
+    pop ebx               ; restore user data segment
+    mov ds, bx
+    mov es, bx
+    mov fs, bx
+    mov gs, bx
+
+    popa                  ; restore all registers, eax holds the result
+    add esp, 0x8          ; drop interrupt number and error code
+    iret
+
+; sysenter lands here on the task's kernel stack with interrupts off
+; eax = number, ebx, esi, edi = arguments, ecx = user esp, edx = user eip
+; the frame matches syscall_int80, with the arguments moved to ebx, ecx, edx
+syscall_sysenter:
+    push 0x23             ; ss
+    push ecx              ; user stack pointer
+    push 0x202            ; eflags, interrupts on
+    push 0x1B             ; cs
+    push edx              ; user return address
+    push byte 0           ; no error code
+    push 128              ; interrupt number
+    pusha
+    mov [esp + 24], esi   ; arg2 in the saved ecx
+    mov [esp + 20], edi   ; arg3 in the saved edx
+    mov ax, ds
+    push eax              ; save ds
+
+    mov ax, 0x10          ; load kernel data segment
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    sti
+
+    push esp
+    call syscall_handler
+    add esp, 4
+
+    cli
+    pop ebx               ; restore user data segment
+    mov ds, bx
+    mov es, bx
+    mov fs, bx
+    mov gs, bx
+
+    popa                  ; ebx/esi/edi/ebp as the caller left them, eax = result
+    add esp, 0x8          ; drop interrupt number and error code
+    mov edx, [esp]        ; user return address for sysexit
+    mov ecx, [esp + 12]   ; user stack pointer for sysexit
+    add esp, 20
+    sti                   ; takes effect after sysexit
+    sysexit
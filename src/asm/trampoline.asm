@@ -0,0 +1,67 @@
+; application processor startup code
+; smp.c copies trampoline_start..trampoline_end to TRAMPOLINE_BASE and
+; fills in the parameter block, then wakes the cpu with a STARTUP IPI.
+; the cpu starts in real mode at TRAMPOLINE_BASE, so every address below
+; is computed relative to where the copy lives
+
+TRAMPOLINE_BASE equ 0x8000
+
+%define REL(label) (TRAMPOLINE_BASE + (label - trampoline_start))
+
+section .text
+    global trampoline_start
+    global trampoline_end
+    global trampoline_params
+
+bits 16
+trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+
+    o32 lgdt [REL(trampoline_gdt_ptr)]
+    mov eax, cr0
+    or eax, 1                   ; protected mode
+    mov cr0, eax
+    jmp dword 0x08:REL(trampoline_32)
+
+bits 32
+trampoline_32:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    mov eax, [REL(trampoline_params)]       ; kernel page directory
+    mov cr3, eax
+    mov eax, cr0
+    or eax, 0x80010000          ; paging and supervisor write protect
+    mov cr0, eax
+
+    mov esp, [REL(trampoline_params) + 4]   ; stack
+    push dword [REL(trampoline_params) + 12] ; argument
+    mov eax, [REL(trampoline_params) + 8]   ; entry, never returns
+    call eax
+.halt:
+    hlt
+    jmp .halt
+
+align 8
+trampoline_gdt:
+    dq 0
+    dq 0x00CF9A000000FFFF       ; flat code
+    dq 0x00CF92000000FFFF       ; flat data
+
+trampoline_gdt_ptr:
+    dw trampoline_gdt_ptr - trampoline_gdt - 1
+    dd REL(trampoline_gdt)
+
+; filled in by smp.c: cr3, stack, entry, argument
+align 4
+trampoline_params:
+    dd 0, 0, 0, 0
+
+trampoline_end:
@@ -0,0 +1,299 @@
+/**
+ * Microbenchmarks
+ * samples are read with cpuid before rdtsc, so earlier instructions can't
+ * leak into them, and end with rdtscp where the cpu has it. the null
+ * benchmark is the cost of the timing and the loop itself.
+ * tools/bench.sh collects the serial lines of a run
+ */
+
+#include "bench.h"
+#include "cpu.h"
+#include "cpufeat.h"
+#include "isr.h"
+#include "serial.h"
+#include "console.h"
+#include "string.h"
+#include "utils.h"
+#include "filesystem.h"
+#include "vga.h"
+#include "clock.h"
+#include "timer.h"
+
+#define BENCH_BUFFER_SIZE       4096
+
+static uint8 g_src[BENCH_BUFFER_SIZE];
+static uint8 g_dst[BENCH_BUFFER_SIZE];
+static char g_str1[] = "the quick brown fox jumps over!!";
+static char g_str2[] = "the quick brown fox jumps over!!";
+static char g_long1[256];
+static char g_long2[256];
+static BOOL g_rdtscp = FALSE;
+
+static void bench_null(uint32 ops) {
+    while (ops--)
+        asm volatile("");
+}
+
+static void bench_malloc_free_32(uint32 ops) {
+    while (ops--)
+        free(malloc(32));
+}
+
+static void bench_malloc_free_4k(uint32 ops) {
+    while (ops--)
+        free(malloc(4096));
+}
+
+static void bench_memcpy_64(uint32 ops) {
+    while (ops--)
+        memcpy(g_dst, g_src, 64);
+}
+
+static void bench_memcpy_4k(uint32 ops) {
+    while (ops--)
+        memcpy(g_dst, g_src, BENCH_BUFFER_SIZE);
+}
+
+static void bench_memset_4k(uint32 ops) {
+    while (ops--)
+        memset(g_dst, 0, BENCH_BUFFER_SIZE);
+}
+
+static void bench_strlen_32(uint32 ops) {
+    while (ops--)
+        strlen(g_str1);
+}
+
+static void bench_strlen_256(uint32 ops) {
+    while (ops--)
+        strlen(g_long1);
+}
+
+static void bench_strcmp_256(uint32 ops) {
+    while (ops--)
+        strcmp(g_long1, g_long2);
+}
+
+static void bench_strstr_256(uint32 ops) {
+    while (ops--)
+        strstr(g_long1, "quick brown fox");
+}
+
+static void bench_strchr_256(uint32 ops) {
+    while (ops--)
+        strchr(g_long1, 'q');
+}
+
+static void bench_ip_checksum_1500(uint32 ops) {
+    while (ops--)
+        ip_checksum(g_src, 1500);
+}
+
+static void bench_strcmp_32(uint32 ops) {
+    while (ops--)
+        strcmp(g_str1, g_str2);
+}
+
+static void bench_fs_path_to_node(uint32 ops) {
+    while (ops--)
+        fs_path_to_node("/bin/hello");
+}
+
+static void bench_console_putchar(uint32 ops) {
+    while (ops--)
+        console_putchar(' ');
+}
+
+static void bench_clock_ns(uint32 ops) {
+    while (ops--)
+        clock_ns();
+}
+
+static void bench_vga_draw_pixel(uint32 ops) {
+    uint32 i;
+
+    for (i = 0; i < ops; i++)
+        vga_draw_pixel(i & 0xFF, 100, i & 0xF);
+}
+
+static const BENCH g_benches[] = {
+    { "null", bench_null, 64, NULL, NULL },
+    { "malloc_free_32", bench_malloc_free_32, 64, NULL, NULL },
+    { "malloc_free_4k", bench_malloc_free_4k, 16, NULL, NULL },
+    { "memcpy_64", bench_memcpy_64, 64, NULL, NULL },
+    { "memcpy_4k", bench_memcpy_4k, 8, NULL, NULL },
+    { "memset_4k", bench_memset_4k, 8, NULL, NULL },
+    { "strlen_32", bench_strlen_32, 64, NULL, NULL },
+    { "strlen_256", bench_strlen_256, 16, NULL, NULL },
+    { "strcmp_256", bench_strcmp_256, 16, NULL, NULL },
+    { "strstr_256", bench_strstr_256, 16, NULL, NULL },
+    { "strchr_256", bench_strchr_256, 16, NULL, NULL },
+    { "ip_checksum_1500", bench_ip_checksum_1500, 16, NULL, NULL },
+    { "strcmp_32", bench_strcmp_32, 64, NULL, NULL },
+    { "fs_path_to_node", bench_fs_path_to_node, 16, NULL, NULL },
+    { "console_putchar", bench_console_putchar, 16, NULL, NULL },
+    { "vga_draw_pixel", bench_vga_draw_pixel, 64, NULL, NULL },
+    { "clock_ns", bench_clock_ns, 16, NULL, NULL },
+    // the sse2 scans with their fpu_kernel_begin()/end(), against the above
+    { "strlen_256/sse2", bench_strlen_256, 16, "strlen", "sse2" },
+    { "strcmp_256/sse2", bench_strcmp_256, 16, "strcmp", "sse2" },
+    { "strstr_256/sse2", bench_strstr_256, 16, "strstr", "sse2" },
+    { "strchr_256/sse2", bench_strchr_256, 16, "strchr", "sse2" },
+};
+
+#define BENCH_COUNT (sizeof(g_benches) / sizeof(g_benches[0]))
+
+static inline uint64 bench_begin(void) {
+    uint32 eax, ebx, ecx, edx;
+
+    cpu_cpuid(0, &eax, &ebx, &ecx, &edx);
+    return cpu_rdtsc();
+}
+
+static inline uint64 bench_end(void) {
+    uint32 eax, ebx, ecx, edx;
+    uint64 tsc;
+
+    if (g_rdtscp) {
+        tsc = cpu_rdtscp();
+        // keeps later instructions from starting before the read
+        cpu_cpuid(0, &eax, &ebx, &ecx, &edx);
+    } else {
+        cpu_cpuid(0, &eax, &ebx, &ecx, &edx);
+        tsc = cpu_rdtsc();
+    }
+    return tsc;
+}
+
+static uint32 bench_sample(const BENCH *bench) {
+    uint32 flags = irq_save();
+    uint64 start = bench_begin();
+    uint64 cycles;
+
+    bench->fn(bench->ops);
+    cycles = bench_end() - start;
+    irq_restore(flags);
+
+    // without 64 bit division, a sample that long is broken anyway
+    if (cycles >> 32)
+        return 0xFFFFFFFF;
+    return (uint32)cycles / bench->ops;
+}
+
+static void bench_field(char *line, const char *key, uint32 value) {
+    char num[16];
+
+    itoa(num, 'u', value);
+    strcat(line, key);
+    strcat(line, num);
+}
+
+/**
+ * number of benchmarks in the suite
+ */
+uint32 bench_count(void) {
+    return BENCH_COUNT;
+}
+
+/**
+ * benchmark at index, NULL past the last
+ */
+const BENCH *bench_get(uint32 index) {
+    return index < BENCH_COUNT ? &g_benches[index] : NULL;
+}
+
+/**
+ * FALSE when bench times a variant the cpu can't run
+ */
+BOOL bench_available(const BENCH *bench) {
+    const CPU_DISPATCH *dispatch;
+    uint32 i;
+
+    if (!bench->routine)
+        return TRUE;
+    dispatch = cpu_dispatch_find(bench->routine);
+    for (i = 0; dispatch && i < dispatch->variant_count; i++) {
+        if (strcmp(dispatch->variants[i].name, bench->variant) == 0)
+            return cpu_has(dispatch->variants[i].needs);
+    }
+    return FALSE;
+}
+
+// insertion sort, the samples arrive one at a time
+static void bench_insert(uint32 *samples, uint32 count, uint32 value) {
+    uint32 i;
+
+    for (i = count; i > 0 && samples[i - 1] > value; i--)
+        samples[i] = samples[i - 1];
+    samples[i] = value;
+}
+
+// summary of the sorted samples, also as a key=value line on the serial port
+static void bench_report(const char *name, uint32 ops, const uint32 *samples, BENCH_RESULT *result) {
+    char line[128];
+
+    result->min = samples[0];
+    result->median = samples[BENCH_REPS / 2];
+    result->p99 = samples[(BENCH_REPS * 99 + 99) / 100 - 1];
+
+    strcpy(line, "bench name=");
+    strcat(line, name);
+    bench_field(line, " ops=", ops);
+    bench_field(line, " min=", result->min);
+    bench_field(line, " median=", result->median);
+    bench_field(line, " p99=", result->p99);
+    strcat(line, "\n");
+    serial_write(line);
+}
+
+/**
+ * time bench, also writing a key=value line of the result to the serial port
+ */
+void bench_run(const BENCH *bench, BENCH_RESULT *result) {
+    uint32 samples[BENCH_REPS];
+    const char *bound = NULL;
+    uint32 i;
+
+    g_rdtscp = cpu_has(CPU_FEAT_RDTSCP);
+    // equal strings of 255 bytes, the strstr needle at their end
+    if (!g_long1[0]) {
+        memset(g_long1, 'x', sizeof(g_long1) - 1);
+        strcpy(g_long1 + sizeof(g_long1) - 16, "quick brown fox");
+        strcpy(g_long2, g_long1);
+    }
+
+    if (bench->routine) {
+        memset(result, 0, sizeof(BENCH_RESULT));
+        if (!bench_available(bench))
+            return;
+        bound = cpu_dispatch_find(bench->routine)->chosen->name;
+        cpu_dispatch_bind(bench->routine, bench->variant);
+    }
+
+    for (i = 0; i < BENCH_WARMUP; i++)
+        bench_sample(bench);
+    for (i = 0; i < BENCH_REPS; i++)
+        bench_insert(samples, i, bench_sample(bench));
+    if (bound)
+        cpu_dispatch_bind(bench->routine, bound);
+    bench_report(bench->name, bench->ops, samples, result);
+}
+
+/**
+ * how many ns after their deadline BENCH_REPS sleeps of BENCH_WAKEUP_US
+ * get to run again, reported like a benchmark named BENCH_WAKEUP_NAME
+ */
+void bench_wakeup_latency(BENCH_RESULT *result) {
+    uint32 samples[BENCH_REPS];
+    uint32 i;
+
+    for (i = 0; i < BENCH_REPS; i++) {
+        uint64 deadline = clock_ns() + BENCH_WAKEUP_US * NSEC_PER_USEC;
+        uint64 late;
+
+        timer_sleep_until(deadline);
+        late = clock_ns() - deadline;
+        bench_insert(samples, i, late >> 32 ? 0xFFFFFFFF : (uint32)late);
+    }
+    bench_report(BENCH_WAKEUP_NAME, 1, samples, result);
+}
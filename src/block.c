@@ -0,0 +1,151 @@
+/**
+ * Block layer
+ * a submitted batch goes to the end of the disk's queue, and the driver
+ * takes from its front until the device is full. completions make room,
+ * and the driver kicks the queue again from its interrupt handler
+ */
+
+#include "block.h"
+#include "string.h"
+
+static BLOCK_DEVICE *g_devices[BLOCK_MAX_DEVICES];
+static uint32 g_device_count = 0;
+
+/**
+ * add dev, named and sized by its driver
+ */
+BOOL block_register(BLOCK_DEVICE *dev) {
+    if (g_device_count == BLOCK_MAX_DEVICES)
+        return FALSE;
+    spin_init(&dev->lock, "block");
+    dev->queue = NULL;
+    dev->queue_tail = NULL;
+    waitq_init(&dev->waiters);
+    dev->requests = 0;
+    dev->batches = 0;
+    dev->notifications = 0;
+    g_devices[g_device_count++] = dev;
+    return TRUE;
+}
+
+/**
+ * device by index, NULL past the last
+ */
+BLOCK_DEVICE *block_get(uint32 index) {
+    return index < g_device_count ? g_devices[index] : NULL;
+}
+
+/**
+ * device with name, NULL if there is none
+ */
+BLOCK_DEVICE *block_find(const char *name) {
+    uint32 i;
+
+    for (i = 0; i < g_device_count; i++) {
+        if (strcmp(g_devices[i]->name, name) == 0)
+            return g_devices[i];
+    }
+    return NULL;
+}
+
+/**
+ * hand queued requests to the driver
+ */
+void block_kick(BLOCK_DEVICE *dev) {
+    uint32 flags = spin_lock_irqsave(&dev->lock);
+    BLOCK_REQUEST *rest;
+
+    // a request taken may complete on another cpu at once, and be gone
+    if (dev->queue) {
+        rest = dev->submit(dev, dev->queue);
+        if (rest != dev->queue)
+            dev->batches++;
+        dev->queue = rest;
+        if (!rest)
+            dev->queue_tail = NULL;
+    }
+    spin_unlock_irqrestore(&dev->lock, flags);
+}
+
+/**
+ * queue the requests linked from batch and start as many as the device
+ * has room for, with one notification. requests outside the disk fail now
+ */
+void block_submit(BLOCK_DEVICE *dev, BLOCK_REQUEST *batch) {
+    BLOCK_REQUEST *req = batch, *next;
+    uint32 flags;
+
+    flags = spin_lock_irqsave(&dev->lock);
+    for (; req; req = next) {
+        next = req->next;
+        req->next = NULL;
+        if (req->op != BLOCK_FLUSH
+                && (req->count == 0 || req->sector + req->count > dev->sectors || req->sector + req->count < req->sector)) {
+            spin_unlock_irqrestore(&dev->lock, flags);
+            block_complete(dev, req, BLOCK_ERANGE);
+            flags = spin_lock_irqsave(&dev->lock);
+            continue;
+        }
+        if (req->op == BLOCK_WRITE && dev->read_only) {
+            spin_unlock_irqrestore(&dev->lock, flags);
+            block_complete(dev, req, BLOCK_EUNSUPPORTED);
+            flags = spin_lock_irqsave(&dev->lock);
+            continue;
+        }
+        req->status = BLOCK_PENDING;
+        if (dev->queue_tail)
+            dev->queue_tail->next = req;
+        else
+            dev->queue = req;
+        dev->queue_tail = req;
+        dev->requests++;
+    }
+    spin_unlock_irqrestore(&dev->lock, flags);
+    block_kick(dev);
+}
+
+/**
+ * called by drivers in interrupt context once req is done, then
+ * block_kick() when they have room again
+ */
+void block_complete(BLOCK_DEVICE *dev, BLOCK_REQUEST *req, sint32 status) {
+    BLOCK_DONE done = req->done;
+
+    if (done)
+        done(req, status);
+    // a waiter may free req as soon as it sees the status, don't touch it after
+    req->status = status;
+    waitq_wake_all(&dev->waiters);
+}
+
+/**
+ * sleep until req is done, returns its status
+ */
+sint32 block_wait(BLOCK_DEVICE *dev, BLOCK_REQUEST *req) {
+    waitq_wait_event(&dev->waiters, req->status != BLOCK_PENDING);
+    return req->status;
+}
+
+static sint32 block_sync(BLOCK_DEVICE *dev, BLOCK_OP op, uint64 sector, uint32 count, void *buffer) {
+    BLOCK_REQUEST req;
+
+    memset(&req, 0, sizeof(req));
+    req.op = op;
+    req.sector = sector;
+    req.count = count;
+    req.buffer = buffer;
+    req.status = BLOCK_PENDING;
+    block_submit(dev, &req);
+    return block_wait(dev, &req);
+}
+
+/**
+ * synchronous count sectors from sector into buffer
+ */
+sint32 block_read(BLOCK_DEVICE *dev, uint64 sector, uint32 count, void *buffer) {
+    return block_sync(dev, BLOCK_READ, sector, count, buffer);
+}
+
+sint32 block_write(BLOCK_DEVICE *dev, uint64 sector, uint32 count, const void *buffer) {
+    return block_sync(dev, BLOCK_WRITE, sector, count, (void *)buffer);
+}
@@ -0,0 +1,216 @@
+/**
+ * Clocksources
+ * the system clock is a base time plus the cycles of its source since the
+ * base was taken. the base only moves for counters narrower than 64 bits,
+ * from an hrtimer at half their wrap period, and readers retry around the
+ * update with a sequence count
+ */
+
+#include "clock.h"
+#include "hpet.h"
+#include "timer.h"
+#include "cpu.h"
+#include "cpufeat.h"
+#include "isr.h"
+#include "io_ports.h"
+#include "console.h"
+
+static CLOCKSOURCE *g_sources[CLOCK_SOURCES];
+static uint32 g_source_count = 0;
+static CLOCKSOURCE *volatile g_current = NULL;
+static volatile uint32 g_seq = 0;
+static uint64 g_base_ns = 0;
+static uint64 g_base_cycles = 0;
+static uint64 g_tsc_hz = 0;
+static HRTIMER g_refresh;
+static uint64 g_refresh_ns = 0;
+
+static uint64 clock_read_tsc(void) {
+    return cpu_rdtsc();
+}
+
+static CLOCKSOURCE g_tsc = { "tsc", CLOCK_RATING_TSC, clock_read_tsc, 0xFFFFFFFFFFFFFFFFULL, 0, 0, 0 };
+static CLOCKSOURCE g_hpet = { "hpet", CLOCK_RATING_HPET, hpet_read, 0xFFFFFFFFFFFFFFFFULL, 0, 0, 0 };
+
+// cycles * mult >> shift in two halves, the product needs up to 96 bits
+static uint64 clock_scale(uint64 cycles, uint32 mult, uint32 shift) {
+    uint64 low = (uint64)(uint32)cycles * mult;
+    uint64 high = (cycles >> 32) * mult;
+
+    return (low >> shift) + (high << (32 - shift));
+}
+
+// the largest shift that keeps mult in 32 bits
+static void clock_set_rate(CLOCKSOURCE *source, uint64 hz) {
+    uint64 num = NSEC_PER_SEC, den = hz;
+    uint32 shift = 32;
+
+    while (den >> 32) {
+        num >>= 1;
+        den >>= 1;
+    }
+    while (shift > 0 && cpu_div64(num << shift, (uint32)den, NULL) >> 32)
+        shift--;
+    source->hz = hz;
+    source->shift = shift;
+    source->mult = (uint32)cpu_div64(num << shift, (uint32)den, NULL);
+}
+
+// move the base up to now, before a narrow counter wraps
+static void clock_refresh(HRTIMER *timer) {
+    CLOCKSOURCE *source = g_current;
+    uint64 cycles = source->read();
+
+    g_seq++;
+    asm volatile("" ::: "memory");
+    g_base_ns += clock_scale((cycles - g_base_cycles) & source->mask, source->mult, source->shift);
+    g_base_cycles = cycles;
+    asm volatile("" ::: "memory");
+    g_seq++;
+    hrtimer_start(timer, timer->expires + g_refresh_ns);
+}
+
+// switch the system clock to source without a jump in time
+static void clock_select(CLOCKSOURCE *source) {
+    uint32 flags = irq_save();
+    uint64 now = clock_ns();
+
+    g_seq++;
+    asm volatile("" ::: "memory");
+    g_base_ns = now;
+    g_base_cycles = source->read();
+    g_current = source;
+    asm volatile("" ::: "memory");
+    g_seq++;
+    irq_restore(flags);
+}
+
+// TSC cycles during CLOCK_CALIBRATE_MS of the HPET
+static uint64 clock_tsc_hz_hpet(void) {
+    uint64 target = cpu_div64(hpet_hz(), 1000 / CLOCK_CALIBRATE_MS, NULL);
+    uint64 mask = hpet_counter_64() ? 0xFFFFFFFFFFFFFFFFULL : 0xFFFFFFFF;
+    uint32 flags = irq_save();
+    uint64 start = hpet_read();
+    uint64 tsc = cpu_rdtsc();
+    uint64 elapsed;
+
+    do {
+        elapsed = (hpet_read() - start) & mask;
+    } while (elapsed < target);
+    tsc = cpu_rdtsc() - tsc;
+    irq_restore(flags);
+    return cpu_div64(tsc * hpet_hz(), (uint32)elapsed, NULL);
+}
+
+// TSC cycles during a PIT channel 2 one-shot of CLOCK_CALIBRATE_MS
+static uint64 clock_tsc_hz_pit(void) {
+    uint32 count = PIT_FREQUENCY / (1000 / CLOCK_CALIBRATE_MS);
+    uint8 gate = inportb(PIT_GATE) & ~(PIT_GATE_SPEAKER | PIT_GATE_CHANNEL2);
+    uint32 flags = irq_save();
+    uint64 tsc;
+
+    // load the count with the gate low, the rising edge starts it
+    outportb(PIT_GATE, gate);
+    outportb(PIT_COMMAND, PIT_SELECT_CHANNEL2 | PIT_ACCESS_LOHI | PIT_MODE_ONESHOT);
+    outportb(PIT_CHANNEL2, count & 0xFF);
+    outportb(PIT_CHANNEL2, count >> 8);
+
+    tsc = cpu_rdtsc();
+    outportb(PIT_GATE, gate | PIT_GATE_CHANNEL2);
+    while (!(inportb(PIT_GATE) & PIT_GATE_OUT2))
+        ;
+    tsc = cpu_rdtsc() - tsc;
+    outportb(PIT_GATE, gate);
+    irq_restore(flags);
+    return tsc * (1000 / CLOCK_CALIBRATE_MS);
+}
+
+/**
+ * register the HPET and the TSC and pick the system clock, after acpi_init()
+ */
+void clock_init(void) {
+    BOOL hpet = hpet_init();
+
+    if (hpet) {
+        if (!hpet_counter_64())
+            g_hpet.mask = 0xFFFFFFFF;
+        clock_register(&g_hpet, hpet_hz());
+    }
+
+    g_tsc_hz = hpet ? clock_tsc_hz_hpet() : clock_tsc_hz_pit();
+    if (cpu_has(CPU_FEAT_INVARIANT_TSC))
+        g_tsc.rating = CLOCK_RATING_TSC_STABLE;
+    clock_register(&g_tsc, g_tsc_hz);
+
+    // queued now, fires once timer_init() arms the timer
+    if (g_current->mask != 0xFFFFFFFFFFFFFFFFULL) {
+        g_refresh_ns = clock_cycles_to_ns(g_current, g_current->mask >> 1);
+        hrtimer_init(&g_refresh, clock_refresh, NULL);
+        hrtimer_start(&g_refresh, clock_ns() + g_refresh_ns);
+    }
+    announce("Clock: %s, tsc at %d kHz measured against the %s\n", g_current->name,
+             (uint32)cpu_div64(g_tsc_hz, 1000, NULL), hpet ? "HPET" : "PIT");
+}
+
+/**
+ * add source counting at hz, it becomes the system clock if rated higher
+ */
+BOOL clock_register(CLOCKSOURCE *source, uint64 hz) {
+    if (g_source_count == CLOCK_SOURCES || hz == 0)
+        return FALSE;
+    clock_set_rate(source, hz);
+    g_sources[g_source_count++] = source;
+    if (!g_current || source->rating > g_current->rating)
+        clock_select(source);
+    return TRUE;
+}
+
+/**
+ * the system clock, NULL before clock_init()
+ */
+const CLOCKSOURCE *clock_current(void) {
+    return g_current;
+}
+
+/**
+ * registered source by index, NULL past the last
+ */
+const CLOCKSOURCE *clock_get(uint32 index) {
+    return index < g_source_count ? g_sources[index] : NULL;
+}
+
+/**
+ * nanoseconds since clock_init(), 0 before it
+ */
+uint64 clock_ns(void) {
+    CLOCKSOURCE *source;
+    uint64 base_ns, base_cycles, cycles;
+    uint32 seq;
+
+    do {
+        seq = g_seq;
+        asm volatile("" ::: "memory");
+        source = g_current;
+        if (!source)
+            return 0;
+        base_ns = g_base_ns;
+        base_cycles = g_base_cycles;
+        cycles = source->read();
+        asm volatile("" ::: "memory");
+    } while ((seq & 1) || seq != g_seq);
+    return base_ns + clock_scale((cycles - base_cycles) & source->mask, source->mult, source->shift);
+}
+
+/**
+ * cycles of source in nanoseconds
+ */
+uint64 clock_cycles_to_ns(const CLOCKSOURCE *source, uint64 cycles) {
+    return clock_scale(cycles, source->mult, source->shift);
+}
+
+/**
+ * measured time stamp counter frequency in Hz
+ */
+uint64 clock_tsc_hz(void) {
+    return g_tsc_hz;
+}
@@ -3,6 +3,8 @@
 #include "types.h"
 #include "vga.h"
 #include "keyboard.h"
+#include "spinlock.h"
+#include "task.h"
 
 // Add this function declaration
 static uint16 *g_vga_buffer;
@@ -14,6 +16,9 @@ static uint8 cursor_pos_x = 0, cursor_pos_y = 0;
 uint8 g_fore_color = COLOR_WHITE, g_back_color = COLOR_BLACK;
 static uint16 g_temp_pages[MAXIMUM_PAGES][VGA_TOTAL_ITEMS];
 uint32 g_current_temp_page = 0;
+// set once a task redirected its output, before that there may be no tasks
+static BOOL g_console_sinks = FALSE;
+static SPINLOCK g_console_lock = SPINLOCK_INIT("console");
 
 // clear video buffer array
 void console_clear(VGA_COLOR_TYPE fore_color, VGA_COLOR_TYPE back_color) {
@@ -84,7 +89,7 @@ static void console_newline() {
 
 
 //assign ascii character to video buffer
-void console_putchar(char ch) {
+static void console_put_vga(char ch) {
     if (ch == ' ') {
         g_vga_buffer[g_vga_index++] = vga_item_entry(' ', g_fore_color, g_back_color);
         cursor_pos_x++;
@@ -130,6 +135,20 @@ void console_putchar(char ch) {
     }
 }
 
+void console_putchar(char ch) {
+    CONSOLE_SINK sink = g_console_sinks ? task_current()->console_sink : NULL;
+    uint32 flags;
+
+    if (sink) {
+        sink(ch);
+        return;
+    }
+    // cpus print whole characters, the screen state stays consistent
+    flags = spin_lock_irqsave(&g_console_lock);
+    console_put_vga(ch);
+    spin_unlock_irqrestore(&g_console_lock, flags);
+}
+
 // revert back the printed character and add 0 to it
 void console_ungetchar() {
     if(g_vga_index > 0) {
@@ -187,14 +206,18 @@ void console_gotoxy(uint16 x, uint16 y) {
 void console_putstr(const char *str) {
     uint32 index = 0;
     while (str[index]) {
-        if (str[index] == '\n')
-            console_newline();
-        else
-            console_putchar(str[index]);
+        console_putchar(str[index]);
         index++;
     }
 }
 
+// redirect the current task's console output to sink, NULL restores the screen
+void console_set_sink(CONSOLE_SINK sink) {
+    if (sink)
+        g_console_sinks = TRUE;
+    task_current()->console_sink = sink;
+}
+
 void printf(const char *format, ...) {
     char **arg = (char **)&format;
     int c;
@@ -269,6 +292,7 @@ void getstr(char *buffer) {
 
 // read string from console, and erase or go back util bound occurs
 void getstr_bound(char *buffer, uint8 bound) {
+    char *start = buffer;
     if (!buffer) return;
     while(1) {
         char ch = kb_getchar();
@@ -276,6 +300,8 @@ void getstr_bound(char *buffer, uint8 bound) {
             printf("\n");
             return ;
         } else if(ch == '\b') {
+            if (buffer == start)
+                continue;
             console_ungetchar_bound(bound);
             buffer--;
             *buffer = '\0';
@@ -0,0 +1,223 @@
+/**
+ * CPU feature registry
+ * every feature is a bit of one cpuid leaf. the leaves above the maximum
+ * the cpu reports read as zero, so their features are simply absent
+ */
+
+#include "cpufeat.h"
+#include "cpu.h"
+#include "string.h"
+
+#define CPUID_EAX       0
+#define CPUID_EBX       1
+#define CPUID_ECX       2
+#define CPUID_EDX       3
+
+typedef struct {
+    uint32 leaf;
+    uint8 reg;
+    uint8 bit;
+    const char *name;
+} CPU_FEATURE_BIT;
+
+// in CPU_FEATURE order
+static const CPU_FEATURE_BIT g_feature_bits[CPU_FEAT_COUNT] = {
+    { 0, 0, 0, "none" },
+    { 1, CPUID_EDX, 4, "tsc" },
+    { 1, CPUID_EDX, 5, "msr" },
+    { 1, CPUID_EDX, 9, "apic" },
+    { 1, CPUID_EDX, 11, "sep" },
+    { 1, CPUID_EDX, 24, "fxsr" },
+    { 1, CPUID_EDX, 25, "sse" },
+    { 1, CPUID_EDX, 26, "sse2" },
+    { 1, CPUID_EDX, 28, "ht" },
+    { 1, CPUID_ECX, 0, "sse3" },
+    { 1, CPUID_ECX, 3, "monitor" },
+    { 1, CPUID_ECX, 9, "ssse3" },
+    { 1, CPUID_ECX, 17, "pcid" },
+    { 1, CPUID_ECX, 19, "sse4_1" },
+    { 1, CPUID_ECX, 20, "sse4_2" },
+    { 1, CPUID_ECX, 21, "x2apic" },
+    { 1, CPUID_ECX, 23, "popcnt" },
+    { 1, CPUID_ECX, 26, "xsave" },
+    { 1, CPUID_ECX, 28, "avx" },
+    { 1, CPUID_ECX, 31, "hypervisor" },
+    { 7, CPUID_EBX, 5, "avx2" },
+    { 7, CPUID_EBX, 9, "erms" },
+    { 7, CPUID_EBX, 10, "invpcid" },
+    { 7, CPUID_EDX, 4, "fsrm" },
+    { 0x80000001, CPUID_EDX, 20, "nx" },
+    { 0x80000001, CPUID_EDX, 27, "rdtscp" },
+    { 0x80000007, CPUID_EDX, 8, "invariant_tsc" },
+};
+
+static CPU_INFO g_cpu_info;
+static CPU_DISPATCH *g_dispatch_tables[CPU_DISPATCH_TABLES];
+static uint32 g_dispatch_counts[CPU_DISPATCH_TABLES];
+static uint32 g_dispatch_table_count = 0;
+
+// leaf with its registers in CPUID_* order, zero past the maximum
+static void cpu_leaf(uint32 leaf, uint32 regs[4]) {
+    uint32 max = leaf & 0x80000000 ? g_cpu_info.max_ext_leaf : g_cpu_info.max_leaf;
+
+    if (leaf > max) {
+        memset(regs, 0, 4 * sizeof(uint32));
+        return;
+    }
+    cpu_cpuid(leaf, &regs[CPUID_EAX], &regs[CPUID_EBX], &regs[CPUID_ECX], &regs[CPUID_EDX]);
+}
+
+static void cpu_set(CPU_FEATURE feature) {
+    g_cpu_info.present[feature / 32] |= 1 << (feature % 32);
+}
+
+static void cpu_decode(void) {
+    uint32 regs[4];
+    uint32 leaf = 0;
+    uint32 i;
+
+    cpu_cpuid(0, &g_cpu_info.max_leaf, &regs[CPUID_EBX], &regs[CPUID_ECX], &regs[CPUID_EDX]);
+    // the vendor is ebx, edx, ecx
+    memcpy(g_cpu_info.vendor, &regs[CPUID_EBX], 4);
+    memcpy(g_cpu_info.vendor + 4, &regs[CPUID_EDX], 4);
+    memcpy(g_cpu_info.vendor + 8, &regs[CPUID_ECX], 4);
+    g_cpu_info.vendor[12] = '\0';
+    cpu_cpuid(0x80000000, &g_cpu_info.max_ext_leaf, &regs[CPUID_EBX], &regs[CPUID_ECX], &regs[CPUID_EDX]);
+    if (!(g_cpu_info.max_ext_leaf & 0x80000000))
+        g_cpu_info.max_ext_leaf = 0;
+
+    cpu_leaf(1, regs);
+    g_cpu_info.stepping = regs[CPUID_EAX] & 0xF;
+    g_cpu_info.model = (regs[CPUID_EAX] >> 4) & 0xF;
+    g_cpu_info.family = (regs[CPUID_EAX] >> 8) & 0xF;
+    if (g_cpu_info.family == 0xF)
+        g_cpu_info.family += (regs[CPUID_EAX] >> 20) & 0xFF;
+    if (g_cpu_info.family == 6 || g_cpu_info.family >= 0xF)
+        g_cpu_info.model += ((regs[CPUID_EAX] >> 16) & 0xF) << 4;
+
+    // the table is sorted by leaf, so each one is read once
+    cpu_set(CPU_FEAT_NONE);
+    for (i = 1; i < CPU_FEAT_COUNT; i++) {
+        const CPU_FEATURE_BIT *bit = &g_feature_bits[i];
+
+        if (bit->leaf != leaf) {
+            leaf = bit->leaf;
+            cpu_leaf(leaf, regs);
+        }
+        if (regs[bit->reg] & (1 << bit->bit))
+            cpu_set(i);
+    }
+
+    memset(g_cpu_info.brand, 0, sizeof(g_cpu_info.brand));
+    for (i = 0; i < 3; i++) {
+        cpu_leaf(0x80000002 + i, regs);
+        memcpy(g_cpu_info.brand + i * 16, regs, 16);
+    }
+}
+
+/**
+ * decode cpuid, first thing at boot
+ */
+void cpu_features_init(void) {
+    cpu_decode();
+}
+
+/**
+ * what cpuid reported
+ */
+const CPU_INFO *cpu_info(void) {
+    return &g_cpu_info;
+}
+
+/**
+ * TRUE when the cpu has feature
+ */
+BOOL cpu_has(CPU_FEATURE feature) {
+    if (feature >= CPU_FEAT_COUNT)
+        return FALSE;
+    return (g_cpu_info.present[feature / 32] >> (feature % 32)) & 1;
+}
+
+/**
+ * lowercase name of feature, as in /proc/cpuinfo
+ */
+const char *cpu_feature_name(CPU_FEATURE feature) {
+    return feature < CPU_FEAT_COUNT ? g_feature_bits[feature].name : "?";
+}
+
+/**
+ * bind every routine of table to the first variant the cpu has the
+ * features for, and list the table for cpu_dispatch_get()
+ */
+void cpu_dispatch_register(CPU_DISPATCH *table, uint32 count) {
+    uint32 i;
+
+    for (i = 0; i < count; i++) {
+        const CPU_VARIANT *variant = table[i].variants;
+
+        while (!cpu_has(variant->needs))
+            variant++;
+        table[i].chosen = variant;
+        *table[i].slot = variant->fn;
+    }
+    if (g_dispatch_table_count < CPU_DISPATCH_TABLES) {
+        g_dispatch_tables[g_dispatch_table_count] = table;
+        g_dispatch_counts[g_dispatch_table_count++] = count;
+    }
+}
+
+/**
+ * dispatched routine by index over all tables, NULL past the last
+ */
+const CPU_DISPATCH *cpu_dispatch_get(uint32 index) {
+    uint32 i;
+
+    for (i = 0; i < g_dispatch_table_count; i++) {
+        if (index < g_dispatch_counts[i])
+            return &g_dispatch_tables[i][index];
+        index -= g_dispatch_counts[i];
+    }
+    return NULL;
+}
+
+static CPU_DISPATCH *cpu_dispatch_lookup(const char *name) {
+    uint32 i, j;
+
+    for (i = 0; i < g_dispatch_table_count; i++) {
+        for (j = 0; j < g_dispatch_counts[i]; j++) {
+            if (strcmp(g_dispatch_tables[i][j].name, name) == 0)
+                return &g_dispatch_tables[i][j];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * dispatched routine called name, NULL if no table has it
+ */
+const CPU_DISPATCH *cpu_dispatch_find(const char *name) {
+    return cpu_dispatch_lookup(name);
+}
+
+/**
+ * bind routine to its variant called variant, FALSE if either is unknown
+ * or the cpu lacks the feature the variant needs
+ */
+BOOL cpu_dispatch_bind(const char *routine, const char *variant) {
+    CPU_DISPATCH *dispatch = cpu_dispatch_lookup(routine);
+    uint32 i;
+
+    if (!dispatch)
+        return FALSE;
+    for (i = 0; i < dispatch->variant_count; i++) {
+        const CPU_VARIANT *v = &dispatch->variants[i];
+
+        if (strcmp(v->name, variant) == 0 && cpu_has(v->needs)) {
+            // every variant gives the same results, callers may see either
+            dispatch->chosen = v;
+            *dispatch->slot = v->fn;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
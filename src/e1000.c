@@ -0,0 +1,322 @@
+/**
+ * e1000 driver
+ * both descriptor rings sit in one page frame and stay filled with buffers
+ * from the packet pool. a received buffer goes up the stack as it is and a
+ * fresh one takes its slot; transmitted buffers are freed once the NIC
+ * reports them done. the ITR register throttles interrupts, and the poll
+ * task keeps them off while traffic lasts
+ */
+
+#include "e1000.h"
+#include "netdev.h"
+#include "pci.h"
+#include "pmm.h"
+#include "spinlock.h"
+#include "string.h"
+#include "utils.h"
+#include "io_ports.h"
+
+typedef struct {
+    NET_DEVICE net;
+    volatile uint8 *regs;
+    E1000_RX_DESC *rx;
+    E1000_TX_DESC *tx;
+    NETBUF *rx_bufs[E1000_RX_DESCS];
+    NETBUF *tx_bufs[E1000_TX_DESCS];
+    uint32 rx_next;             // next descriptor the NIC fills
+    uint32 tx_tail;             // next free descriptor
+    uint32 tx_clean;            // oldest descriptor not reclaimed
+    SPINLOCK tx_lock;
+} E1000;
+
+static E1000 *g_nics[E1000_MAX_NICS];
+static uint32 g_nic_count = 0;
+
+static const PCI_ID g_e1000_ids[] = {
+    { 0x8086, 0x100E },         // 82540EM, QEMU's default
+    { 0x8086, 0x100C },         // 82544GC
+    { 0x8086, 0x100F },         // 82545EM
+    { 0, 0 }
+};
+
+static uint32 e1000_read(E1000 *nic, uint32 reg) {
+    return *(volatile uint32 *)(nic->regs + reg);
+}
+
+static void e1000_write(E1000 *nic, uint32 reg, uint32 value) {
+    *(volatile uint32 *)(nic->regs + reg) = value;
+}
+
+static uint16 e1000_eeprom_read(E1000 *nic, uint8 word) {
+    uint32 value, tries = 1000;
+
+    e1000_write(nic, E1000_EERD, E1000_EERD_START | (word << E1000_EERD_ADDR_SHIFT));
+    while (!((value = e1000_read(nic, E1000_EERD)) & E1000_EERD_DONE) && --tries)
+        io_wait_us(1);
+    return (uint16)(value >> E1000_EERD_DATA_SHIFT);
+}
+
+static void e1000_read_mac(E1000 *nic) {
+    uint32 low = e1000_read(nic, E1000_RAL);
+    uint32 high = e1000_read(nic, E1000_RAH);
+    uint32 i;
+
+    if (!(high & E1000_RAH_AV)) {
+        for (i = 0; i < 3; i++) {
+            uint16 word = e1000_eeprom_read(nic, i);
+
+            nic->net.mac[i * 2] = word & 0xFF;
+            nic->net.mac[i * 2 + 1] = word >> 8;
+        }
+        return;
+    }
+    for (i = 0; i < 4; i++)
+        nic->net.mac[i] = (low >> (i * 8)) & 0xFF;
+    nic->net.mac[4] = high & 0xFF;
+    nic->net.mac[5] = (high >> 8) & 0xFF;
+}
+
+// free the buffers of descriptors the NIC is done with, tx_lock is held
+static void e1000_reclaim(E1000 *nic) {
+    while (nic->tx_clean != nic->tx_tail && (nic->tx[nic->tx_clean].status & E1000_TXD_STAT_DD)) {
+        netbuf_free(nic->tx_bufs[nic->tx_clean]);
+        nic->tx_bufs[nic->tx_clean] = NULL;
+        nic->tx_clean = (nic->tx_clean + 1) % E1000_TX_DESCS;
+    }
+}
+
+static BOOL e1000_transmit(NET_DEVICE *dev, NETBUF *buf) {
+    E1000 *nic = (E1000 *)dev->driver_data;
+    uint32 flags = spin_lock_irqsave(&nic->tx_lock);
+    uint32 next = (nic->tx_tail + 1) % E1000_TX_DESCS;
+    E1000_TX_DESC *desc;
+
+    if (next == nic->tx_clean)
+        e1000_reclaim(nic);
+    if (next == nic->tx_clean) {
+        spin_unlock_irqrestore(&nic->tx_lock, flags);
+        return FALSE;
+    }
+    desc = &nic->tx[nic->tx_tail];
+    desc->addr_low = (uint32)buf->data;
+    desc->addr_high = 0;
+    desc->length = buf->len;
+    desc->cmd = E1000_TXD_CMD_EOP | E1000_TXD_CMD_IFCS | E1000_TXD_CMD_RS;
+    desc->status = 0;
+    nic->tx_bufs[nic->tx_tail] = buf;
+    nic->tx_tail = next;
+    // the descriptor before the tail that hands it over
+    __sync_synchronize();
+    e1000_write(nic, E1000_TDT, nic->tx_tail);
+    spin_unlock_irqrestore(&nic->tx_lock, flags);
+    return TRUE;
+}
+
+static uint32 e1000_poll(NET_DEVICE *dev, uint32 budget) {
+    E1000 *nic = (E1000 *)dev->driver_data;
+    NETBUF *head = NULL, **tail = &head, *buf;
+    uint32 count = 0, last = E1000_RX_DESCS;
+    uint32 flags;
+
+    flags = spin_lock_irqsave(&nic->tx_lock);
+    e1000_reclaim(nic);
+    spin_unlock_irqrestore(&nic->tx_lock, flags);
+
+    // only this task touches the receive ring
+    while (count < budget) {
+        E1000_RX_DESC *desc = &nic->rx[nic->rx_next];
+        NETBUF *fresh;
+
+        if (!(desc->status & E1000_RXD_STAT_DD))
+            break;
+        __sync_synchronize();
+        buf = nic->rx_bufs[nic->rx_next];
+        fresh = NULL;
+        // a frame spread over several buffers can't happen at this size
+        if ((desc->status & E1000_RXD_STAT_EOP) && !desc->errors)
+            fresh = netbuf_alloc();
+        if (fresh) {
+            buf->len = desc->length;
+            *tail = buf;
+            tail = &buf->next;
+            nic->rx_bufs[nic->rx_next] = fresh;
+        } else {
+            // the old buffer stays in the ring, the frame is lost
+            dev->rx_dropped++;
+        }
+        desc->addr_low = (uint32)nic->rx_bufs[nic->rx_next]->data;
+        desc->status = 0;
+        last = nic->rx_next;
+        nic->rx_next = (nic->rx_next + 1) % E1000_RX_DESCS;
+        count++;
+    }
+    // one tail write gives the whole batch back
+    if (last != E1000_RX_DESCS) {
+        __sync_synchronize();
+        e1000_write(nic, E1000_RDT, last);
+    }
+
+    *tail = NULL;
+    while (head) {
+        buf = head;
+        head = head->next;
+        netdev_receive(dev, buf);
+    }
+    return count;
+}
+
+static BOOL e1000_irq(NET_DEVICE *dev, BOOL on) {
+    E1000 *nic = (E1000 *)dev->driver_data;
+
+    // causes raised while masked stay in ICR and interrupt at once on unmask
+    if (on)
+        e1000_write(nic, E1000_IMS, E1000_ICR_RXT0 | E1000_ICR_RXO | E1000_ICR_RXDMT0
+                                    | E1000_ICR_TXDW | E1000_ICR_LSC);
+    else
+        e1000_write(nic, E1000_IMC, 0xFFFFFFFF);
+    return FALSE;
+}
+
+static void e1000_interrupt(REGISTERS *reg) {
+    uint32 i;
+
+    (void)reg;
+    for (i = 0; i < g_nic_count; i++) {
+        // reading ICR acknowledges, 0 means another device's interrupt
+        if (e1000_read(g_nics[i], E1000_ICR))
+            netdev_schedule(&g_nics[i]->net);
+    }
+}
+
+static BOOL e1000_setup_rings(E1000 *nic) {
+    uint32 frame = pmm_alloc_frame();
+    uint32 i;
+
+    if (!frame)
+        return FALSE;
+    memset((void *)frame, 0, PAGE_SIZE);
+    nic->rx = (E1000_RX_DESC *)frame;
+    nic->tx = (E1000_TX_DESC *)(frame + E1000_RX_DESCS * sizeof(E1000_RX_DESC));
+    for (i = 0; i < E1000_RX_DESCS; i++) {
+        nic->rx_bufs[i] = netbuf_alloc();
+        if (!nic->rx_bufs[i])
+            return FALSE;
+        nic->rx[i].addr_low = (uint32)nic->rx_bufs[i]->data;
+    }
+
+    e1000_write(nic, E1000_RDBAL, (uint32)nic->rx);
+    e1000_write(nic, E1000_RDBAH, 0);
+    e1000_write(nic, E1000_RDLEN, E1000_RX_DESCS * sizeof(E1000_RX_DESC));
+    e1000_write(nic, E1000_RDH, 0);
+    e1000_write(nic, E1000_RDT, E1000_RX_DESCS - 1);
+    // no per packet delay, ITR does the coalescing
+    e1000_write(nic, E1000_RDTR, 0);
+    e1000_write(nic, E1000_RADV, 0);
+    e1000_write(nic, E1000_RCTL, E1000_RCTL_EN | E1000_RCTL_BAM | E1000_RCTL_SECRC);
+
+    e1000_write(nic, E1000_TDBAL, (uint32)nic->tx);
+    e1000_write(nic, E1000_TDBAH, 0);
+    e1000_write(nic, E1000_TDLEN, E1000_TX_DESCS * sizeof(E1000_TX_DESC));
+    e1000_write(nic, E1000_TDH, 0);
+    e1000_write(nic, E1000_TDT, 0);
+    e1000_write(nic, E1000_TIPG, E1000_TIPG_DEFAULT);
+    e1000_write(nic, E1000_TCTL, E1000_TCTL_EN | E1000_TCTL_PSP | E1000_TCTL_CT | E1000_TCTL_COLD);
+    return TRUE;
+}
+
+// stop a NIC that failed to come up and give back what it had
+static void e1000_release(E1000 *nic) {
+    uint32 i;
+
+    e1000_write(nic, E1000_IMC, 0xFFFFFFFF);
+    e1000_write(nic, E1000_RCTL, 0);
+    e1000_write(nic, E1000_TCTL, 0);
+    // with both off the NIC doesn't reach the ring buffers any more
+    for (i = 0; i < E1000_RX_DESCS; i++) {
+        if (nic->rx_bufs[i])
+            netbuf_free(nic->rx_bufs[i]);
+    }
+    for (i = 0; i < E1000_TX_DESCS; i++) {
+        if (nic->tx_bufs[i])
+            netbuf_free(nic->tx_bufs[i]);
+    }
+    if (nic->rx)
+        pmm_free_frame((uint32)nic->rx);
+    for (i = 0; i < g_nic_count; i++) {
+        if (g_nics[i] == nic) {
+            g_nics[i] = g_nics[--g_nic_count];
+            break;
+        }
+    }
+    free(nic);
+}
+
+static BOOL e1000_probe(PCI_DEVICE *pci) {
+    E1000 *nic;
+    uint32 i, tries = 1000;
+
+    if (g_nic_count == E1000_MAX_NICS)
+        return FALSE;
+    nic = (E1000 *)malloc(sizeof(E1000));
+    if (!nic)
+        return FALSE;
+    memset(nic, 0, sizeof(E1000));
+    pci_enable(pci, TRUE);
+    nic->regs = (volatile uint8 *)pci_map_bar(pci, 0);
+    if (!nic->regs) {
+        free(nic);
+        return FALSE;
+    }
+
+    e1000_write(nic, E1000_IMC, 0xFFFFFFFF);
+    e1000_write(nic, E1000_CTRL, e1000_read(nic, E1000_CTRL) | E1000_CTRL_RST);
+    io_wait_us(10);
+    while ((e1000_read(nic, E1000_CTRL) & E1000_CTRL_RST) && --tries)
+        io_wait_us(10);
+    e1000_write(nic, E1000_IMC, 0xFFFFFFFF);
+    e1000_read(nic, E1000_ICR);
+    e1000_write(nic, E1000_CTRL, (e1000_read(nic, E1000_CTRL) | E1000_CTRL_SLU | E1000_CTRL_ASDE)
+                                 & ~(E1000_CTRL_LRST | E1000_CTRL_ILOS | E1000_CTRL_PHY_RST));
+    e1000_read_mac(nic);
+    for (i = 0; i < 128; i++)
+        e1000_write(nic, E1000_MTA + i * 4, 0);
+    spin_init(&nic->tx_lock, "e1000 tx");
+    if (!e1000_setup_rings(nic)) {
+        e1000_release(nic);
+        return FALSE;
+    }
+
+    // an INTx line may be shared with other drivers' devices
+    if (pci_enable_msi(pci, e1000_interrupt, 0) < 0
+            && (!pci->irq_pin || !isr_share_interrupt_handler(pci->irq_line, e1000_interrupt))) {
+        e1000_release(nic);
+        return FALSE;
+    }
+    e1000_write(nic, E1000_ITR, E1000_ITR_INTERVAL);
+
+    nic->net.driver = "e1000";
+    nic->net.transmit = e1000_transmit;
+    nic->net.poll = e1000_poll;
+    nic->net.irq = e1000_irq;
+    nic->net.driver_data = nic;
+    pci->driver_data = nic;
+    g_nics[g_nic_count++] = nic;
+    if (!netdev_register(&nic->net)) {
+        pci->driver_data = NULL;
+        e1000_release(nic);
+        return FALSE;
+    }
+    e1000_irq(&nic->net, TRUE);
+    return TRUE;
+}
+
+static const PCI_DRIVER g_e1000_driver = {
+    "e1000", g_e1000_ids, e1000_probe
+};
+
+/**
+ * register the driver, NICs are probed by pci_register_driver()
+ */
+void e1000_init(void) {
+    pci_register_driver(&g_e1000_driver);
+}
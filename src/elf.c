@@ -0,0 +1,81 @@
+/**
+ * ELF32 executable loader
+ * nothing is copied here, segments become regions that
+ * the page fault handler fills from the file on first touch
+ */
+
+#include "elf.h"
+
+static BOOL elf_check_header(ELF32_HEADER *header) {
+    return header->magic == ELF_MAGIC
+        && header->class == ELF_CLASS_32
+        && header->data == ELF_DATA_LSB
+        && header->type == ELF_TYPE_EXEC
+        && header->machine == ELF_MACHINE_386
+        && header->phentsize >= sizeof(ELF32_PROGRAM_HEADER);
+}
+
+static BOOL elf_map_segment(ADDRESS_SPACE *as, FileNode *file, ELF32_PROGRAM_HEADER *ph) {
+    uint32 start = PAGE_ALIGN_DOWN(ph->vaddr);
+    uint32 skew = ph->vaddr - start;
+    uint32 end = ph->vaddr + ph->memsz;
+    uint32 flags = 0;
+
+    if (ph->filesz > ph->memsz || end < ph->vaddr)
+        return FALSE;
+    if (ph->offset < skew || ph->offset + ph->filesz < ph->offset
+            || ph->offset + ph->filesz > file->size)
+        return FALSE;
+    if (end > VM_STACK_BOTTOM)
+        return FALSE;
+
+    if (ph->flags & ELF_PF_R)
+        flags |= VMA_READ;
+    if (ph->flags & ELF_PF_W)
+        flags |= VMA_WRITE;
+    if (ph->flags & ELF_PF_X)
+        flags |= VMA_EXEC;
+
+    // the region starts at a page boundary, so does its file data
+    return vm_add_region(as, start, PAGE_ALIGN_UP(end), flags, file,
+                         ph->offset - skew, ph->filesz + skew) != NULL;
+}
+
+/**
+ * add a lazily paged region to as for every PT_LOAD segment of file,
+ * entry gets the start address and image_end the end of the highest segment
+ */
+BOOL elf_load(ADDRESS_SPACE *as, FileNode *file, uint32 *entry, uint32 *image_end) {
+    ELF32_HEADER header;
+    ELF32_PROGRAM_HEADER ph;
+    uint32 i, end = 0;
+    BOOL entry_mapped = FALSE;
+
+    if ((uint32)fs_read(file, 0, &header, sizeof(header)) != sizeof(header))
+        return FALSE;
+    if (!elf_check_header(&header))
+        return FALSE;
+
+    for (i = 0; i < header.phnum; i++) {
+        uint32 offset = header.phoff + i * header.phentsize;
+
+        if ((uint32)fs_read(file, offset, &ph, sizeof(ph)) != sizeof(ph))
+            return FALSE;
+        if (ph.type != ELF_PT_LOAD || ph.memsz == 0)
+            continue;
+        if (!elf_map_segment(as, file, &ph))
+            return FALSE;
+
+        if (ph.vaddr + ph.memsz > end)
+            end = ph.vaddr + ph.memsz;
+        if (header.entry >= ph.vaddr && header.entry < ph.vaddr + ph.memsz
+                && (ph.flags & ELF_PF_X))
+            entry_mapped = TRUE;
+    }
+    if (!entry_mapped)
+        return FALSE;
+
+    *entry = header.entry;
+    *image_end = end;
+    return TRUE;
+}
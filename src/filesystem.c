@@ -1,10 +1,40 @@
 #include "filesystem.h"
 #include "string.h"
 #include "console.h"
+#include "utils.h"
+#include "spinlock.h"
+#include "smp.h"
+#include "trace.h"
 
 static FileNode* root_node = NULL;
 static FileNode* current_dir = NULL;
 
+// Guards file contents and directory entries. It nests on one cpu because
+// copying to or from a user buffer can fault and read a program file
+static SPINLOCK g_fs_lock = SPINLOCK_INIT("filesystem");
+static volatile sint32 g_fs_lock_owner = -1;
+static uint32 g_fs_lock_depth = 0;
+
+static uint32 fs_lock(void) {
+    uint32 flags = irq_save();
+    sint32 cpu = (sint32)smp_cpu_index();
+
+    if (g_fs_lock_owner != cpu) {
+        spin_lock(&g_fs_lock);
+        g_fs_lock_owner = cpu;
+    }
+    g_fs_lock_depth++;
+    return flags;
+}
+
+static void fs_unlock(uint32 flags) {
+    if (--g_fs_lock_depth == 0) {
+        g_fs_lock_owner = -1;
+        spin_unlock(&g_fs_lock);
+    }
+    irq_restore(flags);
+}
+
 void fs_init(void) {
     root_node = fs_create_node("/", TRUE);
     current_dir = root_node;
@@ -22,6 +52,9 @@ FileNode* fs_create_node(const char* name, BOOL is_directory) {
     node->is_directory = is_directory;
     node->parent = NULL;
     node->child_count = 0;
+    node->data = NULL;
+    node->capacity = 0;
+    node->version = 0;
     memset(node->children, 0, sizeof(node->children));
 
     return node;
@@ -30,13 +63,18 @@ FileNode* fs_create_node(const char* name, BOOL is_directory) {
 BOOL fs_mkdir(const char* path) {
     if (!path || !*path) return FALSE;
 
-    if (current_dir->child_count >= MAX_FILES) return FALSE;
-
     FileNode* new_dir = fs_create_node(path, TRUE);
     if (!new_dir) return FALSE;
 
+    uint32 flags = fs_lock();
+    if (current_dir->child_count >= MAX_FILES) {
+        fs_unlock(flags);
+        free(new_dir);
+        return FALSE;
+    }
     new_dir->parent = current_dir;
     current_dir->children[current_dir->child_count++] = new_dir;
+    fs_unlock(flags);
     return TRUE;
 }
 
@@ -111,7 +149,7 @@ FileNode* fs_path_to_node(const char* path) {
     if (!path || !*path) return current_dir;
     if (strcmp(path, "/") == 0) return root_node;
 
-    FileNode* current = current_dir;
+    FileNode* current = path[0] == '/' ? root_node : current_dir;
     char path_copy[MAX_PATH];
     strncpy(path_copy, path, MAX_PATH - 1);
     path_copy[MAX_PATH - 1] = '\0';
@@ -137,3 +175,128 @@ FileNode* fs_path_to_node(const char* path) {
 
     return current;
 }
+
+// Split path into its parent directory node and last component
+static FileNode* fs_split_path(const char* path, char* name) {
+    char parent[MAX_PATH];
+    const char* slash = NULL;
+
+    for (const char* p = path; *p; p++) {
+        if (*p == '/') slash = p;
+    }
+
+    if (!slash) {
+        strncpy(name, path, MAX_FILENAME - 1);
+        name[MAX_FILENAME - 1] = '\0';
+        return current_dir;
+    }
+
+    uint32 parent_len = slash - path;
+    if (parent_len >= MAX_PATH) return NULL;
+    memcpy(parent, path, parent_len);
+    parent[parent_len] = '\0';
+
+    strncpy(name, slash + 1, MAX_FILENAME - 1);
+    name[MAX_FILENAME - 1] = '\0';
+    return parent_len == 0 ? root_node : fs_path_to_node(parent);
+}
+
+FileNode* fs_create_file(const char* path) {
+    char name[MAX_FILENAME];
+
+    if (!path || !*path) return NULL;
+
+    FileNode* dir = fs_split_path(path, name);
+    if (!dir || !dir->is_directory || !name[0]) return NULL;
+
+    uint32 flags = fs_lock();
+    FileNode* file = NULL;
+    for (uint32 i = 0; i < dir->child_count; i++) {
+        FileNode* child = dir->children[i];
+        if (strcmp(child->name, name) == 0) {
+            fs_unlock(flags);
+            return child->is_directory ? NULL : child;
+        }
+    }
+
+    if (dir->child_count < MAX_FILES) {
+        file = fs_create_node(name, FALSE);
+        if (file) {
+            file->parent = dir;
+            dir->children[dir->child_count++] = file;
+        }
+    }
+    fs_unlock(flags);
+    TRACE(TRACE_FS_CREATE, file, 0);
+    return file;
+}
+
+// fs_write_at() with the lock held
+static int fs_write_locked(FileNode* node, uint32 offset, const void* buffer, uint32 size) {
+    if (offset > node->size) offset = node->size;
+    node->version++;
+
+    uint32 needed = offset + size;
+
+    if (needed > node->capacity) {
+        // Grow geometrically so appending byte by byte stays cheap
+        uint32 capacity = node->capacity ? node->capacity : 64;
+        while (capacity < needed) capacity *= 2;
+
+        uint8* data = (uint8*)malloc(capacity);
+        if (!data) return -1;
+        if (node->data) {
+            memcpy(data, node->data, node->size);
+            free(node->data);
+        }
+        node->data = data;
+        node->capacity = capacity;
+    }
+
+    memcpy(node->data + offset, buffer, size);
+    if (needed > node->size) node->size = needed;
+    return size;
+}
+
+// Write size bytes at offset, growing the file if needed
+int fs_write_at(FileNode* node, uint32 offset, const void* buffer, uint32 size) {
+    if (!node || node->is_directory) return -1;
+
+    uint32 flags = fs_lock();
+    int written = fs_write_locked(node, offset, buffer, size);
+    fs_unlock(flags);
+    TRACE(TRACE_FS_WRITE, node, written);
+    return written;
+}
+
+// Write size bytes to file, replacing its contents unless append is set
+int fs_write(FileNode* node, const void* buffer, uint32 size, BOOL append) {
+    if (!node || node->is_directory) return -1;
+
+    uint32 flags = fs_lock();
+    if (!append) {
+        node->size = 0;
+        node->version++;
+    }
+    int written = fs_write_locked(node, node->size, buffer, size);
+    fs_unlock(flags);
+    TRACE(TRACE_FS_WRITE, node, written);
+    return written;
+}
+
+// Read up to size bytes from offset, returns number of bytes read
+int fs_read(FileNode* node, uint32 offset, void* buffer, uint32 size) {
+    if (!node || node->is_directory) return -1;
+
+    uint32 flags = fs_lock();
+    if (offset >= node->size) {
+        size = 0;
+    } else {
+        if (size > node->size - offset)
+            size = node->size - offset;
+        memcpy(buffer, node->data + offset, size);
+    }
+    fs_unlock(flags);
+    TRACE(TRACE_FS_READ, node, size);
+    return size;
+}
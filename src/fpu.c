@@ -0,0 +1,195 @@
+/**
+ * Lazy FPU context switching
+ * every cpu remembers the task whose state its registers hold. switching to
+ * any other task sets CR0.TS, and the #NM trap of its first FPU instruction
+ * saves the owner's registers and loads the new task's, allocating its save
+ * area on first use. tasks stay on their cpu, so the owner is never running
+ * elsewhere
+ */
+
+#include "fpu.h"
+#include "task.h"
+#include "smp.h"
+#include "cpu.h"
+#include "cpufeat.h"
+#include "isr.h"
+#include "console.h"
+#include "string.h"
+#include "utils.h"
+
+static BOOL g_fxsr = FALSE;
+// what a task starts with: FNINIT's x87 state, default MXCSR, zeroed registers
+static uint8 g_fpu_initial[FPU_AREA_SIZE] __attribute__((aligned(FPU_AREA_ALIGN)));
+
+// the save area inside the allocation, FXSAVE wants 16 byte alignment
+static uint8 *fpu_area(TASK *task) {
+    return (uint8 *)(((uint32)task->fpu_state + FPU_AREA_ALIGN - 1) & ~(FPU_AREA_ALIGN - 1));
+}
+
+// FNSAVE also reinitializes the registers
+static void fpu_save(uint8 *area) {
+    if (g_fxsr)
+        asm volatile("fxsave (%0)" :: "r"(area) : "memory");
+    else
+        asm volatile("fnsave (%0)" :: "r"(area) : "memory");
+}
+
+static void fpu_restore(uint8 *area) {
+    if (g_fxsr)
+        asm volatile("fxrstor (%0)" :: "r"(area) : "memory");
+    else
+        asm volatile("frstor (%0)" :: "r"(area) : "memory");
+}
+
+// #NM: the current task wants the registers back
+static void fpu_trap(REGISTERS *reg) {
+    CPU *cpu = smp_current();
+    TASK *task = cpu->current;
+
+    asm volatile("clts");
+    if (cpu->fpu_owner == task)
+        return;
+    if (cpu->fpu_owner)
+        fpu_save(fpu_area(cpu->fpu_owner));
+    cpu->fpu_owner = NULL;
+
+    if (!task->fpu_state) {
+        task->fpu_state = (uint8 *)malloc(FPU_AREA_SIZE + FPU_AREA_ALIGN - 1);
+        if (!task->fpu_state) {
+            if ((reg->cs & 3) == 3) {
+                printf("%s: no memory for FPU state, killed\n", task->name);
+                task_exit(-1);
+            }
+            printf("EXCEPTION: no memory for FPU state of %s\n", task->name);
+            for (;;)
+                ;
+        }
+        memcpy(fpu_area(task), g_fpu_initial, FPU_AREA_SIZE);
+    }
+    fpu_restore(fpu_area(task));
+    cpu->fpu_owner = task;
+}
+
+/**
+ * same for an application processor, after fpu_init() on the boot cpu
+ */
+void fpu_init_cpu(void) {
+    uint32 cr0 = cpu_read_cr0();
+
+    // native x87 errors (#MF), no emulation
+    cr0 &= ~(CR0_EM | CR0_TS);
+    cpu_write_cr0(cr0 | CR0_MP | CR0_NE);
+    asm volatile("fninit");
+    if (g_fxsr) {
+        uint32 mxcsr = FPU_MXCSR_DEFAULT;
+
+        cpu_write_cr4(cpu_read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+        asm volatile("ldmxcsr %0" :: "m"(mxcsr));
+    }
+    smp_current()->fpu_owner = NULL;
+    cpu_write_cr0(cpu_read_cr0() | CR0_TS);
+}
+
+/**
+ * enable SSE when the cpu has it, take over #NM, and set up the boot cpu
+ */
+void fpu_init(void) {
+    g_fxsr = cpu_has(CPU_FEAT_FXSR) && cpu_has(CPU_FEAT_SSE);
+    fpu_init_cpu();
+
+    if (g_fxsr) {
+        // FCW at 0, abridged tag word at 4 where 0 is all empty, MXCSR at 24
+        memset(g_fpu_initial, 0, FPU_AREA_SIZE);
+        *(uint16 *)&g_fpu_initial[0] = FPU_FCW_DEFAULT;
+        *(uint32 *)&g_fpu_initial[24] = FPU_MXCSR_DEFAULT;
+    } else {
+        asm volatile("clts");
+        asm volatile("fninit");
+        fpu_save(g_fpu_initial);
+        cpu_write_cr0(cpu_read_cr0() | CR0_TS);
+    }
+    isr_register_interrupt_handler(FPU_NM_VECTOR, fpu_trap);
+}
+
+/**
+ * TRUE when FXSAVE and SSE are enabled
+ */
+BOOL fpu_sse_enabled(void) {
+    return g_fxsr;
+}
+
+/**
+ * let the kernel use xmm0 to xmm3 until fpu_kernel_end(), with interrupts
+ * off. whichever task's registers they hold get them back unchanged
+ */
+void fpu_kernel_begin(FPU_KERNEL_STATE *state) {
+    state->flags = irq_save();
+    state->ts = (cpu_read_cr0() & CR0_TS) != 0;
+    if (state->ts)
+        asm volatile("clts");
+    asm volatile("movdqu %%xmm0, 0(%0)\n\t"
+                 "movdqu %%xmm1, 16(%0)\n\t"
+                 "movdqu %%xmm2, 32(%0)\n\t"
+                 "movdqu %%xmm3, 48(%0)"
+                 :: "r"(state->xmm) : "memory");
+}
+
+void fpu_kernel_end(FPU_KERNEL_STATE *state) {
+    asm volatile("movdqu 0(%0), %%xmm0\n\t"
+                 "movdqu 16(%0), %%xmm1\n\t"
+                 "movdqu 32(%0), %%xmm2\n\t"
+                 "movdqu 48(%0), %%xmm3"
+                 :: "r"(state->xmm) : "memory");
+    if (state->ts)
+        cpu_write_cr0(cpu_read_cr0() | CR0_TS);
+    irq_restore(state->flags);
+}
+
+/**
+ * called by the scheduler before switching to next: leave the registers
+ * as they are, next gets them back on its first FPU instruction
+ */
+void fpu_switch(TASK *next) {
+    uint32 cr0 = cpu_read_cr0();
+
+    if (smp_current()->fpu_owner == next)
+        asm volatile("clts");
+    else if (!(cr0 & CR0_TS))
+        cpu_write_cr0(cr0 | CR0_TS);
+}
+
+/**
+ * give the child of a fork a copy of the parent's state
+ */
+BOOL fpu_fork(TASK *parent, TASK *child) {
+    uint32 flags;
+
+    if (!parent->fpu_state)
+        return TRUE;
+    child->fpu_state = (uint8 *)malloc(FPU_AREA_SIZE + FPU_AREA_ALIGN - 1);
+    if (!child->fpu_state)
+        return FALSE;
+
+    // the parent's latest state may still be in the registers
+    flags = irq_save();
+    if (smp_current()->fpu_owner == parent) {
+        fpu_save(fpu_area(parent));
+        if (!g_fxsr)
+            fpu_restore(fpu_area(parent));
+    }
+    memcpy(fpu_area(child), fpu_area(parent), FPU_AREA_SIZE);
+    irq_restore(flags);
+    return TRUE;
+}
+
+/**
+ * forget task as the owner of this cpu's registers, it is exiting
+ */
+void fpu_exit(TASK *task) {
+    uint32 flags = irq_save();
+    CPU *cpu = smp_current();
+
+    if (cpu->fpu_owner == task)
+        cpu->fpu_owner = NULL;
+    irq_restore(flags);
+}
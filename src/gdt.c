@@ -2,9 +2,11 @@
  * Global Descriptor Table(GDT) setup
  */
 #include "gdt.h"
+#include "string.h"
 
 GDT g_gdt[NO_GDT_DESCRIPTORS];
 GDT_PTR g_gdt_ptr;
+TSS g_tss[CPU_MAX];
 
 /**
  * fill entries of GDT 
@@ -39,5 +41,29 @@ void gdt_init() {
     // user data segment
     gdt_set_entry(4, 0, 0xFFFFFFFF, 0xF2, 0xCF);
 
+    // task state segments, 32 bit available TSS, one per cpu
+    memset(g_tss, 0, sizeof(g_tss));
+    for (int i = 0; i < CPU_MAX; i++) {
+        g_tss[i].ss0 = KERNEL_DATA_SELECTOR;
+        g_tss[i].iomap_base = sizeof(TSS);  // no io permission bitmap
+        gdt_set_entry(GDT_TSS_BASE + i, (uint32)&g_tss[i], sizeof(TSS) - 1, 0x89, 0x00);
+    }
+
+    load_gdt((uint32)&g_gdt_ptr);
+    load_tss(TSS_SELECTOR(0));
+}
+
+/**
+ * load the GDT and the cpu's own TSS on an application processor
+ */
+void gdt_load_cpu(uint32 cpu) {
     load_gdt((uint32)&g_gdt_ptr);
+    load_tss(TSS_SELECTOR(cpu));
+}
+
+/**
+ * set stack used when an interrupt or syscall enters the kernel from ring 3 on cpu
+ */
+void tss_set_kernel_stack(uint32 cpu, uint32 esp0) {
+    g_tss[cpu].esp0 = esp0;
 }
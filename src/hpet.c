@@ -0,0 +1,72 @@
+/**
+ * HPET main counter
+ * only the counter is used, the comparators stay off. a 64 bit counter is
+ * read as two halves, high again after low to catch a carry in between
+ */
+
+#include "hpet.h"
+#include "acpi.h"
+#include "paging.h"
+#include "cpu.h"
+
+static volatile uint32 *g_hpet = NULL;
+static uint64 g_hpet_hz = 0;
+static BOOL g_counter_64 = FALSE;
+
+static uint32 hpet_reg(uint32 reg) {
+    return g_hpet[reg / 4];
+}
+
+/**
+ * map and start the main counter, FALSE without a usable HPET
+ */
+BOOL hpet_init(void) {
+    const ACPI_HPET_INFO *info = acpi_hpet();
+    uint32 period;
+
+    if (!info)
+        return FALSE;
+    paging_map_mmio(info->address, HPET_MMIO_SIZE);
+    g_hpet = (volatile uint32 *)info->address;
+
+    period = hpet_reg(HPET_CAPABILITIES + 4);
+    if (period == 0 || period > HPET_MAX_PERIOD_FS) {
+        g_hpet = NULL;
+        return FALSE;
+    }
+    g_hpet_hz = cpu_div64(FSEC_PER_SEC, period, NULL);
+    g_counter_64 = (hpet_reg(HPET_CAPABILITIES) & HPET_CAP_COUNTER_64) ? TRUE : FALSE;
+    g_hpet[HPET_CONFIG / 4] = hpet_reg(HPET_CONFIG) | HPET_CONFIG_ENABLE;
+    return TRUE;
+}
+
+/**
+ * main counter, 0 before hpet_init()
+ */
+uint64 hpet_read(void) {
+    uint32 high, low;
+
+    if (!g_hpet)
+        return 0;
+    if (!g_counter_64)
+        return hpet_reg(HPET_COUNTER);
+    do {
+        high = hpet_reg(HPET_COUNTER + 4);
+        low = hpet_reg(HPET_COUNTER);
+    } while (high != hpet_reg(HPET_COUNTER + 4));
+    return ((uint64)high << 32) | low;
+}
+
+/**
+ * counter frequency in Hz, 0 without a HPET
+ */
+uint64 hpet_hz(void) {
+    return g_hpet_hz;
+}
+
+/**
+ * TRUE when the main counter has 64 bits, otherwise it wraps at 32
+ */
+BOOL hpet_counter_64(void) {
+    return g_counter_64;
+}
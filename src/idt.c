@@ -5,10 +5,18 @@
 #include "idt.h"
 #include "isr.h"
 #include "8259_pic.h"
+#include "lapic.h"
 
 IDT g_idt[NO_IDT_DESCRIPTORS];
 IDT_PTR g_idt_ptr;
 
+static void (*const g_msi_stubs[MSI_VECTORS])() = {
+    apic_irq_80, apic_irq_81, apic_irq_82, apic_irq_83,
+    apic_irq_84, apic_irq_85, apic_irq_86, apic_irq_87,
+    apic_irq_88, apic_irq_89, apic_irq_90, apic_irq_91,
+    apic_irq_92, apic_irq_93, apic_irq_94, apic_irq_95,
+};
+
 /**
  * fill entries of IDT 
  */
@@ -18,11 +26,13 @@ void idt_set_entry(int index, uint32 base, uint16 seg_sel, uint8 flags) {
     this->base_low = base & 0xFFFF;
     this->segment_selector = seg_sel;
     this->zero = 0;
-    this->type = flags | 0x60;
+    this->type = flags;  // privilege level in bits 5-6, 0 keeps ring 3 from raising it
     this->base_high = (base >> 16) & 0xFFFF;
 }
 
 void idt_init() {
+    uint32 i;
+
     g_idt_ptr.base_address = (uint32)g_idt;
     g_idt_ptr.limit = sizeof(g_idt) - 1;
     pic8259_init();
@@ -75,9 +85,19 @@ void idt_init() {
     idt_set_entry(45, (uint32)irq_13, 0x08, 0x8E);
     idt_set_entry(46, (uint32)irq_14, 0x08, 0x8E);
     idt_set_entry(47, (uint32)irq_15, 0x08, 0x8E);
-    idt_set_entry(128, (uint32)exception_128, 0x08, 0x8E);
+    for (i = 0; i < MSI_VECTORS; i++)
+        idt_set_entry(MSI_VECTOR_BASE + i, (uint32)g_msi_stubs[i], 0x08, 0x8E);
+    idt_set_entry(IPI_RESCHEDULE_VECTOR, (uint32)apic_irq_240, 0x08, 0x8E);
+    idt_set_entry(LAPIC_TIMER_VECTOR, (uint32)apic_irq_241, 0x08, 0x8E);
+    idt_set_entry(LAPIC_SPURIOUS_VECTOR, (uint32)apic_spurious, 0x08, 0x8E);
 
     load_idt((uint32)&g_idt_ptr);
     asm volatile("sti");
 }
 
+/**
+ * load the shared IDT on an application processor
+ */
+void idt_load_cpu(void) {
+    load_idt((uint32)&g_idt_ptr);
+}
@@ -0,0 +1,66 @@
+/**
+ * IPv4 addresses and checksums
+ * checksums use ip_checksum(), which adds dwords
+ */
+
+#include "inet.h"
+#include "string.h"
+
+typedef struct {
+    IP_ADDR src;
+    IP_ADDR dst;
+    uint8 zero;
+    uint8 proto;
+    uint16 len;
+} __attribute__((packed)) IP_PSEUDO_HEADER;
+
+/**
+ * dotted quad to an address, FALSE if str isn't one
+ */
+BOOL ip_parse(const char *str, IP_ADDR *addr) {
+    uint32 part, i;
+    IP_ADDR result = 0;
+
+    for (i = 0; i < 4; i++) {
+        if (*str < '0' || *str > '9')
+            return FALSE;
+        part = 0;
+        while (*str >= '0' && *str <= '9' && part <= 255)
+            part = part * 10 + *str++ - '0';
+        if (part > 255 || *str != (i < 3 ? '.' : '\0'))
+            return FALSE;
+        if (i < 3)
+            str++;
+        result |= part << (i * 8);
+    }
+    *addr = result;
+    return TRUE;
+}
+
+/**
+ * checksum of a TCP or UDP segment, with the pseudo header in front
+ */
+uint16 ip_pseudo_checksum(IP_ADDR src, IP_ADDR dst, uint8 proto, const void *data, uint16 len) {
+    IP_PSEUDO_HEADER pseudo;
+    uint32 sum;
+
+    pseudo.src = src;
+    pseudo.dst = dst;
+    pseudo.zero = 0;
+    pseudo.proto = proto;
+    pseudo.len = htons(len);
+    // ones' complement sums of two parts, the first of even length, add up
+    sum = (uint16)~ip_checksum(&pseudo, sizeof(pseudo)) + (uint16)~ip_checksum(data, len);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16)~sum;
+}
+
+/**
+ * checksum field of a UDP segment of len bytes whose own field is 0
+ */
+uint16 udp_checksum(IP_ADDR src, IP_ADDR dst, const void *segment, uint16 len) {
+    uint16 checksum = ip_pseudo_checksum(src, dst, IP_PROTO_UDP, segment, len);
+
+    // 0 means no checksum, its ones' complement twin goes instead
+    return checksum ? checksum : 0xFFFF;
+}
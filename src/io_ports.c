@@ -48,3 +48,12 @@ void outportl(uint16 port, uint32 data) {
     asm volatile ("outl %%eax, %%dx" : : "dN" (port), "a" (data));
 }
 
+
+/**
+ * busy wait roughly us microseconds, a write to the unused
+ * POST code port 0x80 takes about one
+ */
+void io_wait_us(uint32 us) {
+    while (us--)
+        outportb(0x80, 0);
+}
@@ -0,0 +1,179 @@
+/**
+ * IO-APIC
+ * every ISA irq keeps its 8259 vector (IRQ_BASE + irq) so handlers
+ * registered for it don't change, only the delivery path does
+ */
+
+#include "ioapic.h"
+#include "acpi.h"
+#include "lapic.h"
+#include "smp.h"
+#include "isr.h"
+#include "paging.h"
+#include "8259_pic.h"
+#include "spinlock.h"
+#include "console.h"
+
+typedef struct {
+    volatile uint32 *regs;
+    uint32 gsi_base;
+    uint32 entries;             // redirection entries
+} IOAPIC;
+
+// where an ISA irq ends up
+typedef struct {
+    IOAPIC *ioapic;             // NULL if no IO-APIC handles its gsi
+    uint32 entry;
+    uint32 flags;               // polarity and trigger of the redirection entry
+    uint32 cpu;
+    BOOL masked;
+} IOAPIC_ROUTE;
+
+static IOAPIC g_ioapics[ACPI_MAX_IOAPICS];
+static uint32 g_ioapic_count = 0;
+static IOAPIC_ROUTE g_routes[IOAPIC_LEGACY_IRQS];
+static BOOL g_active = FALSE;
+static SPINLOCK g_ioapic_lock = SPINLOCK_INIT("ioapic");
+
+static uint32 ioapic_read(IOAPIC *ioapic, uint32 reg) {
+    ioapic->regs[IOAPIC_REGSEL / 4] = reg;
+    return ioapic->regs[IOAPIC_WINDOW / 4];
+}
+
+static void ioapic_write(IOAPIC *ioapic, uint32 reg, uint32 value) {
+    ioapic->regs[IOAPIC_REGSEL / 4] = reg;
+    ioapic->regs[IOAPIC_WINDOW / 4] = value;
+}
+
+// write the redirection entry of route, the lock must be held
+static void ioapic_program(IOAPIC_ROUTE *route, uint8 irq) {
+    uint32 reg = IOAPIC_REG_REDIRECT + route->entry * 2;
+    uint32 low = (IRQ_BASE + irq) | route->flags;
+
+    if (route->masked)
+        low |= IOAPIC_MASKED;
+    // mask while the destination changes, so no half written entry fires
+    ioapic_write(route->ioapic, reg, IOAPIC_MASKED);
+    ioapic_write(route->ioapic, reg + 1, (uint32)smp_cpu(route->cpu)->apic_id << 24);
+    ioapic_write(route->ioapic, reg, low);
+}
+
+static IOAPIC *ioapic_for_gsi(uint32 gsi) {
+    uint32 i;
+
+    for (i = 0; i < g_ioapic_count; i++) {
+        if (gsi >= g_ioapics[i].gsi_base && gsi < g_ioapics[i].gsi_base + g_ioapics[i].entries)
+            return &g_ioapics[i];
+    }
+    return NULL;
+}
+
+// ISA irqs are edge triggered and active high unless the MADT overrides them
+static void ioapic_route_legacy(const ACPI_MADT_INFO *madt, uint8 irq) {
+    IOAPIC_ROUTE *route = &g_routes[irq];
+    uint32 gsi = irq;
+    uint32 i;
+
+    route->flags = 0;
+    for (i = 0; i < madt->override_count; i++) {
+        const ACPI_IRQ_OVERRIDE *override = &madt->overrides[i];
+
+        // its input was taken over, usually the timer on the cascade pin
+        if (override->gsi == irq && override->irq != irq && gsi == irq)
+            gsi = (uint32)-1;
+        if (override->irq != irq)
+            continue;
+        gsi = override->gsi;
+        if ((override->flags & ACPI_POLARITY_MASK) == ACPI_POLARITY_LOW)
+            route->flags |= IOAPIC_ACTIVE_LOW;
+        if ((override->flags & ACPI_TRIGGER_MASK) == ACPI_TRIGGER_LEVEL)
+            route->flags |= IOAPIC_LEVEL;
+    }
+
+    // the cascade carries nothing once the 8259 is masked
+    route->ioapic = irq == IRQ2_CASCADE ? NULL : ioapic_for_gsi(gsi);
+    if (!route->ioapic)
+        return;
+    route->entry = gsi - route->ioapic->gsi_base;
+    route->cpu = 0;
+    route->masked = FALSE;
+    ioapic_program(route, irq);
+}
+
+/**
+ * route the ISA irqs through the IO-APICs of the MADT to the boot cpu
+ * and mask the 8259, FALSE (and the 8259 stays) without an IO-APIC
+ */
+BOOL ioapic_init(void) {
+    const ACPI_MADT_INFO *madt = acpi_madt();
+    uint32 i, entry;
+
+    if (!madt || !lapic_present() || madt->ioapic_count == 0) {
+        announce("IO-APIC: not found, using the 8259 PIC\n");
+        return FALSE;
+    }
+
+    for (i = 0; i < madt->ioapic_count; i++) {
+        IOAPIC *ioapic = &g_ioapics[g_ioapic_count++];
+
+        paging_map_mmio(madt->ioapics[i].address, PAGE_SIZE);
+        ioapic->regs = (volatile uint32 *)madt->ioapics[i].address;
+        ioapic->gsi_base = madt->ioapics[i].gsi_base;
+        ioapic->entries = ((ioapic_read(ioapic, IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+        for (entry = 0; entry < ioapic->entries; entry++)
+            ioapic_write(ioapic, IOAPIC_REG_REDIRECT + entry * 2, IOAPIC_MASKED);
+    }
+
+    uint32 flags = spin_lock_irqsave(&g_ioapic_lock);
+    for (i = 0; i < IOAPIC_LEGACY_IRQS; i++)
+        ioapic_route_legacy(madt, i);
+    pic8259_disable();
+    g_active = TRUE;
+    spin_unlock_irqrestore(&g_ioapic_lock, flags);
+
+    announce("IO-APIC: %d controller(s), device interrupts routed\n", g_ioapic_count);
+    return TRUE;
+}
+
+/**
+ * TRUE once device interrupts come through the IO-APIC
+ */
+BOOL ioapic_active(void) {
+    return g_active;
+}
+
+/**
+ * deliver ISA irq to the cpu with the given index
+ */
+BOOL ioapic_set_affinity(uint8 irq, uint32 cpu) {
+    uint32 flags;
+
+    if (!g_active || irq >= IOAPIC_LEGACY_IRQS || !g_routes[irq].ioapic || !smp_cpu(cpu))
+        return FALSE;
+    flags = spin_lock_irqsave(&g_ioapic_lock);
+    g_routes[irq].cpu = cpu;
+    ioapic_program(&g_routes[irq], irq);
+    spin_unlock_irqrestore(&g_ioapic_lock, flags);
+    return TRUE;
+}
+
+/**
+ * index of the cpu ISA irq is delivered to
+ */
+uint32 ioapic_affinity(uint8 irq) {
+    return irq < IOAPIC_LEGACY_IRQS ? g_routes[irq].cpu : 0;
+}
+
+/**
+ * mask or unmask ISA irq
+ */
+void ioapic_mask(uint8 irq, BOOL masked) {
+    uint32 flags;
+
+    if (!g_active || irq >= IOAPIC_LEGACY_IRQS || !g_routes[irq].ioapic)
+        return;
+    flags = spin_lock_irqsave(&g_ioapic_lock);
+    g_routes[irq].masked = masked;
+    ioapic_program(&g_routes[irq], irq);
+    spin_unlock_irqrestore(&g_ioapic_lock, flags);
+}
@@ -0,0 +1,151 @@
+/**
+ * IPv4
+ * fragments and options aren't supported: a fragment is dropped and
+ * headers are sent without options. echo requests are answered in the
+ * buffer they came in
+ */
+
+#include "ip.h"
+#include "arp.h"
+#include "udp.h"
+#include "clock.h"
+#include "timer.h"
+#include "cpu.h"
+#include "string.h"
+
+static uint16 g_ip_id = 0;
+
+// the echo request icmp_ping() waits for
+static volatile uint16 g_ping_seq;
+static volatile BOOL g_ping_replied;
+
+static void icmp_receive(NETBUF *buf, IP_HEADER *ip, uint32 header_len) {
+    ICMP_ECHO *icmp = (ICMP_ECHO *)(buf->data + header_len);
+    uint32 len = buf->len - header_len;
+    IP_ADDR src = ip->src;
+
+    if (len < sizeof(ICMP_ECHO) || ip_checksum(icmp, len) != 0) {
+        net_stats()->ip_dropped++;
+        netbuf_free(buf);
+        return;
+    }
+    if (icmp->type == ICMP_ECHO_REPLY && ntohs(icmp->id) == ICMP_PING_ID && ntohs(icmp->seq) == g_ping_seq)
+        g_ping_replied = TRUE;
+    if (icmp->type != ICMP_ECHO_REQUEST || ip->dst != net_config()->addr) {
+        netbuf_free(buf);
+        return;
+    }
+
+    icmp->type = ICMP_ECHO_REPLY;
+    icmp->checksum = 0;
+    icmp->checksum = ip_checksum(icmp, len);
+    netbuf_pull(buf, header_len);
+    net_stats()->icmp_echo++;
+    ip_send(buf, src, IP_PROTO_ICMP);
+}
+
+/**
+ * an IP packet arrived, buf starts at its header
+ */
+void ip_receive(NETBUF *buf) {
+    IP_HEADER *ip = (IP_HEADER *)buf->data;
+    NET_CONFIG *config = net_config();
+    uint32 header_len, len;
+
+    net_stats()->ip_in++;
+    if (buf->len < sizeof(IP_HEADER) || (ip->version_ihl >> 4) != 4)
+        goto drop;
+    header_len = (ip->version_ihl & 0xF) * 4;
+    len = ntohs(ip->len);
+    if (header_len < sizeof(IP_HEADER) || len < header_len || len > buf->len
+            || ip_checksum(ip, header_len) != 0)
+        goto drop;
+    if (ntohs(ip->fragment) & IP_FRAGMENT_MASK)
+        goto drop;
+    if (ip->dst != config->addr && ip->dst != IP_BROADCAST
+            && ip->dst != (config->addr | ~config->netmask))
+        goto drop;
+    // whatever the NIC padded the frame with goes
+    buf->len = len;
+
+    switch (ip->proto) {
+    case IP_PROTO_ICMP:
+        icmp_receive(buf, ip, header_len);
+        return;
+    case IP_PROTO_UDP:
+        udp_receive(buf);
+        return;
+    }
+drop:
+    net_stats()->ip_dropped++;
+    netbuf_free(buf);
+}
+
+/**
+ * put an IP header in front of the payload in buf and send it to dst,
+ * buf is gone afterwards either way
+ */
+BOOL ip_send(NETBUF *buf, IP_ADDR dst, uint8 proto) {
+    NET_CONFIG *config = net_config();
+    IP_HEADER *ip = (IP_HEADER *)netbuf_push(buf, sizeof(IP_HEADER));
+
+    if (!ip || !config->dev) {
+        netbuf_free(buf);
+        return FALSE;
+    }
+    ip->version_ihl = IP_VERSION_IHL;
+    ip->tos = 0;
+    ip->len = htons(buf->len);
+    ip->id = htons(__sync_fetch_and_add(&g_ip_id, 1));
+    ip->fragment = 0;
+    ip->ttl = IP_TTL;
+    ip->proto = proto;
+    ip->checksum = 0;
+    ip->src = config->addr;
+    ip->dst = dst;
+    ip->checksum = ip_checksum(ip, sizeof(IP_HEADER));
+    net_stats()->ip_out++;
+
+    if (dst == IP_BROADCAST || dst == (config->addr | ~config->netmask))
+        return net_send(buf, NULL, ETH_TYPE_IP);
+    // off the subnet everything goes through the gateway
+    if ((dst & config->netmask) != (config->addr & config->netmask))
+        dst = config->gateway;
+    return arp_output(buf, dst);
+}
+
+/**
+ * send echo request seq to dst and wait for the reply,
+ * returns the round trip in microseconds or -1 after timeout_ms
+ */
+sint32 icmp_ping(IP_ADDR dst, uint16 seq, uint32 timeout_ms) {
+    NETBUF *buf = netbuf_alloc();
+    ICMP_ECHO *icmp;
+    uint64 start, elapsed;
+
+    if (!buf)
+        return -1;
+    icmp = (ICMP_ECHO *)buf->data;
+    buf->len = sizeof(ICMP_ECHO) + ICMP_PING_DATA;
+    icmp->type = ICMP_ECHO_REQUEST;
+    icmp->code = 0;
+    icmp->checksum = 0;
+    icmp->id = htons(ICMP_PING_ID);
+    icmp->seq = htons(seq);
+    memset(icmp + 1, 'S', ICMP_PING_DATA);
+    icmp->checksum = ip_checksum(icmp, buf->len);
+
+    g_ping_seq = seq;
+    g_ping_replied = FALSE;
+    start = clock_ns();
+    if (!ip_send(buf, dst, IP_PROTO_ICMP))
+        return -1;
+    // the reply comes in the NIC's poll task
+    do {
+        if (g_ping_replied)
+            return (sint32)cpu_div64(clock_ns() - start, NSEC_PER_USEC, NULL);
+        timer_sleep(1);
+        elapsed = clock_ns() - start;
+    } while (elapsed < (uint64)timeout_ms * NSEC_PER_MSEC);
+    return -1;
+}
@@ -2,10 +2,24 @@
 #include "idt.h"
 #include "8259_pic.h"
 #include "console.h"
+#include "task.h"
+#include "lapic.h"
+#include "ioapic.h"
+#include "smp.h"
+#include "cpu.h"
+#include "string.h"
+#include "trace.h"
 
 // For both exceptions and irq interrupt
 ISR g_interrupt_handlers[NO_INTERRUPT_HANDLERS];
 
+// per cpu, so handlers running at once on two cpus don't share counters
+static IRQ_STATS g_irq_stats[CPU_MAX][IRQ_STAT_SLOTS];
+static BOOL g_irq_histogram = FALSE;
+static uint32 g_msi_used = 0;              // bit per MSI vector
+// handlers of PCI devices sharing an ISA line, each checks its own device
+static ISR g_shared_handlers[16][ISR_SHARED_HANDLERS];
+
 // for more details, see Intel manual -> Interrupt & Exception Handling
 char *exception_messages[32] = {
     "Division By Zero",
@@ -76,7 +90,40 @@ void isr_register_interrupt_handler(int num, ISR handler) {
  * turn off current interrupt
 */
 void isr_end_interrupt(int num) {
-    pic8259_eoi(num);
+    if (ioapic_active() || num >= IRQ_LEGACY_END)
+        lapic_eoi();
+    else
+        pic8259_eoi(num);
+}
+
+// accounting slot of vector, -1 for vectors nobody routes to
+static sint32 isr_stat_slot(uint32 vector) {
+    if (vector >= IRQ_BASE && vector < IRQ_LEGACY_END)
+        return vector - IRQ_BASE;
+    if (vector >= IRQ_STAT_APIC_BASE)
+        return 16 + vector - IRQ_STAT_APIC_BASE;
+    if (vector >= MSI_VECTOR_BASE && vector < MSI_VECTOR_BASE + MSI_VECTORS)
+        return IRQ_STAT_MSI_SLOT + vector - MSI_VECTOR_BASE;
+    return -1;
+}
+
+static void isr_account(IRQ_STATS *stats, uint64 start, uint64 end) {
+    uint32 cycles = (uint32)(end - start);
+
+    stats->count++;
+    stats->cycles += cycles;
+    if (cycles > stats->max_cycles)
+        stats->max_cycles = cycles;
+    stats->last_tsc = start;
+
+    if (g_irq_histogram) {
+        uint32 bucket = 0;
+
+        // bucket n counts handlers that took less than 2^(n + 9) cycles
+        while (bucket < IRQ_HIST_BUCKETS - 1 && (cycles >> (bucket + 9)))
+            bucket++;
+        stats->histogram[bucket]++;
+    }
 }
 
 /**
@@ -84,11 +131,133 @@ void isr_end_interrupt(int num) {
  * being called in irq.asm
  */
 void isr_irq_handler(REGISTERS *reg) {
+    uint64 start = cpu_rdtsc();
+    sint32 slot = isr_stat_slot(reg->int_no);
+
+    TRACE(TRACE_IRQ_ENTER, reg->int_no, reg->eip);
     if (g_interrupt_handlers[reg->int_no] != NULL) {
         ISR handler = g_interrupt_handlers[reg->int_no];
         handler(reg);
     }
-    pic8259_eoi(reg->int_no);
+    isr_end_interrupt(reg->int_no);
+    TRACE(TRACE_IRQ_EXIT, reg->int_no, 0);
+
+    if (slot >= 0)
+        isr_account(&g_irq_stats[smp_cpu_index()][slot], start, cpu_rdtsc());
+}
+
+/**
+ * hand out a free MSI vector for handler, -1 when all are taken
+ */
+sint32 isr_alloc_vector(ISR handler) {
+    uint32 flags = irq_save();
+    sint32 vector = -1;
+    uint32 i;
+
+    for (i = 0; i < MSI_VECTORS; i++) {
+        if (!(g_msi_used & (1 << i))) {
+            g_msi_used |= 1 << i;
+            vector = MSI_VECTOR_BASE + i;
+            g_interrupt_handlers[vector] = handler;
+            break;
+        }
+    }
+    irq_restore(flags);
+    return vector;
+}
+
+/**
+ * give a vector from isr_alloc_vector() back
+ */
+void isr_free_vector(uint32 vector) {
+    uint32 flags;
+
+    if (vector < MSI_VECTOR_BASE || vector >= MSI_VECTOR_BASE + MSI_VECTORS)
+        return;
+    flags = irq_save();
+    g_interrupt_handlers[vector] = NULL;
+    g_msi_used &= ~(1 << (vector - MSI_VECTOR_BASE));
+    irq_restore(flags);
+}
+
+static void isr_shared_handler(REGISTERS *reg) {
+    ISR *chain = g_shared_handlers[reg->int_no - IRQ_BASE];
+    uint32 i;
+
+    for (i = 0; i < ISR_SHARED_HANDLERS && chain[i]; i++)
+        chain[i](reg);
+}
+
+/**
+ * add handler to the ones called for a level triggered line, FALSE if the
+ * line has an unshared handler or no room for another
+ */
+BOOL isr_share_interrupt_handler(uint32 line, ISR handler) {
+    uint32 vector = IRQ_BASE + line;
+    ISR *chain;
+    BOOL added = FALSE;
+    uint32 flags, i;
+
+    if (line >= 16)
+        return FALSE;
+    chain = g_shared_handlers[line];
+    flags = irq_save();
+    if (g_interrupt_handlers[vector] == NULL || g_interrupt_handlers[vector] == isr_shared_handler) {
+        for (i = 0; i < ISR_SHARED_HANDLERS; i++) {
+            // one handler serves every device of its driver
+            if (chain[i] == handler) {
+                added = TRUE;
+                break;
+            }
+            if (chain[i] == NULL) {
+                chain[i] = handler;
+                g_interrupt_handlers[vector] = isr_shared_handler;
+                added = TRUE;
+                break;
+            }
+        }
+    }
+    irq_restore(flags);
+    return added;
+}
+
+/**
+ * counters of vector summed over the cpus, FALSE if it isn't tracked
+ */
+BOOL isr_irq_stats(uint32 vector, IRQ_STATS *stats) {
+    sint32 slot = isr_stat_slot(vector);
+    uint32 cpu, i;
+
+    memset(stats, 0, sizeof(IRQ_STATS));
+    if (slot < 0)
+        return FALSE;
+    for (cpu = 0; cpu < smp_cpu_count(); cpu++) {
+        IRQ_STATS *s = &g_irq_stats[cpu][slot];
+
+        stats->count += s->count;
+        stats->cycles += s->cycles;
+        if (s->max_cycles > stats->max_cycles)
+            stats->max_cycles = s->max_cycles;
+        if (s->last_tsc > stats->last_tsc)
+            stats->last_tsc = s->last_tsc;
+        for (i = 0; i < IRQ_HIST_BUCKETS; i++)
+            stats->histogram[i] += s->histogram[i];
+    }
+    return TRUE;
+}
+
+/**
+ * zero every interrupt counter
+ */
+void isr_irq_stats_reset(void) {
+    memset(g_irq_stats, 0, sizeof(g_irq_stats));
+}
+
+/**
+ * collect the handler time histograms too, off by default
+ */
+void isr_irq_histogram(BOOL enable) {
+    g_irq_histogram = enable;
 }
 
 static void print_registers(REGISTERS *reg) {
@@ -99,31 +268,25 @@ static void print_registers(REGISTERS *reg) {
     printf("eip=0x%x, cs=0x%x, ss=0x%x, eflags=0x%x, useresp=0x%x\n", reg->eip, reg->ss, reg->eflags, reg->useresp);
 }
 
-static void handle_fpu_exception(REGISTERS *reg) {
-    // Reset FPU state
-    asm volatile("fnclex");  // Clear FPU exceptions
-    asm volatile("finit");   // Reinitialize FPU
-    
-    // Re-enable FPU
-    uint32 cr0;
-    asm volatile("mov %%cr0, %0" : "=r"(cr0));
-    cr0 &= ~(1 << 2);  // Clear EM flag
-    cr0 &= ~(1 << 3);  // Clear TS flag
-    asm volatile("mov %0, %%cr0" :: "r"(cr0));
-}
-
 /**
  * invoke exception routine,
  * being called in exception.asm
  */
 void isr_exception_handler(REGISTERS reg) {
     if (reg.int_no < 32) {
-        // Special handling for FPU exceptions
-        if (reg.int_no == 7 || reg.int_no == 16) {  // Device not available or FPU error
-            handle_fpu_exception(&reg);
-            return;  // Return after handling FPU exception
+        // exceptions a subsystem resolves itself, like page faults
+        if (g_interrupt_handlers[reg.int_no] != NULL) {
+            g_interrupt_handlers[reg.int_no](&reg);
+            return;
         }
         
+        // a fault in ring 3 only takes down the offending task
+        if ((reg.cs & 3) == 3) {
+            printf("%s: %s at eip=0x%x, killed\n", task_current()->name,
+                   exception_messages[reg.int_no], reg.eip);
+            task_exit(-1);
+        }
+
         printf("EXCEPTION: %s\n", exception_messages[reg.int_no]);
         print_registers(&reg);
         for (;;)
@@ -5,12 +5,17 @@
 #include "isr.h"
 #include "types.h"
 #include "string.h"
+#include "msgq.h"
 
 #define INPUT_BUFFER_SIZE 256  // Adjust as needed
+#define KEY_QUEUE_SIZE    64
 
 static BOOL g_caps_lock = FALSE;
 static BOOL g_shift_pressed = FALSE;
-char g_ch = 0, g_scan_code = 0;
+
+// key presses queued by the interrupt handler for the readers below
+static KEY_EVENT g_key_storage[KEY_QUEUE_SIZE];
+static MSGQ g_key_queue;
 
 // Input buffer and position tracking
 static char g_input_buffer[INPUT_BUFFER_SIZE];
@@ -70,12 +75,13 @@ char alternate_chars(char ch) {
 }
 
 void keyboard_handler(REGISTERS *r) {
+    KEY_EVENT event;
     int scancode;
+    char ch = 0;
 
-    g_ch = 0;
+    (void)r;
     scancode = get_scancode();
-    g_scan_code = scancode;
-    
+
     if (scancode & 0x80) {
         // key release
         switch(scancode & 0x7F) {
@@ -91,13 +97,13 @@ void keyboard_handler(REGISTERS *r) {
                 break;
 
             case SCAN_CODE_KEY_ENTER:
-                g_ch = '\n';
+                ch = '\n';
                 g_input_buffer[g_input_pos] = '\0'; // Null-terminate the string
                 g_input_pos = 0; // Reset position for next input
                 break;
 
             case SCAN_CODE_KEY_TAB:
-                g_ch = '\t';
+                ch = '\t';
                 break;
 
             case SCAN_CODE_KEY_LEFT_SHIFT:
@@ -105,72 +111,76 @@ void keyboard_handler(REGISTERS *r) {
                 break;
 
             case SCAN_CODE_KEY_BACKSPACE:
+                // let the reader erase it, getstr_bound() knows the prompt bound
+                ch = '\b';
                 if (g_input_pos > 0) {
                     g_input_pos--;
                     g_input_buffer[g_input_pos] = '\0';
-                    console_backspace();
                 }
                 break;
 
             default:
-                g_ch = g_scan_code_chars[scancode];
-                if (g_ch) {
+                ch = g_scan_code_chars[scancode];
+                if (ch) {
                     // if caps is on, convert to upper
                     if (g_caps_lock) {
                         // if shift is pressed before
                         if (g_shift_pressed) {
                             // replace alternate chars
-                            g_ch = alternate_chars(g_ch);
+                            ch = alternate_chars(ch);
                         } else {
-                            g_ch = upper(g_ch);
+                            ch = upper(ch);
                         }
                     } else {
                         if (g_shift_pressed) {
-                            if (isalpha(g_ch)) {
-                                g_ch = upper(g_ch);
+                            if (isalpha(ch)) {
+                                ch = upper(ch);
                             } else {
                                 // replace alternate chars
-                                g_ch = alternate_chars(g_ch);
+                                ch = alternate_chars(ch);
                             }
                         }
                     }
                     
                     // Only add to buffer if there's space and it's a printable character
-                    if (g_input_pos < INPUT_BUFFER_SIZE - 1 && g_ch >= ' ') {
-                        g_input_buffer[g_input_pos] = g_ch;
+                    if (g_input_pos < INPUT_BUFFER_SIZE - 1 && ch >= ' ') {
+                        g_input_buffer[g_input_pos] = ch;
                         g_input_pos++;
                     }
                 }
                 break;
         }
+
+        // a full queue drops the key, the handler must never block
+        event.ch = ch;
+        event.scancode = scancode;
+        msgq_try_send(&g_key_queue, &event);
     }
 }
 
 void keyboard_init() {
     memset(g_input_buffer, 0, INPUT_BUFFER_SIZE);
     g_input_pos = 0;
+    msgq_init(&g_key_queue, g_key_storage, sizeof(KEY_EVENT), KEY_QUEUE_SIZE);
     isr_register_interrupt_handler(IRQ_BASE + 1, keyboard_handler);
 }
 
 // a blocking character read
 char kb_getchar() {
-    char c;
+    KEY_EVENT event;
 
-    while(g_ch <= 0);
-    c = g_ch;
-    g_ch = 0;
-    g_scan_code = 0;
-    return c;
+    // sleeps until the interrupt handler queues a printable key
+    do {
+        msgq_receive(&g_key_queue, &event);
+    } while (event.ch <= 0);
+    return event.ch;
 }
 
 char kb_get_scancode() {
-    char code;
+    KEY_EVENT event;
 
-    while(g_scan_code <= 0);
-    code = g_scan_code;
-    g_ch = 0;
-    g_scan_code = 0;
-    return code;
+    msgq_receive(&g_key_queue, &event);
+    return event.scancode;
 }
 
 int kb_getkey() {
@@ -191,9 +201,13 @@ char kb_scan(void) {
 
 // Non-blocking character read
 char keyboard_read() {
-    char c = g_ch;
-    g_ch = 0;
-    return c;
+    KEY_EVENT event;
+
+    while (msgq_try_receive(&g_key_queue, &event)) {
+        if (event.ch > 0)
+            return event.ch;
+    }
+    return 0;
 }
 
 // Get the current input buffer (for command processing)
@@ -0,0 +1,225 @@
+/**
+ * Kernel allocator
+ * small requests are rounded up to a size class. every cpu keeps a loaded
+ * and a previous magazine per class and serves alloc and free from them with
+ * only interrupts off; the depot lock is taken to trade a full magazine for
+ * an empty one or back, and the heap lock only on a depot miss or a flush
+ */
+
+#include "kmem.h"
+#include "utils.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "trace.h"
+
+// every allocation is preceded by its class, or KMEM_LARGE for heap sized ones
+#define KMEM_LARGE          0xFFFFFFFF
+#define KMEM_TAG_SIZE       4
+
+typedef struct MAGAZINE {
+    uint32 rounds;
+    void *objects[KMEM_MAGAZINE_SIZE];
+    struct MAGAZINE *next;
+} MAGAZINE;
+
+typedef struct {
+    MAGAZINE *loaded;
+    MAGAZINE *previous;
+    uint32 hits;
+    uint32 misses;
+} KMEM_CPU_CACHE;
+
+typedef struct {
+    SPINLOCK lock;
+    MAGAZINE *full;
+    MAGAZINE *empty;
+    uint32 full_count;
+} KMEM_DEPOT;
+
+static KMEM_CPU_CACHE g_caches[CPU_MAX][KMEM_CLASSES];
+static KMEM_DEPOT g_depots[KMEM_CLASSES] = {
+    { SPINLOCK_INIT("kmem 16"), NULL, NULL, 0 },
+    { SPINLOCK_INIT("kmem 32"), NULL, NULL, 0 },
+    { SPINLOCK_INIT("kmem 64"), NULL, NULL, 0 },
+    { SPINLOCK_INIT("kmem 128"), NULL, NULL, 0 },
+    { SPINLOCK_INIT("kmem 256"), NULL, NULL, 0 },
+    { SPINLOCK_INIT("kmem 512"), NULL, NULL, 0 },
+    { SPINLOCK_INIT("kmem 1024"), NULL, NULL, 0 },
+    { SPINLOCK_INIT("kmem 2048"), NULL, NULL, 0 },
+};
+
+static uint32 kmem_class(uint32 size) {
+    uint32 class = 0;
+
+    while (class < KMEM_CLASSES && ((uint32)KMEM_MIN_SIZE << class) < size)
+        class++;
+    return class;
+}
+
+// heap allocation with its tag, returns the object
+static void *kmem_heap_alloc(uint32 size, uint32 tag) {
+    uint32 *block = (uint32 *)heap_alloc(size + KMEM_TAG_SIZE);
+
+    if (!block)
+        return NULL;
+    *block = tag;
+    return block + 1;
+}
+
+static void kmem_heap_free(void *ptr) {
+    heap_free((uint32 *)ptr - 1);
+}
+
+// give the objects of a magazine back to the heap
+static void kmem_flush(MAGAZINE *magazine) {
+    while (magazine->rounds)
+        kmem_heap_free(magazine->objects[--magazine->rounds]);
+    heap_free(magazine);
+}
+
+// swap an empty loaded magazine for a full one, interrupts are off
+static BOOL kmem_reload(KMEM_CPU_CACHE *cache, KMEM_DEPOT *depot) {
+    MAGAZINE *full;
+
+    if (cache->previous && cache->previous->rounds) {
+        MAGAZINE *loaded = cache->loaded;
+
+        cache->loaded = cache->previous;
+        cache->previous = loaded;
+        return TRUE;
+    }
+
+    spin_lock(&depot->lock);
+    full = depot->full;
+    if (full) {
+        depot->full = full->next;
+        depot->full_count--;
+        // previous is empty here, keep it for a later free
+        if (cache->previous) {
+            cache->previous->next = depot->empty;
+            depot->empty = cache->previous;
+        }
+        cache->previous = cache->loaded;
+        cache->loaded = full;
+    }
+    spin_unlock(&depot->lock);
+    return full != NULL;
+}
+
+// make room in the loaded magazine, interrupts are off. a full magazine
+// beyond the depot limit is returned in flush for the caller to empty
+static BOOL kmem_unload(KMEM_CPU_CACHE *cache, KMEM_DEPOT *depot, MAGAZINE **flush) {
+    MAGAZINE *empty;
+
+    if (cache->previous && cache->previous->rounds == 0) {
+        MAGAZINE *loaded = cache->loaded;
+
+        cache->loaded = cache->previous;
+        cache->previous = loaded;
+        return TRUE;
+    }
+
+    spin_lock(&depot->lock);
+    empty = depot->empty;
+    if (empty)
+        depot->empty = empty->next;
+    spin_unlock(&depot->lock);
+
+    if (!empty) {
+        empty = (MAGAZINE *)heap_alloc(sizeof(MAGAZINE));
+        if (!empty)
+            return FALSE;
+        empty->rounds = 0;
+    }
+
+    // previous is full here, it goes to the depot
+    if (cache->previous) {
+        spin_lock(&depot->lock);
+        if (depot->full_count < KMEM_DEPOT_MAX) {
+            cache->previous->next = depot->full;
+            depot->full = cache->previous;
+            depot->full_count++;
+        } else {
+            *flush = cache->previous;
+        }
+        spin_unlock(&depot->lock);
+    }
+    cache->previous = cache->loaded;
+    cache->loaded = empty;
+    return TRUE;
+}
+
+void *malloc(uint32 size) {
+    uint32 class = kmem_class(size);
+    KMEM_CPU_CACHE *cache;
+    void *object = NULL;
+    uint32 flags;
+
+    if (class == KMEM_CLASSES) {
+        object = kmem_heap_alloc(size, KMEM_LARGE);
+        TRACE(TRACE_ALLOC, size, object);
+        return object;
+    }
+
+    flags = irq_save();
+    cache = &g_caches[smp_cpu_index()][class];
+    if ((cache->loaded && cache->loaded->rounds) || kmem_reload(cache, &g_depots[class])) {
+        object = cache->loaded->objects[--cache->loaded->rounds];
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+    irq_restore(flags);
+
+    if (!object)
+        object = kmem_heap_alloc(KMEM_MIN_SIZE << class, class);
+    TRACE(TRACE_ALLOC, size, object);
+    return object;
+}
+
+void free(void *ptr) {
+    uint32 class;
+    KMEM_CPU_CACHE *cache;
+    MAGAZINE *flush = NULL;
+    BOOL cached = FALSE;
+    uint32 flags;
+
+    if (!ptr)
+        return;
+    TRACE(TRACE_FREE, ptr, 0);
+    class = ((uint32 *)ptr)[-1];
+    if (class >= KMEM_CLASSES) {
+        kmem_heap_free(ptr);
+        return;
+    }
+
+    flags = irq_save();
+    cache = &g_caches[smp_cpu_index()][class];
+    if ((cache->loaded && cache->loaded->rounds < KMEM_MAGAZINE_SIZE)
+            || kmem_unload(cache, &g_depots[class], &flush)) {
+        cache->loaded->objects[cache->loaded->rounds++] = ptr;
+        cached = TRUE;
+    }
+    irq_restore(flags);
+
+    if (flush)
+        kmem_flush(flush);
+    if (!cached)
+        kmem_heap_free(ptr);
+}
+
+/**
+ * counters of size class
+ */
+void kmem_stats(uint32 class, KMEM_STATS *stats) {
+    uint32 cpu;
+
+    stats->size = KMEM_MIN_SIZE << class;
+    stats->hits = 0;
+    stats->misses = 0;
+    for (cpu = 0; cpu < smp_cpu_count(); cpu++) {
+        stats->hits += g_caches[cpu][class].hits;
+        stats->misses += g_caches[cpu][class].misses;
+    }
+    stats->full = g_depots[class].full_count;
+}
@@ -0,0 +1,47 @@
+/**
+ * Kernel symbol table
+ * the table is sorted by address and ends with __text_end from linker.ld.
+ * it only adds .rodata, so the code keeps the addresses of the first link
+ */
+
+#include "ksyms.h"
+
+// weak, so the first link goes through without a table
+extern const KSYM ksym_table[] __attribute__((weak));
+extern const uint32 ksym_table_size __attribute__((weak));
+
+/**
+ * number of functions in the table, 0 when the kernel was linked without one
+ */
+uint32 ksym_count(void) {
+    // the end marker isn't a function
+    return &ksym_table_size && ksym_table_size ? ksym_table_size - 1 : 0;
+}
+
+/**
+ * function at index, in address order
+ */
+const KSYM *ksym_get(uint32 index) {
+    return index < ksym_count() ? &ksym_table[index] : NULL;
+}
+
+/**
+ * index of the function containing addr, -1 outside the kernel's code
+ */
+sint32 ksym_index(uint32 addr) {
+    uint32 count = ksym_count();
+    uint32 low = 0, high = count;
+
+    if (count == 0 || addr < ksym_table[0].addr || addr >= ksym_table[count].addr)
+        return -1;
+    // last entry at or below addr
+    while (high - low > 1) {
+        uint32 mid = (low + high) / 2;
+
+        if (ksym_table[mid].addr <= addr)
+            low = mid;
+        else
+            high = mid;
+    }
+    return low;
+}
@@ -0,0 +1,131 @@
+/**
+ * Local APIC
+ * registers are 32 bit wide, 16 byte aligned MMIO at the APIC base
+ */
+
+#include "lapic.h"
+#include "paging.h"
+#include "io_ports.h"
+
+static volatile uint32 *g_lapic = NULL;
+
+static uint32 lapic_read(uint32 reg) {
+    return g_lapic[reg / 4];
+}
+
+static void lapic_write(uint32 reg, uint32 value) {
+    g_lapic[reg / 4] = value;
+    lapic_read(LAPIC_ID);   // wait for the write to finish
+}
+
+static void lapic_wait_icr(void) {
+    while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING)
+        asm volatile("pause");
+}
+
+/**
+ * map the local APIC registers at phys and enable the boot cpu's
+ */
+void lapic_init(uint32 phys) {
+    if (!phys)
+        phys = LAPIC_DEFAULT_BASE;
+    paging_map_mmio(phys, PAGE_SIZE);
+    g_lapic = (volatile uint32 *)phys;
+    lapic_init_cpu();
+}
+
+/**
+ * enable the local APIC of the calling cpu
+ */
+void lapic_init_cpu(void) {
+    // accept every priority, software enable with the spurious vector
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+    // clear stale errors, the register latches on write
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_ESR, 0);
+    lapic_eoi();
+}
+
+/**
+ * TRUE once lapic_init() ran
+ */
+BOOL lapic_present(void) {
+    return g_lapic != NULL;
+}
+
+/**
+ * APIC id of the calling cpu
+ */
+uint8 lapic_id(void) {
+    return g_lapic ? lapic_read(LAPIC_ID) >> 24 : 0;
+}
+
+/**
+ * acknowledge the interrupt being handled
+ */
+void lapic_eoi(void) {
+    if (g_lapic)
+        g_lapic[LAPIC_EOI / 4] = 0;
+}
+
+/**
+ * send vector to the cpu with the given APIC id
+ */
+void lapic_send_ipi(uint8 apic_id, uint8 vector) {
+    if (!g_lapic)
+        return;
+    lapic_wait_icr();
+    lapic_write(LAPIC_ICR_HIGH, (uint32)apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, LAPIC_ICR_FIXED | LAPIC_ICR_ASSERT | vector);
+}
+
+/**
+ * INIT, then two STARTUP IPIs making the cpu run real mode code at page
+ */
+void lapic_start_cpu(uint8 apic_id, uint32 page) {
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_ICR_HIGH, (uint32)apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL | LAPIC_ICR_ASSERT);
+    lapic_wait_icr();
+    lapic_write(LAPIC_ICR_HIGH, (uint32)apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+    lapic_wait_icr();
+    io_wait_us(10000);
+
+    // the startup vector is the page number of the entry code
+    for (int i = 0; i < 2; i++) {
+        lapic_write(LAPIC_ICR_HIGH, (uint32)apic_id << 24);
+        lapic_write(LAPIC_ICR_LOW, LAPIC_ICR_STARTUP | (page >> 12));
+        io_wait_us(200);
+        lapic_wait_icr();
+    }
+}
+
+/**
+ * make the calling cpu's timer count down from count at bus clock / 16,
+ * raising vector every time it reaches 0, or once if periodic is FALSE
+ */
+void lapic_timer_start(uint8 vector, uint32 count, BOOL periodic) {
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+    lapic_write(LAPIC_LVT_TIMER, vector | (periodic ? LAPIC_TIMER_PERIODIC : 0));
+    // writing the initial count starts it
+    lapic_write(LAPIC_TIMER_INITIAL, count);
+}
+
+/**
+ * remaining count of the calling cpu's timer
+ */
+uint32 lapic_timer_current(void) {
+    return lapic_read(LAPIC_TIMER_CURRENT);
+}
+
+/**
+ * stop the calling cpu's timer
+ */
+void lapic_timer_stop(void) {
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INITIAL, 0);
+}
@@ -0,0 +1,123 @@
+/**
+ * Typed message queues
+ * bounded FIFO of fixed size messages with blocking send/receive
+ */
+
+#include "msgq.h"
+#include "string.h"
+#include "utils.h"
+
+/**
+ * set up a queue over caller provided storage of msg_size * capacity bytes
+ */
+void msgq_init(MSGQ *q, void *storage, uint32 msg_size, uint32 capacity) {
+    q->buffer = (uint8 *)storage;
+    q->msg_size = msg_size;
+    q->capacity = capacity;
+    q->head = 0;
+    q->count = 0;
+    q->owns_buffer = FALSE;
+    waitq_init(&q->receivers);
+    waitq_init(&q->senders);
+}
+
+/**
+ * allocate a queue and its storage from the heap
+ */
+MSGQ *msgq_create(uint32 msg_size, uint32 capacity) {
+    MSGQ *q = (MSGQ *)malloc(sizeof(MSGQ));
+    void *storage;
+
+    if (!q)
+        return NULL;
+    storage = malloc(msg_size * capacity);
+    if (!storage) {
+        free(q);
+        return NULL;
+    }
+    msgq_init(q, storage, msg_size, capacity);
+    q->owns_buffer = TRUE;
+    return q;
+}
+
+void msgq_destroy(MSGQ *q) {
+    if (!q)
+        return;
+    if (q->owns_buffer)
+        free(q->buffer);
+    free(q);
+}
+
+// interrupts must be off and a slot free
+static void msgq_put(MSGQ *q, const void *msg) {
+    uint32 tail = (q->head + q->count) % q->capacity;
+    memcpy(q->buffer + tail * q->msg_size, msg, q->msg_size);
+    q->count++;
+}
+
+// interrupts must be off and a message queued
+static void msgq_take(MSGQ *q, void *msg) {
+    memcpy(msg, q->buffer + q->head * q->msg_size, q->msg_size);
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+}
+
+/**
+ * copy msg into the queue, sleeping while it is full
+ */
+void msgq_send(MSGQ *q, const void *msg) {
+    uint32 flags = task_lock();
+
+    while (q->count == q->capacity)
+        waitq_sleep(&q->senders);
+    msgq_put(q, msg);
+    task_unlock(flags);
+
+    waitq_wake_one(&q->receivers);
+}
+
+/**
+ * copy the oldest message into msg, sleeping while the queue is empty
+ */
+void msgq_receive(MSGQ *q, void *msg) {
+    uint32 flags = task_lock();
+
+    while (q->count == 0)
+        waitq_sleep(&q->receivers);
+    msgq_take(q, msg);
+    task_unlock(flags);
+
+    waitq_wake_one(&q->senders);
+}
+
+/**
+ * non-blocking variants, safe from interrupt handlers,
+ * return FALSE when the queue is full / empty
+ */
+BOOL msgq_try_send(MSGQ *q, const void *msg) {
+    uint32 flags = task_lock();
+
+    if (q->count == q->capacity) {
+        task_unlock(flags);
+        return FALSE;
+    }
+    msgq_put(q, msg);
+    task_unlock(flags);
+
+    waitq_wake_one(&q->receivers);
+    return TRUE;
+}
+
+BOOL msgq_try_receive(MSGQ *q, void *msg) {
+    uint32 flags = task_lock();
+
+    if (q->count == 0) {
+        task_unlock(flags);
+        return FALSE;
+    }
+    msgq_take(q, msg);
+    task_unlock(flags);
+
+    waitq_wake_one(&q->senders);
+    return TRUE;
+}
@@ -0,0 +1,87 @@
+/**
+ * Ethernet layer
+ * frames arrive in the NIC's poll task and are handed on by ethertype
+ * in the buffer they came in; nothing below a UDP socket copies them
+ */
+
+#include "net.h"
+#include "arp.h"
+#include "ip.h"
+#include "rshell.h"
+#include "string.h"
+
+static NET_CONFIG g_config;
+static NET_STATS g_stats;
+
+static const uint8 g_broadcast_mac[ETH_ALEN] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+static void net_receive(NET_DEVICE *dev, NETBUF *buf) {
+    ETH_HEADER *eth = (ETH_HEADER *)buf->data;
+
+    if (dev != g_config.dev || buf->len < sizeof(ETH_HEADER)) {
+        netbuf_free(buf);
+        return;
+    }
+    netbuf_pull(buf, sizeof(ETH_HEADER));
+    switch (ntohs(eth->type)) {
+    case ETH_TYPE_ARP:
+        arp_receive(buf);
+        break;
+    case ETH_TYPE_IP:
+        ip_receive(buf);
+        break;
+    default:
+        netbuf_free(buf);
+        break;
+    }
+}
+
+/**
+ * take the frames of the first NIC with the default address, after the
+ * NIC drivers probed. FALSE without a NIC
+ */
+BOOL net_init(void) {
+    g_config.dev = netdev_get(0);
+    if (!g_config.dev)
+        return FALSE;
+    net_configure(NET_DEFAULT_ADDR, NET_DEFAULT_NETMASK, NET_DEFAULT_GATEWAY);
+    netdev_set_receive(net_receive);
+    rshell_init();
+    return TRUE;
+}
+
+/**
+ * the interface's address
+ */
+NET_CONFIG *net_config(void) {
+    return &g_config;
+}
+
+void net_configure(IP_ADDR addr, IP_ADDR netmask, IP_ADDR gateway) {
+    g_config.addr = addr;
+    g_config.netmask = netmask;
+    g_config.gateway = gateway;
+}
+
+/**
+ * counters of every layer
+ */
+NET_STATS *net_stats(void) {
+    return &g_stats;
+}
+
+/**
+ * put an ethernet header in front of buf and send it, buf is gone afterwards
+ */
+BOOL net_send(NETBUF *buf, const uint8 *dst, uint16 type) {
+    ETH_HEADER *eth = (ETH_HEADER *)netbuf_push(buf, sizeof(ETH_HEADER));
+
+    if (!eth || !g_config.dev) {
+        netbuf_free(buf);
+        return FALSE;
+    }
+    memcpy(eth->dst, dst ? dst : g_broadcast_mac, ETH_ALEN);
+    memcpy(eth->src, g_config.dev->mac, ETH_ALEN);
+    eth->type = htons(type);
+    return netdev_transmit(g_config.dev, buf);
+}
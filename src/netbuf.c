@@ -0,0 +1,107 @@
+/**
+ * Packet buffer pool
+ * the buffers are carved out of page frames taken once at boot, so a NIC
+ * can DMA straight into them and every layer hands the same buffer on
+ */
+
+#include "netbuf.h"
+#include "pmm.h"
+#include "spinlock.h"
+
+static NETBUF g_netbufs[NETBUF_COUNT];
+static NETBUF *g_free = NULL;
+static uint32 g_free_count = 0;
+static uint32 g_failed = 0;
+static SPINLOCK g_netbuf_lock = SPINLOCK_INIT("netbuf");
+
+/**
+ * take the pool's page frames, before the NIC drivers probe
+ */
+BOOL netbuf_init(void) {
+    uint32 i, frame = 0;
+
+    for (i = 0; i < NETBUF_COUNT; i++) {
+        if (i % (PAGE_SIZE / NETBUF_SIZE) == 0) {
+            frame = pmm_alloc_frame();
+            if (!frame)
+                return FALSE;
+        }
+        g_netbufs[i].head = (uint8 *)frame + (i % (PAGE_SIZE / NETBUF_SIZE)) * NETBUF_SIZE;
+        netbuf_free(&g_netbufs[i]);
+    }
+    return TRUE;
+}
+
+/**
+ * empty buffer with NETBUF_HEADROOM free in front, NULL when the pool is dry.
+ * safe from interrupt handlers
+ */
+NETBUF *netbuf_alloc(void) {
+    uint32 flags = spin_lock_irqsave(&g_netbuf_lock);
+    NETBUF *buf = g_free;
+
+    if (buf) {
+        g_free = buf->next;
+        g_free_count--;
+    } else {
+        g_failed++;
+    }
+    spin_unlock_irqrestore(&g_netbuf_lock, flags);
+
+    if (buf) {
+        buf->data = buf->head + NETBUF_HEADROOM;
+        buf->len = 0;
+        buf->dev = NULL;
+        buf->next = NULL;
+    }
+    return buf;
+}
+
+void netbuf_free(NETBUF *buf) {
+    uint32 flags;
+
+    if (!buf)
+        return;
+    flags = spin_lock_irqsave(&g_netbuf_lock);
+    buf->next = g_free;
+    g_free = buf;
+    g_free_count++;
+    spin_unlock_irqrestore(&g_netbuf_lock, flags);
+}
+
+/**
+ * grow the frame by len bytes at the front, returns the new start
+ */
+uint8 *netbuf_push(NETBUF *buf, uint32 len) {
+    if (buf->data - buf->head < (sint32)len)
+        return NULL;
+    buf->data -= len;
+    buf->len += len;
+    return buf->data;
+}
+
+/**
+ * strip len bytes off the front, returns the new start
+ */
+uint8 *netbuf_pull(NETBUF *buf, uint32 len) {
+    if (len > buf->len)
+        return NULL;
+    buf->data += len;
+    buf->len -= len;
+    return buf->data;
+}
+
+/**
+ * bytes after the frame's start that still fit the buffer
+ */
+uint32 netbuf_tailroom(const NETBUF *buf) {
+    return NETBUF_SIZE - (buf->data - buf->head);
+}
+
+/**
+ * buffers left in the pool, and allocations that found it empty
+ */
+void netbuf_stats(uint32 *free_bufs, uint32 *failed) {
+    *free_bufs = g_free_count;
+    *failed = g_failed;
+}
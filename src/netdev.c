@@ -0,0 +1,128 @@
+/**
+ * Network device layer
+ * an interrupt only masks the device and wakes its poll task, which takes
+ * up to NETDEV_BUDGET frames a round and leaves interrupts off for as long
+ * as frames keep coming. under load a NIC costs a poll per budget of
+ * frames instead of an interrupt per frame
+ */
+
+#include "netdev.h"
+#include "task.h"
+#include "string.h"
+#include "console.h"
+
+static NET_DEVICE *g_netdevs[NETDEV_MAX_DEVICES];
+static uint32 g_netdev_count = 0;
+static NETDEV_RECEIVE g_receive = NULL;
+
+static void netdev_poll_task(void *arg) {
+    NET_DEVICE *dev = (NET_DEVICE *)arg;
+
+    for (;;) {
+        waitq_wait_event(&dev->poll_wait, dev->poll_scheduled);
+        dev->polls++;
+        if (dev->poll(dev, NETDEV_BUDGET) == NETDEV_BUDGET) {
+            task_yield();
+            continue;
+        }
+        // frames that came after the last poll either raise an interrupt
+        // or are reported here
+        dev->poll_scheduled = FALSE;
+        __sync_synchronize();
+        if (dev->irq(dev, TRUE)) {
+            dev->irq(dev, FALSE);
+            dev->poll_scheduled = TRUE;
+        }
+    }
+}
+
+/**
+ * add dev as eth0, eth1, ... and start its poll task
+ */
+BOOL netdev_register(NET_DEVICE *dev) {
+    if (g_netdev_count == NETDEV_MAX_DEVICES)
+        return FALSE;
+    strcpy(dev->name, "eth0");
+    dev->name[3] += g_netdev_count;
+    waitq_init(&dev->poll_wait);
+    dev->poll_scheduled = FALSE;
+    if (!task_create_kernel(dev->name, netdev_poll_task, dev))
+        return FALSE;
+    g_netdevs[g_netdev_count++] = dev;
+    announce("%s: %s %x:%x:%x:%x:%x:%x\n", dev->name, dev->driver, dev->mac[0], dev->mac[1],
+             dev->mac[2], dev->mac[3], dev->mac[4], dev->mac[5]);
+    return TRUE;
+}
+
+/**
+ * device by index, NULL past the last
+ */
+NET_DEVICE *netdev_get(uint32 index) {
+    return index < g_netdev_count ? g_netdevs[index] : NULL;
+}
+
+/**
+ * device with name, NULL if there is none
+ */
+NET_DEVICE *netdev_find(const char *name) {
+    uint32 i;
+
+    for (i = 0; i < g_netdev_count; i++) {
+        if (strcmp(g_netdevs[i]->name, name) == 0)
+            return g_netdevs[i];
+    }
+    return NULL;
+}
+
+/**
+ * called by drivers from their interrupt handler: turn the device's
+ * interrupts off and let the poll task drain it
+ */
+void netdev_schedule(NET_DEVICE *dev) {
+    dev->interrupts++;
+    if (dev->poll_scheduled)
+        return;
+    dev->irq(dev, FALSE);
+    dev->poll_scheduled = TRUE;
+    waitq_wake_all(&dev->poll_wait);
+}
+
+/**
+ * called by drivers from poll for a frame they received into buf
+ */
+void netdev_receive(NET_DEVICE *dev, NETBUF *buf) {
+    buf->dev = dev;
+    dev->rx_packets++;
+    dev->rx_bytes += buf->len;
+    if (g_receive)
+        g_receive(dev, buf);
+    else
+        netbuf_free(buf);
+}
+
+/**
+ * send the frame in buf, which is gone afterwards either way
+ */
+BOOL netdev_transmit(NET_DEVICE *dev, NETBUF *buf) {
+    uint32 len = buf->len;
+
+    if (len < ETH_MIN_FRAME) {
+        memset(buf->data + len, 0, ETH_MIN_FRAME - len);
+        buf->len = ETH_MIN_FRAME;
+    }
+    if (buf->len > ETH_MAX_FRAME || !dev->transmit(dev, buf)) {
+        dev->tx_dropped++;
+        netbuf_free(buf);
+        return FALSE;
+    }
+    dev->tx_packets++;
+    dev->tx_bytes += len;
+    return TRUE;
+}
+
+/**
+ * let handler take received frames, they are dropped without one
+ */
+void netdev_set_receive(NETDEV_RECEIVE handler) {
+    g_receive = handler;
+}
@@ -0,0 +1,148 @@
+/**
+ * x86 two level paging
+ * page directories and tables are frames from the pmm, which lie in
+ * identity mapped memory, so their physical address is also a pointer
+ */
+
+#include "paging.h"
+#include "string.h"
+
+#define CR0_WP  0x00010000  // supervisor writes respect read only pages
+#define CR0_PG  0x80000000
+
+static uint32 *g_kernel_directory = NULL;
+
+static uint32 *paging_alloc_table(void) {
+    uint32 frame = pmm_alloc_frame();
+
+    if (frame)
+        memset((void *)frame, 0, PAGE_SIZE);
+    return (uint32 *)frame;
+}
+
+static BOOL paging_is_user(uint32 virt) {
+    return virt >= USER_BASE && virt < USER_TOP;
+}
+
+/**
+ * identity map physical memory into the kernel directory and turn paging on
+ */
+void paging_init(void) {
+    uint32 addr, cr0;
+
+    g_kernel_directory = paging_alloc_table();
+
+    // page 0 stays unmapped to catch NULL pointers
+    for (addr = PAGE_SIZE; addr < pmm_memory_end(); addr += PAGE_SIZE)
+        paging_map(g_kernel_directory, addr, addr, PAGE_PRESENT | PAGE_WRITE);
+
+    asm volatile("mov %0, %%cr3" :: "r"(g_kernel_directory));
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 |= CR0_PG | CR0_WP;
+    asm volatile("mov %0, %%cr0" :: "r"(cr0));
+}
+
+/**
+ * directory holding the kernel mappings every address space shares
+ */
+uint32 *paging_kernel_directory(void) {
+    return g_kernel_directory;
+}
+
+/**
+ * map page virt to frame phys, allocating a page table if needed
+ */
+BOOL paging_map(uint32 *directory, uint32 virt, uint32 phys, uint32 flags) {
+    uint32 *pde = &directory[PDE_INDEX(virt)];
+    uint32 *table;
+
+    if (!(*pde & PAGE_PRESENT)) {
+        table = paging_alloc_table();
+        if (!table)
+            return FALSE;
+        // access is decided per page, the directory entry allows everything
+        *pde = (uint32)table | PAGE_PRESENT | PAGE_WRITE | (flags & PAGE_USER);
+    }
+
+    table = (uint32 *)(*pde & PAGE_MASK);
+    table[PTE_INDEX(virt)] = (phys & PAGE_MASK) | (flags & PAGE_FLAGS_MASK) | PAGE_PRESENT;
+    if (directory == paging_current_directory())
+        paging_invalidate(virt);
+    return TRUE;
+}
+
+/**
+ * remove mapping of virt, returns the page table entry it had (0 if none)
+ */
+uint32 paging_unmap(uint32 *directory, uint32 virt) {
+    uint32 pde = directory[PDE_INDEX(virt)];
+    uint32 *table, entry;
+
+    if (!(pde & PAGE_PRESENT))
+        return 0;
+    table = (uint32 *)(pde & PAGE_MASK);
+    entry = table[PTE_INDEX(virt)];
+    table[PTE_INDEX(virt)] = 0;
+    if (directory == paging_current_directory())
+        paging_invalidate(virt);
+    return entry;
+}
+
+/**
+ * page table entry for virt, 0 when unmapped
+ */
+uint32 paging_get_entry(uint32 *directory, uint32 virt) {
+    uint32 pde = directory[PDE_INDEX(virt)];
+
+    if (!(pde & PAGE_PRESENT))
+        return 0;
+    return ((uint32 *)(pde & PAGE_MASK))[PTE_INDEX(virt)];
+}
+
+/**
+ * identity map uncached device memory in the kernel directory,
+ * pages that are already mapped are left alone
+ */
+void paging_map_mmio(uint32 phys, uint32 size) {
+    uint32 addr;
+
+    // device memory inside user space can't be identity mapped
+    if (paging_is_user(phys) || paging_is_user(phys + size - 1))
+        return;
+    for (addr = PAGE_ALIGN_DOWN(phys); addr < phys + size; addr += PAGE_SIZE) {
+        if (!(paging_get_entry(g_kernel_directory, addr) & PAGE_PRESENT))
+            paging_map(g_kernel_directory, addr, addr, PAGE_PRESENT | PAGE_WRITE | PAGE_NO_CACHE);
+        if (addr + PAGE_SIZE < addr)
+            break;
+    }
+}
+
+/**
+ * copy a kernel directory entry that appeared after directory was created,
+ * returns FALSE if the kernel doesn't map virt either
+ */
+BOOL paging_sync_kernel(uint32 *directory, uint32 virt) {
+    uint32 index = PDE_INDEX(virt);
+
+    if (paging_is_user(virt) || !(g_kernel_directory[index] & PAGE_PRESENT))
+        return FALSE;
+    if (directory[index] == g_kernel_directory[index])
+        return FALSE;
+    directory[index] = g_kernel_directory[index];
+    return TRUE;
+}
+
+/**
+ * load directory into cr3 unless it is already active
+ */
+void paging_switch(uint32 *directory) {
+    if (directory != paging_current_directory())
+        asm volatile("mov %0, %%cr3" :: "r"(directory) : "memory");
+}
+
+uint32 *paging_current_directory(void) {
+    uint32 cr3;
+
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    return (uint32 *)cr3;
+}
@@ -0,0 +1,417 @@
+/**
+ * PCI bus
+ * buses are found by following bridges down from bus 0 through ports
+ * 0xCF8/0xCFC, so empty bus numbers are never mapped. the functions found
+ * then use ECAM when the MCFG window can be identity mapped, and keep the
+ * ports otherwise; their address and data pair is serialized by a lock
+ */
+
+#include "pci.h"
+#include "acpi.h"
+#include "paging.h"
+#include "io_ports.h"
+#include "spinlock.h"
+#include "smp.h"
+#include "console.h"
+#include "string.h"
+
+static PCI_DEVICE g_devices[PCI_MAX_DEVICES];
+static uint32 g_device_count = 0;
+static const PCI_DRIVER *g_drivers[PCI_MAX_DRIVERS];
+static uint32 g_driver_count = 0;
+static BOOL g_scanned = FALSE;
+static SPINLOCK g_config_lock = SPINLOCK_INIT("pci config");
+static uint32 g_ecam = 0;
+static uint8 g_ecam_start, g_ecam_end;
+
+// select a register of bus/slot/func for the data port, lock held
+static void pci_port_select(uint8 bus, uint8 slot, uint8 func, uint32 offset) {
+    outportl(PCI_CONFIG_ADDRESS, PCI_CONFIG_ENABLE | ((uint32)bus << 16) | ((uint32)slot << 11)
+             | ((uint32)func << 8) | (offset & 0xFC));
+}
+
+static uint32 pci_port_read(uint8 bus, uint8 slot, uint8 func, uint32 offset, uint32 size) {
+    uint32 flags = spin_lock_irqsave(&g_config_lock);
+    uint16 port = PCI_CONFIG_DATA + (offset & 3);
+    uint32 value;
+
+    pci_port_select(bus, slot, func, offset);
+    if (size == 1)
+        value = inportb(port);
+    else if (size == 2)
+        value = inports(port);
+    else
+        value = inportl(port);
+    spin_unlock_irqrestore(&g_config_lock, flags);
+    return value;
+}
+
+static void pci_port_write(uint8 bus, uint8 slot, uint8 func, uint32 offset, uint32 size, uint32 value) {
+    uint32 flags = spin_lock_irqsave(&g_config_lock);
+    uint16 port = PCI_CONFIG_DATA + (offset & 3);
+
+    pci_port_select(bus, slot, func, offset);
+    if (size == 1)
+        outportb(port, (uint8)value);
+    else if (size == 2)
+        outports(port, (uint16)value);
+    else
+        outportl(port, value);
+    spin_unlock_irqrestore(&g_config_lock, flags);
+}
+
+// the 4KB of configuration space of a function, NULL without usable ECAM
+static volatile uint8 *pci_ecam_map(uint8 bus, uint8 slot, uint8 func) {
+    uint32 phys;
+
+    if (!g_ecam || bus < g_ecam_start || bus > g_ecam_end)
+        return NULL;
+    phys = g_ecam + ((uint32)bus << 20) + ((uint32)slot << 15) + ((uint32)func << 12);
+    paging_map_mmio(phys, PCI_ECAM_SIZE);
+    return (volatile uint8 *)phys;
+}
+
+static uint32 pci_read(const PCI_DEVICE *dev, uint32 offset, uint32 size) {
+    if (dev->ecam) {
+        if (size == 1)
+            return dev->ecam[offset];
+        if (size == 2)
+            return *(volatile uint16 *)(dev->ecam + offset);
+        return *(volatile uint32 *)(dev->ecam + offset);
+    }
+    if (offset >= PCI_CONFIG_SIZE)
+        return 0xFFFFFFFF;
+    return pci_port_read(dev->bus, dev->slot, dev->func, offset, size);
+}
+
+static void pci_write(const PCI_DEVICE *dev, uint32 offset, uint32 size, uint32 value) {
+    if (dev->ecam) {
+        if (size == 1)
+            dev->ecam[offset] = (uint8)value;
+        else if (size == 2)
+            *(volatile uint16 *)(dev->ecam + offset) = (uint16)value;
+        else
+            *(volatile uint32 *)(dev->ecam + offset) = value;
+        return;
+    }
+    if (offset < PCI_CONFIG_SIZE)
+        pci_port_write(dev->bus, dev->slot, dev->func, offset, size, value);
+}
+
+/**
+ * configuration space of dev, offsets past 255 only through ECAM
+ */
+uint8 pci_read8(const PCI_DEVICE *dev, uint32 offset) {
+    return (uint8)pci_read(dev, offset, 1);
+}
+
+uint16 pci_read16(const PCI_DEVICE *dev, uint32 offset) {
+    return (uint16)pci_read(dev, offset, 2);
+}
+
+uint32 pci_read32(const PCI_DEVICE *dev, uint32 offset) {
+    return pci_read(dev, offset, 4);
+}
+
+void pci_write8(const PCI_DEVICE *dev, uint32 offset, uint8 value) {
+    pci_write(dev, offset, 1, value);
+}
+
+void pci_write16(const PCI_DEVICE *dev, uint32 offset, uint16 value) {
+    pci_write(dev, offset, 2, value);
+}
+
+void pci_write32(const PCI_DEVICE *dev, uint32 offset, uint32 value) {
+    pci_write(dev, offset, 4, value);
+}
+
+// size a BAR by writing all ones with decoding off, returns the next index
+static uint32 pci_size_bar(PCI_DEVICE *dev, uint32 index) {
+    uint32 offset = PCI_BAR0 + index * 4;
+    uint32 value = pci_read32(dev, offset);
+    uint32 mask, high = 0;
+    PCI_BAR *bar = &dev->bars[index];
+    BOOL is64 = !(value & PCI_BAR_IO) && (value & 0x6) == PCI_BAR_64;
+
+    pci_write32(dev, offset, 0xFFFFFFFF);
+    mask = pci_read32(dev, offset);
+    pci_write32(dev, offset, value);
+    if (is64 && index + 1 < PCI_BARS) {
+        high = pci_read32(dev, offset + 4);
+        pci_write32(dev, offset + 4, 0xFFFFFFFF);
+        pci_read32(dev, offset + 4);
+        pci_write32(dev, offset + 4, high);
+    }
+
+    if (value & PCI_BAR_IO) {
+        bar->io = TRUE;
+        bar->base = value & ~0x3;
+        mask &= 0xFFFF & ~0x3;
+    } else {
+        bar->prefetchable = (value & PCI_BAR_PREFETCH) ? TRUE : FALSE;
+        mask &= ~0xF;
+        // a BAR placed above 4GB is out of reach, leave it unused
+        bar->base = high ? 0 : value & ~0xF;
+    }
+    bar->size = mask ? (~mask & (bar->io ? 0xFFFF : 0xFFFFFFFF)) + 1 : 0;
+    if (!bar->size)
+        bar->base = 0;
+    return is64 ? index + 2 : index + 1;
+}
+
+static void pci_scan_bus(uint8 bus);
+
+static void pci_add_function(uint8 bus, uint8 slot, uint8 func) {
+    PCI_DEVICE *dev;
+    uint16 command;
+    uint32 i;
+
+    if (g_device_count == PCI_MAX_DEVICES)
+        return;
+    dev = &g_devices[g_device_count];
+    memset(dev, 0, sizeof(PCI_DEVICE));
+    dev->bus = bus;
+    dev->slot = slot;
+    dev->func = func;
+    dev->ecam = pci_ecam_map(bus, slot, func);
+    dev->vendor_id = pci_read16(dev, PCI_VENDOR_ID);
+    dev->device_id = pci_read16(dev, PCI_DEVICE_ID);
+    dev->revision = pci_read8(dev, PCI_REVISION);
+    dev->prog_if = pci_read8(dev, PCI_PROG_IF);
+    dev->subclass = pci_read8(dev, PCI_SUBCLASS);
+    dev->class_code = pci_read8(dev, PCI_CLASS);
+    dev->header_type = pci_read8(dev, PCI_HEADER_TYPE) & ~PCI_HEADER_MULTI;
+    g_device_count++;
+
+    if (dev->header_type == PCI_HEADER_BRIDGE) {
+        uint8 secondary = pci_read8(dev, PCI_SECONDARY_BUS);
+
+        if (secondary > bus)
+            pci_scan_bus(secondary);
+        return;
+    }
+    if (dev->header_type != 0)
+        return;
+
+    dev->subsystem_id = pci_read16(dev, PCI_SUBSYSTEM_ID);
+    dev->irq_line = pci_read8(dev, PCI_IRQ_LINE);
+    dev->irq_pin = pci_read8(dev, PCI_IRQ_PIN);
+    dev->msi_cap = pci_find_capability(dev, PCI_CAP_MSI);
+    dev->msix_cap = pci_find_capability(dev, PCI_CAP_MSIX);
+
+    // sizing moves the BARs for a moment, nothing may decode meanwhile
+    command = pci_read16(dev, PCI_COMMAND);
+    pci_write16(dev, PCI_COMMAND, command & ~(PCI_COMMAND_IO | PCI_COMMAND_MEMORY));
+    for (i = 0; i < PCI_BARS; )
+        i = pci_size_bar(dev, i);
+    pci_write16(dev, PCI_COMMAND, command);
+}
+
+static void pci_scan_bus(uint8 bus) {
+    uint8 slot, func;
+
+    for (slot = 0; slot < 32; slot++) {
+        uint8 functions = 1;
+
+        if (pci_port_read(bus, slot, 0, PCI_VENDOR_ID, 2) == 0xFFFF)
+            continue;
+        if (pci_port_read(bus, slot, 0, PCI_HEADER_TYPE, 1) & PCI_HEADER_MULTI)
+            functions = 8;
+        for (func = 0; func < functions; func++) {
+            if (pci_port_read(bus, slot, func, PCI_VENDOR_ID, 2) != 0xFFFF)
+                pci_add_function(bus, slot, func);
+        }
+    }
+}
+
+static BOOL pci_match(const PCI_DRIVER *driver, const PCI_DEVICE *dev) {
+    const PCI_ID *id;
+
+    for (id = driver->ids; id->vendor_id || id->device_id; id++) {
+        if ((id->vendor_id == PCI_ANY_ID || id->vendor_id == dev->vendor_id)
+                && (id->device_id == PCI_ANY_ID || id->device_id == dev->device_id))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static void pci_probe(const PCI_DRIVER *driver) {
+    uint32 i;
+
+    for (i = 0; i < g_device_count; i++) {
+        PCI_DEVICE *dev = &g_devices[i];
+
+        if (!dev->driver && pci_match(driver, dev) && driver->probe(dev))
+            dev->driver = driver;
+    }
+}
+
+/**
+ * enumerate the devices on every bus reachable from bus 0, after acpi_init()
+ */
+void pci_init(void) {
+    const ACPI_MCFG_INFO *mcfg = acpi_mcfg();
+    uint32 i;
+
+    // identity mapping can't reach a window inside user space
+    if (mcfg && (mcfg->address >= USER_TOP || mcfg->address + ((uint32)mcfg->end_bus + 1) * 0x100000 <= USER_BASE)) {
+        g_ecam = mcfg->address;
+        g_ecam_start = mcfg->start_bus;
+        g_ecam_end = mcfg->end_bus;
+    }
+    pci_scan_bus(0);
+    g_scanned = TRUE;
+    for (i = 0; i < g_driver_count; i++)
+        pci_probe(g_drivers[i]);
+    announce("PCI: %d functions, configuration through %s\n", g_device_count, g_ecam ? "ECAM" : "ports");
+}
+
+/**
+ * device by index, NULL past the last
+ */
+PCI_DEVICE *pci_get(uint32 index) {
+    return index < g_device_count ? &g_devices[index] : NULL;
+}
+
+/**
+ * first device with vendor and device id, NULL if there is none
+ */
+PCI_DEVICE *pci_find(uint16 vendor_id, uint16 device_id) {
+    uint32 i;
+
+    for (i = 0; i < g_device_count; i++) {
+        if (g_devices[i].vendor_id == vendor_id && g_devices[i].device_id == device_id)
+            return &g_devices[i];
+    }
+    return NULL;
+}
+
+/**
+ * turn on I/O and memory decoding, and bus mastering for DMA
+ */
+void pci_enable(PCI_DEVICE *dev, BOOL bus_master) {
+    uint16 command = pci_read16(dev, PCI_COMMAND) | PCI_COMMAND_IO | PCI_COMMAND_MEMORY;
+
+    if (bus_master)
+        command |= PCI_COMMAND_MASTER;
+    pci_write16(dev, PCI_COMMAND, command);
+}
+
+/**
+ * identity map memory BAR bar uncached, NULL for an I/O or unusable BAR.
+ * the device decodes it once pci_enable() was called
+ */
+void *pci_map_bar(PCI_DEVICE *dev, uint32 bar) {
+    PCI_BAR *b;
+
+    if (bar >= PCI_BARS)
+        return NULL;
+    b = &dev->bars[bar];
+    if (b->io || !b->base || !b->size)
+        return NULL;
+    if (b->base + b->size > USER_BASE && b->base < USER_TOP)
+        return NULL;
+    paging_map_mmio(b->base, b->size);
+    return (void *)b->base;
+}
+
+/**
+ * offset of the first capability with id, 0 if dev has none
+ */
+uint8 pci_find_capability(const PCI_DEVICE *dev, uint8 id) {
+    uint8 offset;
+    uint32 hops;
+
+    if (!(pci_read16(dev, PCI_STATUS) & PCI_STATUS_CAPABILITIES))
+        return 0;
+    offset = pci_read8(dev, PCI_CAPABILITIES) & ~0x3;
+    // a broken list could loop, there is room for 48 capabilities at most
+    for (hops = 0; offset && hops < 48; hops++) {
+        if (pci_read8(dev, offset) == id)
+            return offset;
+        offset = pci_read8(dev, offset + 1) & ~0x3;
+    }
+    return 0;
+}
+
+static uint32 pci_msi_address(uint32 cpu) {
+    return MSI_ADDRESS_BASE | ((uint32)smp_cpu(cpu)->apic_id << MSI_ADDRESS_DEST_SHIFT);
+}
+
+/**
+ * let dev raise one message signalled interrupt at handler on cpu.
+ * returns the vector, or -1 without MSI or free vectors
+ */
+sint32 pci_enable_msi(PCI_DEVICE *dev, ISR handler, uint32 cpu) {
+    uint8 cap = dev->msi_cap;
+    uint16 control;
+    sint32 vector;
+
+    if (!cap || cpu >= smp_cpu_count())
+        return -1;
+    vector = isr_alloc_vector(handler);
+    if (vector < 0)
+        return -1;
+
+    control = pci_read16(dev, cap + PCI_MSI_CONTROL);
+    pci_write32(dev, cap + PCI_MSI_ADDRESS, pci_msi_address(cpu));
+    // edge triggered, fixed delivery
+    if (control & PCI_MSI_64) {
+        pci_write32(dev, cap + PCI_MSI_ADDRESS + 4, 0);
+        pci_write16(dev, cap + PCI_MSI_ADDRESS + 8, (uint16)vector);
+    } else {
+        pci_write16(dev, cap + PCI_MSI_ADDRESS + 4, (uint16)vector);
+    }
+    control &= ~PCI_MSI_MME_MASK;
+    pci_write16(dev, cap + PCI_MSI_CONTROL, control | PCI_MSI_ENABLE);
+    pci_write16(dev, PCI_COMMAND, pci_read16(dev, PCI_COMMAND) | PCI_COMMAND_INTX_OFF);
+    return vector;
+}
+
+/**
+ * same for entry of the MSI-X table, its other entries stay masked
+ */
+sint32 pci_enable_msix(PCI_DEVICE *dev, uint32 entry, ISR handler, uint32 cpu) {
+    uint8 cap = dev->msix_cap;
+    volatile uint32 *slot;
+    uint32 table;
+    uint16 control;
+    uint8 *base;
+    sint32 vector;
+
+    if (!cap || cpu >= smp_cpu_count())
+        return -1;
+    control = pci_read16(dev, cap + PCI_MSIX_CONTROL);
+    if (entry > (uint32)(control & PCI_MSIX_SIZE_MASK))
+        return -1;
+    table = pci_read32(dev, cap + PCI_MSIX_TABLE);
+    base = (uint8 *)pci_map_bar(dev, table & 0x7);
+    if (!base)
+        return -1;
+    vector = isr_alloc_vector(handler);
+    if (vector < 0)
+        return -1;
+
+    // the function mask holds everything back while the entry is written
+    pci_write16(dev, cap + PCI_MSIX_CONTROL, control | PCI_MSIX_ENABLE | PCI_MSIX_FUNCTION_MASK);
+    slot = (volatile uint32 *)(base + (table & ~0x7) + entry * PCI_MSIX_ENTRY_SIZE);
+    slot[0] = pci_msi_address(cpu);
+    slot[1] = 0;
+    slot[2] = (uint32)vector;
+    slot[3] &= ~PCI_MSIX_VECTOR_MASKED;
+    pci_write16(dev, cap + PCI_MSIX_CONTROL, (control | PCI_MSIX_ENABLE) & ~PCI_MSIX_FUNCTION_MASK);
+    pci_write16(dev, PCI_COMMAND, pci_read16(dev, PCI_COMMAND) | PCI_COMMAND_INTX_OFF);
+    return vector;
+}
+
+/**
+ * offer every unclaimed device to driver, at pci_init() if it hasn't run yet
+ */
+BOOL pci_register_driver(const PCI_DRIVER *driver) {
+    if (g_driver_count == PCI_MAX_DRIVERS)
+        return FALSE;
+    g_drivers[g_driver_count++] = driver;
+    if (g_scanned)
+        pci_probe(driver);
+    return TRUE;
+}
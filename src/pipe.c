@@ -0,0 +1,172 @@
+/**
+ * In-kernel pipe buffers
+ * fixed size byte ring with blocking readers and writers
+ */
+
+#include "pipe.h"
+#include "string.h"
+#include "utils.h"
+
+/**
+ * allocate a pipe with a ring buffer of given capacity
+ */
+PIPE *pipe_create(uint32 capacity) {
+    PIPE *pipe = (PIPE *)malloc(sizeof(PIPE));
+    if (!pipe)
+        return NULL;
+
+    pipe->buffer = (uint8 *)malloc(capacity);
+    if (!pipe->buffer) {
+        free(pipe);
+        return NULL;
+    }
+    pipe->capacity = capacity;
+    pipe->head = 0;
+    pipe->count = 0;
+    pipe->write_closed = FALSE;
+    pipe->read_closed = FALSE;
+    waitq_init(&pipe->readers);
+    waitq_init(&pipe->writers);
+    return pipe;
+}
+
+/**
+ * free pipe and its buffer
+ */
+void pipe_destroy(PIPE *pipe) {
+    if (!pipe)
+        return;
+    free(pipe->buffer);
+    free(pipe);
+}
+
+// copy in as much as fits, interrupts must be off
+static uint32 pipe_put(PIPE *pipe, const uint8 *src, uint32 size) {
+    uint32 space = pipe->capacity - pipe->count;
+    uint32 tail, first;
+
+    if (size > space)
+        size = space;
+
+    // copy in at most two chunks, up to the end of the ring and from its start
+    tail = (pipe->head + pipe->count) % pipe->capacity;
+    first = pipe->capacity - tail;
+    if (first > size)
+        first = size;
+    memcpy(pipe->buffer + tail, src, first);
+    memcpy(pipe->buffer, src + first, size - first);
+
+    pipe->count += size;
+    return size;
+}
+
+// copy out what is buffered, interrupts must be off
+static uint32 pipe_take(PIPE *pipe, uint8 *dst, uint32 size) {
+    uint32 first;
+
+    if (size > pipe->count)
+        size = pipe->count;
+
+    first = pipe->capacity - pipe->head;
+    if (first > size)
+        first = size;
+    memcpy(dst, pipe->buffer + pipe->head, first);
+    memcpy(dst + first, pipe->buffer, size - first);
+
+    pipe->head = (pipe->head + size) % pipe->capacity;
+    pipe->count -= size;
+    return size;
+}
+
+/**
+ * blocking write of size bytes, returns bytes written,
+ * short (or -1 if nothing was written) once the read end is closed
+ */
+int pipe_write(PIPE *pipe, const void *buffer, uint32 size) {
+    const uint8 *src = (const uint8 *)buffer;
+    uint32 written = 0;
+
+    while (written < size) {
+        uint32 flags = task_lock();
+
+        while (pipe->count == pipe->capacity && !pipe->read_closed)
+            waitq_sleep(&pipe->writers);
+        if (pipe->read_closed) {
+            task_unlock(flags);
+            break;
+        }
+        written += pipe_put(pipe, src + written, size - written);
+        task_unlock(flags);
+
+        waitq_wake_all(&pipe->readers);
+    }
+
+    if (written == 0 && size > 0)
+        return -1;
+    return written;
+}
+
+/**
+ * blocking read, waits until some data is buffered,
+ * returns bytes read or 0 at end of file
+ */
+int pipe_read(PIPE *pipe, void *buffer, uint32 size) {
+    uint32 flags = task_lock();
+    uint32 read;
+
+    while (pipe->count == 0 && !pipe->write_closed)
+        waitq_sleep(&pipe->readers);
+    read = pipe_take(pipe, (uint8 *)buffer, size);
+    task_unlock(flags);
+
+    if (read)
+        waitq_wake_all(&pipe->writers);
+    return read;
+}
+
+/**
+ * non-blocking variants, safe from interrupt handlers,
+ * return the number of bytes actually transferred
+ */
+uint32 pipe_try_write(PIPE *pipe, const void *buffer, uint32 size) {
+    uint32 flags = task_lock();
+    uint32 written = 0;
+
+    if (!pipe->read_closed)
+        written = pipe_put(pipe, (const uint8 *)buffer, size);
+    task_unlock(flags);
+
+    if (written)
+        waitq_wake_all(&pipe->readers);
+    return written;
+}
+
+uint32 pipe_try_read(PIPE *pipe, void *buffer, uint32 size) {
+    uint32 flags = task_lock();
+    uint32 read = pipe_take(pipe, (uint8 *)buffer, size);
+    task_unlock(flags);
+
+    if (read)
+        waitq_wake_all(&pipe->writers);
+    return read;
+}
+
+/**
+ * close one end and wake whoever waits on the other
+ */
+void pipe_close_write(PIPE *pipe) {
+    pipe->write_closed = TRUE;
+    waitq_wake_all(&pipe->readers);
+}
+
+void pipe_close_read(PIPE *pipe) {
+    pipe->read_closed = TRUE;
+    waitq_wake_all(&pipe->writers);
+}
+
+/**
+ * number of bytes ready to be read
+ */
+uint32 pipe_available(PIPE *pipe) {
+    return pipe->count;
+}
@@ -0,0 +1,172 @@
+/**
+ * Physical memory manager
+ * one bit per 4KB frame, set while the frame is in use,
+ * and a reference count for frames shared between address spaces
+ */
+
+#include "pmm.h"
+#include "string.h"
+#include "spinlock.h"
+
+static uint32 g_frame_bitmap[PMM_MAX_FRAMES / 32];
+static uint16 g_frame_refs[PMM_MAX_FRAMES];
+static uint32 g_memory_end = 0;
+static uint32 g_free_frames = 0;
+static uint32 g_next_frame = 0;     // where the next search starts
+static SPINLOCK g_pmm_lock = SPINLOCK_INIT("pmm");
+
+static void pmm_set_free(uint32 start, uint32 end, BOOL free) {
+    uint32 frame;
+
+    start = PAGE_ALIGN_UP(start);
+    for (frame = start / PAGE_SIZE; frame < end / PAGE_SIZE && frame < PMM_MAX_FRAMES; frame++) {
+        BOOL used = (g_frame_bitmap[frame / 32] >> (frame % 32)) & 1;
+
+        if (free && used) {
+            g_frame_bitmap[frame / 32] &= ~(1 << (frame % 32));
+            g_free_frames++;
+        } else if (!free && !used) {
+            g_frame_bitmap[frame / 32] |= 1 << (frame % 32);
+            g_free_frames--;
+        }
+    }
+}
+
+/**
+ * build the frame map from the multiboot memory map,
+ * keeping the kernel, heap and boot modules reserved
+ */
+void pmm_init(MULTIBOOT_INFO *mbi) {
+    uint32 i;
+
+    memset(g_frame_bitmap, 0xFF, sizeof(g_frame_bitmap));
+    g_free_frames = 0;
+
+    if (mbi->flags & MULTIBOOT_INFO_MEM_MAP) {
+        uint32 addr = mbi->mmap_addr;
+
+        while (addr < mbi->mmap_addr + mbi->mmap_length) {
+            MULTIBOOT_MMAP_ENTRY *entry = (MULTIBOOT_MMAP_ENTRY *)addr;
+
+            // only the part below 4GB and below PMM_MAX_MEMORY is usable here
+            if (entry->type == MULTIBOOT_MEMORY_AVAILABLE && entry->addr_high == 0
+                    && entry->addr_low < PMM_MAX_MEMORY) {
+                uint32 end = entry->addr_low + entry->len_low;
+
+                if (entry->len_high || end < entry->addr_low || end > PMM_MAX_MEMORY)
+                    end = PMM_MAX_MEMORY;
+                pmm_set_free(entry->addr_low, PAGE_ALIGN_DOWN(end), TRUE);
+                if (end > g_memory_end)
+                    g_memory_end = end;
+            }
+            addr += entry->size + sizeof(entry->size);
+        }
+    } else if (mbi->flags & MULTIBOOT_INFO_MEMORY) {
+        uint32 end = 0x100000 + mbi->mem_upper * 1024;
+
+        if (end > PMM_MAX_MEMORY)
+            end = PMM_MAX_MEMORY;
+        pmm_set_free(0x100000, PAGE_ALIGN_DOWN(end), TRUE);
+        g_memory_end = end;
+    }
+
+    pmm_set_free(0, PMM_RESERVED_END, FALSE);
+
+    if (mbi->flags & MULTIBOOT_INFO_MODS) {
+        MULTIBOOT_MODULE *mods = (MULTIBOOT_MODULE *)mbi->mods_addr;
+
+        for (i = 0; i < mbi->mods_count; i++)
+            pmm_set_free(PAGE_ALIGN_DOWN(mods[i].mod_start), PAGE_ALIGN_UP(mods[i].mod_end), FALSE);
+    }
+
+    g_next_frame = PMM_RESERVED_END / PAGE_SIZE;
+}
+
+/**
+ * physical address of a free frame, 0 when memory ran out
+ */
+uint32 pmm_alloc_frame(void) {
+    uint32 flags = spin_lock_irqsave(&g_pmm_lock);
+    uint32 i, frame, address = 0;
+
+    // next fit, skipping whole words of used frames
+    for (i = 0; g_free_frames > 0 && i < PMM_MAX_FRAMES / 32; i++) {
+        uint32 word = (g_next_frame / 32 + i) % (PMM_MAX_FRAMES / 32);
+        uint32 bits = g_frame_bitmap[word];
+
+        if (bits == 0xFFFFFFFF)
+            continue;
+        for (frame = 0; frame < 32; frame++) {
+            if (!(bits & (1 << frame))) {
+                g_frame_bitmap[word] |= 1 << frame;
+                g_free_frames--;
+                g_next_frame = word * 32 + frame;
+                g_frame_refs[g_next_frame] = 1;
+                address = g_next_frame * PAGE_SIZE;
+                break;
+            }
+        }
+        if (address)
+            break;
+    }
+    spin_unlock_irqrestore(&g_pmm_lock, flags);
+    return address;
+}
+
+/**
+ * drop a reference to frame, it is free once the last one is gone
+ */
+void pmm_free_frame(uint32 frame) {
+    uint32 index = frame / PAGE_SIZE;
+    uint32 flags;
+
+    if (index >= PMM_MAX_FRAMES)
+        return;
+    flags = spin_lock_irqsave(&g_pmm_lock);
+    if (!(g_frame_bitmap[index / 32] & (1 << (index % 32)))) {
+        // already free
+    } else if (g_frame_refs[index] > 1) {
+        g_frame_refs[index]--;
+    } else {
+        // reserved frames handed back at boot were never counted
+        g_frame_refs[index] = 0;
+        g_frame_bitmap[index / 32] &= ~(1 << (index % 32));
+        g_free_frames++;
+    }
+    spin_unlock_irqrestore(&g_pmm_lock, flags);
+}
+
+/**
+ * take another reference to an allocated frame
+ */
+void pmm_ref_frame(uint32 frame) {
+    uint32 index = frame / PAGE_SIZE;
+
+    if (index < PMM_MAX_FRAMES) {
+        uint32 flags = spin_lock_irqsave(&g_pmm_lock);
+
+        if (g_frame_refs[index] < 0xFFFF)
+            g_frame_refs[index]++;
+        spin_unlock_irqrestore(&g_pmm_lock, flags);
+    }
+}
+
+/**
+ * number of references to frame, 1 means the caller owns it alone
+ */
+uint32 pmm_frame_refs(uint32 frame) {
+    uint32 index = frame / PAGE_SIZE;
+
+    return index < PMM_MAX_FRAMES ? g_frame_refs[index] : 0;
+}
+
+/**
+ * end of usable physical memory
+ */
+uint32 pmm_memory_end(void) {
+    return g_memory_end;
+}
+
+uint32 pmm_free_frames(void) {
+    return g_free_frames;
+}
@@ -0,0 +1,124 @@
+/**
+ * Sampling profiler
+ * the tick can't land while interrupts are off, so time spent with them off
+ * shows up at the irq_restore() or sti that ends it
+ */
+
+#include "prof.h"
+#include "timer.h"
+#include "ksyms.h"
+#include "smp.h"
+#include "string.h"
+#include "utils.h"
+
+typedef struct {
+    uint32 count;
+    uint32 user;
+    uint32 dropped;
+    uint32 eips[PROF_SAMPLES];
+} PROF_CPU;
+
+static PROF_CPU g_prof[CPU_MAX];
+static volatile BOOL g_running = FALSE;
+
+static void prof_sample(REGISTERS *reg) {
+    PROF_CPU *prof;
+
+    if (!g_running)
+        return;
+    prof = &g_prof[smp_cpu_index()];
+    if ((reg->cs & 3) == 3)
+        prof->user++;
+    else if (prof->count == PROF_SAMPLES)
+        prof->dropped++;
+    else
+        prof->eips[prof->count++] = reg->eip;
+}
+
+/**
+ * hook the profiler into the kernel tick, it starts stopped
+ */
+void prof_init(void) {
+    timer_register_tick(prof_sample);
+}
+
+// samples need the periodic tick, otherwise it only runs for sleepers
+void prof_start(void) {
+    if (!g_running)
+        timer_keep_tick(TRUE);
+    g_running = TRUE;
+}
+
+void prof_stop(void) {
+    if (g_running)
+        timer_keep_tick(FALSE);
+    g_running = FALSE;
+}
+
+BOOL prof_running(void) {
+    return g_running;
+}
+
+/**
+ * throw the samples away
+ */
+void prof_reset(void) {
+    uint32 cpu;
+
+    for (cpu = 0; cpu < CPU_MAX; cpu++) {
+        g_prof[cpu].count = 0;
+        g_prof[cpu].user = 0;
+        g_prof[cpu].dropped = 0;
+    }
+}
+
+/**
+ * fill top with the max functions that got the most samples, returns how many
+ */
+uint32 prof_report(PROF_ENTRY *top, uint32 max, PROF_SUMMARY *summary) {
+    uint32 symbols = ksym_count();
+    uint32 *counts = NULL;
+    uint32 cpu, i, n;
+
+    memset(summary, 0, sizeof(PROF_SUMMARY));
+    if (symbols) {
+        counts = (uint32 *)malloc(symbols * sizeof(uint32));
+        if (!counts)
+            return 0;
+        memset(counts, 0, symbols * sizeof(uint32));
+    }
+
+    for (cpu = 0; cpu < smp_cpu_count(); cpu++) {
+        PROF_CPU *prof = &g_prof[cpu];
+        uint32 count = prof->count;
+
+        for (i = 0; i < count; i++) {
+            sint32 index = ksym_index(prof->eips[i]);
+
+            if (index < 0)
+                summary->unknown++;
+            else
+                counts[index]++;
+        }
+        summary->samples += count;
+        summary->user += prof->user;
+        summary->dropped += prof->dropped;
+    }
+
+    // pick the biggest count max times, max is a screenful
+    for (n = 0; n < max; n++) {
+        uint32 best = 0;
+
+        for (i = 1; i < symbols; i++) {
+            if (counts[i] > counts[best])
+                best = i;
+        }
+        if (!symbols || counts[best] == 0)
+            break;
+        top[n].name = ksym_get(best)->name;
+        top[n].samples = counts[best];
+        counts[best] = 0;
+    }
+    free(counts);
+    return n;
+}
@@ -0,0 +1,53 @@
+/**
+ * hello, a ring 3 demo: console and file syscalls, sbrk, yield and fork
+ */
+
+#include "ulib.h"
+
+int main(void) {
+    char name[64];
+    char *greeting;
+    int len, fd, i, child;
+
+    puts("Hello from ring 3, syscalls through ");
+    puts((ulib_flags() & USER_FLAG_SYSENTER) ? "sysenter\n" : "int 0x80\n");
+
+    puts("What's your name? ");
+    len = read(STDIN_FILENO, name, sizeof(name) - 1);
+    if (len > 0 && name[len - 1] == '\n')
+        len--;
+
+    // build the greeting in memory taken from the heap
+    greeting = (char *)sbrk(len + 8);
+    if (greeting == (char *)-1) {
+        puts("sbrk failed\n");
+        return 1;
+    }
+    greeting[0] = 'H'; greeting[1] = 'i'; greeting[2] = ','; greeting[3] = ' ';
+    for (i = 0; i < len; i++)
+        greeting[4 + i] = name[i];
+    greeting[4 + len] = '!';
+    greeting[5 + len] = '\n';
+
+    yield();
+    write(STDOUT_FILENO, greeting, len + 6);
+
+    // the child's write copies the heap page, ours stays untouched
+    child = fork();
+    if (child == 0) {
+        greeting[0] = 'h';
+        puts("child: ");
+        write(STDOUT_FILENO, greeting, len + 6);
+        return 0;
+    }
+    if (child > 0)
+        wait(child);
+
+    // leave a trace in the filesystem
+    fd = open("/hello.txt", O_WRONLY | O_CREAT | O_APPEND);
+    if (fd >= 0) {
+        write(fd, greeting, len + 6);
+        close(fd);
+    }
+    return 0;
+}
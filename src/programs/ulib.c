@@ -0,0 +1,116 @@
+/**
+ * User mode runtime: syscall wrappers for ring 3 programs
+ * sysenter is used when the kernel reports it, int 0x80 otherwise
+ */
+
+#include "ulib.h"
+
+static BOOL g_use_sysenter = FALSE;
+
+static uint32 g_flags = 0;
+
+/**
+ * call first from a program entry point with the flags it received
+ */
+void ulib_init(uint32 flags) {
+    g_flags = flags;
+    g_use_sysenter = (flags & USER_FLAG_SYSENTER) ? TRUE : FALSE;
+}
+
+/**
+ * USER_FLAG_* the kernel started the program with
+ */
+uint32 ulib_flags(void) {
+    return g_flags;
+}
+
+static int syscall3(uint32 number, uint32 arg1, uint32 arg2, uint32 arg3) {
+    int ret;
+
+    if (g_use_sysenter) {
+        // sysexit returns to edx with esp = ecx
+        asm volatile("mov %%esp, %%ecx\n\t"
+                     "movl $1f, %%edx\n\t"
+                     "sysenter\n"
+                     "1:"
+                     : "=a"(ret)
+                     : "a"(number), "b"(arg1), "S"(arg2), "D"(arg3)
+                     : "ecx", "edx", "memory");
+    } else {
+        asm volatile("int $0x80"
+                     : "=a"(ret)
+                     : "a"(number), "b"(arg1), "c"(arg2), "d"(arg3)
+                     : "memory");
+    }
+    return ret;
+}
+
+void exit(int code) {
+    syscall3(SYS_EXIT, code, 0, 0);
+    for (;;)
+        ;
+}
+
+int read(int fd, void *buffer, uint32 size) {
+    return syscall3(SYS_READ, fd, (uint32)buffer, size);
+}
+
+int write(int fd, const void *buffer, uint32 size) {
+    return syscall3(SYS_WRITE, fd, (uint32)buffer, size);
+}
+
+int open(const char *path, uint32 flags) {
+    return syscall3(SYS_OPEN, (uint32)path, flags, 0);
+}
+
+int close(int fd) {
+    return syscall3(SYS_CLOSE, fd, 0, 0);
+}
+
+void *sbrk(int increment) {
+    return (void *)syscall3(SYS_SBRK, increment, 0, 0);
+}
+
+void yield(void) {
+    syscall3(SYS_YIELD, 0, 0, 0);
+}
+
+/**
+ * copy this program, returns 0 in the child and the child's id in the parent
+ */
+int fork(void) {
+    return syscall3(SYS_FORK, 0, 0, 0);
+}
+
+/**
+ * wait for child id to exit, returns its exit code
+ */
+int wait(int id) {
+    return syscall3(SYS_WAIT, id, 0, 0);
+}
+
+/**
+ * give the cpu up for ms milliseconds
+ */
+void sleep_ms(uint32 ms) {
+    syscall3(SYS_SLEEP, ms, 0, 0);
+}
+
+/**
+ * write a NUL terminated string to stdout
+ */
+int puts(const char *str) {
+    uint32 len = 0;
+
+    while (str[len])
+        len++;
+    return write(STDOUT_FILENO, str, len);
+}
+
+/**
+ * program entry point, the kernel passes USER_FLAG_* on the stack
+ */
+void _start(uint32 flags) {
+    ulib_init(flags);
+    exit(main());
+}
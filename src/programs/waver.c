@@ -5,11 +5,14 @@
 #include "console.h"
 #include "string.h"
 #include "utils.h"
+#include "timer.h"
+#include "clock.h"
 
 #define PI 3.14159265359
 #define AMPLITUDE 30.0
 #define WAVE_SPEED 0.5
 #define INITIAL_DENSITY 3  // Initial number of pixels per wave cycle
+#define WAVE_FRAME_NS (NSEC_PER_SEC / 30)
 
 // Function to calculate sine without using floating point
 sint32 sin_fixed(sint32 angle) {
@@ -30,8 +33,10 @@ void draw_wave() {
     uint16 x;
     sint16 y;
     uint8 color = COLOR_BLUE;
+    uint64 frame;
 
     vga_set_graphics_mode();
+    frame = clock_ns();
 
     while (1) {
         // Clear screen by drawing black pixels
@@ -63,7 +68,9 @@ void draw_wave() {
             break;
         }
 
-        for (int i = 0; i < 100000; i++) { }
+        // absolute deadlines, so drawing time doesn't add up into drift
+        frame += WAVE_FRAME_NS;
+        timer_sleep_until(frame);
     }
 
     // Return to text mode
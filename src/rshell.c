@@ -0,0 +1,61 @@
+/**
+ * Remote shell
+ * every datagram to RSHELL_PORT is one command line for shell_execute(),
+ * its output goes back in datagrams of RSHELL_CHUNK bytes followed by the
+ * prompt. there is no authentication, anyone who reaches the port runs
+ * commands; QEMU's user networking only lets forwarded ports in
+ */
+
+#include "rshell.h"
+#include "udp.h"
+#include "shell.h"
+#include "pipe.h"
+#include "task.h"
+#include "string.h"
+#include "console.h"
+
+static void rshell_task(void *arg) {
+    UDP_SOCKET *sock = (UDP_SOCKET *)arg;
+    char line[SHELL_LINE_MAX + 1];
+    char chunk[RSHELL_CHUNK];
+    IP_ADDR src;
+    uint16 port;
+    NETBUF *buf;
+    PIPE *out;
+    uint32 len;
+
+    for (;;) {
+        buf = udp_recv(sock, &src, &port);
+        len = buf->len < SHELL_LINE_MAX ? buf->len : SHELL_LINE_MAX;
+        memcpy(line, buf->data, len);
+        netbuf_free(buf);
+        // nc sends the newline along
+        while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            len--;
+        line[len] = '\0';
+
+        out = pipe_create(SHELL_PIPE_SIZE);
+        if (!out)
+            continue;
+        if (len)
+            shell_execute_into(line, out);
+        while ((len = pipe_try_read(out, chunk, RSHELL_CHUNK)) > 0)
+            udp_sendto(sock, src, port, chunk, len);
+        pipe_destroy(out);
+        udp_sendto(sock, src, port, RSHELL_PROMPT, strlen(RSHELL_PROMPT));
+    }
+}
+
+/**
+ * start the task serving RSHELL_PORT
+ */
+void rshell_init(void) {
+    UDP_SOCKET *sock = udp_open(RSHELL_PORT);
+
+    if (!sock || !task_create_kernel("rshell", rshell_task, sock)) {
+        if (sock)
+            udp_close(sock);
+        return;
+    }
+    announce("remote shell on udp port %d\n", RSHELL_PORT);
+}
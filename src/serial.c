@@ -0,0 +1,74 @@
+/**
+ * Serial port
+ * polled output only, the transmit register is waited on per byte
+ */
+
+#include "serial.h"
+#include "io_ports.h"
+#include "spinlock.h"
+
+static BOOL g_present = FALSE;
+static SPINLOCK g_serial_lock = SPINLOCK_INIT("serial");
+
+/**
+ * set COM1 to baud 8N1, FALSE if no UART answers
+ */
+BOOL serial_init(uint32 baud) {
+    uint16 divisor = SERIAL_BAUD_BASE / baud;
+
+    outportb(SERIAL_COM1 + SERIAL_IER, 0);
+    outportb(SERIAL_COM1 + SERIAL_LCR, SERIAL_LCR_DLAB);
+    outportb(SERIAL_COM1 + SERIAL_DATA, divisor & 0xFF);
+    outportb(SERIAL_COM1 + SERIAL_IER, divisor >> 8);
+    outportb(SERIAL_COM1 + SERIAL_LCR, SERIAL_LCR_8N1);
+    outportb(SERIAL_COM1 + SERIAL_FCR, SERIAL_FCR_ENABLE);
+
+    // a byte sent in loopback mode must come back, or there is no UART
+    outportb(SERIAL_COM1 + SERIAL_MCR, SERIAL_MCR_LOOPBACK);
+    outportb(SERIAL_COM1 + SERIAL_DATA, 0xAE);
+    if (inportb(SERIAL_COM1 + SERIAL_DATA) != 0xAE)
+        return FALSE;
+    outportb(SERIAL_COM1 + SERIAL_MCR, SERIAL_MCR_NORMAL);
+    g_present = TRUE;
+    return TRUE;
+}
+
+/**
+ * TRUE once serial_init() found the UART
+ */
+BOOL serial_present(void) {
+    return g_present;
+}
+
+static void serial_put(char ch) {
+    while (!(inportb(SERIAL_COM1 + SERIAL_LSR) & SERIAL_LSR_THR_EMPTY))
+        ;
+    outportb(SERIAL_COM1 + SERIAL_DATA, ch);
+}
+
+void serial_putchar(char ch) {
+    uint32 flags;
+
+    if (!g_present)
+        return;
+    flags = spin_lock_irqsave(&g_serial_lock);
+    serial_put(ch);
+    spin_unlock_irqrestore(&g_serial_lock, flags);
+}
+
+/**
+ * write s in one piece, lines from different cpus don't mix
+ */
+void serial_write(const char *s) {
+    uint32 flags;
+
+    if (!g_present)
+        return;
+    flags = spin_lock_irqsave(&g_serial_lock);
+    while (*s) {
+        if (*s == '\n')
+            serial_put('\r');
+        serial_put(*s++);
+    }
+    spin_unlock_irqrestore(&g_serial_lock, flags);
+}
@@ -0,0 +1,1393 @@
+/**
+ * Smetana Interactive Shell
+ * tokenizes command lines, runs builtins through pipelines and
+ * redirections, and executes script files with `source`
+ */
+
+#include "shell.h"
+#include "kernel.h"
+#include "console.h"
+#include "string.h"
+#include "filesystem.h"
+#include "utils.h"
+#include "info.h"
+#include "task.h"
+#include "smp.h"
+#include "ioapic.h"
+#include "work.h"
+#include "sync.h"
+#include "kmem.h"
+#include "cpu.h"
+#include "prof.h"
+#include "bench.h"
+#include "serial.h"
+#include "trace.h"
+#include "cpufeat.h"
+#include "acpi.h"
+#include "clock.h"
+#include "timer.h"
+#include "pci.h"
+#include "block.h"
+#include "netdev.h"
+#include "net.h"
+#include "arp.h"
+#include "ip.h"
+
+// defined in programs/waver.c
+extern void draw_wave(void);
+// ring 3 programs are ELF files here, loaded from boot modules
+#define SHELL_BIN_DIR "/bin/"
+
+// Declare external color variables from console.c
+extern uint8 g_fore_color, g_back_color;
+
+typedef struct {
+    int argc;
+    char *argv[SHELL_MAX_ARGS + 1];
+} SHELL_STAGE;
+
+// where the running command reads from and prints to
+static PIPE *g_stdin = NULL;
+static PIPE *g_out_pipe = NULL;
+static FileNode *g_out_file = NULL;
+// output lost to a full pipe, stages run in turn so nobody drains it meanwhile
+static uint32 g_out_dropped = 0;
+
+static int g_source_depth = 0;
+// one command line at a time, from the console or the remote shell
+static MUTEX g_shell_lock = MUTEX_INIT("shell");
+
+static const SHELL_COMMAND *shell_find_command(const char *name);
+static BOOL shell_run_program(const char *name);
+
+// a program still running after its command finished has nowhere to print
+static void shell_sink(char ch) {
+    if (g_out_file)
+        fs_write(g_out_file, &ch, 1, TRUE);
+    else if (!g_out_pipe || pipe_try_write(g_out_pipe, &ch, 1) == 0)
+        g_out_dropped++;
+}
+
+static void shell_set_output(PIPE *pipe, FileNode *file) {
+    g_out_pipe = pipe;
+    g_out_file = file;
+    console_set_sink((pipe || file) ? shell_sink : NULL);
+}
+
+/**
+ * pipe feeding the running command, NULL when it has no input
+ */
+PIPE *shell_stdin(void) {
+    return g_stdin;
+}
+
+// Helper function to get current path
+static void get_current_path(char* path_buffer, uint32 size) {
+    char temp[MAX_PATH];
+    FileNode* node = fs_get_current_dir();
+    FileNode* root = fs_path_to_node("/");
+    uint32 path_len = 0;
+
+    // Handle root directory
+    if (node == root) {
+        strcpy(path_buffer, "/");
+        return;
+    }
+
+    // Build path from current directory up to root
+    while (node != root) {
+        uint32 name_len = strlen(node->name);
+        if (path_len + name_len + 1 >= size) break;
+
+        // Shift existing path right
+        memmove(temp + name_len + 1, temp, path_len);
+        // Add new directory name
+        memcpy(temp, node->name, name_len);
+        temp[name_len] = '/';
+        path_len += name_len + 1;
+
+        node = node->parent;
+    }
+
+    // Add leading slash and null terminator
+    temp[path_len] = '\0';
+    strcpy(path_buffer, "/");
+    strcat(path_buffer, temp);
+}
+
+/**
+ * split line into tokens, honouring '' and "" quoting and \ escapes,
+ * words are copied into storage which must hold 2 * strlen(line) + 1 bytes.
+ * returns number of tokens or -1 on syntax error
+ */
+int shell_tokenize(const char *line, char *storage, SHELL_TOKEN *tokens, int max_tokens) {
+    const char *p = line;
+    char *out = storage;
+    int count = 0;
+
+    while (1) {
+        char quote = 0;
+
+        while (isspace(*p))
+            p++;
+        // '#' starts a comment only at the beginning of a word
+        if (!*p || *p == '#')
+            break;
+        if (count >= max_tokens) {
+            printf("syntax error: too many words\n");
+            return -1;
+        }
+
+        tokens[count].text = NULL;
+        if (*p == '|') {
+            tokens[count++].type = TOKEN_PIPE;
+            p++;
+            continue;
+        }
+        if (*p == '>') {
+            if (p[1] == '>') {
+                tokens[count++].type = TOKEN_APPEND;
+                p += 2;
+            } else {
+                tokens[count++].type = TOKEN_REDIRECT;
+                p++;
+            }
+            continue;
+        }
+
+        tokens[count].type = TOKEN_WORD;
+        tokens[count].text = out;
+        while (*p) {
+            if (quote) {
+                if (*p == quote) {
+                    quote = 0;
+                    p++;
+                    continue;
+                }
+                if (quote == '"' && *p == '\\' && (p[1] == '"' || p[1] == '\\'))
+                    p++;
+                *out++ = *p++;
+            } else {
+                if (isspace(*p) || *p == '|' || *p == '>')
+                    break;
+                if (*p == '\'' || *p == '"') {
+                    quote = *p++;
+                    continue;
+                }
+                if (*p == '\\' && p[1])
+                    p++;
+                *out++ = *p++;
+            }
+        }
+        if (quote) {
+            printf("syntax error: unterminated %c\n", quote);
+            return -1;
+        }
+        *out++ = '\0';
+        count++;
+    }
+    return count;
+}
+
+static void shell_run_stage(SHELL_STAGE *stage) {
+    const SHELL_COMMAND *cmd = shell_find_command(stage->argv[0]);
+
+    if (!cmd) {
+        if (!shell_run_program(stage->argv[0]))
+            printf("%s: command not found\n", stage->argv[0]);
+        return;
+    }
+    cmd->handler(stage->argc, stage->argv);
+}
+
+/**
+ * run one command line, including pipelines and > / >> redirection
+ */
+void shell_execute(const char *line) {
+    char storage[SHELL_LINE_MAX * 2 + 1];
+    SHELL_TOKEN tokens[SHELL_MAX_TOKENS];
+    SHELL_STAGE stages[SHELL_MAX_STAGES];
+    const char *target = NULL;
+    BOOL append = FALSE;
+    int stage_count = 1;
+    int count, i;
+
+    if (strlen(line) > SHELL_LINE_MAX) {
+        printf("syntax error: line too long\n");
+        return;
+    }
+
+    count = shell_tokenize(line, storage, tokens, SHELL_MAX_TOKENS);
+    if (count <= 0)
+        return;
+
+    // group words into pipeline stages
+    stages[0].argc = 0;
+    for (i = 0; i < count; i++) {
+        SHELL_STAGE *stage = &stages[stage_count - 1];
+
+        if (target) {
+            printf("syntax error: unexpected word after redirection\n");
+            return;
+        }
+
+        switch (tokens[i].type) {
+            case TOKEN_WORD:
+                if (stage->argc >= SHELL_MAX_ARGS) {
+                    printf("syntax error: too many arguments\n");
+                    return;
+                }
+                stage->argv[stage->argc++] = tokens[i].text;
+                break;
+
+            case TOKEN_PIPE:
+                if (stage->argc == 0 || stage_count >= SHELL_MAX_STAGES) {
+                    printf("syntax error near `|'\n");
+                    return;
+                }
+                stages[stage_count++].argc = 0;
+                break;
+
+            case TOKEN_REDIRECT:
+            case TOKEN_APPEND:
+                if (i + 1 >= count || tokens[i + 1].type != TOKEN_WORD) {
+                    printf("syntax error: missing redirection target\n");
+                    return;
+                }
+                append = tokens[i].type == TOKEN_APPEND;
+                target = tokens[++i].text;
+                break;
+        }
+    }
+    if (stages[stage_count - 1].argc == 0) {
+        printf("syntax error near `|'\n");
+        return;
+    }
+    for (i = 0; i < stage_count; i++)
+        stages[i].argv[stages[i].argc] = NULL;
+
+    FileNode *file = NULL;
+    if (target) {
+        file = fs_create_file(target);
+        if (!file) {
+            printf("%s: cannot open for writing\n", target);
+            return;
+        }
+        if (!append)
+            fs_write(file, "", 0, FALSE);
+    }
+
+    // a nested shell_execute (from `source`) inherits the caller's streams
+    PIPE *saved_in = g_stdin;
+    PIPE *saved_pipe = g_out_pipe;
+    FileNode *saved_file = g_out_file;
+    PIPE *in = saved_in;
+
+    // stages run one after another, each one's output buffered for the next.
+    // a stage that fills the buffer ends the pipeline with an error
+    for (i = 0; i < stage_count; i++) {
+        BOOL last = (i == stage_count - 1);
+        PIPE *out = NULL;
+
+        if (!last) {
+            out = pipe_create(SHELL_PIPE_SIZE);
+            if (!out) {
+                printf("%s: out of memory for pipe\n", stages[i].argv[0]);
+                break;
+            }
+            shell_set_output(out, NULL);
+        } else if (file) {
+            shell_set_output(NULL, file);
+        } else {
+            shell_set_output(saved_pipe, saved_file);
+        }
+
+        g_stdin = in;
+        g_out_dropped = 0;
+        shell_run_stage(&stages[i]);
+        shell_set_output(saved_pipe, saved_file);
+
+        if (in != saved_in)
+            pipe_destroy(in);
+        in = out;
+        if (!out)
+            continue;
+        if (g_out_dropped) {
+            // the next stage would work on part of the output and look right
+            printf("%s: output over %d bytes doesn't fit the pipe, %d bytes lost\n",
+                   stages[i].argv[0], SHELL_PIPE_SIZE, g_out_dropped);
+            break;
+        }
+        // end of file for the next stage once it drained the buffer
+        pipe_close_write(out);
+    }
+    if (in != saved_in)
+        pipe_destroy(in);
+
+    g_stdin = saved_in;
+}
+
+/**
+ * run line with its output going to out instead of the screen, for the
+ * remote shell. it waits for a command of the console to finish first
+ */
+void shell_execute_into(const char *line, PIPE *out) {
+    PIPE *saved_pipe;
+    FileNode *saved_file;
+
+    mutex_lock(&g_shell_lock);
+    saved_pipe = g_out_pipe;
+    saved_file = g_out_file;
+    shell_set_output(out, NULL);
+    shell_execute(line);
+    shell_set_output(saved_pipe, saved_file);
+    mutex_unlock(&g_shell_lock);
+}
+
+/**
+ * run every line of a script file, returns FALSE if it can't be read
+ */
+BOOL shell_source(const char *path) {
+    char line[SHELL_LINE_MAX + 1];
+    FileNode *file = fs_path_to_node(path);
+    uint32 i, size, len = 0;
+    char *script;
+
+    if (!file || file->is_directory)
+        return FALSE;
+    if (g_source_depth >= SHELL_MAX_DEPTH) {
+        printf("source: %s: nested too deeply\n", path);
+        return TRUE;
+    }
+
+    // copy the script, commands may rewrite the file while it runs
+    size = file->size;
+    script = (char *)malloc(size + 1);
+    if (!script)
+        return FALSE;
+    fs_read(file, 0, script, size);
+    script[size] = '\n';
+
+    g_source_depth++;
+    for (i = 0; i <= size; i++) {
+        char ch = script[i];
+
+        if (ch == '\n' || ch == '\r') {
+            line[len] = '\0';
+            if (len > 0)
+                shell_execute(line);
+            len = 0;
+        } else if (len < SHELL_LINE_MAX) {
+            line[len++] = ch;
+        }
+    }
+    g_source_depth--;
+
+    free(script);
+    return TRUE;
+}
+
+// reads lines either from a file argument or from the pipe feeding the command
+typedef struct {
+    FileNode *file;
+    uint32 offset;
+    PIPE *pipe;
+} SHELL_INPUT;
+
+static BOOL shell_open_input(SHELL_INPUT *in, const char *name, const char *path) {
+    in->file = NULL;
+    in->offset = 0;
+    in->pipe = NULL;
+
+    if (path) {
+        in->file = fs_path_to_node(path);
+        if (!in->file) {
+            printf("%s: %s: No such file\n", name, path);
+            return FALSE;
+        }
+        if (in->file->is_directory) {
+            printf("%s: %s: Is a directory\n", name, path);
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    in->pipe = g_stdin;
+    if (!in->pipe) {
+        printf("%s: missing file operand\n", name);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// next input character, -1 at end of input
+static int shell_getc(SHELL_INPUT *in) {
+    char ch;
+
+    if (in->file) {
+        if (fs_read(in->file, in->offset, &ch, 1) != 1)
+            return -1;
+        in->offset++;
+        return (uint8)ch;
+    }
+    if (pipe_read(in->pipe, &ch, 1) != 1)
+        return -1;
+    return (uint8)ch;
+}
+
+// read one line without its newline, returns FALSE at end of input
+static BOOL shell_getline(SHELL_INPUT *in, char *line, uint32 size) {
+    uint32 len = 0;
+    int ch = shell_getc(in);
+
+    if (ch < 0)
+        return FALSE;
+    while (ch >= 0 && ch != '\n') {
+        if (len < size - 1)
+            line[len++] = ch;
+        ch = shell_getc(in);
+    }
+    line[len] = '\0';
+    return TRUE;
+}
+
+static void print_padded(const char *str, int width) {
+    int len = strlen(str);
+
+    printf("%s", str);
+    while (len++ < width)
+        console_putchar(' ');
+}
+
+static void print_number(uint32 n, int width) {
+    char buf[12];
+
+    itoa(buf, 'u', n);
+    print_padded(buf, width);
+}
+
+static void cmd_help(int argc, char **argv);
+
+static void cmd_cpuid(int argc, char **argv) {
+    (void)argc; (void)argv;
+    cpuid_info(1);
+}
+
+static void cmd_cpuinfo(int argc, char **argv) {
+    const CPU_INFO *info = cpu_info();
+    const CPU_DISPATCH *dispatch;
+    const char *brand = info->brand;
+    uint32 i, column = 6;
+
+    if (argc == 3) {
+        if (!cpu_dispatch_bind(argv[1], argv[2]))
+            printf("cpuinfo: no %s variant %s for this cpu\n", argv[1], argv[2]);
+        return;
+    }
+    while (*brand == ' ')
+        brand++;
+    printf("%s  %s\n", info->vendor, brand);
+    printf("family %d  model %d  stepping %d\n", info->family, info->model, info->stepping);
+    printf("flags");
+    for (i = CPU_FEAT_NONE + 1; i < CPU_FEAT_COUNT; i++) {
+        const char *name = cpu_feature_name(i);
+
+        if (!cpu_has(i))
+            continue;
+        if (column + strlen(name) + 1 > 78) {
+            printf("\n     ");
+            column = 5;
+        }
+        printf(" %s", name);
+        column += strlen(name) + 1;
+    }
+    printf("\n\nroutine      variant  alternatives\n");
+    for (i = 0; (dispatch = cpu_dispatch_get(i)) != NULL; i++) {
+        uint32 j;
+
+        print_padded(dispatch->name, 13);
+        print_padded(dispatch->chosen->name, 9);
+        for (j = 0; j < dispatch->variant_count; j++) {
+            if (&dispatch->variants[j] != dispatch->chosen)
+                printf("%s ", dispatch->variants[j].name);
+        }
+        printf("\n");
+    }
+}
+
+static void cmd_cpus(int argc, char **argv) {
+    uint32 i;
+
+    (void)argc; (void)argv;
+    printf("cpu  apic  ready  switches  jobs  stolen  running\n");
+    for (i = 0; i < smp_cpu_count(); i++) {
+        CPU *cpu = smp_cpu(i);
+        uint32 jobs, stolen;
+
+        work_stats(i, &jobs, &stolen);
+        printf("%d    %d     %d      %d        %d     %d       %s\n", cpu->index, cpu->apic_id,
+               cpu->ready_count, cpu->switches, jobs, stolen,
+               cpu->current ? cpu->current->name : "-");
+    }
+}
+
+static void cmd_acpi(int argc, char **argv) {
+    const ACPI_FADT_INFO *fadt = acpi_fadt();
+    const ACPI_HPET_INFO *hpet = acpi_hpet();
+    ACPI_SDT_HEADER *table;
+    uint32 i;
+
+    (void)argc; (void)argv;
+    printf("table  address     length  revision\n");
+    for (i = 0; (table = acpi_table_get(i)) != NULL; i++) {
+        char signature[5];
+
+        memcpy(signature, table->signature, 4);
+        signature[4] = '\0';
+        printf("%s   0x%x  %d     %d\n", signature, (uint32)table, table->length, table->revision);
+    }
+    if (fadt) {
+        printf("\nsci irq %d  pm1a 0x%x  pm1b 0x%x  pm timer 0x%x\n",
+               fadt->sci_irq, fadt->pm1a_cnt, fadt->pm1b_cnt, fadt->pm_timer);
+        if (fadt->s5_found)
+            printf("S5 SLP_TYP a %d b %d\n", fadt->s5_typ_a, fadt->s5_typ_b);
+        else
+            printf("S5 not found in the DSDT\n");
+        printf("reset register %s\n", fadt->reset_supported ? "yes" : "no");
+    }
+    if (hpet)
+        printf("HPET 0x%x  %d comparators  %s bit counter\n", hpet->address, hpet->comparators,
+               hpet->counter_64 ? "64" : "32");
+}
+
+static void cmd_clock(int argc, char **argv) {
+    const CLOCKSOURCE *source;
+    uint64 ns = clock_ns();
+    uint32 i;
+
+    (void)argc; (void)argv;
+    printf("source  rating  kHz\n");
+    for (i = 0; (source = clock_get(i)) != NULL; i++) {
+        print_padded(source->name, 8);
+        print_number(source->rating, 8);
+        printf("%d%s\n", (uint32)cpu_div64(source->hz, 1000, NULL),
+               source == clock_current() ? "  (current)" : "");
+    }
+    printf("\nup %d ms\n", (uint32)cpu_div64(ns, NSEC_PER_MSEC, NULL));
+}
+
+static void cmd_lspci(int argc, char **argv) {
+    PCI_DEVICE *dev;
+    uint32 i;
+
+    (void)argc; (void)argv;
+    printf("bus:slot.fn  vendor:device  class  irq  driver\n");
+    for (i = 0; (dev = pci_get(i)) != NULL; i++) {
+        printf("%x:%x.%d       %x:%x      %x.%x   %d    %s", dev->bus, dev->slot, dev->func,
+               dev->vendor_id, dev->device_id, dev->class_code, dev->subclass, dev->irq_line,
+               dev->driver ? dev->driver->name : "-");
+        if (dev->msix_cap)
+            printf("  msi-x");
+        else if (dev->msi_cap)
+            printf("  msi");
+        printf("\n");
+    }
+}
+
+static void cmd_blk(int argc, char **argv) {
+    BLOCK_REQUEST *requests;
+    BLOCK_DEVICE *dev;
+    uint8 *buffer;
+    uint64 start, ns;
+    uint32 rounds, round, i, errors = 0, batches, notifications;
+
+    if (argc < 3) {
+        printf("disk  MB      requests  batches  notifications\n");
+        for (i = 0; (dev = block_get(i)) != NULL; i++) {
+            print_padded(dev->name, 6);
+            print_number((uint32)(dev->sectors >> 11), 8);
+            print_number(dev->requests, 10);
+            print_number(dev->batches, 9);
+            printf("%d%s\n", dev->notifications, dev->read_only ? "  (read-only)" : "");
+        }
+        return;
+    }
+    dev = block_find(argv[2]);
+    if (!dev) {
+        printf("blk: no disk %s\n", argv[2]);
+        return;
+    }
+
+    if (strcmp(argv[1], "read") == 0) {
+        uint32 sector = argc > 3 ? atoi(argv[3]) : 0;
+        sint32 status;
+
+        buffer = (uint8 *)malloc(BLOCK_SECTOR_SIZE);
+        if (!buffer)
+            return;
+        status = block_read(dev, sector, 1, buffer);
+        if (status != BLOCK_OK) {
+            printf("blk: read failed (%d)\n", status);
+        } else {
+            for (i = 0; i < 64; i++)
+                printf("%x%s", buffer[i], (i & 15) == 15 ? "\n" : " ");
+        }
+        free(buffer);
+        return;
+    }
+    if (strcmp(argv[1], "bench") != 0) {
+        printf("usage: blk [read <disk> [sector] | bench <disk> [MB]]\n");
+        return;
+    }
+
+    // whole batches go in at once, the driver rings once per batch it takes
+    rounds = (argc > 3 ? atoi(argv[3]) : 16) * 2048 / (SHELL_BLK_BATCH * SHELL_BLK_SECTORS);
+    if ((uint64)rounds * SHELL_BLK_BATCH * SHELL_BLK_SECTORS > dev->sectors)
+        rounds = (uint32)cpu_div64(dev->sectors, SHELL_BLK_BATCH * SHELL_BLK_SECTORS, NULL);
+    requests = (BLOCK_REQUEST *)malloc(SHELL_BLK_BATCH * sizeof(BLOCK_REQUEST));
+    buffer = (uint8 *)malloc(SHELL_BLK_BATCH * SHELL_BLK_SECTORS * BLOCK_SECTOR_SIZE);
+    if (!requests || !buffer || rounds == 0) {
+        free(requests);
+        free(buffer);
+        return;
+    }
+    batches = dev->batches;
+    notifications = dev->notifications;
+    start = clock_ns();
+    for (round = 0; round < rounds; round++) {
+        memset(requests, 0, SHELL_BLK_BATCH * sizeof(BLOCK_REQUEST));
+        for (i = 0; i < SHELL_BLK_BATCH; i++) {
+            requests[i].op = BLOCK_READ;
+            requests[i].sector = (uint64)(round * SHELL_BLK_BATCH + i) * SHELL_BLK_SECTORS;
+            requests[i].count = SHELL_BLK_SECTORS;
+            requests[i].buffer = buffer + i * SHELL_BLK_SECTORS * BLOCK_SECTOR_SIZE;
+            requests[i].next = i + 1 < SHELL_BLK_BATCH ? &requests[i + 1] : NULL;
+        }
+        block_submit(dev, requests);
+        for (i = 0; i < SHELL_BLK_BATCH; i++) {
+            if (block_wait(dev, &requests[i]) != BLOCK_OK)
+                errors++;
+        }
+    }
+    ns = clock_ns() - start;
+    free(requests);
+    free(buffer);
+
+    printf("%d requests of %d KB in %d us, %d errors\n", rounds * SHELL_BLK_BATCH,
+           SHELL_BLK_SECTORS / 2, (uint32)cpu_div64(ns, NSEC_PER_USEC, NULL), errors);
+    printf("%d batches, %d notifications\n", dev->batches - batches, dev->notifications - notifications);
+}
+
+static void print_ip(IP_ADDR addr) {
+    printf("%d.%d.%d.%d", addr & 0xFF, (addr >> 8) & 0xFF, (addr >> 16) & 0xFF, addr >> 24);
+}
+
+static void cmd_net(int argc, char **argv) {
+    NET_CONFIG *config = net_config();
+    NET_STATS *stats = net_stats();
+    NET_DEVICE *dev;
+    ARP_ENTRY entry;
+    NETBUF *buf;
+    uint32 i, free_bufs, failed;
+
+    if (argc > 2 && strcmp(argv[1], "send") == 0) {
+        dev = netdev_find(argv[2]);
+        buf = dev ? netbuf_alloc() : NULL;
+        if (!buf) {
+            printf("net: no %s\n", dev ? "buffer" : "such device");
+            return;
+        }
+        // broadcast of the local experimental ethertype, for tcpdump on the host
+        buf->len = ETH_HEADER_SIZE + 8;
+        memset(buf->data, 0xFF, ETH_ALEN);
+        memcpy(buf->data + ETH_ALEN, dev->mac, ETH_ALEN);
+        buf->data[12] = 0x88;
+        buf->data[13] = 0xB5;
+        memcpy(buf->data + ETH_HEADER_SIZE, "smetana", 8);
+        if (!netdev_transmit(dev, buf))
+            printf("net: %s transmit ring full\n", dev->name);
+        return;
+    }
+    if (argc > 1 && strcmp(argv[1], "ip") == 0) {
+        IP_ADDR addr, netmask = config->netmask, gateway = config->gateway;
+
+        if (argc < 3 || !ip_parse(argv[2], &addr) || (argc > 3 && !ip_parse(argv[3], &netmask))
+                || (argc > 4 && !ip_parse(argv[4], &gateway))) {
+            printf("usage: net ip <addr> [netmask [gateway]]\n");
+            return;
+        }
+        net_configure(addr, netmask, gateway);
+        return;
+    }
+    if (argc > 1 && strcmp(argv[1], "arp") == 0) {
+        printf("address          hardware address    state\n");
+        for (i = 0; arp_entry(i, &entry); i++) {
+            if (!entry.addr)
+                continue;
+            print_ip(entry.addr);
+            printf("    %x:%x:%x:%x:%x:%x    %s\n", entry.mac[0], entry.mac[1], entry.mac[2],
+                   entry.mac[3], entry.mac[4], entry.mac[5], entry.resolved ? "resolved" : "incomplete");
+        }
+        return;
+    }
+
+    for (i = 0; (dev = netdev_get(i)) != NULL; i++) {
+        printf("%s  %s  %x:%x:%x:%x:%x:%x\n", dev->name, dev->driver, dev->mac[0], dev->mac[1],
+               dev->mac[2], dev->mac[3], dev->mac[4], dev->mac[5]);
+        if (dev == config->dev) {
+            printf("  inet ");
+            print_ip(config->addr);
+            printf("  netmask ");
+            print_ip(config->netmask);
+            printf("  gateway ");
+            print_ip(config->gateway);
+            printf("\n");
+        }
+        printf("  rx %d packets %d bytes %d dropped\n", dev->rx_packets, dev->rx_bytes, dev->rx_dropped);
+        printf("  tx %d packets %d bytes %d dropped\n", dev->tx_packets, dev->tx_bytes, dev->tx_dropped);
+        printf("  %d interrupts %d polls\n", dev->interrupts, dev->polls);
+    }
+    netbuf_stats(&free_bufs, &failed);
+    printf("buffers %d of %d free, %d allocations failed\n", free_bufs, NETBUF_COUNT, failed);
+    if (config->dev) {
+        printf("ip in %d out %d dropped %d  icmp echo %d\n", stats->ip_in, stats->ip_out,
+               stats->ip_dropped, stats->icmp_echo);
+        printf("udp in %d out %d dropped %d  arp requests %d replies %d\n", stats->udp_in,
+               stats->udp_out, stats->udp_dropped, stats->arp_requests, stats->arp_replies);
+    }
+}
+
+static void cmd_ping(int argc, char **argv) {
+    uint32 count = argc > 2 ? atoi(argv[2]) : 4;
+    IP_ADDR addr;
+    uint32 seq;
+
+    if (argc < 2 || !ip_parse(argv[1], &addr)) {
+        printf("usage: ping <addr> [count]\n");
+        return;
+    }
+    if (!net_config()->dev) {
+        printf("ping: no network interface\n");
+        return;
+    }
+    for (seq = 1; seq <= count; seq++) {
+        sint32 us = icmp_ping(addr, seq, 1000);
+
+        if (us < 0)
+            printf("seq %d: timeout\n", seq);
+        else
+            printf("seq %d: %d us\n", seq, us);
+        if (seq < count)
+            timer_sleep(1000);
+    }
+}
+
+static void cmd_lockstat(int argc, char **argv) {
+    LOCK_STATS *stats;
+
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        lockstat_reset();
+        return;
+    }
+    printf("lock            acquired  contended  spins\n");
+    for (stats = lockstat_list(); stats; stats = stats->next) {
+        print_padded(stats->name, 16);
+        printf("%d  %d  %d\n", stats->acquired, stats->contended, stats->spins);
+    }
+}
+
+static void cmd_kmem(int argc, char **argv) {
+    KMEM_STATS stats;
+    uint32 class;
+
+    (void)argc; (void)argv;
+    printf("size  hits      misses    depot\n");
+    for (class = 0; class < KMEM_CLASSES; class++) {
+        kmem_stats(class, &stats);
+        printf("%d    %d    %d    %d\n", stats.size, stats.hits, stats.misses, stats.full);
+    }
+}
+
+static void cmd_bench(int argc, char **argv) {
+    const char *prefix = argc > 1 ? argv[1] : "";
+    uint32 count = bench_count();
+    BENCH_RESULT *results = (BENCH_RESULT *)malloc(count * sizeof(BENCH_RESULT));
+    BOOL wakeup = strncmp(BENCH_WAKEUP_NAME, prefix, strlen(prefix)) == 0;
+    BENCH_RESULT latency;
+    char line[48];
+    uint32 i;
+
+    if (!results)
+        return;
+    strcpy(line, "bench-begin cpus=");
+    itoa(line + strlen(line), 'u', smp_cpu_count());
+    strcat(line, "\n");
+    serial_write(line);
+    // the table comes after all runs, console_putchar scrolls the screen
+    for (i = 0; i < count; i++) {
+        if (strncmp(bench_get(i)->name, prefix, strlen(prefix)) == 0)
+            bench_run(bench_get(i), &results[i]);
+    }
+    if (wakeup)
+        bench_wakeup_latency(&latency);
+    serial_write("bench-end\n");
+
+    printf("\nbenchmark           min       median    p99 (cycles/op)\n");
+    for (i = 0; i < count; i++) {
+        if (strncmp(bench_get(i)->name, prefix, strlen(prefix)) != 0 || !bench_available(bench_get(i)))
+            continue;
+        print_padded(bench_get(i)->name, 20);
+        print_number(results[i].min, 10);
+        print_number(results[i].median, 10);
+        printf("%d\n", results[i].p99);
+    }
+    if (wakeup) {
+        printf("\nwakeup after deadline  min %d  median %d  p99 %d ns\n",
+               latency.min, latency.median, latency.p99);
+    }
+    free(results);
+}
+
+static void cmd_trace(int argc, char **argv) {
+    uint32 cpu;
+
+    if (argc > 1 && strcmp(argv[1], "on") == 0) {
+        trace_enable(TRUE);
+        return;
+    }
+    if (argc > 1 && strcmp(argv[1], "off") == 0) {
+        trace_enable(FALSE);
+        return;
+    }
+    if (argc > 1 && strcmp(argv[1], "clear") == 0) {
+        trace_clear();
+        return;
+    }
+    if (argc > 1 && strcmp(argv[1], "dump") == 0) {
+        if (!serial_present())
+            printf("trace: no serial port to dump to\n");
+        trace_dump();
+        return;
+    }
+    printf("tracing %s\n", g_trace_enabled ? "on" : "off");
+    for (cpu = 0; cpu < smp_cpu_count(); cpu++)
+        printf("cpu %d: %d records\n", cpu, trace_count(cpu));
+}
+
+#define PROF_TOP_DEFAULT    10
+#define PROF_TOP_MAX        20
+
+static void cmd_prof(int argc, char **argv) {
+    PROF_ENTRY top[PROF_TOP_MAX];
+    PROF_SUMMARY summary;
+    uint32 count = PROF_TOP_DEFAULT;
+    uint32 total, n, i;
+
+    if (argc > 1 && strcmp(argv[1], "start") == 0) {
+        prof_start();
+        return;
+    }
+    if (argc > 1 && strcmp(argv[1], "stop") == 0) {
+        prof_stop();
+        return;
+    }
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        prof_reset();
+        return;
+    }
+    if (argc > 1 && atoi(argv[1]) > 0)
+        count = atoi(argv[1]) < PROF_TOP_MAX ? (uint32)atoi(argv[1]) : PROF_TOP_MAX;
+
+    n = prof_report(top, count, &summary);
+    total = summary.samples + summary.user;
+    printf("%s, %d samples, %d in user mode, %d dropped\n", prof_running() ? "running" : "stopped",
+           total, summary.user, summary.dropped);
+    if (total == 0)
+        return;
+    printf("samples   pct  function\n");
+    for (i = 0; i < n; i++) {
+        print_number(top[i].samples, 10);
+        print_number(top[i].samples * 100 / total, 5);
+        printf("%s\n", top[i].name);
+    }
+    if (summary.unknown) {
+        print_number(summary.unknown, 10);
+        print_number(summary.unknown * 100 / total, 5);
+        printf("(unknown)\n");
+    }
+}
+
+// irq number as the shell shows it: ISA irqs by number, APIC vectors as such
+static uint32 irqstat_vector(uint32 irq) {
+    return irq < 16 ? IRQ_BASE + irq : irq;
+}
+
+// average without 64 bit division, libgcc isn't linked in
+static uint32 irqstat_average(uint64 cycles, uint32 count) {
+    if (cycles >> 32)
+        return ((uint32)(cycles >> 10) / count) << 10;
+    return (uint32)cycles / count;
+}
+
+static void irqstat_histogram(uint32 irq) {
+    IRQ_STATS stats;
+    uint32 i;
+
+    if (!isr_irq_stats(irqstat_vector(irq), &stats)) {
+        printf("irqstat: irq %d isn't tracked\n", irq);
+        return;
+    }
+    printf("handler cycles of irq %d\n", irq);
+    for (i = 0; i < IRQ_HIST_BUCKETS; i++) {
+        if (stats.histogram[i] == 0)
+            continue;
+        if (i == IRQ_HIST_BUCKETS - 1)
+            printf("   more      %d\n", stats.histogram[i]);
+        else
+            printf("  < %d  %d\n", 1 << (i + 9), stats.histogram[i]);
+    }
+}
+
+static void cmd_irqstat(int argc, char **argv) {
+    uint64 now = cpu_rdtsc();
+    IRQ_STATS stats;
+    uint32 irq;
+
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        isr_irq_stats_reset();
+        return;
+    }
+    if (argc > 2 && strcmp(argv[1], "hist") == 0) {
+        isr_irq_histogram(strcmp(argv[2], "on") == 0);
+        return;
+    }
+    if (argc > 1) {
+        irqstat_histogram(atoi(argv[1]));
+        return;
+    }
+
+    printf("irq  count     avg cyc   max cyc   since (Mcyc)\n");
+    for (irq = 0; irq < 256; irq++) {
+        if (irq == 16)
+            irq = MSI_VECTOR_BASE;
+        if (irq == MSI_VECTOR_BASE + MSI_VECTORS)
+            irq = IRQ_STAT_APIC_BASE;
+        if (!isr_irq_stats(irqstat_vector(irq), &stats) || stats.count == 0)
+            continue;
+        print_number(irq, 5);
+        print_number(stats.count, 10);
+        print_number(irqstat_average(stats.cycles, stats.count), 10);
+        print_number(stats.max_cycles, 10);
+        printf("%d\n", (uint32)((now - stats.last_tsc) >> 20));
+    }
+}
+
+static void cmd_irq(int argc, char **argv) {
+    uint32 irq;
+
+    if (!ioapic_active()) {
+        printf("irq: interrupts go through the 8259 PIC\n");
+        return;
+    }
+    if (argc == 3) {
+        if (!ioapic_set_affinity(atoi(argv[1]), atoi(argv[2])))
+            printf("irq: can't route irq %s to cpu %s\n", argv[1], argv[2]);
+        return;
+    }
+    printf("irq  cpu\n");
+    for (irq = 0; irq < IOAPIC_LEGACY_IRQS; irq++) {
+        if (irq != IRQ2_CASCADE)
+            printf("%d    %d\n", irq, ioapic_affinity(irq));
+    }
+}
+
+static void cmd_clear(int argc, char **argv) {
+    (void)argc; (void)argv;
+    console_clear(g_fore_color, g_back_color);
+}
+
+static void cmd_ls(int argc, char **argv) {
+    fs_ls(argc > 1 ? argv[1] : NULL);
+}
+
+static void cmd_cd(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : "/";
+
+    if (fs_cd(path) == NULL) {
+        printf("cd: %s: No such directory\n", path);
+    }
+}
+
+static void cmd_pwd(int argc, char **argv) {
+    (void)argc; (void)argv;
+    fs_print_working_directory();
+}
+
+static void cmd_mkdir(int argc, char **argv) {
+    if (argc < 2) {
+        printf("mkdir: missing operand\n");
+    } else if (!fs_mkdir(argv[1])) {
+        printf("mkdir: cannot create directory '%s'\n", argv[1]);
+    }
+}
+
+static void cmd_touch(int argc, char **argv) {
+    int i;
+
+    if (argc < 2) {
+        printf("touch: missing file operand\n");
+        return;
+    }
+    for (i = 1; i < argc; i++) {
+        if (!fs_create_file(argv[i]))
+            printf("touch: cannot touch '%s'\n", argv[i]);
+    }
+}
+
+static void cmd_cat(int argc, char **argv) {
+    SHELL_INPUT in;
+    int ch;
+
+    if (!shell_open_input(&in, "cat", argc > 1 ? argv[1] : NULL))
+        return;
+    while ((ch = shell_getc(&in)) >= 0)
+        console_putchar(ch);
+}
+
+static void cmd_grep(int argc, char **argv) {
+    char line[SHELL_LINE_MAX + 1];
+    SHELL_INPUT in;
+
+    if (argc < 2) {
+        printf("usage: grep <pattern> [file]\n");
+        return;
+    }
+    if (!shell_open_input(&in, "grep", argc > 2 ? argv[2] : NULL))
+        return;
+    while (shell_getline(&in, line, sizeof(line))) {
+        if (strstr(line, argv[1]) != NULL)
+            printf("%s\n", line);
+    }
+}
+
+static void cmd_wc(int argc, char **argv) {
+    SHELL_INPUT in;
+    uint32 lines = 0, words = 0, bytes = 0;
+    BOOL in_word = FALSE;
+    int ch;
+
+    if (!shell_open_input(&in, "wc", argc > 1 ? argv[1] : NULL))
+        return;
+    while ((ch = shell_getc(&in)) >= 0) {
+        bytes++;
+        if (ch == '\n')
+            lines++;
+        if (isspace(ch)) {
+            in_word = FALSE;
+        } else if (!in_word) {
+            in_word = TRUE;
+            words++;
+        }
+    }
+    printf("%d %d %d\n", lines, words, bytes);
+}
+
+#define SUM_BLOCK_SIZE  1024
+
+typedef struct {
+    const uint8 *data;
+    uint32 size;
+    volatile uint32 sum;
+} SUM_JOB;
+
+// add up the bytes of blocks [begin, end), a chunk of the work pool
+static void sum_blocks(uint32 begin, uint32 end, void *arg) {
+    SUM_JOB *job = (SUM_JOB *)arg;
+    uint32 i = begin * SUM_BLOCK_SIZE;
+    uint32 last = end * SUM_BLOCK_SIZE;
+    uint32 sum = 0;
+
+    if (last > job->size)
+        last = job->size;
+    for (; i < last; i++)
+        sum += job->data[i];
+    __sync_fetch_and_add(&job->sum, sum);
+}
+
+static void cmd_sum(int argc, char **argv) {
+    SHELL_INPUT in;
+    SUM_JOB job;
+    uint8 *data;
+
+    if (argc < 2) {
+        printf("usage: sum <file>\n");
+        return;
+    }
+    if (!shell_open_input(&in, "sum", argv[1]))
+        return;
+    job.size = in.file->size;
+    data = (uint8 *)malloc(job.size ? job.size : 1);
+    if (!data) {
+        printf("sum: out of memory\n");
+        return;
+    }
+    job.size = fs_read(in.file, 0, data, job.size);
+    job.data = data;
+    job.sum = 0;
+    work_parallel_for(0, (job.size + SUM_BLOCK_SIZE - 1) / SUM_BLOCK_SIZE, 4, sum_blocks, &job);
+    printf("%d %d %s\n", job.sum, job.size, argv[1]);
+    free(data);
+}
+
+static void cmd_echo(int argc, char **argv) {
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        printf(i > 1 ? " %s" : "%s", argv[i]);
+    }
+    printf("\n");
+}
+
+static void cmd_source(int argc, char **argv) {
+    if (argc < 2) {
+        printf("source: filename argument required\n");
+        return;
+    }
+    if (!shell_source(argv[1]))
+        printf("source: %s: No such file\n", argv[1]);
+}
+
+static void cmd_waver(int argc, char **argv) {
+    (void)argc; (void)argv;
+    printf("Warning, this will lock your system\n");
+    printf("Press ESC to exit\n");
+    printf(">draw_wave()\n");
+    draw_wave();
+}
+
+// a bare name is looked up in SHELL_BIN_DIR, anything with a '/' is a path
+static FileNode *shell_find_program(const char *name) {
+    char path[MAX_PATH];
+
+    if (strchr(name, '/'))
+        return fs_path_to_node(name);
+    if (strlen(name) + strlen(SHELL_BIN_DIR) >= (int)sizeof(path))
+        return NULL;
+    strcpy(path, SHELL_BIN_DIR);
+    strcat(path, name);
+    return fs_path_to_node(path);
+}
+
+// run program in ring 3 and wait for it, FALSE if there is no such file
+static BOOL shell_run_program(const char *name) {
+    FileNode *program = shell_find_program(name);
+    TASK *task;
+    int code;
+
+    if (!program || program->is_directory)
+        return FALSE;
+
+    task = task_create_user(program->name, program);
+    if (!task) {
+        printf("%s: not an executable or out of memory\n", name);
+        return TRUE;
+    }
+    code = task_wait(task);
+    if (code != 0)
+        printf("%s: exited with %d\n", name, code);
+    return TRUE;
+}
+
+static void cmd_run(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: run <program>\n");
+        return;
+    }
+    if (!shell_run_program(argv[1]))
+        printf("run: %s: no such program\n", argv[1]);
+}
+
+static const struct {
+    const char *name;
+    VGA_COLOR_TYPE color;
+} g_color_names[] = {
+    { "BLACK", COLOR_BLACK },
+    { "BLUE", COLOR_BLUE },
+    { "GREEN", COLOR_GREEN },
+    { "CYAN", COLOR_CYAN },
+    { "RED", COLOR_RED },
+    { "MAGENTA", COLOR_MAGENTA },
+    { "BROWN", COLOR_BROWN },
+    { "GREY", COLOR_GREY },
+    { "DARK_GREY", COLOR_DARK_GREY },
+    { "BRIGHT_BLUE", COLOR_BRIGHT_BLUE },
+    { "BRIGHT_GREEN", COLOR_BRIGHT_GREEN },
+    { "BRIGHT_CYAN", COLOR_BRIGHT_CYAN },
+    { "BRIGHT_RED", COLOR_BRIGHT_RED },
+    { "BRIGHT_MAGENTA", COLOR_BRIGHT_MAGENTA },
+    { "YELLOW", COLOR_YELLOW },
+    { "WHITE", COLOR_WHITE },
+};
+
+static VGA_COLOR_TYPE color_from_name(const char *name, VGA_COLOR_TYPE fallback) {
+    uint32 i;
+
+    for (i = 0; i < sizeof(g_color_names) / sizeof(g_color_names[0]); i++) {
+        if (strcmp(name, g_color_names[i].name) == 0)
+            return g_color_names[i].color;
+    }
+    return fallback;
+}
+
+static void cmd_color(int argc, char **argv) {
+    if (argc < 2) {
+        print_available_colors();
+        return;
+    }
+    set_text_color(color_from_name(argv[1], COLOR_WHITE),
+                   argc > 2 ? color_from_name(argv[2], COLOR_BLACK) : COLOR_BLACK);
+}
+
+static void cmd_reset_color(int argc, char **argv) {
+    (void)argc; (void)argv;
+    reset_text_color();
+}
+
+static void cmd_shutdown(int argc, char **argv) {
+    (void)argc; (void)argv;
+    announce("Shutting down. Bye!\n");
+    shutdown();
+}
+
+static void cmd_reboot(int argc, char **argv) {
+    (void)argc; (void)argv;
+    announce("Rebooting\n");
+    reboot();
+}
+
+static void cmd_uname(int argc, char **argv) {
+    (void)argc; (void)argv;
+    printf("%s\n", OS_FULL_NAME);
+}
+
+static const SHELL_COMMAND g_commands[] = {
+    { "cpuid", "cpuid", "Display CPU information", cmd_cpuid },
+    { "cpuinfo", "cpuinfo [fn variant]", "CPU features and the routines chosen for them", cmd_cpuinfo },
+    { "cpus", "cpus", "List processors and their run queues", cmd_cpus },
+    { "acpi", "acpi", "List ACPI tables and power management ports", cmd_acpi },
+    { "clock", "clock", "List clocksources and the one in use", cmd_clock },
+    { "lspci", "lspci", "List PCI functions and their drivers", cmd_lspci },
+    { "net", "net [ip|arp|send]", "NICs and counters, set the address, ARP cache", cmd_net },
+    { "ping", "ping <addr> [n]", "Send ICMP echo requests", cmd_ping },
+    { "blk", "blk [read|bench <d>]", "List disks, read a sector or time reads", cmd_blk },
+    { "lockstat", "lockstat [reset]", "Show how often locks were contended", cmd_lockstat },
+    { "kmem", "kmem", "Show allocator magazine hits per size class", cmd_kmem },
+    { "irqstat", "irqstat [irq]", "Interrupt counts and handler cycles", cmd_irqstat },
+    { "bench", "bench [name]", "Time the kernel's hot paths in cycles", cmd_bench },
+    { "trace", "trace [on|off|dump]", "Record events, dump them to COM1", cmd_trace },
+    { "prof", "prof [start|stop|n]", "Sample where the kernel spends time", cmd_prof },
+    { "irq", "irq [irq cpu]", "Show or set which cpu handles an irq", cmd_irq },
+    { "help", "help [name]", "Display help for builtin commands", cmd_help },
+    { "echo", "echo <text>", "Display a line of text", cmd_echo },
+    { "clear", "clear", "Clear the Smetana screen", cmd_clear },
+    { "ls", "ls [dir]", "List directory contents", cmd_ls },
+    { "cd", "cd <dir>", "Change the current directory", cmd_cd },
+    { "pwd", "pwd", "Print working directory", cmd_pwd },
+    { "mkdir", "mkdir <dir>", "Create a new directory", cmd_mkdir },
+    { "touch", "touch <file>", "Create an empty file", cmd_touch },
+    { "cat", "cat [file]", "Print a file or the piped input", cmd_cat },
+    { "grep", "grep <pat> [f]", "Print lines containing a pattern", cmd_grep },
+    { "wc", "wc [file]", "Count lines, words and bytes", cmd_wc },
+    { "sum", "sum <file>", "Add up the bytes of a file in parallel", cmd_sum },
+    { "source", "source <file>", "Run the commands in a script file", cmd_source },
+    { ".", ". <file>", "Same as source", cmd_source },
+    { "waver", "waver", "Draw an animated wave (ESC to exit)", cmd_waver },
+    { "run", "run <program>", "Run a user mode program", cmd_run },
+    { "color", "color <fg> <bg>", "Set text color, no args lists colors", cmd_color },
+    { "reset-color", "reset-color", "Reset text color to default", cmd_reset_color },
+    { "shutdown", "shutdown", "Shutdown the system", cmd_shutdown },
+    { "exit", "exit", "Same as shutdown", cmd_shutdown },
+    { "reboot", "reboot", "Restart the system", cmd_reboot },
+    { "uname", "uname", "Display system information", cmd_uname },
+    { NULL, NULL, NULL, NULL }
+};
+
+static const SHELL_COMMAND *shell_find_command(const char *name) {
+    const SHELL_COMMAND *cmd;
+
+    for (cmd = g_commands; cmd->name; cmd++) {
+        if (strcmp(cmd->name, name) == 0)
+            return cmd;
+    }
+    return NULL;
+}
+
+static void cmd_help(int argc, char **argv) {
+    const SHELL_COMMAND *cmd;
+
+    if (argc > 1) {
+        cmd = shell_find_command(argv[1]);
+        if (!cmd) {
+            printf("help: no help topics match `%s'\n", argv[1]);
+            return;
+        }
+        printf("%s: %s\n", cmd->usage, cmd->description);
+        return;
+    }
+
+    printf("SIS Smetana Interactive Shell\n");
+    printf("These shell commands are defined internally. Type `help' to see this list.\n");
+    printf("Type `help name' to find out more about the function `name'.\n");
+    printf("Commands can be piped with `|' and redirected with `>' or `>>'.\n");
+    printf("\n");
+    for (cmd = g_commands; cmd->name; cmd++) {
+        printf(" ");
+        print_padded(cmd->usage, 16);
+        printf("- %s\n", cmd->description);
+    }
+}
+
+/**
+ * interactive prompt loop, never returns
+ */
+void shell_run(void) {
+    char buffer[SHELL_LINE_MAX + 1];
+    char prompt[MAX_PATH + 32];  // Extra space for "user@Smetana:" and "$"
+    char current_path[MAX_PATH];
+
+    while(1) {
+        // Build prompt with current directory
+        get_current_path(current_path, MAX_PATH);
+
+        VGA_COLOR_TYPE orig_fore = g_fore_color;
+        VGA_COLOR_TYPE orig_back = g_back_color;
+
+        set_text_color(COLOR_BRIGHT_GREEN, COLOR_BLACK);
+        printf("tty1@");
+        printf("smetana");
+
+        set_text_color(COLOR_WHITE, COLOR_BLACK);
+        printf(":");
+
+        set_text_color(COLOR_BRIGHT_BLUE, COLOR_BLACK);
+        printf("%s", current_path);
+
+        set_text_color(COLOR_WHITE, COLOR_BLACK);
+        printf("$ ");
+
+        // Calculate total prompt length for input bound
+        strcpy(prompt, "tty1@smetana:");
+        strcat(prompt, current_path);
+        strcat(prompt, "$ ");
+
+        memset(buffer, 0, sizeof(buffer));
+        getstr_bound(buffer, strlen(prompt));
+
+        // Restore original colors after input
+        set_text_color(orig_fore, orig_back);
+
+        mutex_lock(&g_shell_lock);
+        shell_execute(buffer);
+        mutex_unlock(&g_shell_lock);
+    }
+}
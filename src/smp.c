@@ -0,0 +1,151 @@
+/**
+ * Symmetric multiprocessing
+ * application processors start in real mode at the trampoline
+ * (see trampoline.asm), switch to the kernel's GDT, IDT and page
+ * directory, and then idle until their run queue gets work
+ */
+
+#include "smp.h"
+#include "acpi.h"
+#include "lapic.h"
+#include "gdt.h"
+#include "idt.h"
+#include "paging.h"
+#include "task.h"
+#include "syscall.h"
+#include "fpu.h"
+#include "io_ports.h"
+#include "console.h"
+#include "string.h"
+#include "utils.h"
+
+#define TRAMPOLINE_BASE     0x8000      // must match trampoline.asm
+#define AP_START_TIMEOUT    100000      // microseconds
+
+// parameter block at the end of the trampoline
+typedef struct {
+    uint32 cr3;
+    uint32 stack;
+    uint32 entry;
+    uint32 arg;
+} TRAMPOLINE_PARAMS;
+
+extern uint8 trampoline_start[];
+extern uint8 trampoline_end[];
+extern uint8 trampoline_params[];
+
+static CPU g_cpus[CPU_MAX] = { [0] = { .online = TRUE } };
+static uint32 g_cpu_count = 1;
+static uint8 g_apic_to_cpu[256];
+
+// first C code on an application processor, runs on its boot stack
+static void smp_ap_main(uint32 index) {
+    CPU *cpu = &g_cpus[index];
+
+    // before any string routine, they may use SSE2
+    fpu_init_cpu();
+    gdt_load_cpu(index);
+    idt_load_cpu();
+    lapic_init_cpu();
+    syscall_init_cpu();
+    task_init_cpu(cpu);
+
+    cpu->online = TRUE;
+    task_idle();
+}
+
+static BOOL smp_start_cpu(CPU *cpu, TRAMPOLINE_PARAMS *params) {
+    uint32 waited;
+
+    cpu->boot_stack = (uint8 *)malloc(TASK_KERNEL_STACK_SIZE);
+    if (!cpu->boot_stack)
+        return FALSE;
+
+    params->cr3 = (uint32)paging_kernel_directory();
+    params->stack = (uint32)cpu->boot_stack + TASK_KERNEL_STACK_SIZE;
+    params->entry = (uint32)smp_ap_main;
+    params->arg = cpu->index;
+
+    lapic_start_cpu(cpu->apic_id, TRAMPOLINE_BASE);
+    for (waited = 0; !cpu->online && waited < AP_START_TIMEOUT; waited += 10)
+        io_wait_us(10);
+    return cpu->online;
+}
+
+/**
+ * find the processors in the ACPI MADT and start them,
+ * falls back to the boot cpu alone without ACPI
+ */
+void smp_init(void) {
+    const ACPI_MADT_INFO *madt;
+    TRAMPOLINE_PARAMS *params;
+    uint32 i;
+
+    if (!acpi_init() || (madt = acpi_madt()) == NULL) {
+        announce("SMP: no ACPI MADT, running on the boot cpu only\n");
+        return;
+    }
+
+    lapic_init(madt->lapic_address);
+    g_cpus[0].apic_id = lapic_id();
+
+    memcpy((void *)TRAMPOLINE_BASE, trampoline_start, trampoline_end - trampoline_start);
+    params = (TRAMPOLINE_PARAMS *)(TRAMPOLINE_BASE + (trampoline_params - trampoline_start));
+
+    // cpus are started one at a time, they share the trampoline
+    for (i = 0; i < madt->cpu_count && g_cpu_count < CPU_MAX; i++) {
+        CPU *cpu = &g_cpus[g_cpu_count];
+
+        if (madt->cpu_apic_ids[i] == g_cpus[0].apic_id)
+            continue;
+        cpu->index = g_cpu_count;
+        cpu->apic_id = madt->cpu_apic_ids[i];
+        g_apic_to_cpu[cpu->apic_id] = cpu->index;
+
+        if (smp_start_cpu(cpu, params)) {
+            g_cpu_count++;
+        } else {
+            printf("SMP: cpu with apic id %d did not start\n", cpu->apic_id);
+            g_apic_to_cpu[cpu->apic_id] = 0;
+            free(cpu->boot_stack);
+            memset(cpu, 0, sizeof(CPU));
+        }
+    }
+    announce("SMP: %d of %d cpus online\n", g_cpu_count, madt->cpu_count);
+}
+
+/**
+ * index of the calling cpu
+ */
+uint32 smp_cpu_index(void) {
+    return lapic_present() ? g_apic_to_cpu[lapic_id()] : 0;
+}
+
+/**
+ * data of the calling cpu, call with interrupts off to stay on it
+ */
+CPU *smp_current(void) {
+    return &g_cpus[smp_cpu_index()];
+}
+
+/**
+ * cpu by index, NULL past the last one started
+ */
+CPU *smp_cpu(uint32 index) {
+    return index < g_cpu_count ? &g_cpus[index] : NULL;
+}
+
+/**
+ * number of cpus running
+ */
+uint32 smp_cpu_count(void) {
+    return g_cpu_count;
+}
+
+/**
+ * interrupt cpu so it looks at its run queue, nothing for the calling cpu
+ */
+void smp_kick(CPU *cpu) {
+    if (cpu != smp_current())
+        lapic_send_ipi(cpu->apic_id, IPI_RESCHEDULE_VECTOR);
+}
@@ -1,13 +1,43 @@
 #include "string.h"
 #include "types.h"
+#include "fpu.h"
 
-void* memset(void* dst, int c, uint32 n) {
+// shorter strings are done before a SIMD section pays for itself
+#define STRING_SSE2_MIN     32
+#define PAGE_MASK_BYTES     4095
+
+// the kernel is built without SSE, so gcc refuses xmm clobbers there
+#ifdef __SSE__
+#define XMM_CLOBBERS        , "xmm0", "xmm1", "xmm2", "xmm3"
+#else
+#define XMM_CLOBBERS
+#endif
+
+static void *memset_bytes(void *dst, int c, uint32 n) {
     unsigned char* temp = (unsigned char*)dst;
     for (; n != 0; n--) *temp++ = (unsigned char)c;
     return dst;
 }
 
-void *memcpy(void *dst, const void *src, uint32 n) {
+static void *memset_stosd(void *dst, int c, uint32 n) {
+    uint32 pattern = (uint32)(uint8)c * 0x01010101;
+    uint32 dwords = n / 4, bytes = n % 4;
+    void *p = dst;
+
+    asm volatile("rep stosl" : "+D"(p), "+c"(dwords) : "a"(pattern) : "memory");
+    asm volatile("rep stosb" : "+D"(p), "+c"(bytes) : "a"(pattern) : "memory");
+    return dst;
+}
+
+// a single rep stosb, fast at any length with ERMS
+static void *memset_erms(void *dst, int c, uint32 n) {
+    void *p = dst;
+
+    asm volatile("rep stosb" : "+D"(p), "+c"(n) : "a"(c) : "memory");
+    return dst;
+}
+
+static void *memcpy_bytes(void *dst, const void *src, uint32 n) {
     char *ret = dst;
     char *p = dst;
     const char *q = src;
@@ -16,6 +46,380 @@ void *memcpy(void *dst, const void *src, uint32 n) {
     return ret;
 }
 
+static void *memcpy_movsd(void *dst, const void *src, uint32 n) {
+    uint32 dwords = n / 4, bytes = n % 4;
+    void *p = dst;
+
+    asm volatile("rep movsl" : "+D"(p), "+S"(src), "+c"(dwords) :: "memory");
+    asm volatile("rep movsb" : "+D"(p), "+S"(src), "+c"(bytes) :: "memory");
+    return dst;
+}
+
+static void *memcpy_erms(void *dst, const void *src, uint32 n) {
+    void *p = dst;
+
+    asm volatile("rep movsb" : "+D"(p), "+S"(src), "+c"(n) :: "memory");
+    return dst;
+}
+
+static int strlen_bytes(const char *s) {
+    int len = 0;
+    while (*s++)
+        len++;
+    return len;
+}
+
+// four bytes at a time, aligned loads never cross into the next page
+static int strlen_dword(const char *s) {
+    const char *p = s;
+    const uint32 *w;
+    uint32 v;
+
+    for (; (uint32)p & 3; p++) {
+        if (!*p)
+            return p - s;
+    }
+    // a zero byte turns on the top bit of its byte in (v - 0x01..) & ~v
+    for (w = (const uint32 *)p; ; w++) {
+        v = *w;
+        if ((v - 0x01010101) & ~v & 0x80808080)
+            break;
+    }
+    for (p = (const char *)w; *p; p++)
+        ;
+    return p - s;
+}
+
+/**
+ * SSE2 scans, between fpu_kernel_begin() and fpu_kernel_end()
+ * aligned 16 byte loads never cross into a page the string doesn't reach.
+ * bit i of a mask stands for byte i of the block
+ */
+
+// zero bytes of the aligned block at p
+static inline uint32 sse2_zero_mask(const char *p) {
+    uint32 mask;
+
+    asm volatile("pxor %%xmm0, %%xmm0\n\t"
+                 "movdqa (%1), %%xmm1\n\t"
+                 "pcmpeqb %%xmm0, %%xmm1\n\t"
+                 "pmovmskb %%xmm1, %0"
+                 : "=r"(mask) : "r"(p) : "cc", "memory" XMM_CLOBBERS);
+    return mask;
+}
+
+// zero bytes and bytes equal to those of pattern, both aligned
+static inline uint32 sse2_byte_mask(const char *p, const uint8 *pattern) {
+    uint32 mask;
+
+    asm volatile("pxor %%xmm0, %%xmm0\n\t"
+                 "movdqa (%1), %%xmm1\n\t"
+                 "movdqa %%xmm1, %%xmm2\n\t"
+                 "pcmpeqb %%xmm0, %%xmm1\n\t"
+                 "pcmpeqb (%2), %%xmm2\n\t"
+                 "por %%xmm2, %%xmm1\n\t"
+                 "pmovmskb %%xmm1, %0"
+                 : "=r"(mask) : "r"(p), "r"(pattern) : "cc", "memory" XMM_CLOBBERS);
+    return mask;
+}
+
+// bytes where s1 and s2 differ or s1 ends, unaligned
+static inline uint32 sse2_diff_mask(const char *s1, const char *s2) {
+    uint32 equal, zero;
+
+    asm volatile("pxor %%xmm0, %%xmm0\n\t"
+                 "movdqu (%2), %%xmm1\n\t"
+                 "movdqu (%3), %%xmm2\n\t"
+                 "movdqa %%xmm1, %%xmm3\n\t"
+                 "pcmpeqb %%xmm2, %%xmm1\n\t"
+                 "pcmpeqb %%xmm0, %%xmm3\n\t"
+                 "pmovmskb %%xmm1, %0\n\t"
+                 "pmovmskb %%xmm3, %1"
+                 : "=&r"(equal), "=&r"(zero) : "r"(s1), "r"(s2) : "cc", "memory" XMM_CLOBBERS);
+    return (equal ^ 0xFFFF) | zero;
+}
+
+// the aligned block holding p, the bytes before p are cleared from *skip
+static inline const char *sse2_block(const char *p, uint32 *skip) {
+    *skip = 0xFFFF << ((uint32)p & 15);
+    return p - ((uint32)p & 15);
+}
+
+static int strlen_sse2(const char *s) {
+    FPU_KERNEL_STATE fpu;
+    const char *p;
+    uint32 mask;
+
+    // short strings one byte at a time
+    for (p = s; p < s + STRING_SSE2_MIN; p++) {
+        if (!*p)
+            return p - s;
+    }
+    fpu_kernel_begin(&fpu);
+    p = sse2_block(p, &mask);
+    mask &= sse2_zero_mask(p);
+    while (!mask) {
+        p += 16;
+        mask = sse2_zero_mask(p);
+    }
+    fpu_kernel_end(&fpu);
+    return p - s + __builtin_ctz(mask);
+}
+
+static int strcmp_bytes(const char *s1, const char *s2) {
+    int i = 0;
+
+    while ((s1[i] == s2[i])) {
+        if (s2[i++] == 0)
+            return 0;
+    }
+    return (uint8)s1[i] - (uint8)s2[i];
+}
+
+static int strcmp_sse2(const char *s1, const char *s2) {
+    FPU_KERNEL_STATE fpu;
+    uint32 i, mask;
+
+    for (i = 0; i < STRING_SSE2_MIN; i++) {
+        if (s1[i] != s2[i] || !s1[i])
+            return (uint8)s1[i] - (uint8)s2[i];
+    }
+    s1 += i;
+    s2 += i;
+
+    fpu_kernel_begin(&fpu);
+    for (;;) {
+        // the strings are at different alignments, so step bytewise over page ends
+        if (((uint32)s1 & PAGE_MASK_BYTES) > PAGE_MASK_BYTES - 16
+                || ((uint32)s2 & PAGE_MASK_BYTES) > PAGE_MASK_BYTES - 16) {
+            if (*s1 != *s2 || !*s1)
+                break;
+            s1++;
+            s2++;
+            continue;
+        }
+        mask = sse2_diff_mask(s1, s2);
+        if (mask) {
+            s1 += __builtin_ctz(mask);
+            s2 += __builtin_ctz(mask);
+            break;
+        }
+        s1 += 16;
+        s2 += 16;
+    }
+    fpu_kernel_end(&fpu);
+    return (uint8)*s1 - (uint8)*s2;
+}
+
+static char *strchr_bytes(const char *str, char c) {
+    while (*str) {
+        if (*str == c) {
+            return (char*)str;
+        }
+        str++;
+    }
+    return NULL;
+}
+
+static char *strchr_sse2(const char *str, char c) {
+    uint8 pattern[16] __attribute__((aligned(16)));
+    FPU_KERNEL_STATE fpu;
+    const char *p;
+    uint32 mask;
+
+    for (p = str; p < str + STRING_SSE2_MIN; p++) {
+        if (!*p)
+            return NULL;
+        if (*p == c)
+            return (char *)p;
+    }
+    memset(pattern, c, sizeof(pattern));
+    fpu_kernel_begin(&fpu);
+    p = sse2_block(p, &mask);
+    mask &= sse2_byte_mask(p, pattern);
+    while (!mask) {
+        p += 16;
+        mask = sse2_byte_mask(p, pattern);
+    }
+    fpu_kernel_end(&fpu);
+    p += __builtin_ctz(mask);
+    return *p ? (char *)p : NULL;
+}
+
+// the rest of needle follows at p, the first byte is known to match
+static BOOL strstr_match(const char *p, const char *needle) {
+    while (*++needle) {
+        if (*++p != *needle)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static char *strstr_bytes(const char *in, const char *str) {
+    char c;
+    uint32 len;
+
+    c = *str++;
+    if (!c)
+        return (char *)in;
+
+    len = strlen(str);
+    do {
+        char sc;
+        do {
+            sc = *in++;
+            if (!sc)
+                return (char *)0;
+        } while (sc != c);
+    } while (strncmp(in, str, len) != 0);
+
+    return (char *)(in - 1);
+}
+
+// blocks are searched for the first byte of str, the candidates then compared
+static char *strstr_sse2(const char *in, const char *str) {
+    uint8 pattern[16] __attribute__((aligned(16)));
+    FPU_KERNEL_STATE fpu;
+    const char *p, *found = NULL;
+    BOOL end = FALSE;
+    uint32 mask, skip, i;
+
+    if (!*str)
+        return (char *)in;
+    for (p = in; p < in + STRING_SSE2_MIN; p++) {
+        if (!*p)
+            return NULL;
+        if (*p == *str && strstr_match(p, str))
+            return (char *)p;
+    }
+
+    memset(pattern, *str, sizeof(pattern));
+    fpu_kernel_begin(&fpu);
+    p = sse2_block(p, &skip);
+    while (!found && !end) {
+        mask = sse2_byte_mask(p, pattern) & skip;
+        skip = 0xFFFF;
+        while (mask && !found && !end) {
+            i = __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (!p[i])
+                end = TRUE;
+            else if (strstr_match(p + i, str))
+                found = p + i;
+        }
+        p += 16;
+    }
+    fpu_kernel_end(&fpu);
+    return (char *)found;
+}
+
+static uint16 ip_checksum_fold(uint64 sum) {
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~sum & 0xFFFF;
+}
+
+static uint16 ip_checksum_words(const void *data, uint32 n) {
+    const uint16 *w = data;
+    uint64 sum = 0;
+
+    for (; n >= 2; n -= 2)
+        sum += *w++;
+    if (n)
+        sum += *(const uint8 *)w;
+    return ip_checksum_fold(sum);
+}
+
+// a 64 bit sum of dwords folds to the same 16 bit ones' complement sum
+static uint16 ip_checksum_dword(const void *data, uint32 n) {
+    const uint32 *d = data;
+    const uint8 *tail;
+    uint64 sum = 0;
+
+    for (; n >= 4; n -= 4)
+        sum += *d++;
+    tail = (const uint8 *)d;
+    if (n >= 2) {
+        sum += *(const uint16 *)tail;
+        tail += 2;
+        n -= 2;
+    }
+    if (n)
+        sum += *tail;
+    return ip_checksum_fold(sum);
+}
+
+static void *(*g_memset)(void *, int, uint32) = memset_bytes;
+static void *(*g_memcpy)(void *, const void *, uint32) = memcpy_bytes;
+static int (*g_strlen)(const char *) = strlen_bytes;
+static int (*g_strcmp)(const char *, const char *) = strcmp_bytes;
+static char *(*g_strchr)(const char *, char) = strchr_bytes;
+static char *(*g_strstr)(const char *, const char *) = strstr_bytes;
+static uint16 (*g_ip_checksum)(const void *, uint32) = ip_checksum_words;
+
+static const CPU_VARIANT g_memset_variants[] = {
+    { "erms", CPU_FEAT_ERMS, memset_erms },
+    { "stosd", CPU_FEAT_NONE, memset_stosd },
+    { "bytes", CPU_FEAT_NONE, memset_bytes },
+};
+
+static const CPU_VARIANT g_memcpy_variants[] = {
+    { "erms", CPU_FEAT_ERMS, memcpy_erms },
+    { "movsd", CPU_FEAT_NONE, memcpy_movsd },
+    { "bytes", CPU_FEAT_NONE, memcpy_bytes },
+};
+
+// the sse2 scans are bound with cpu_dispatch_bind() only. in the kernel each
+// call pays for fpu_kernel_begin() and fpu_kernel_end(), which the host
+// bench doesn't see; `bench` times them against the defaults
+static const CPU_VARIANT g_strlen_variants[] = {
+    { "dword", CPU_FEAT_NONE, strlen_dword },
+    { "sse2", CPU_FEAT_SSE2, strlen_sse2 },
+    { "bytes", CPU_FEAT_NONE, strlen_bytes },
+};
+
+static const CPU_VARIANT g_strcmp_variants[] = {
+    { "bytes", CPU_FEAT_NONE, strcmp_bytes },
+    { "sse2", CPU_FEAT_SSE2, strcmp_sse2 },
+};
+
+static const CPU_VARIANT g_strchr_variants[] = {
+    { "bytes", CPU_FEAT_NONE, strchr_bytes },
+    { "sse2", CPU_FEAT_SSE2, strchr_sse2 },
+};
+
+static const CPU_VARIANT g_strstr_variants[] = {
+    { "bytes", CPU_FEAT_NONE, strstr_bytes },
+    { "sse2", CPU_FEAT_SSE2, strstr_sse2 },
+};
+
+static const CPU_VARIANT g_ip_checksum_variants[] = {
+    { "dword", CPU_FEAT_NONE, ip_checksum_dword },
+    { "words", CPU_FEAT_NONE, ip_checksum_words },
+};
+
+#define VARIANTS(v)     v, sizeof(v) / sizeof(v[0])
+
+CPU_DISPATCH g_string_dispatch[] = {
+    { "memset", (void **)&g_memset, VARIANTS(g_memset_variants), NULL },
+    { "memcpy", (void **)&g_memcpy, VARIANTS(g_memcpy_variants), NULL },
+    { "strlen", (void **)&g_strlen, VARIANTS(g_strlen_variants), NULL },
+    { "strcmp", (void **)&g_strcmp, VARIANTS(g_strcmp_variants), NULL },
+    { "strchr", (void **)&g_strchr, VARIANTS(g_strchr_variants), NULL },
+    { "strstr", (void **)&g_strstr, VARIANTS(g_strstr_variants), NULL },
+    { "ip_checksum", (void **)&g_ip_checksum, VARIANTS(g_ip_checksum_variants), NULL },
+};
+
+const uint32 g_string_dispatch_count = sizeof(g_string_dispatch) / sizeof(g_string_dispatch[0]);
+
+void *memset(void *dst, int c, uint32 n) {
+    return g_memset(dst, c, n);
+}
+
+void *memcpy(void *dst, const void *src, uint32 n) {
+    return g_memcpy(dst, src, n);
+}
+
 void* memmove(void* dest, const void* src, uint32 n) {
     uint8* d = (uint8*)dest;
     const uint8* s = (const uint8*)src;
@@ -39,28 +443,26 @@ void* memmove(void* dest, const void* src, uint32 n) {
 int memcmp(uint8 *s1, uint8 *s2, uint32 n) {
     while (n--) {
         if (*s1 != *s2)
-            return 0;
+            return *s1 - *s2;
         s1++;
         s2++;
     }
-    return 1;
+    return 0;
 }
 
 int strlen(const char *s) {
-    int len = 0;
-    while (*s++)
-        len++;
-    return len;
+    return g_strlen(s);
 }
 
-int strcmp(const char *s1, const char *s2) {
-    int i = 0;
+/**
+ * internet checksum of RFC 1071, ready to store in a header
+ */
+uint16 ip_checksum(const void *data, uint32 n) {
+    return g_ip_checksum(data, n);
+}
 
-    while ((s1[i] == s2[i])) {
-        if (s2[i++] == 0)
-            return 0;
-    }
-    return 1;
+int strcmp(const char *s1, const char *s2) {
+    return g_strcmp(s1, s2);
 }
 
 int strncmp(const char *s1, const char *s2, int c) {
@@ -94,10 +496,8 @@ int strcpy(char *dst, const char *src) {
 }
 
 void strcat(char *dest, const char *src) {
-    char *end = (char *)dest + strlen(dest);
-    memcpy((void *)end, (void *)src, strlen(src));
-    end = end + strlen(src);
-    *end = '\0';
+    // the terminator comes along with the copy
+    memcpy(dest + strlen(dest), src, strlen(src) + 1);
 }
 
 char* strtok(char* str, const char* delim) {
@@ -136,14 +536,8 @@ char* strtok(char* str, const char* delim) {
     return token;
 }
 
-char* strchr(const char* str, char c) {
-    while (*str) {
-        if (*str == c) {
-            return (char*)str;
-        }
-        str++;
-    }
-    return NULL;
+char *strchr(const char *str, char c) {
+    return g_strchr(str, c);
 }
 
 int isspace(char c) {
@@ -169,14 +563,14 @@ char lower(char c) {
 void itoa(char *buf, int base, int d) {
     char *p = buf;
     char *p1, *p2;
-    unsigned long ud = d;
+    uint32 ud = d;
     int divisor = 10;
 
     /* If %d is specified and D is minus, put ‘-’ in the head. */
     if (base == 'd' && d < 0) {
         *p++ = '-';
         buf++;
-        ud = -d;
+        ud = 0 - ud;
     } else if (base == 'x')
         divisor = 16;
 
@@ -201,24 +595,23 @@ void itoa(char *buf, int base, int d) {
     }
 }
 
-char *strstr(const char *in, const char *str) {
-    char c;
-    uint32 len;
-
-    c = *str++;
-    if (!c)
-        return (char *)in;
+// decimal number at the start of s, with an optional sign
+int atoi(const char *s) {
+    int sign = 1, n = 0;
 
-    len = strlen(str);
-    do {
-        char sc;
-        do {
-            sc = *in++;
-            if (!sc)
-                return (char *)0;
-        } while (sc != c);
-    } while (strncmp(in, str, len) != 0);
+    while (isspace(*s))
+        s++;
+    if (*s == '-' || *s == '+') {
+        if (*s == '-')
+            sign = -1;
+        s++;
+    }
+    while (*s >= '0' && *s <= '9')
+        n = n * 10 + (*s++ - '0');
+    return sign * n;
+}
 
-    return (char *)(in - 1);
+char *strstr(const char *in, const char *str) {
+    return g_strstr(in, str);
 }
 
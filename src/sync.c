@@ -0,0 +1,186 @@
+/**
+ * Reader-writer locks, mutexes, semaphores and the lockstat list
+ * the sleeping locks keep their state under the task lock, so checking
+ * and going to sleep can't miss a wakeup
+ */
+
+#include "sync.h"
+#include "task.h"
+
+static LOCK_STATS *volatile g_lockstat_head = NULL;
+
+/**
+ * make stats show up in lockstat
+ */
+void lockstat_register(LOCK_STATS *stats) {
+    LOCK_STATS *head;
+
+    // whoever flips listed first links it, without taking a lock
+    if (!__sync_bool_compare_and_swap(&stats->listed, 0, 1))
+        return;
+    do {
+        head = g_lockstat_head;
+        stats->next = head;
+    } while (!__sync_bool_compare_and_swap(&g_lockstat_head, head, stats));
+}
+
+/**
+ * first lock that was taken so far, follow ->next for the others
+ */
+LOCK_STATS *lockstat_list(void) {
+    return g_lockstat_head;
+}
+
+/**
+ * zero the counters of every listed lock
+ */
+void lockstat_reset(void) {
+    LOCK_STATS *stats;
+
+    for (stats = g_lockstat_head; stats; stats = stats->next) {
+        stats->acquired = 0;
+        stats->contended = 0;
+        stats->spins = 0;
+    }
+}
+
+void rwlock_init(RWLOCK *lock, const char *name) {
+    lock->state = 0;
+    lock->writers = 0;
+    lock->stats = (LOCK_STATS)LOCK_STATS_INIT(name);
+}
+
+void read_lock(RWLOCK *lock) {
+    uint32 spins = 0;
+    sint32 state;
+
+    for (;;) {
+        state = lock->state;
+        if (state >= 0 && !lock->writers
+                && __sync_bool_compare_and_swap(&lock->state, state, state + 1))
+            break;
+        asm volatile("pause");
+        spins++;
+    }
+    // readers share the lock, so the counters need atomic updates
+    __sync_fetch_and_add(&lock->stats.acquired, 1);
+    if (spins) {
+        __sync_fetch_and_add(&lock->stats.contended, 1);
+        __sync_fetch_and_add(&lock->stats.spins, spins);
+    }
+    if (!lock->stats.listed)
+        lockstat_register(&lock->stats);
+}
+
+void read_unlock(RWLOCK *lock) {
+    __sync_fetch_and_sub(&lock->state, 1);
+}
+
+void write_lock(RWLOCK *lock) {
+    uint32 spins = 0;
+
+    __sync_fetch_and_add(&lock->writers, 1);
+    while (!__sync_bool_compare_and_swap(&lock->state, 0, -1)) {
+        asm volatile("pause");
+        spins++;
+    }
+    __sync_fetch_and_sub(&lock->writers, 1);
+    lockstat_acquired(&lock->stats, spins);
+}
+
+void write_unlock(RWLOCK *lock) {
+    __sync_lock_release(&lock->state);
+}
+
+void mutex_init(MUTEX *mutex, const char *name) {
+    mutex->owner = NULL;
+    waitq_init(&mutex->waiters);
+    mutex->stats = (LOCK_STATS)LOCK_STATS_INIT(name);
+}
+
+/**
+ * take mutex, sleeping while another task holds it
+ */
+void mutex_lock(MUTEX *mutex) {
+    uint32 flags = task_lock();
+    uint32 sleeps = 0;
+
+    while (mutex->owner) {
+        waitq_sleep(&mutex->waiters);
+        sleeps++;
+    }
+    mutex->owner = task_current();
+    lockstat_acquired(&mutex->stats, sleeps);
+    task_unlock(flags);
+}
+
+/**
+ * take mutex if it is free, FALSE otherwise
+ */
+BOOL mutex_trylock(MUTEX *mutex) {
+    uint32 flags = task_lock();
+    BOOL taken = mutex->owner == NULL;
+
+    if (taken) {
+        mutex->owner = task_current();
+        lockstat_acquired(&mutex->stats, 0);
+    }
+    task_unlock(flags);
+    return taken;
+}
+
+void mutex_unlock(MUTEX *mutex) {
+    uint32 flags = task_lock();
+
+    mutex->owner = NULL;
+    waitq_wake_one(&mutex->waiters);
+    task_unlock(flags);
+}
+
+void sem_init(SEMAPHORE *sem, const char *name, sint32 count) {
+    sem->count = count;
+    waitq_init(&sem->waiters);
+    sem->stats = (LOCK_STATS)LOCK_STATS_INIT(name);
+}
+
+/**
+ * take one unit, sleeping while there is none
+ */
+void sem_down(SEMAPHORE *sem) {
+    uint32 flags = task_lock();
+    uint32 sleeps = 0;
+
+    while (sem->count <= 0) {
+        waitq_sleep(&sem->waiters);
+        sleeps++;
+    }
+    sem->count--;
+    lockstat_acquired(&sem->stats, sleeps);
+    task_unlock(flags);
+}
+
+/**
+ * take one unit if there is one, FALSE otherwise
+ */
+BOOL sem_trydown(SEMAPHORE *sem) {
+    uint32 flags = task_lock();
+    BOOL taken = sem->count > 0;
+
+    if (taken) {
+        sem->count--;
+        lockstat_acquired(&sem->stats, 0);
+    }
+    task_unlock(flags);
+    return taken;
+}
+
+/**
+ * give back one unit and wake a sleeper
+ */
+void sem_up(SEMAPHORE *sem) {
+    uint32 flags = task_lock();
+
+    sem->count++;
+    waitq_wake_one(&sem->waiters);
+    task_unlock(flags);
+}
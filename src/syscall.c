@@ -0,0 +1,282 @@
+/**
+ * System calls from ring 3
+ * int 0x80 works everywhere, sysenter/sysexit is set up
+ * as the faster path when the cpu has it
+ */
+
+#include "syscall.h"
+#include "task.h"
+#include "gdt.h"
+#include "idt.h"
+#include "cpu.h"
+#include "isr.h"
+#include "console.h"
+#include "keyboard.h"
+#include "filesystem.h"
+#include "vm.h"
+#include "smp.h"
+#include "timer.h"
+
+typedef uint32 (*SYSCALL)(uint32 arg1, uint32 arg2, uint32 arg3);
+
+static BOOL g_sysenter = FALSE;
+
+// buffers must lie in user space, the page fault handler deals with the rest
+static BOOL syscall_check_user(uint32 ptr, uint32 size) {
+    return ptr >= USER_BASE && ptr + size >= ptr && ptr + size <= USER_TOP;
+}
+
+// copy a NUL terminated string from user space, FALSE if it doesn't fit
+static BOOL syscall_copy_string(char *dest, uint32 src, uint32 size) {
+    uint32 i;
+
+    for (i = 0; i < size; i++) {
+        if (!syscall_check_user(src + i, 1))
+            return FALSE;
+        dest[i] = ((const char *)src)[i];
+        if (dest[i] == '\0')
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static TASK_FILE *syscall_get_file(uint32 fd) {
+    TASK *task = task_current();
+
+    if (fd >= TASK_MAX_FILES || !task->files[fd].used)
+        return NULL;
+    return &task->files[fd];
+}
+
+static uint32 sys_exit(uint32 code, uint32 arg2, uint32 arg3) {
+    (void)arg2; (void)arg3;
+    task_exit((int)code);
+    return 0;
+}
+
+// console input: echo like the shell does and return after a newline
+static uint32 console_read(char *buffer, uint32 size) {
+    uint32 count = 0;
+
+    while (count < size) {
+        char ch = kb_getchar();
+
+        if (ch == '\b') {
+            if (count > 0) {
+                count--;
+                console_ungetchar();
+            }
+            continue;
+        }
+        buffer[count++] = ch;
+        console_putchar(ch);
+        if (ch == '\n')
+            break;
+    }
+    return count;
+}
+
+static uint32 sys_read(uint32 fd, uint32 buffer, uint32 size) {
+    TASK_FILE *file = syscall_get_file(fd);
+    int read;
+
+    if (!file || !syscall_check_user(buffer, size))
+        return (uint32)-1;
+    if ((file->flags & O_ACCMODE) == O_WRONLY)
+        return (uint32)-1;
+    if (!file->node)
+        return console_read((char *)buffer, size);
+
+    read = fs_read(file->node, file->offset, (void *)buffer, size);
+    if (read > 0)
+        file->offset += read;
+    return (uint32)read;
+}
+
+static uint32 sys_write(uint32 fd, uint32 buffer, uint32 size) {
+    TASK_FILE *file = syscall_get_file(fd);
+    const char *src = (const char *)buffer;
+    int written;
+    uint32 i;
+
+    if (!file || !syscall_check_user(buffer, size))
+        return (uint32)-1;
+    if (!file->node) {
+        for (i = 0; i < size; i++)
+            console_putchar(src[i]);
+        return size;
+    }
+    if ((file->flags & O_ACCMODE) == O_RDONLY)
+        return (uint32)-1;
+
+    if (file->flags & O_APPEND)
+        file->offset = file->node->size;
+    written = fs_write_at(file->node, file->offset, src, size);
+    if (written > 0)
+        file->offset += written;
+    return (uint32)written;
+}
+
+static uint32 sys_open(uint32 path, uint32 flags, uint32 arg3) {
+    TASK *task = task_current();
+    char name[MAX_PATH];
+    FileNode *node;
+    uint32 fd;
+
+    (void)arg3;
+    if (!syscall_copy_string(name, path, sizeof(name)))
+        return (uint32)-1;
+
+    node = (flags & O_CREAT) ? fs_create_file(name) : fs_path_to_node(name);
+    if (!node || node->is_directory)
+        return (uint32)-1;
+    if (flags & O_TRUNC)
+        fs_write(node, "", 0, FALSE);
+
+    for (fd = 0; fd < TASK_MAX_FILES; fd++) {
+        if (!task->files[fd].used) {
+            task->files[fd].used = TRUE;
+            task->files[fd].node = node;
+            task->files[fd].offset = 0;
+            task->files[fd].flags = flags;
+            return fd;
+        }
+    }
+    return (uint32)-1;
+}
+
+static uint32 sys_close(uint32 fd, uint32 arg2, uint32 arg3) {
+    TASK_FILE *file = syscall_get_file(fd);
+
+    (void)arg2; (void)arg3;
+    if (!file)
+        return (uint32)-1;
+    file->used = FALSE;
+    file->node = NULL;
+    return 0;
+}
+
+// move the user program break, returns the old break
+static uint32 sys_sbrk(uint32 increment, uint32 arg2, uint32 arg3) {
+    TASK *task = task_current();
+
+    (void)arg2; (void)arg3;
+    if (!task->as)
+        return (uint32)-1;
+    return vm_sbrk(task->as, (sint32)increment);
+}
+
+static uint32 sys_yield(uint32 arg1, uint32 arg2, uint32 arg3) {
+    (void)arg1; (void)arg2; (void)arg3;
+    task_yield();
+    return 0;
+}
+
+// child gets 0, the parent the child's id
+static uint32 sys_fork(uint32 arg1, uint32 arg2, uint32 arg3) {
+    TASK *child;
+
+    (void)arg1; (void)arg2; (void)arg3;
+    child = task_fork(task_current()->syscall_regs);
+    return child ? child->id : (uint32)-1;
+}
+
+// wait for child id to exit and return its exit code
+static uint32 sys_wait(uint32 id, uint32 arg2, uint32 arg3) {
+    TASK *child = task_find_child(id);
+
+    (void)arg2; (void)arg3;
+    if (!child)
+        return (uint32)-1;
+    return (uint32)task_wait(child);
+}
+
+// give the cpu up for ms milliseconds
+static uint32 sys_sleep(uint32 ms, uint32 arg2, uint32 arg3) {
+    (void)arg2; (void)arg3;
+    timer_sleep(ms);
+    return 0;
+}
+
+static SYSCALL g_syscalls[NO_SYSCALLS] = {
+    sys_exit,
+    sys_read,
+    sys_write,
+    sys_open,
+    sys_close,
+    sys_sbrk,
+    sys_yield,
+    sys_fork,
+    sys_wait,
+    sys_sleep,
+};
+
+/**
+ * run syscall number with up to three arguments, returns value for eax
+ */
+uint32 syscall_dispatch(uint32 number, uint32 arg1, uint32 arg2, uint32 arg3) {
+    if (number >= NO_SYSCALLS)
+        return (uint32)-1;
+    return g_syscalls[number](arg1, arg2, arg3);
+}
+
+/**
+ * C side of both entry stubs in syscall.asm
+ */
+void syscall_handler(REGISTERS *reg) {
+    task_current()->syscall_regs = reg;
+    reg->eax = syscall_dispatch(reg->eax, reg->ebx, reg->ecx, reg->edx);
+}
+
+// sysenter exists from family 6 model 3 on, earlier parts report it wrongly
+static BOOL syscall_has_sysenter(void) {
+    uint32 eax, ebx, ecx, edx;
+    uint32 family, model, stepping;
+
+    cpu_cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_FEAT_EDX_SEP))
+        return FALSE;
+
+    family = (eax >> 8) & 0xF;
+    model = (eax >> 4) & 0xF;
+    stepping = eax & 0xF;
+    return !(family == 6 && model < 3 && stepping < 3);
+}
+
+/**
+ * install the int 0x80 gate and, when supported, the sysenter MSRs
+ */
+void syscall_init(void) {
+    // trap gate callable from ring 3, interrupts stay on during syscalls
+    idt_set_entry(SYSCALL_VECTOR, (uint32)syscall_int80, KERNEL_CODE_SELECTOR, 0xEF);
+
+    g_sysenter = syscall_has_sysenter();
+    syscall_init_cpu();
+}
+
+/**
+ * program the sysenter MSRs, which every cpu has its own copy of
+ */
+void syscall_init_cpu(void) {
+    if (g_sysenter) {
+        // user cs/ss are derived from this selector: +16 / +24 with rpl 3
+        cpu_wrmsr(MSR_SYSENTER_CS, KERNEL_CODE_SELECTOR, 0);
+        cpu_wrmsr(MSR_SYSENTER_EIP, (uint32)syscall_sysenter, 0);
+    }
+}
+
+/**
+ * kernel stack to enter on from ring 3 on this cpu, updated on every task switch
+ */
+void syscall_set_kernel_stack(uint32 esp0) {
+    tss_set_kernel_stack(smp_cpu_index(), esp0);
+    if (g_sysenter)
+        cpu_wrmsr(MSR_SYSENTER_ESP, esp0, 0);
+}
+
+/**
+ * USER_FLAG_* describing the syscall paths available
+ */
+uint32 syscall_user_flags(void) {
+    return g_sysenter ? USER_FLAG_SYSENTER : 0;
+}
@@ -0,0 +1,539 @@
+/**
+ * Kernel tasks and the per-cpu round robin schedulers
+ * tasks switch cooperatively, on yield or when they block on a wait queue.
+ * every cpu has its own run queue and idle task, a task stays on the cpu
+ * it was placed on when it was created
+ */
+
+#include "task.h"
+#include "syscall.h"
+#include "string.h"
+#include "utils.h"
+#include "isr.h"
+#include "elf.h"
+#include "spinlock.h"
+#include "trace.h"
+#include "fpu.h"
+#include "cpufeat.h"
+
+static TASK g_boot_task;
+static uint32 g_next_id = 0;
+static uint32 g_next_cpu = 0;
+// exited tasks whose parent is gone, freed by the next task_create or task_wait
+static TASK *g_orphans = NULL;
+// idle cpus wait with monitor/mwait instead of hlt
+static BOOL g_idle_mwait = FALSE;
+
+// owned by a cpu rather than a task: it stays held across task_switch()
+// and the task switched to releases it
+static SPINLOCK g_task_lock = SPINLOCK_INIT("task");
+static volatile sint32 g_task_lock_owner = -1;
+static uint32 g_task_lock_depth = 0;
+
+/**
+ * take the scheduler lock, nests on the same cpu.
+ * returns the eflags for task_unlock()
+ */
+uint32 task_lock(void) {
+    uint32 flags = irq_save();
+    sint32 cpu = (sint32)smp_cpu_index();
+
+    if (g_task_lock_owner != cpu) {
+        spin_lock(&g_task_lock);
+        g_task_lock_owner = cpu;
+    }
+    g_task_lock_depth++;
+    return flags;
+}
+
+void task_unlock(uint32 flags) {
+    if (--g_task_lock_depth == 0) {
+        g_task_lock_owner = -1;
+        spin_unlock(&g_task_lock);
+    }
+    irq_restore(flags);
+}
+
+static void task_enqueue(CPU *cpu, TASK *task) {
+    task->next = NULL;
+    if (cpu->ready_tail)
+        cpu->ready_tail->next = task;
+    else
+        cpu->ready_head = task;
+    cpu->ready_tail = task;
+    cpu->ready_count++;
+}
+
+static TASK *task_dequeue(CPU *cpu) {
+    TASK *task = cpu->ready_head;
+
+    if (task) {
+        cpu->ready_head = task->next;
+        if (!cpu->ready_head)
+            cpu->ready_tail = NULL;
+        cpu->ready_count--;
+        task->next = NULL;
+    }
+    return task;
+}
+
+static uint32 task_kernel_stack_top(TASK *task) {
+    return (uint32)task->kernel_stack + TASK_KERNEL_STACK_SIZE;
+}
+
+/**
+ * pick the next ready task of this cpu and switch to it, the task lock
+ * must be held. a running task goes back to the end of the queue,
+ * with nothing ready the cpu's idle task runs
+ */
+static void schedule(void) {
+    CPU *cpu = smp_current();
+    TASK *prev = cpu->current;
+    TASK *next;
+
+    if (prev->state == TASK_RUNNING && prev != cpu->idle) {
+        prev->state = TASK_READY;
+        task_enqueue(cpu, prev);
+    }
+
+    next = task_dequeue(cpu);
+    if (!next)
+        next = cpu->idle;
+
+    next->state = TASK_RUNNING;
+    if (next == prev)
+        return;
+
+    cpu->current = next;
+    cpu->switches++;
+    paging_switch(next->as ? next->as->directory : paging_kernel_directory());
+    if (next->kernel_stack)
+        syscall_set_kernel_stack(task_kernel_stack_top(next));
+
+    fpu_switch(next);
+    TRACE(TRACE_SWITCH, prev->id, next->id);
+    prev->lock_depth = g_task_lock_depth;
+    task_switch(&prev->esp, next->esp);
+    g_task_lock_depth = prev->lock_depth;
+}
+
+// a new task inherits the task lock from the schedule() that switched to it
+static void task_first_run(void) {
+    g_task_lock_depth = 1;
+    task_unlock(EFLAGS_IF);
+}
+
+// first code a new task runs, task_switch() returns here
+static void task_start(void) {
+    TASK *task;
+
+    task_first_run();
+    task = task_current();
+    task->entry(task->arg);
+    task_exit(0);
+}
+
+// a forked child's first switch lands here, then in syscall_return
+static void task_fork_start(void) {
+    task_first_run();
+}
+
+static void task_init_files(TASK *task) {
+    int i;
+
+    memset(task->files, 0, sizeof(task->files));
+    // stdin, stdout and stderr are the console
+    for (i = 0; i < 3; i++)
+        task->files[i].used = TRUE;
+}
+
+// free a zombie and everything it owns
+static void task_free(TASK *task) {
+    if (task->as)
+        vm_destroy(task->as);
+    free(task->kernel_stack);
+    free(task->fpu_state);
+    free(task);
+}
+
+static void task_reap_orphans(void) {
+    uint32 flags = task_lock();
+    TASK *orphans = g_orphans;
+
+    g_orphans = NULL;
+    task_unlock(flags);
+
+    while (orphans) {
+        TASK *next = orphans->next;
+
+        task_free(orphans);
+        orphans = next;
+    }
+}
+
+// new task with a kernel stack, not yet runnable
+static TASK *task_alloc(const char *name) {
+    TASK *task;
+
+    task_reap_orphans();
+    task = (TASK *)malloc(sizeof(TASK));
+    if (!task)
+        return NULL;
+    memset(task, 0, sizeof(TASK));
+
+    task->kernel_stack = (uint8 *)malloc(TASK_KERNEL_STACK_SIZE);
+    if (!task->kernel_stack) {
+        free(task);
+        return NULL;
+    }
+
+    strncpy(task->name, name, TASK_NAME_LEN - 1);
+    task->name[TASK_NAME_LEN - 1] = '\0';
+    waitq_init(&task->exit_waiters);
+    task_init_files(task);
+
+    uint32 flags = task_lock();
+    task->id = g_next_id++;
+    task_unlock(flags);
+    return task;
+}
+
+// kernel thread running entry(arg), not yet runnable
+static TASK *task_spawn(const char *name, TASK_ENTRY entry, void *arg) {
+    TASK *task = task_alloc(name);
+    uint32 *stack;
+
+    if (!task)
+        return NULL;
+    task->entry = entry;
+    task->arg = arg;
+
+    // frame popped by task_switch(): edi, esi, ebx, ebp, then return address
+    stack = (uint32 *)task_kernel_stack_top(task);
+    *--stack = 0;                   // task_start() never returns
+    *--stack = (uint32)task_start;
+    *--stack = 0;                   // ebp
+    *--stack = 0;                   // ebx
+    *--stack = 0;                   // esi
+    *--stack = 0;                   // edi
+    task->esp = (uint32)stack;
+    return task;
+}
+
+// make task a child of the current one and queue it on cpu, NULL for the next one in turn
+static void task_make_ready(TASK *task, CPU *cpu) {
+    uint32 flags = task_lock();
+    TASK *parent = task_current();
+
+    if (!cpu)
+        cpu = smp_cpu(g_next_cpu++ % smp_cpu_count());
+
+    task->parent = parent;
+    task->sibling = parent->children;
+    parent->children = task;
+
+    task->cpu = cpu;
+    task->state = TASK_READY;
+    task_enqueue(cpu, task);
+    smp_kick(cpu);
+    task_unlock(flags);
+}
+
+/**
+ * adopt the boot context as the first task of the boot cpu
+ */
+void task_init(void) {
+    CPU *cpu = smp_current();
+
+    g_idle_mwait = cpu_has(CPU_FEAT_MONITOR);
+
+    memset(&g_boot_task, 0, sizeof(g_boot_task));
+    g_boot_task.id = g_next_id++;
+    strcpy(g_boot_task.name, "kernel");
+    g_boot_task.state = TASK_RUNNING;
+    g_boot_task.cpu = cpu;
+    waitq_init(&g_boot_task.exit_waiters);
+    task_init_files(&g_boot_task);
+    cpu->current = &g_boot_task;
+
+    cpu->idle = task_spawn("idle0", (TASK_ENTRY)task_idle, NULL);
+    cpu->idle->cpu = cpu;
+}
+
+/**
+ * adopt the startup context of an application processor as its idle task
+ */
+void task_init_cpu(CPU *cpu) {
+    TASK *idle = (TASK *)malloc(sizeof(TASK));
+
+    memset(idle, 0, sizeof(TASK));
+    strcpy(idle->name, "idle0");
+    idle->name[4] += cpu->index;
+    idle->kernel_stack = cpu->boot_stack;
+    idle->state = TASK_RUNNING;
+    idle->cpu = cpu;
+    waitq_init(&idle->exit_waiters);
+
+    uint32 flags = task_lock();
+    idle->id = g_next_id++;
+    cpu->idle = idle;
+    cpu->current = idle;
+    task_unlock(flags);
+}
+
+// wait for an interrupt, called with interrupts off. mwait also returns
+// on a store to the monitored run queue, the kick IPI comes all the same
+static void task_halt(CPU *cpu) {
+    if (!g_idle_mwait) {
+        // sti only takes effect after hlt, so a wakeup IPI can't be missed in between
+        asm volatile("sti\n\thlt" ::: "memory");
+        return;
+    }
+    asm volatile("monitor" :: "a"(&cpu->ready_head), "c"(0), "d"(0));
+    if (cpu->ready_head)
+        return;
+    // the same holds for mwait, eax 0 asks for C1
+    asm volatile("sti\n\tmwait" :: "a"(0), "c"(0) : "memory");
+}
+
+/**
+ * idle loop of a cpu: run whatever gets queued, halt until an interrupt otherwise
+ */
+void task_idle(void) {
+    CPU *cpu;
+
+    for (;;) {
+        task_lock();
+        cpu = smp_current();
+        while (cpu->ready_head)
+            schedule();
+        task_unlock(0);
+        task_halt(cpu);
+    }
+}
+
+/**
+ * currently running task, NULL before task_init()
+ */
+TASK *task_current(void) {
+    uint32 flags = irq_save();
+    TASK *task = smp_current()->current;
+
+    irq_restore(flags);
+    return task;
+}
+
+/**
+ * create a kernel thread running entry(arg), it starts out ready
+ */
+TASK *task_create_kernel(const char *name, TASK_ENTRY entry, void *arg) {
+    return task_create_kernel_on(NULL, name, entry, arg);
+}
+
+/**
+ * same as task_create_kernel(), on the given cpu instead of the next one in turn
+ */
+TASK *task_create_kernel_on(CPU *cpu, const char *name, TASK_ENTRY entry, void *arg) {
+    TASK *task = task_spawn(name, entry, arg);
+
+    if (task)
+        task_make_ready(task, cpu);
+    return task;
+}
+
+// kernel side of a user task: build its stack and drop to ring 3
+static void task_user_start(void *arg) {
+    uint32 *stack = (uint32 *)USER_TOP;
+
+    (void)arg;
+    // the first push faults the top stack page in
+    *--stack = syscall_user_flags();    // argument of the entry point
+    *--stack = 0;                       // entry must exit(), never return
+    enter_usermode(task_current()->user_entry, (uint32)stack);
+}
+
+/**
+ * create a task that runs ELF executable program in ring 3
+ */
+TASK *task_create_user(const char *name, FileNode *program) {
+    ADDRESS_SPACE *as = vm_create();
+    uint32 entry, image_end;
+    TASK *task;
+
+    if (!as)
+        return NULL;
+    if (!elf_load(as, program, &entry, &image_end)
+            || !vm_set_break(as, image_end)
+            || !vm_add_region(as, VM_STACK_BOTTOM, USER_TOP, VMA_READ | VMA_WRITE, NULL, 0, 0)) {
+        vm_destroy(as);
+        return NULL;
+    }
+
+    task = task_spawn(name, task_user_start, NULL);
+    if (!task) {
+        vm_destroy(as);
+        return NULL;
+    }
+    task->user_entry = entry;
+    task->as = as;
+    // a program prints where the command that started it does
+    task->console_sink = task_current()->console_sink;
+    task_make_ready(task, NULL);
+    return task;
+}
+
+/**
+ * duplicate the current user task, the child returns from the
+ * syscall in reg with 0 and shares memory copy on write
+ */
+TASK *task_fork(REGISTERS *reg) {
+    TASK *parent = task_current();
+    ADDRESS_SPACE *as;
+    REGISTERS *frame;
+    TASK *task;
+    uint32 *stack;
+
+    if (!parent->as)
+        return NULL;
+    as = vm_clone(parent->as);
+    if (!as)
+        return NULL;
+    task = task_alloc(parent->name);
+    if (!task) {
+        vm_destroy(as);
+        return NULL;
+    }
+    task->as = as;
+    if (!fpu_fork(parent, task)) {
+        task_free(task);
+        return NULL;
+    }
+    task->user_entry = parent->user_entry;
+    memcpy(task->files, parent->files, sizeof(task->files));
+    task->console_sink = parent->console_sink;
+
+    // the child releases the task lock, then pops a copy of the frame in syscall_return
+    frame = (REGISTERS *)(task_kernel_stack_top(task) - sizeof(REGISTERS));
+    *frame = *reg;
+    frame->eax = 0;
+    stack = (uint32 *)frame;
+    *--stack = (uint32)syscall_return;
+    *--stack = (uint32)task_fork_start;
+    *--stack = 0;                   // ebp
+    *--stack = 0;                   // ebx
+    *--stack = 0;                   // esi
+    *--stack = 0;                   // edi
+    task->esp = (uint32)stack;
+    task_make_ready(task, NULL);
+    return task;
+}
+
+/**
+ * child of the current task with the given id, NULL if there is none
+ */
+TASK *task_find_child(uint32 id) {
+    uint32 flags = task_lock();
+    TASK *child;
+
+    for (child = task_current()->children; child; child = child->sibling) {
+        if (child->id == id)
+            break;
+    }
+    task_unlock(flags);
+    return child;
+}
+
+/**
+ * give the cpu to the next ready task
+ */
+void task_yield(void) {
+    uint32 flags = task_lock();
+    schedule();
+    task_unlock(flags);
+}
+
+/**
+ * stop running until task_wakeup(), call with the task lock held
+ */
+void task_block(void) {
+    task_current()->state = TASK_BLOCKED;
+    schedule();
+}
+
+/**
+ * make a blocked task ready again on its cpu, safe from interrupt handlers
+ */
+void task_wakeup(TASK *task) {
+    uint32 flags = task_lock();
+
+    if (task->state == TASK_BLOCKED) {
+        task->state = TASK_READY;
+        task_enqueue(task->cpu, task);
+        smp_kick(task->cpu);
+    }
+    task_unlock(flags);
+}
+
+/**
+ * terminate the current task
+ */
+void task_exit(int code) {
+    TASK *self, *child, *next;
+
+    task_lock();
+    self = task_current();
+
+    // nobody will wait for the children anymore
+    for (child = self->children; child; child = next) {
+        next = child->sibling;
+        child->parent = NULL;
+        child->sibling = NULL;
+        if (child->state == TASK_ZOMBIE) {
+            child->next = g_orphans;
+            g_orphans = child;
+        }
+    }
+    self->children = NULL;
+
+    self->exit_code = code;
+    self->state = TASK_ZOMBIE;
+    fpu_exit(self);
+    if (self->parent) {
+        waitq_wake_all(&self->exit_waiters);
+    } else {
+        self->next = g_orphans;
+        g_orphans = self;
+    }
+    // the stack stays in use until the next task drops the task lock,
+    // which is what keeps task_wait() from freeing it early
+    schedule();
+
+    // a zombie is never scheduled again
+    for (;;)
+        ;
+}
+
+/**
+ * sleep until task exits, free it and return its exit code
+ */
+int task_wait(TASK *task) {
+    TASK **link;
+    uint32 flags;
+    int code;
+
+    waitq_wait_event(&task->exit_waiters, task->state == TASK_ZOMBIE);
+
+    flags = task_lock();
+    code = task->exit_code;
+    for (link = &task->parent->children; *link; link = &(*link)->sibling) {
+        if (*link == task) {
+            *link = task->sibling;
+            break;
+        }
+    }
+    task_unlock(flags);
+
+    task_free(task);
+    task_reap_orphans();
+    return code;
+}
@@ -0,0 +1,273 @@
+/**
+ * Kernel timer
+ * the local APIC timer runs at an unknown bus clock, so it is measured
+ * against the system clock first. every cpu keeps its hrtimers sorted by
+ * expiry and programs a one-shot for the first one after each interrupt;
+ * an idle cpu with no timers gets none at all. other cpus are sent the
+ * timer vector as an IPI to reprogram theirs
+ */
+
+#include "timer.h"
+#include "clock.h"
+#include "lapic.h"
+#include "ioapic.h"
+#include "smp.h"
+#include "io_ports.h"
+#include "console.h"
+#include "cpu.h"
+#include "task.h"
+
+#define TIMER_NS_PER_TICK       (NSEC_PER_SEC / TIMER_HZ)
+#define TIMER_CALIBRATE_NS      (10 * NSEC_PER_MSEC)
+
+static ISR g_tick_hooks[TIMER_TICK_HOOKS];
+static uint32 g_tick_hook_count = 0;
+static volatile sint32 g_tick_users = 0;
+static BOOL g_periodic[CPU_MAX];
+// sorted by expiry, only touched by their own cpu with interrupts off
+static HRTIMER *g_hrtimers[CPU_MAX];
+static uint32 g_lapic_count = 0;
+static BOOL g_running = FALSE;
+
+// local APIC timer counts during TIMER_CALIBRATE_NS of the system clock
+static uint32 timer_calibrate(void) {
+    uint64 start, elapsed;
+    uint32 counts;
+
+    if (!lapic_present())
+        return 0;
+    lapic_timer_start(LAPIC_TIMER_VECTOR, 0xFFFFFFFF, FALSE);
+    start = clock_ns();
+    while (clock_ns() - start < TIMER_CALIBRATE_NS)
+        ;
+    counts = 0xFFFFFFFF - lapic_timer_current();
+    elapsed = clock_ns() - start;
+    lapic_timer_stop();
+
+    return (uint32)cpu_div64((uint64)counts * TIMER_NS_PER_TICK, (uint32)elapsed, NULL);
+}
+
+// arm the local APIC timer of cpu, the calling one, interrupts are off
+static void timer_program(uint32 cpu) {
+    HRTIMER *first = g_hrtimers[cpu];
+    uint64 now, left;
+
+    if (!lapic_present() || !g_lapic_count)
+        return;
+    if (g_tick_users > 0) {
+        if (!g_periodic[cpu])
+            lapic_timer_start(LAPIC_TIMER_VECTOR, g_lapic_count, TRUE);
+        g_periodic[cpu] = TRUE;
+        return;
+    }
+    g_periodic[cpu] = FALSE;
+    if (!first) {
+        lapic_timer_stop();
+        return;
+    }
+
+    // a second at most, later timers get another one-shot then
+    now = clock_ns();
+    left = first->expires > now ? first->expires - now : 0;
+    if (left > NSEC_PER_SEC)
+        left = NSEC_PER_SEC;
+    lapic_timer_start(LAPIC_TIMER_VECTOR,
+                      (uint32)cpu_div64(left * g_lapic_count, TIMER_NS_PER_TICK, NULL) + 1, FALSE);
+}
+
+static void timer_tick(REGISTERS *reg) {
+    uint32 cpu = smp_cpu_index();
+    uint64 now = clock_ns();
+    HRTIMER *timer;
+    uint32 i;
+
+    while ((timer = g_hrtimers[cpu]) != NULL && timer->expires <= now) {
+        g_hrtimers[cpu] = timer->next;
+        timer->queued = FALSE;
+        // may start it again, or free it
+        timer->fn(timer);
+    }
+    for (i = 0; i < g_tick_hook_count; i++)
+        g_tick_hooks[i](reg);
+    timer_program(cpu);
+}
+
+/**
+ * calibrate and arm the timer on every cpu online, after clock_init()
+ */
+void timer_init(void) {
+    uint32 divisor = PIT_FREQUENCY / TIMER_HZ;
+    uint32 flags, i;
+
+    g_lapic_count = timer_calibrate();
+    g_running = TRUE;
+    if (!lapic_present()) {
+        isr_register_interrupt_handler(IRQ_BASE + IRQ0_TIMER, timer_tick);
+        outportb(PIT_COMMAND, PIT_SELECT_CHANNEL0 | PIT_ACCESS_LOHI | PIT_MODE_RATE);
+        outportb(PIT_CHANNEL0, divisor & 0xFF);
+        outportb(PIT_CHANNEL0, divisor >> 8);
+        announce("Timer: PIT at %d Hz\n", TIMER_HZ);
+        return;
+    }
+
+    // channel 0 keeps its BIOS rate, nobody needs its irq any more
+    ioapic_mask(IRQ0_TIMER, TRUE);
+    isr_register_interrupt_handler(LAPIC_TIMER_VECTOR, timer_tick);
+
+    // timers may have been queued before, like the clock's refresh
+    flags = irq_save();
+    timer_program(smp_cpu_index());
+    irq_restore(flags);
+    for (i = 1; i < smp_cpu_count(); i++)
+        lapic_send_ipi(smp_cpu(i)->apic_id, LAPIC_TIMER_VECTOR);
+    announce("Timer: local APIC one-shot, %d counts per %d Hz tick\n", g_lapic_count, TIMER_HZ);
+}
+
+/**
+ * call hook from every timer interrupt on every cpu, in interrupt context.
+ * they come every tick only while timer_keep_tick() holds it
+ */
+BOOL timer_register_tick(ISR hook) {
+    if (g_tick_hook_count == TIMER_TICK_HOOKS)
+        return FALSE;
+    g_tick_hooks[g_tick_hook_count] = hook;
+    // the handler may read the count at any time, so the slot goes first
+    asm volatile("" ::: "memory");
+    g_tick_hook_count++;
+    return TRUE;
+}
+
+/**
+ * run the periodic tick on every cpu while keep calls outnumber the others
+ */
+void timer_keep_tick(BOOL keep) {
+    uint32 flags, self, i;
+
+    if (keep)
+        __sync_fetch_and_add(&g_tick_users, 1);
+    else
+        __sync_fetch_and_sub(&g_tick_users, 1);
+    if (!lapic_present() || !g_lapic_count)
+        return;
+
+    flags = irq_save();
+    self = smp_cpu_index();
+    timer_program(self);
+    for (i = 0; i < smp_cpu_count(); i++) {
+        if (i != self)
+            lapic_send_ipi(smp_cpu(i)->apic_id, LAPIC_TIMER_VECTOR);
+    }
+    irq_restore(flags);
+}
+
+/**
+ * prepare timer to call fn with data
+ */
+void hrtimer_init(HRTIMER *timer, HRTIMER_FN fn, void *data) {
+    timer->expires = 0;
+    timer->fn = fn;
+    timer->data = data;
+    timer->cpu = 0;
+    timer->queued = FALSE;
+    timer->next = NULL;
+}
+
+/**
+ * fire timer on the calling cpu once clock_ns() reaches expires, moving it
+ * if it is already queued there
+ */
+void hrtimer_start(HRTIMER *timer, uint64 expires) {
+    uint32 flags = irq_save();
+    uint32 cpu = smp_cpu_index();
+    HRTIMER **link;
+
+    if (timer->queued)
+        hrtimer_cancel(timer);
+    timer->expires = expires;
+    timer->cpu = cpu;
+    for (link = &g_hrtimers[cpu]; *link && (*link)->expires <= expires; link = &(*link)->next)
+        ;
+    timer->next = *link;
+    *link = timer;
+    timer->queued = TRUE;
+    // an earlier first timer needs an earlier interrupt
+    if (link == &g_hrtimers[cpu] && g_running)
+        timer_program(cpu);
+    irq_restore(flags);
+}
+
+/**
+ * take timer off its queue, from the cpu that started it.
+ * FALSE if it already fired or was never started
+ */
+BOOL hrtimer_cancel(HRTIMER *timer) {
+    uint32 flags = irq_save();
+    HRTIMER **link;
+    BOOL found = FALSE;
+
+    if (timer->queued && timer->cpu == smp_cpu_index()) {
+        for (link = &g_hrtimers[timer->cpu]; *link; link = &(*link)->next) {
+            if (*link == timer) {
+                *link = timer->next;
+                timer->queued = FALSE;
+                found = TRUE;
+                break;
+            }
+        }
+    }
+    irq_restore(flags);
+    // the interrupt reprograms for the next one, an early wakeup is harmless
+    return found;
+}
+
+static void timer_wake(HRTIMER *timer) {
+    task_wakeup((struct TASK *)timer->data);
+}
+
+/**
+ * put the current task to sleep until clock_ns() reaches expires,
+ * not before timer_init()
+ */
+void timer_sleep_until(uint64 expires) {
+    HRTIMER timer;
+    uint32 flags;
+
+    // nothing would wake it before timer_init()
+    if (!g_running)
+        return;
+    flags = task_lock();
+    hrtimer_init(&timer, timer_wake, task_current());
+    hrtimer_start(&timer, expires);
+    // the timer lives on this stack, it is off the queue once not queued
+    while (timer.queued)
+        task_block();
+    task_unlock(flags);
+}
+
+/**
+ * put the current task to sleep for ms milliseconds, not before timer_init()
+ */
+void timer_sleep(uint32 ms) {
+    timer_sleep_until(clock_ns() + (uint64)ms * NSEC_PER_MSEC);
+}
+
+/**
+ * TIMER_HZ ticks since clock_init(), counted even while the timer is off
+ */
+uint32 timer_ticks(void) {
+    return (uint32)cpu_div64(clock_ns(), TIMER_NS_PER_TICK, NULL);
+}
+
+/**
+ * local APIC timer counts per tick, 0 when the PIT drives the tick
+ */
+uint32 timer_lapic_count(void) {
+    return g_lapic_count;
+}
+
+/**
+ * time stamp counter frequency in kHz, measured by clock_init()
+ */
+uint32 timer_tsc_khz(void) {
+    return (uint32)cpu_div64(clock_tsc_hz(), 1000, NULL);
+}
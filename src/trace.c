@@ -0,0 +1,124 @@
+/**
+ * Trace ring
+ * no locks: a cpu only writes its own ring, with interrupts off while it
+ * fills a record, so a tracepoint in an interrupt handler can't tear it
+ */
+
+#include "trace.h"
+#include "isr.h"
+#include "cpu.h"
+#include "smp.h"
+#include "timer.h"
+#include "serial.h"
+#include "string.h"
+#include "utils.h"
+
+typedef struct {
+    TRACE_RECORD *records;
+    uint32 head;                // records written so far, the ring wraps
+} TRACE_RING;
+
+static const char *g_event_names[TRACE_EVENTS] = {
+    "irq_enter", "irq_exit", "switch", "alloc", "free",
+    "fs_create", "fs_read", "fs_write",
+};
+
+volatile BOOL g_trace_enabled = FALSE;
+static TRACE_RING g_rings[CPU_MAX];
+
+/**
+ * allocate a ring for every cpu online, tracing starts off
+ */
+void trace_init(void) {
+    uint32 cpu;
+
+    for (cpu = 0; cpu < smp_cpu_count(); cpu++)
+        g_rings[cpu].records = (TRACE_RECORD *)malloc(TRACE_RING_SIZE * sizeof(TRACE_RECORD));
+}
+
+/**
+ * append a record to the calling cpu's ring, use TRACE() instead
+ */
+void trace_record(uint32 event, uint32 a, uint32 b) {
+    uint32 flags = irq_save();
+    TRACE_RING *ring = &g_rings[smp_cpu_index()];
+
+    if (ring->records) {
+        TRACE_RECORD *record = &ring->records[ring->head & (TRACE_RING_SIZE - 1)];
+
+        record->tsc = cpu_rdtsc();
+        record->event = event;
+        record->a = a;
+        record->b = b;
+        ring->head++;
+    }
+    irq_restore(flags);
+}
+
+void trace_enable(BOOL enable) {
+    g_trace_enabled = enable;
+}
+
+/**
+ * empty every ring
+ */
+void trace_clear(void) {
+    uint32 cpu;
+
+    for (cpu = 0; cpu < CPU_MAX; cpu++)
+        g_rings[cpu].head = 0;
+}
+
+/**
+ * records in the ring of cpu, at most TRACE_RING_SIZE
+ */
+uint32 trace_count(uint32 cpu) {
+    if (cpu >= CPU_MAX)
+        return 0;
+    return g_rings[cpu].head < TRACE_RING_SIZE ? g_rings[cpu].head : TRACE_RING_SIZE;
+}
+
+static void trace_field(char *line, uint32 value, int base) {
+    char num[16];
+
+    itoa(num, base, value);
+    strcat(line, " ");
+    strcat(line, num);
+}
+
+/**
+ * stop tracing and write every ring to the serial port, oldest first,
+ * as `T <cpu> <tsc high> <tsc low> <event> <a> <b>` lines
+ * that tools/trace2json.awk turns into Chrome trace JSON
+ */
+void trace_dump(void) {
+    char line[96];
+    uint32 cpu, i;
+
+    g_trace_enabled = FALSE;
+    strcpy(line, "trace-begin");
+    trace_field(line, timer_tsc_khz(), 'u');
+    strcat(line, "\n");
+    serial_write(line);
+
+    for (cpu = 0; cpu < smp_cpu_count(); cpu++) {
+        TRACE_RING *ring = &g_rings[cpu];
+        uint32 count = trace_count(cpu);
+
+        for (i = ring->head - count; i != ring->head; i++) {
+            TRACE_RECORD *record = &ring->records[i & (TRACE_RING_SIZE - 1)];
+
+            strcpy(line, "T");
+            trace_field(line, cpu, 'u');
+            trace_field(line, (uint32)(record->tsc >> 32), 'u');
+            trace_field(line, (uint32)record->tsc, 'u');
+            strcat(line, " ");
+            strcat(line, record->event < TRACE_EVENTS ? g_event_names[record->event] : "unknown");
+            trace_field(line, record->a, 'x');
+            trace_field(line, record->b, 'x');
+            strcat(line, "\n");
+            serial_write(line);
+        }
+    }
+    serial_write("trace-end\n");
+}
@@ -0,0 +1,175 @@
+/**
+ * UDP
+ * a datagram waits in its socket in the buffer the NIC received it into,
+ * and udp_recv() hands that very buffer to the reader
+ */
+
+#include "udp.h"
+#include "ip.h"
+#include "string.h"
+
+static UDP_SOCKET g_sockets[UDP_MAX_SOCKETS];
+static SPINLOCK g_udp_lock = SPINLOCK_INIT("udp");
+
+// socket bound to port, g_udp_lock is held
+static UDP_SOCKET *udp_lookup(uint16 port) {
+    uint32 i;
+
+    for (i = 0; i < UDP_MAX_SOCKETS; i++) {
+        if (g_sockets[i].port == port)
+            return &g_sockets[i];
+    }
+    return NULL;
+}
+
+/**
+ * socket bound to port, NULL if the port is taken or no socket is left
+ */
+UDP_SOCKET *udp_open(uint16 port) {
+    UDP_SOCKET *sock = NULL;
+    uint32 flags;
+
+    if (port == 0)
+        return NULL;
+    flags = spin_lock_irqsave(&g_udp_lock);
+    if (!udp_lookup(port)) {
+        sock = udp_lookup(0);
+        if (sock) {
+            spin_init(&sock->lock, "udp socket");
+            sock->queue = NULL;
+            sock->queue_tail = NULL;
+            sock->queued = 0;
+            sock->dropped = 0;
+            waitq_init(&sock->waiters);
+            sock->port = port;
+        }
+    }
+    spin_unlock_irqrestore(&g_udp_lock, flags);
+    return sock;
+}
+
+/**
+ * unbind sock and drop what it still holds, nobody may be waiting in it
+ */
+void udp_close(UDP_SOCKET *sock) {
+    NETBUF *buf;
+    uint32 flags;
+
+    flags = spin_lock_irqsave(&g_udp_lock);
+    sock->port = 0;
+    spin_unlock_irqrestore(&g_udp_lock, flags);
+    while ((buf = sock->queue) != NULL) {
+        sock->queue = buf->next;
+        netbuf_free(buf);
+    }
+    sock->queue_tail = NULL;
+    sock->queued = 0;
+}
+
+/**
+ * sleep until a datagram arrives, and return the buffer it came in with
+ * data at its payload. the caller frees it
+ */
+NETBUF *udp_recv(UDP_SOCKET *sock, IP_ADDR *src, uint16 *src_port) {
+    NETBUF *buf = NULL;
+    IP_HEADER *ip;
+    UDP_HEADER *udp;
+    uint32 header_len;
+    uint32 flags;
+
+    while (!buf) {
+        waitq_wait_event(&sock->waiters, sock->queue != NULL);
+        flags = spin_lock_irqsave(&sock->lock);
+        buf = sock->queue;
+        if (buf) {
+            sock->queue = buf->next;
+            if (!sock->queue)
+                sock->queue_tail = NULL;
+            sock->queued--;
+        }
+        spin_unlock_irqrestore(&sock->lock, flags);
+    }
+
+    ip = (IP_HEADER *)buf->data;
+    header_len = (ip->version_ihl & 0xF) * 4;
+    udp = (UDP_HEADER *)(buf->data + header_len);
+    if (src)
+        *src = ip->src;
+    if (src_port)
+        *src_port = ntohs(udp->src_port);
+    netbuf_pull(buf, header_len + sizeof(UDP_HEADER));
+    buf->next = NULL;
+    return buf;
+}
+
+/**
+ * send len bytes of data from sock's port to port at dst
+ */
+BOOL udp_sendto(UDP_SOCKET *sock, IP_ADDR dst, uint16 port, const void *data, uint32 len) {
+    NETBUF *buf;
+    UDP_HEADER *udp;
+
+    if (len > UDP_MAX_PAYLOAD)
+        return FALSE;
+    buf = netbuf_alloc();
+    if (!buf)
+        return FALSE;
+    memcpy(buf->data, data, len);
+    buf->len = len;
+    udp = (UDP_HEADER *)netbuf_push(buf, sizeof(UDP_HEADER));
+    udp->src_port = htons(sock->port);
+    udp->dst_port = htons(port);
+    udp->len = htons(buf->len);
+    udp->checksum = 0;
+    udp->checksum = udp_checksum(net_config()->addr, dst, udp, buf->len);
+    net_stats()->udp_out++;
+    return ip_send(buf, dst, IP_PROTO_UDP);
+}
+
+/**
+ * a UDP datagram arrived, buf starts at its IP header
+ */
+void udp_receive(NETBUF *buf) {
+    IP_HEADER *ip = (IP_HEADER *)buf->data;
+    uint32 header_len = (ip->version_ihl & 0xF) * 4;
+    UDP_HEADER *udp = (UDP_HEADER *)(buf->data + header_len);
+    UDP_SOCKET *sock;
+    uint32 len, flags;
+
+    net_stats()->udp_in++;
+    if (buf->len < header_len + sizeof(UDP_HEADER))
+        goto drop;
+    len = ntohs(udp->len);
+    if (len < sizeof(UDP_HEADER) || len > buf->len - header_len)
+        goto drop;
+    if (udp->checksum && ip_pseudo_checksum(ip->src, ip->dst, IP_PROTO_UDP, udp, len) != 0)
+        goto drop;
+    buf->len = header_len + len;
+
+    flags = spin_lock_irqsave(&g_udp_lock);
+    sock = udp_lookup(ntohs(udp->dst_port));
+    if (sock) {
+        spin_lock(&sock->lock);
+        if (sock->queued < UDP_QUEUE_MAX) {
+            buf->next = NULL;
+            if (sock->queue_tail)
+                sock->queue_tail->next = buf;
+            else
+                sock->queue = buf;
+            sock->queue_tail = buf;
+            sock->queued++;
+            buf = NULL;
+        } else {
+            sock->dropped++;
+        }
+        spin_unlock(&sock->lock);
+        if (!buf)
+            waitq_wake_all(&sock->waiters);
+    }
+    spin_unlock_irqrestore(&g_udp_lock, flags);
+    if (!buf)
+        return;
+drop:
+    net_stats()->udp_dropped++;
+    netbuf_free(buf);
+}
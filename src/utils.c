@@ -1,10 +1,6 @@
 #include "utils.h"
 #include "types.h"
-
-// Position heap after kernel
-#define HEAP_START 0x400000
-#define HEAP_SIZE  0x400000
-#define HEAP_END   (HEAP_START + HEAP_SIZE)
+#include "spinlock.h"
 
 typedef struct MemBlock {
     uint32 size;
@@ -14,6 +10,8 @@ typedef struct MemBlock {
 
 static MemBlock* heap_start = (MemBlock*)HEAP_START;
 static BOOL initialized = FALSE;
+// one heap for all cpus
+static SPINLOCK g_heap_lock = SPINLOCK_INIT("heap");
 
 void init_heap(void) {
     if (!initialized) {
@@ -24,12 +22,14 @@ void init_heap(void) {
     }
 }
 
-void* malloc(uint32 size) {
+// shared heap below the per-cpu magazines of kmem.c
+void* heap_alloc(uint32 size) {
     if (!initialized) init_heap();
     
     // Align size to 4 bytes
     size = (size + 3) & ~3;
     
+    uint32 flags = spin_lock_irqsave(&g_heap_lock);
     MemBlock* current = heap_start;
     while (current && (uint32)current < HEAP_END) {
         if (!current->used && current->size >= size) {
@@ -43,19 +43,22 @@ void* malloc(uint32 size) {
                 current->next = new_block;
             }
             current->used = TRUE;
+            spin_unlock_irqrestore(&g_heap_lock, flags);
             return (void*)((uint32)current + sizeof(MemBlock));
         }
         current = current->next;
     }
+    spin_unlock_irqrestore(&g_heap_lock, flags);
     return NULL;
 }
 
-void free(void* ptr) {
+void heap_free(void* ptr) {
     if (!ptr || (uint32)ptr < HEAP_START || (uint32)ptr >= HEAP_END) return;
     
     MemBlock* block = (MemBlock*)((uint32)ptr - sizeof(MemBlock));
     if ((uint32)block < HEAP_START || (uint32)block >= HEAP_END) return;
     
+    uint32 flags = spin_lock_irqsave(&g_heap_lock);
     block->used = FALSE;
     
     // Merge with next block if it's free
@@ -65,6 +68,7 @@ void free(void* ptr) {
         block->size += sizeof(MemBlock) + block->next->size;
         block->next = block->next->next;
     }
+    spin_unlock_irqrestore(&g_heap_lock, flags);
 }
 
 int abs(int n) {
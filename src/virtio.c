@@ -0,0 +1,369 @@
+/**
+ * Virtio PCI transport and split virtqueues
+ * a device with virtio 1.0 capabilities is driven through the structures
+ * they point to, anything else through the legacy registers of BAR 0.
+ * every queue sits in one allocation in the legacy layout, which suits both
+ */
+
+#include "virtio.h"
+#include "io_ports.h"
+#include "string.h"
+#include "utils.h"
+
+// the legacy transport wants the used ring page aligned
+static uint32 virtq_used_offset(uint16 size) {
+    uint32 avail_end = size * sizeof(VIRTQ_DESC) + sizeof(VIRTQ_AVAIL) + size * sizeof(uint16) + sizeof(uint16);
+
+    return (avail_end + VIRTIO_LEGACY_QUEUE_ALIGN - 1) & ~(VIRTIO_LEGACY_QUEUE_ALIGN - 1);
+}
+
+static uint32 virtq_memory_size(uint16 size) {
+    return virtq_used_offset(size) + sizeof(VIRTQ_USED) + size * sizeof(VIRTQ_USED_ELEM) + sizeof(uint16);
+}
+
+static uint8 virtio_status(VIRTIO_DEVICE *vdev) {
+    if (vdev->modern)
+        return vdev->common[VIRTIO_COMMON_STATUS];
+    return inportb(vdev->io + VIRTIO_LEGACY_STATUS);
+}
+
+static void virtio_set_status(VIRTIO_DEVICE *vdev, uint8 status) {
+    if (vdev->modern)
+        vdev->common[VIRTIO_COMMON_STATUS] = status;
+    else
+        outportb(vdev->io + VIRTIO_LEGACY_STATUS, status);
+}
+
+static volatile uint16 *virtio_common16(VIRTIO_DEVICE *vdev, uint32 offset) {
+    return (volatile uint16 *)(vdev->common + offset);
+}
+
+static volatile uint32 *virtio_common32(VIRTIO_DEVICE *vdev, uint32 offset) {
+    return (volatile uint32 *)(vdev->common + offset);
+}
+
+// structure a vendor capability points to, NULL if its BAR can't be mapped
+static volatile uint8 *virtio_map_cap(PCI_DEVICE *pci, uint8 cap) {
+    uint8 *base = (uint8 *)pci_map_bar(pci, pci_read8(pci, cap + VIRTIO_PCI_CAP_BAR));
+
+    if (!base)
+        return NULL;
+    return base + pci_read32(pci, cap + VIRTIO_PCI_CAP_OFFSET);
+}
+
+// walk the vendor capabilities for the modern structures
+static BOOL virtio_find_modern(VIRTIO_DEVICE *vdev) {
+    PCI_DEVICE *pci = vdev->pci;
+    uint8 cap = pci_find_capability(pci, PCI_CAP_VENDOR);
+    uint32 hops = 0;
+
+    while (cap && hops++ < 48) {
+        if (pci_read8(pci, cap) == PCI_CAP_VENDOR) {
+            switch (pci_read8(pci, cap + VIRTIO_PCI_CAP_TYPE)) {
+            case VIRTIO_PCI_CAP_COMMON:
+                if (!vdev->common)
+                    vdev->common = virtio_map_cap(pci, cap);
+                break;
+            case VIRTIO_PCI_CAP_NOTIFY:
+                if (!vdev->notify) {
+                    vdev->notify = virtio_map_cap(pci, cap);
+                    vdev->notify_multiplier = pci_read32(pci, cap + VIRTIO_PCI_CAP_MULTIPLIER);
+                }
+                break;
+            case VIRTIO_PCI_CAP_ISR:
+                if (!vdev->isr)
+                    vdev->isr = virtio_map_cap(pci, cap);
+                break;
+            case VIRTIO_PCI_CAP_DEVICE:
+                if (!vdev->config)
+                    vdev->config = virtio_map_cap(pci, cap);
+                break;
+            }
+        }
+        cap = pci_read8(pci, cap + 1) & ~0x3;
+    }
+    return vdev->common && vdev->notify && vdev->isr && vdev->config;
+}
+
+/**
+ * find the transport of pci, reset the device and acknowledge it
+ */
+BOOL virtio_init(VIRTIO_DEVICE *vdev, PCI_DEVICE *pci) {
+    memset(vdev, 0, sizeof(VIRTIO_DEVICE));
+    vdev->pci = pci;
+    vdev->vector = -1;
+    pci_enable(pci, TRUE);
+
+    if (virtio_find_modern(vdev)) {
+        vdev->modern = TRUE;
+    } else if (pci->bars[0].io && pci->bars[0].base) {
+        vdev->io = (uint16)pci->bars[0].base;
+    } else {
+        return FALSE;
+    }
+
+    // a reset reads back as 0 once the device is done with it
+    virtio_set_status(vdev, 0);
+    while (virtio_status(vdev) != 0)
+        asm volatile("pause");
+    virtio_set_status(vdev, VIRTIO_STATUS_ACKNOWLEDGE);
+    virtio_set_status(vdev, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+    return TRUE;
+}
+
+/**
+ * accept the features of wanted the device offers, FALSE if it refuses
+ */
+BOOL virtio_negotiate(VIRTIO_DEVICE *vdev, uint32 wanted) {
+    uint32 offered;
+
+    if (!vdev->modern) {
+        offered = inportl(vdev->io + VIRTIO_LEGACY_DEVICE_FEATURES);
+        vdev->features = offered & wanted;
+        outportl(vdev->io + VIRTIO_LEGACY_DRIVER_FEATURES, vdev->features);
+        return TRUE;
+    }
+
+    *virtio_common32(vdev, VIRTIO_COMMON_DEVICE_FEATURE_SELECT) = 0;
+    offered = *virtio_common32(vdev, VIRTIO_COMMON_DEVICE_FEATURE);
+    vdev->features = offered & wanted;
+    *virtio_common32(vdev, VIRTIO_COMMON_DRIVER_FEATURE_SELECT) = 0;
+    *virtio_common32(vdev, VIRTIO_COMMON_DRIVER_FEATURE) = vdev->features;
+
+    // a modern device needs VERSION_1 from the high word
+    *virtio_common32(vdev, VIRTIO_COMMON_DEVICE_FEATURE_SELECT) = 1;
+    if (!(*virtio_common32(vdev, VIRTIO_COMMON_DEVICE_FEATURE) & VIRTIO_F_VERSION_1))
+        return FALSE;
+    *virtio_common32(vdev, VIRTIO_COMMON_DRIVER_FEATURE_SELECT) = 1;
+    *virtio_common32(vdev, VIRTIO_COMMON_DRIVER_FEATURE) = VIRTIO_F_VERSION_1;
+
+    virtio_set_status(vdev, virtio_status(vdev) | VIRTIO_STATUS_FEATURES_OK);
+    return (virtio_status(vdev) & VIRTIO_STATUS_FEATURES_OK) != 0;
+}
+
+/**
+ * send queue interrupts to handler: MSI-X entry 0 when the device has it,
+ * else its legacy INTx line. before the queues are set up
+ */
+BOOL virtio_setup_interrupt(VIRTIO_DEVICE *vdev, ISR handler) {
+    PCI_DEVICE *pci = vdev->pci;
+
+    vdev->vector = pci_enable_msix(pci, 0, handler, 0);
+    if (vdev->vector >= 0) {
+        vdev->msix = TRUE;
+        // configuration changes aren't watched
+        if (vdev->modern)
+            *virtio_common16(vdev, VIRTIO_COMMON_MSIX_CONFIG) = VIRTIO_NO_VECTOR;
+        else
+            outports(vdev->io + VIRTIO_LEGACY_CONFIG_VECTOR, VIRTIO_NO_VECTOR);
+        return TRUE;
+    }
+
+    // the IO-APIC routes the ISA lines only, other drivers' devices may be on it
+    if (!pci->irq_pin || !isr_share_interrupt_handler(pci->irq_line, handler))
+        return FALSE;
+    vdev->vector = IRQ_BASE + pci->irq_line;
+    return TRUE;
+}
+
+/**
+ * allocate and register queue index, at most VIRTQ_MAX_SIZE entries
+ */
+BOOL virtio_setup_queue(VIRTIO_DEVICE *vdev, VIRTQ *vq, uint16 index) {
+    uint16 size;
+    uint32 i;
+
+    if (vdev->modern) {
+        *virtio_common16(vdev, VIRTIO_COMMON_QUEUE_SELECT) = index;
+        size = *virtio_common16(vdev, VIRTIO_COMMON_QUEUE_SIZE);
+        // the modern transport lets the driver pick a smaller ring
+        if (size > VIRTQ_MAX_SIZE)
+            size = VIRTQ_MAX_SIZE;
+    } else {
+        outports(vdev->io + VIRTIO_LEGACY_QUEUE_SELECT, index);
+        size = inports(vdev->io + VIRTIO_LEGACY_QUEUE_SIZE);
+        if (size > VIRTQ_MAX_SIZE)
+            return FALSE;
+    }
+    if (size == 0)
+        return FALSE;
+
+    memset(vq, 0, sizeof(VIRTQ));
+    vq->memory = (uint8 *)malloc(virtq_memory_size(size) + VIRTIO_LEGACY_QUEUE_ALIGN - 1);
+    if (!vq->memory)
+        return FALSE;
+    vq->index = index;
+    vq->size = size;
+    vq->desc = (VIRTQ_DESC *)(((uint32)vq->memory + VIRTIO_LEGACY_QUEUE_ALIGN - 1) & ~(VIRTIO_LEGACY_QUEUE_ALIGN - 1));
+    memset(vq->desc, 0, virtq_memory_size(size));
+    vq->avail = (VIRTQ_AVAIL *)((uint8 *)vq->desc + size * sizeof(VIRTQ_DESC));
+    vq->used = (volatile VIRTQ_USED *)((uint8 *)vq->desc + virtq_used_offset(size));
+    for (i = 0; i < size; i++)
+        vq->desc[i].next = i + 1;
+    vq->free_head = 0;
+    vq->free_count = size;
+    spin_init(&vq->lock, "virtq");
+
+    if (vdev->modern) {
+        *virtio_common16(vdev, VIRTIO_COMMON_QUEUE_SIZE) = size;
+        if (vdev->msix)
+            *virtio_common16(vdev, VIRTIO_COMMON_QUEUE_MSIX_VECTOR) = 0;
+        *virtio_common32(vdev, VIRTIO_COMMON_QUEUE_DESC) = (uint32)vq->desc;
+        *virtio_common32(vdev, VIRTIO_COMMON_QUEUE_DESC + 4) = 0;
+        *virtio_common32(vdev, VIRTIO_COMMON_QUEUE_DRIVER) = (uint32)vq->avail;
+        *virtio_common32(vdev, VIRTIO_COMMON_QUEUE_DRIVER + 4) = 0;
+        *virtio_common32(vdev, VIRTIO_COMMON_QUEUE_DEVICE) = (uint32)vq->used;
+        *virtio_common32(vdev, VIRTIO_COMMON_QUEUE_DEVICE + 4) = 0;
+        vq->notify_off = *virtio_common16(vdev, VIRTIO_COMMON_QUEUE_NOTIFY_OFF) * vdev->notify_multiplier;
+        *virtio_common16(vdev, VIRTIO_COMMON_QUEUE_ENABLE) = 1;
+    } else {
+        if (vdev->msix)
+            outports(vdev->io + VIRTIO_LEGACY_QUEUE_VECTOR, 0);
+        outportl(vdev->io + VIRTIO_LEGACY_QUEUE_PFN, (uint32)vq->desc / VIRTIO_LEGACY_QUEUE_ALIGN);
+    }
+    return TRUE;
+}
+
+/**
+ * the device may run
+ */
+void virtio_driver_ok(VIRTIO_DEVICE *vdev) {
+    virtio_set_status(vdev, virtio_status(vdev) | VIRTIO_STATUS_DRIVER_OK);
+}
+
+/**
+ * mark the device failed, it is left alone afterwards
+ */
+void virtio_fail(VIRTIO_DEVICE *vdev) {
+    virtio_set_status(vdev, virtio_status(vdev) | VIRTIO_STATUS_FAILED);
+}
+
+/**
+ * device specific configuration
+ */
+uint32 virtio_config32(VIRTIO_DEVICE *vdev, uint32 offset) {
+    if (vdev->modern)
+        return *(volatile uint32 *)(vdev->config + offset);
+    return inportl(vdev->io + (vdev->msix ? VIRTIO_LEGACY_CONFIG_MSIX : VIRTIO_LEGACY_CONFIG) + offset);
+}
+
+uint8 virtio_config8(VIRTIO_DEVICE *vdev, uint32 offset) {
+    if (vdev->modern)
+        return vdev->config[offset];
+    return inportb(vdev->io + (vdev->msix ? VIRTIO_LEGACY_CONFIG_MSIX : VIRTIO_LEGACY_CONFIG) + offset);
+}
+
+/**
+ * read and clear the interrupt status, 0 when the interrupt wasn't ours
+ */
+uint8 virtio_isr(VIRTIO_DEVICE *vdev) {
+    // MSI-X vectors are never shared, and the status isn't kept for them
+    if (vdev->msix)
+        return VIRTIO_ISR_QUEUE;
+    if (vdev->modern)
+        return *vdev->isr;
+    return inportb(vdev->io + VIRTIO_LEGACY_ISR);
+}
+
+/**
+ * make a chain of count buffers available with token, the ones the device
+ * reads first. FALSE without enough free descriptors. vq->lock is held
+ */
+BOOL virtq_add(VIRTQ *vq, const VIRTQ_BUFFER *buffers, uint32 count, void *token) {
+    uint16 head = vq->free_head;
+    uint16 index = head;
+    uint32 i;
+
+    if (count == 0 || count > vq->free_count)
+        return FALSE;
+    for (i = 0; i < count; i++) {
+        VIRTQ_DESC *desc = &vq->desc[index];
+
+        desc->addr_low = (uint32)buffers[i].addr;
+        desc->addr_high = 0;
+        desc->len = buffers[i].len;
+        desc->flags = buffers[i].device_writes ? VIRTQ_DESC_F_WRITE : 0;
+        if (i + 1 < count)
+            desc->flags |= VIRTQ_DESC_F_NEXT;
+        else
+            vq->free_head = desc->next;
+        index = desc->next;
+    }
+    vq->free_count -= count;
+    vq->tokens[head] = token;
+
+    // not visible before the kick moves the index
+    vq->avail->ring[(uint16)(vq->avail->idx + vq->added) % vq->size] = head;
+    vq->added++;
+    return TRUE;
+}
+
+/**
+ * publish the chains added since the last kick and notify the device once,
+ * unless it asked not to be. vq->lock is held
+ */
+void virtq_kick(VIRTIO_DEVICE *vdev, VIRTQ *vq) {
+    if (vq->added == 0)
+        return;
+    // the ring entries before the index, the index before the flags are read
+    __sync_synchronize();
+    vq->avail->idx += vq->added;
+    vq->added = 0;
+    __sync_synchronize();
+    if (vq->used->flags & VIRTQ_USED_F_NO_NOTIFY)
+        return;
+
+    vq->kicks++;
+    if (vdev->modern)
+        *(volatile uint16 *)(vdev->notify + vq->notify_off) = vq->index;
+    else
+        outports(vdev->io + VIRTIO_LEGACY_QUEUE_NOTIFY, vq->index);
+}
+
+/**
+ * token of the next chain the device finished, NULL if there is none.
+ * its descriptors are free again. vq->lock is held
+ */
+void *virtq_get(VIRTQ *vq, uint32 *len) {
+    volatile VIRTQ_USED_ELEM *elem;
+    uint16 head, index;
+    void *token;
+
+    if (vq->last_used == vq->used->idx)
+        return NULL;
+    // the entry isn't read before the index that covers it
+    __sync_synchronize();
+    elem = &vq->used->ring[vq->last_used % vq->size];
+    head = (uint16)elem->id;
+    if (len)
+        *len = elem->len;
+    vq->last_used++;
+
+    token = vq->tokens[head];
+    vq->tokens[head] = NULL;
+    // the chain goes back to the front of the free list
+    index = head;
+    vq->free_count++;
+    while (vq->desc[index].flags & VIRTQ_DESC_F_NEXT) {
+        index = vq->desc[index].next;
+        vq->free_count++;
+    }
+    vq->desc[index].next = vq->free_head;
+    vq->free_head = head;
+    return token;
+}
+
+/**
+ * ask the device to interrupt for finished chains or not, only a hint.
+ * turning them on returns TRUE when chains finished that it won't announce
+ */
+BOOL virtq_interrupts(VIRTQ *vq, BOOL on) {
+    if (!on) {
+        vq->avail->flags |= VIRTQ_AVAIL_F_NO_INTERRUPT;
+        return FALSE;
+    }
+    vq->avail->flags &= ~VIRTQ_AVAIL_F_NO_INTERRUPT;
+    // the flag before the index, or a chain finishing now goes unnoticed
+    __sync_synchronize();
+    return vq->last_used != vq->used->idx;
+}
@@ -0,0 +1,165 @@
+/**
+ * virtio-blk driver
+ * one queue per disk. a request is a chain of header, data and status
+ * byte; the block layer hands over a batch, which goes into the ring as
+ * far as it fits and reaches the device with a single notification. the
+ * interrupt handler reaps the used ring and kicks the block queue again
+ */
+
+#include "virtio_blk.h"
+#include "virtio.h"
+#include "block.h"
+#include "string.h"
+#include "utils.h"
+#include "console.h"
+
+typedef struct {
+    uint32 type;
+    uint32 reserved;
+    uint64 sector;
+} __attribute__((packed)) VIRTIO_BLK_HEADER;
+
+typedef struct {
+    VIRTIO_DEVICE vdev;
+    VIRTQ vq;
+    BLOCK_DEVICE block;
+    // by chain head, in memory the device reaches
+    VIRTIO_BLK_HEADER headers[VIRTQ_MAX_SIZE];
+    uint8 status[VIRTQ_MAX_SIZE];
+} VIRTIO_BLK;
+
+static VIRTIO_BLK *g_disks[VIRTIO_BLK_MAX_DISKS];
+static uint32 g_disk_count = 0;
+
+static const PCI_ID g_virtio_blk_ids[] = {
+    { VIRTIO_VENDOR_ID, 0x1001 },   // transitional
+    { VIRTIO_VENDOR_ID, 0x1042 },   // modern only
+    { 0, 0 }
+};
+
+static BLOCK_REQUEST *virtio_blk_submit(BLOCK_DEVICE *dev, BLOCK_REQUEST *list) {
+    VIRTIO_BLK *disk = (VIRTIO_BLK *)dev->driver_data;
+    VIRTQ *vq = &disk->vq;
+    uint32 flags = spin_lock_irqsave(&vq->lock);
+
+    while (list) {
+        BLOCK_REQUEST *next = list->next;
+        uint16 head = vq->free_head;
+        VIRTQ_BUFFER buffers[3];
+        uint32 count = 0;
+
+        // without room free_head is stale, or heads a chain still in flight
+        if (vq->free_count < (list->op == BLOCK_FLUSH ? 2 : 3))
+            break;
+        disk->headers[head].type = list->op == BLOCK_READ ? VIRTIO_BLK_T_IN
+                                 : list->op == BLOCK_WRITE ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_FLUSH;
+        disk->headers[head].reserved = 0;
+        disk->headers[head].sector = list->op == BLOCK_FLUSH ? 0 : list->sector;
+        disk->status[head] = 0xFF;
+
+        buffers[count].addr = &disk->headers[head];
+        buffers[count].len = sizeof(VIRTIO_BLK_HEADER);
+        buffers[count++].device_writes = FALSE;
+        if (list->op != BLOCK_FLUSH) {
+            buffers[count].addr = list->buffer;
+            buffers[count].len = list->count * BLOCK_SECTOR_SIZE;
+            buffers[count++].device_writes = list->op == BLOCK_READ;
+        }
+        buffers[count].addr = &disk->status[head];
+        buffers[count].len = 1;
+        buffers[count++].device_writes = TRUE;
+
+        // the device can't see it before the kick below
+        virtq_add(vq, buffers, count, list);
+        list = next;
+    }
+    virtq_kick(&disk->vdev, vq);
+    dev->notifications = vq->kicks;
+    spin_unlock_irqrestore(&vq->lock, flags);
+    return list;
+}
+
+static void virtio_blk_reap(VIRTIO_BLK *disk) {
+    BLOCK_REQUEST *req;
+    uint32 count = 0;
+    uint32 flags;
+
+    if (!(virtio_isr(&disk->vdev) & VIRTIO_ISR_QUEUE))
+        return;
+
+    flags = spin_lock_irqsave(&disk->vq.lock);
+    while ((req = (BLOCK_REQUEST *)virtq_get(&disk->vq, NULL)) != NULL) {
+        // the freed chain heads the free list, and its status is still there
+        uint8 result = disk->status[disk->vq.free_head];
+        sint32 status = result == VIRTIO_BLK_S_OK ? BLOCK_OK
+                      : result == VIRTIO_BLK_S_UNSUPP ? BLOCK_EUNSUPPORTED : BLOCK_EIO;
+
+        // completions run without the ring locked, submit may be waiting for it
+        spin_unlock_irqrestore(&disk->vq.lock, flags);
+        block_complete(&disk->block, req, status);
+        count++;
+        flags = spin_lock_irqsave(&disk->vq.lock);
+    }
+    spin_unlock_irqrestore(&disk->vq.lock, flags);
+
+    if (count)
+        block_kick(&disk->block);
+}
+
+static void virtio_blk_interrupt(REGISTERS *reg) {
+    uint32 i;
+
+    (void)reg;
+    for (i = 0; i < g_disk_count; i++)
+        virtio_blk_reap(g_disks[i]);
+}
+
+static BOOL virtio_blk_probe(PCI_DEVICE *pci) {
+    VIRTIO_BLK *disk;
+
+    if (g_disk_count == VIRTIO_BLK_MAX_DISKS)
+        return FALSE;
+    disk = (VIRTIO_BLK *)malloc(sizeof(VIRTIO_BLK));
+    if (!disk)
+        return FALSE;
+    memset(disk, 0, sizeof(VIRTIO_BLK));
+
+    if (!virtio_init(&disk->vdev, pci)) {
+        free(disk);
+        return FALSE;
+    }
+    if (!virtio_negotiate(&disk->vdev, VIRTIO_BLK_F_RO | VIRTIO_BLK_F_FLUSH)
+            || !virtio_setup_interrupt(&disk->vdev, virtio_blk_interrupt)
+            || !virtio_setup_queue(&disk->vdev, &disk->vq, 0)) {
+        virtio_fail(&disk->vdev);
+        free(disk);
+        return FALSE;
+    }
+
+    strcpy(disk->block.name, "vda");
+    disk->block.name[2] += g_disk_count;
+    disk->block.sectors = virtio_config32(&disk->vdev, VIRTIO_BLK_CONFIG_CAPACITY)
+                        | (uint64)virtio_config32(&disk->vdev, VIRTIO_BLK_CONFIG_CAPACITY + 4) << 32;
+    disk->block.read_only = (disk->vdev.features & VIRTIO_BLK_F_RO) != 0;
+    disk->block.submit = virtio_blk_submit;
+    disk->block.driver_data = disk;
+    pci->driver_data = disk;
+    g_disks[g_disk_count++] = disk;
+    block_register(&disk->block);
+    virtio_driver_ok(&disk->vdev);
+
+    announce("%s: %d MB virtio-blk, %s transport, %d entry queue\n", disk->block.name,
+             (uint32)(disk->block.sectors >> 11), disk->vdev.modern ? "modern" : "legacy", disk->vq.size);
+    return TRUE;
+}
+
+static const PCI_DRIVER g_virtio_blk_driver = {
+    "virtio-blk", g_virtio_blk_ids, virtio_blk_probe
+};
+
+/**
+ * register the driver, disks are probed by pci_register_driver()
+ */
+void virtio_blk_init(void) {
+    pci_register_driver(&g_virtio_blk_driver);
+}
@@ -0,0 +1,194 @@
+/**
+ * virtio-net driver
+ * every buffer in the receive queue is a packet buffer, its header
+ * descriptor in the headroom right before the frame, so a received frame
+ * goes up the stack in place. a frame to send gets its header pushed the
+ * same way. polling turns the queues' interrupts off with the avail flag
+ */
+
+#include "virtio_net.h"
+#include "virtio.h"
+#include "netdev.h"
+#include "string.h"
+#include "utils.h"
+
+typedef struct {
+    VIRTIO_DEVICE vdev;
+    VIRTQ rx;
+    VIRTQ tx;
+    NET_DEVICE net;
+    uint32 header_size;
+} VIRTIO_NET;
+
+static VIRTIO_NET *g_nics[VIRTIO_NET_MAX_NICS];
+static uint32 g_nic_count = 0;
+
+static const PCI_ID g_virtio_net_ids[] = {
+    { VIRTIO_VENDOR_ID, 0x1000 },   // transitional
+    { VIRTIO_VENDOR_ID, 0x1041 },   // modern only
+    { 0, 0 }
+};
+
+// post buf for a frame to arrive in, rx.lock is held
+static BOOL virtio_net_post(VIRTIO_NET *nic, NETBUF *buf) {
+    VIRTQ_BUFFER buffers[2];
+
+    buf->data = buf->head + NETBUF_HEADROOM;
+    buffers[0].addr = buf->data - nic->header_size;
+    buffers[0].len = nic->header_size;
+    buffers[0].device_writes = TRUE;
+    buffers[1].addr = buf->data;
+    buffers[1].len = NETBUF_SIZE - NETBUF_HEADROOM;
+    buffers[1].device_writes = TRUE;
+    return virtq_add(&nic->rx, buffers, 2, buf);
+}
+
+static BOOL virtio_net_transmit(NET_DEVICE *dev, NETBUF *buf) {
+    VIRTIO_NET *nic = (VIRTIO_NET *)dev->driver_data;
+    VIRTQ_BUFFER buffers[2];
+    NETBUF *done;
+    uint32 flags;
+    BOOL added;
+
+    // no checksum offload or segmentation, the header is all zero
+    memset(buf->data - nic->header_size, 0, nic->header_size);
+    buffers[0].addr = buf->data - nic->header_size;
+    buffers[0].len = nic->header_size;
+    buffers[0].device_writes = FALSE;
+    buffers[1].addr = buf->data;
+    buffers[1].len = buf->len;
+    buffers[1].device_writes = FALSE;
+
+    flags = spin_lock_irqsave(&nic->tx.lock);
+    if (nic->tx.free_count < 2) {
+        while ((done = (NETBUF *)virtq_get(&nic->tx, NULL)) != NULL)
+            netbuf_free(done);
+    }
+    added = virtq_add(&nic->tx, buffers, 2, buf);
+    virtq_kick(&nic->vdev, &nic->tx);
+    spin_unlock_irqrestore(&nic->tx.lock, flags);
+    return added;
+}
+
+static uint32 virtio_net_poll(NET_DEVICE *dev, uint32 budget) {
+    VIRTIO_NET *nic = (VIRTIO_NET *)dev->driver_data;
+    NETBUF *head = NULL, **tail = &head, *buf, *fresh;
+    uint32 count = 0, len;
+    uint32 flags;
+
+    flags = spin_lock_irqsave(&nic->tx.lock);
+    while ((buf = (NETBUF *)virtq_get(&nic->tx, NULL)) != NULL)
+        netbuf_free(buf);
+    spin_unlock_irqrestore(&nic->tx.lock, flags);
+
+    flags = spin_lock_irqsave(&nic->rx.lock);
+    while (count < budget && (buf = (NETBUF *)virtq_get(&nic->rx, &len)) != NULL) {
+        count++;
+        fresh = netbuf_alloc();
+        if (!fresh || len <= nic->header_size) {
+            // the old buffer goes back, the frame is lost
+            dev->rx_dropped++;
+            netbuf_free(fresh);
+            virtio_net_post(nic, buf);
+            continue;
+        }
+        buf->len = len - nic->header_size;
+        *tail = buf;
+        tail = &buf->next;
+        virtio_net_post(nic, fresh);
+    }
+    // the refills of the whole batch with one notification
+    virtq_kick(&nic->vdev, &nic->rx);
+    spin_unlock_irqrestore(&nic->rx.lock, flags);
+
+    *tail = NULL;
+    while (head) {
+        buf = head;
+        head = head->next;
+        netdev_receive(dev, buf);
+    }
+    return count;
+}
+
+static BOOL virtio_net_irq(NET_DEVICE *dev, BOOL on) {
+    VIRTIO_NET *nic = (VIRTIO_NET *)dev->driver_data;
+    uint32 flags;
+    BOOL pending;
+
+    flags = spin_lock_irqsave(&nic->rx.lock);
+    pending = virtq_interrupts(&nic->rx, on);
+    spin_unlock_irqrestore(&nic->rx.lock, flags);
+    flags = spin_lock_irqsave(&nic->tx.lock);
+    pending |= virtq_interrupts(&nic->tx, on);
+    spin_unlock_irqrestore(&nic->tx.lock, flags);
+    return pending;
+}
+
+static void virtio_net_interrupt(REGISTERS *reg) {
+    uint32 i;
+
+    (void)reg;
+    for (i = 0; i < g_nic_count; i++) {
+        if (virtio_isr(&g_nics[i]->vdev) & VIRTIO_ISR_QUEUE)
+            netdev_schedule(&g_nics[i]->net);
+    }
+}
+
+static BOOL virtio_net_probe(PCI_DEVICE *pci) {
+    static const uint8 fallback_mac[ETH_ALEN] = { 0x52, 0x54, 0x00, 0x12, 0x34, 0x56 };
+    VIRTIO_NET *nic;
+    NETBUF *buf;
+    uint32 i;
+
+    if (g_nic_count == VIRTIO_NET_MAX_NICS)
+        return FALSE;
+    nic = (VIRTIO_NET *)malloc(sizeof(VIRTIO_NET));
+    if (!nic)
+        return FALSE;
+    memset(nic, 0, sizeof(VIRTIO_NET));
+
+    if (!virtio_init(&nic->vdev, pci)) {
+        free(nic);
+        return FALSE;
+    }
+    if (!virtio_negotiate(&nic->vdev, VIRTIO_NET_F_MAC)
+            || !virtio_setup_interrupt(&nic->vdev, virtio_net_interrupt)
+            || !virtio_setup_queue(&nic->vdev, &nic->rx, VIRTIO_NET_QUEUE_RX)
+            || !virtio_setup_queue(&nic->vdev, &nic->tx, VIRTIO_NET_QUEUE_TX)) {
+        virtio_fail(&nic->vdev);
+        free(nic);
+        return FALSE;
+    }
+    nic->header_size = nic->vdev.modern ? VIRTIO_NET_HEADER_MODERN : VIRTIO_NET_HEADER_LEGACY;
+    for (i = 0; i < ETH_ALEN; i++) {
+        nic->net.mac[i] = nic->vdev.features & VIRTIO_NET_F_MAC
+                        ? virtio_config8(&nic->vdev, VIRTIO_NET_CONFIG_MAC + i) : fallback_mac[i];
+    }
+
+    // the receive queue starts full, a chain is two descriptors
+    while (nic->rx.free_count >= 2 && (buf = netbuf_alloc()) != NULL)
+        virtio_net_post(nic, buf);
+
+    nic->net.driver = "virtio-net";
+    nic->net.transmit = virtio_net_transmit;
+    nic->net.poll = virtio_net_poll;
+    nic->net.irq = virtio_net_irq;
+    nic->net.driver_data = nic;
+    pci->driver_data = nic;
+    g_nics[g_nic_count++] = nic;
+    // no notification may come before DRIVER_OK
+    virtio_driver_ok(&nic->vdev);
+    virtq_kick(&nic->vdev, &nic->rx);
+    return netdev_register(&nic->net);
+}
+
+static const PCI_DRIVER g_virtio_net_driver = {
+    "virtio-net", g_virtio_net_ids, virtio_net_probe
+};
+
+/**
+ * register the driver, NICs are probed by pci_register_driver()
+ */
+void virtio_net_init(void) {
+    pci_register_driver(&g_virtio_net_driver);
+}
@@ -0,0 +1,379 @@
+/**
+ * User address spaces and demand paging
+ * a page gets its frame on the first fault, file backed pages
+ * are read from the filesystem at that point. read only file pages
+ * are shared through a small page cache, and forked address spaces
+ * share writable pages until one side writes to them
+ */
+
+#include "vm.h"
+#include "isr.h"
+#include "task.h"
+#include "console.h"
+#include "string.h"
+#include "utils.h"
+#include "spinlock.h"
+
+#define PAGE_FAULT_VECTOR   14
+#define VM_PAGE_CACHE_SIZE  256
+
+// read only file page shared by every address space that maps it
+typedef struct {
+    FileNode *file;
+    uint32 version;         // file version the page was read at
+    uint32 offset;
+    uint32 size;            // bytes from the file, the rest of the page is zero
+    uint32 frame;           // 0 for an empty slot, the cache holds a reference
+} PAGE_CACHE_ENTRY;
+
+static PAGE_CACHE_ENTRY g_page_cache[VM_PAGE_CACHE_SIZE];
+static SPINLOCK g_page_cache_lock = SPINLOCK_INIT("page cache");
+
+static VMA *vm_find(ADDRESS_SPACE *as, uint32 addr) {
+    VMA *vma;
+
+    for (vma = as->vmas; vma; vma = vma->next) {
+        if (addr >= vma->start && addr < vma->end)
+            return vma;
+    }
+    return NULL;
+}
+
+static void vm_unmap_range(ADDRESS_SPACE *as, uint32 start, uint32 end) {
+    uint32 addr;
+
+    for (addr = start; addr < end; addr += PAGE_SIZE) {
+        uint32 entry = paging_unmap(as->directory, addr);
+
+        if (entry & PAGE_PRESENT)
+            pmm_free_frame(entry & PAGE_MASK);
+    }
+}
+
+// fill a fresh frame with the region contents for page
+static void vm_fill_page(VMA *vma, uint32 page, uint32 frame) {
+    uint32 offset = page - vma->start;
+    uint32 size;
+
+    memset((void *)frame, 0, PAGE_SIZE);
+    if (!vma->file || offset >= vma->file_size)
+        return;
+
+    size = vma->file_size - offset;
+    if (size > PAGE_SIZE)
+        size = PAGE_SIZE;
+    fs_read(vma->file, vma->file_offset + offset, (void *)frame, size);
+}
+
+static BOOL vm_cache_match(PAGE_CACHE_ENTRY *entry, FileNode *file, uint32 version,
+        uint32 offset, uint32 size) {
+    return entry->frame && entry->file == file && entry->version == version
+        && entry->offset == offset && entry->size == size;
+}
+
+// referenced frame holding the read only file page at offset into vma
+static uint32 vm_cache_get(VMA *vma, uint32 offset) {
+    uint32 file_offset = vma->file_offset + offset;
+    uint32 size = vma->file_size - offset;
+    uint32 version = vma->file->version;
+    PAGE_CACHE_ENTRY *entry;
+    uint32 frame, flags;
+
+    if (size > PAGE_SIZE)
+        size = PAGE_SIZE;
+    entry = &g_page_cache[(((uint32)vma->file >> 4) ^ (file_offset / PAGE_SIZE)) % VM_PAGE_CACHE_SIZE];
+
+    flags = spin_lock_irqsave(&g_page_cache_lock);
+    if (vm_cache_match(entry, vma->file, version, file_offset, size)) {
+        frame = entry->frame;
+        pmm_ref_frame(frame);
+        spin_unlock_irqrestore(&g_page_cache_lock, flags);
+        return frame;
+    }
+    spin_unlock_irqrestore(&g_page_cache_lock, flags);
+
+    // read without the lock, the filesystem may fault pages in itself
+    frame = pmm_alloc_frame();
+    if (!frame)
+        return 0;
+    vm_fill_page(vma, vma->start + offset, frame);
+
+    flags = spin_lock_irqsave(&g_page_cache_lock);
+    if (vm_cache_match(entry, vma->file, version, file_offset, size)) {
+        // another cpu read the same page meanwhile, share its copy
+        pmm_free_frame(frame);
+        frame = entry->frame;
+    } else {
+        // the slot's previous page stays alive as long as someone maps it
+        if (entry->frame)
+            pmm_free_frame(entry->frame);
+        entry->file = vma->file;
+        entry->version = version;
+        entry->offset = file_offset;
+        entry->size = size;
+        entry->frame = frame;
+    }
+    pmm_ref_frame(frame);
+    spin_unlock_irqrestore(&g_page_cache_lock, flags);
+    return frame;
+}
+
+// first touch of a page: share it from the cache or fill a private frame
+static BOOL vm_map_page(ADDRESS_SPACE *as, VMA *vma, uint32 page) {
+    uint32 offset = page - vma->start;
+    uint32 flags = PAGE_PRESENT | PAGE_USER;
+    uint32 frame;
+
+    if (vma->file && !(vma->flags & VMA_WRITE) && offset < vma->file_size) {
+        frame = vm_cache_get(vma, offset);
+        if (!frame)
+            return FALSE;
+    } else {
+        frame = pmm_alloc_frame();
+        if (!frame)
+            return FALSE;
+        vm_fill_page(vma, page, frame);
+    }
+
+    if (vma->flags & VMA_WRITE)
+        flags |= PAGE_WRITE;
+    if (!paging_map(as->directory, page, frame, flags)) {
+        pmm_free_frame(frame);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// write to a page shared after fork: copy it unless nobody else maps it anymore
+static BOOL vm_copy_on_write(ADDRESS_SPACE *as, VMA *vma, uint32 page) {
+    uint32 entry = paging_get_entry(as->directory, page);
+    uint32 frame = entry & PAGE_MASK;
+    uint32 flags = ((entry & PAGE_FLAGS_MASK) & ~PAGE_COW) | PAGE_WRITE;
+    uint32 copy;
+
+    if (!(entry & PAGE_COW) || !(vma->flags & VMA_WRITE))
+        return FALSE;
+    if (pmm_frame_refs(frame) == 1)
+        return paging_map(as->directory, page, frame, flags);
+
+    copy = pmm_alloc_frame();
+    if (!copy)
+        return FALSE;
+    memcpy((void *)copy, (void *)frame, PAGE_SIZE);
+    if (!paging_map(as->directory, page, copy, flags)) {
+        pmm_free_frame(copy);
+        return FALSE;
+    }
+    pmm_free_frame(frame);
+    return TRUE;
+}
+
+/**
+ * resolve a fault at addr if a region covers it, returns FALSE for bad accesses
+ */
+BOOL vm_handle_fault(ADDRESS_SPACE *as, uint32 addr, uint32 error) {
+    VMA *vma = vm_find(as, addr);
+    uint32 page = PAGE_ALIGN_DOWN(addr);
+
+    if (!vma)
+        return FALSE;
+    if ((error & PF_WRITE) && !(vma->flags & VMA_WRITE))
+        return FALSE;
+    if (error & PF_PRESENT)
+        return (error & PF_WRITE) && vm_copy_on_write(as, vma, page);
+    return vm_map_page(as, vma, page);
+}
+
+static void vm_page_fault(REGISTERS *reg) {
+    TASK *task = task_current();
+    BOOL user_mode = (reg->cs & 3) == 3;
+    BOOL user_addr;
+    uint32 addr;
+
+    asm volatile("mov %%cr2, %0" : "=r"(addr));
+    user_addr = addr >= USER_BASE && addr < USER_TOP;
+
+    if (user_addr && task && task->as) {
+        if (vm_handle_fault(task->as, addr, reg->err_code))
+            return;
+    } else if (!user_addr && !user_mode) {
+        // kernel mapping added after this directory was created
+        if (paging_sync_kernel(paging_current_directory(), addr))
+            return;
+    }
+
+    // bad user pointers, whether touched by the program or by a syscall
+    if (user_mode || (user_addr && task && task->as)) {
+        printf("%s: segmentation fault at 0x%x (eip=0x%x), killed\n",
+               task->name, addr, reg->eip);
+        task_exit(-1);
+    }
+
+    printf("EXCEPTION: Page Fault at 0x%x, eip=0x%x, err_code=%d\n",
+           addr, reg->eip, reg->err_code);
+    for (;;)
+        ;
+}
+
+/**
+ * register the page fault handler
+ */
+void vm_init(void) {
+    isr_register_interrupt_handler(PAGE_FAULT_VECTOR, vm_page_fault);
+}
+
+/**
+ * empty address space sharing the kernel mappings
+ */
+ADDRESS_SPACE *vm_create(void) {
+    ADDRESS_SPACE *as = (ADDRESS_SPACE *)malloc(sizeof(ADDRESS_SPACE));
+    uint32 frame = pmm_alloc_frame();
+
+    if (!as || !frame) {
+        free(as);
+        if (frame)
+            pmm_free_frame(frame);
+        return NULL;
+    }
+    memset(as, 0, sizeof(ADDRESS_SPACE));
+
+    // kernel page tables are shared, user entries start empty
+    as->directory = (uint32 *)frame;
+    memcpy(as->directory, paging_kernel_directory(), PAGE_SIZE);
+    return as;
+}
+
+/**
+ * copy of as for a forked task, writable pages are shared copy on write
+ */
+ADDRESS_SPACE *vm_clone(ADDRESS_SPACE *parent) {
+    ADDRESS_SPACE *as = vm_create();
+    VMA *vma, *copy;
+    uint32 addr, entry;
+
+    if (!as)
+        return NULL;
+
+    for (vma = parent->vmas; vma; vma = vma->next) {
+        copy = vm_add_region(as, vma->start, vma->end, vma->flags,
+                             vma->file, vma->file_offset, vma->file_size);
+        if (!copy) {
+            vm_destroy(as);
+            return NULL;
+        }
+        if (vma == parent->heap)
+            as->heap = copy;
+
+        for (addr = vma->start; addr < vma->end; addr += PAGE_SIZE) {
+            entry = paging_get_entry(parent->directory, addr);
+            if (!(entry & PAGE_PRESENT))
+                continue;
+            // both sides lose write access until the first write copies the page
+            if (entry & PAGE_WRITE) {
+                entry = (entry & ~PAGE_WRITE) | PAGE_COW;
+                paging_map(parent->directory, addr, entry, entry & PAGE_FLAGS_MASK);
+            }
+            if (!paging_map(as->directory, addr, entry, entry & PAGE_FLAGS_MASK)) {
+                vm_destroy(as);
+                return NULL;
+            }
+            pmm_ref_frame(entry & PAGE_MASK);
+        }
+    }
+    as->brk = parent->brk;
+    return as;
+}
+
+/**
+ * free every frame, page table and region of as
+ */
+void vm_destroy(ADDRESS_SPACE *as) {
+    VMA *vma;
+    uint32 i;
+
+    while ((vma = as->vmas) != NULL) {
+        vm_unmap_range(as, vma->start, vma->end);
+        as->vmas = vma->next;
+        free(vma);
+    }
+    for (i = PDE_INDEX(USER_BASE); i < PDE_INDEX(USER_TOP); i++) {
+        if (as->directory[i] & PAGE_PRESENT)
+            pmm_free_frame(as->directory[i] & PAGE_MASK);
+    }
+    pmm_free_frame((uint32)as->directory);
+    free(as);
+}
+
+/**
+ * add region [start, end), backed by file_size bytes of file at file_offset.
+ * NULL if it overlaps an existing region or leaves user space
+ */
+VMA *vm_add_region(ADDRESS_SPACE *as, uint32 start, uint32 end, uint32 flags,
+                   FileNode *file, uint32 file_offset, uint32 file_size) {
+    VMA **link = &as->vmas;
+    VMA *vma;
+
+    if (start & ~PAGE_MASK || end & ~PAGE_MASK || start > end)
+        return NULL;
+    if (start < USER_BASE || end > USER_TOP)
+        return NULL;
+
+    while (*link && (*link)->start < end) {
+        if ((*link)->end > start)
+            return NULL;
+        link = &(*link)->next;
+    }
+
+    vma = (VMA *)malloc(sizeof(VMA));
+    if (!vma)
+        return NULL;
+    vma->start = start;
+    vma->end = end;
+    vma->flags = flags;
+    vma->file = file;
+    vma->file_offset = file_offset;
+    vma->file_size = file ? file_size : 0;
+    vma->next = *link;
+    *link = vma;
+    return vma;
+}
+
+/**
+ * start an empty heap at brk
+ */
+BOOL vm_set_break(ADDRESS_SPACE *as, uint32 brk) {
+    uint32 start = PAGE_ALIGN_UP(brk);
+
+    as->heap = vm_add_region(as, start, start, VMA_READ | VMA_WRITE, NULL, 0, 0);
+    if (!as->heap)
+        return FALSE;
+    as->brk = start;
+    return TRUE;
+}
+
+/**
+ * move the program break by increment, returns the old break or -1
+ */
+uint32 vm_sbrk(ADDRESS_SPACE *as, sint32 increment) {
+    VMA *heap = as->heap;
+    uint32 old_brk = as->brk;
+    uint32 new_brk = old_brk + increment;
+    uint32 new_end;
+
+    if (!heap)
+        return (uint32)-1;
+    if (increment < 0 ? new_brk > old_brk || new_brk < heap->start
+                      : new_brk < old_brk || new_brk > USER_TOP)
+        return (uint32)-1;
+
+    new_end = PAGE_ALIGN_UP(new_brk);
+    // the heap stops where the next region, the stack, begins
+    if (heap->next && new_end > heap->next->start)
+        return (uint32)-1;
+
+    if (new_end < heap->end)
+        vm_unmap_range(as, new_end, heap->end);
+    heap->end = new_end;
+    as->brk = new_brk;
+    return old_brk;
+}
@@ -0,0 +1,77 @@
+/**
+ * Wait queues
+ * a sleeper links an entry from its own stack into the queue
+ * and blocks (or halts, before tasks exist) until a waker marks it
+ */
+
+#include "waitq.h"
+#include "task.h"
+
+void waitq_init(WAITQ *wq) {
+    wq->head = NULL;
+}
+
+/**
+ * sleep until woken, must be called with the task lock held
+ * and returns with it held again
+ */
+void waitq_sleep(WAITQ *wq) {
+    WAITQ_ENTRY entry;
+    WAITQ_ENTRY **link = &wq->head;
+
+    entry.woken = FALSE;
+    entry.task = task_current();
+    entry.next = NULL;
+    // append, wakers serve the queue in arrival order
+    while (*link)
+        link = &(*link)->next;
+    *link = &entry;
+
+    while (!entry.woken) {
+        if (entry.task)
+            task_block();
+        else
+            // sti only takes effect after hlt, so an interrupt can't be missed in between
+            asm volatile("sti\n\thlt\n\tcli" ::: "memory");
+    }
+}
+
+// mark entry woken and make its task runnable, the task lock must be held
+static void waitq_wake_entry(WAITQ_ENTRY *entry) {
+    struct TASK *task = entry->task;
+
+    // the entry lives on the sleeper's stack, don't touch it once marked
+    entry->woken = TRUE;
+    if (task)
+        task_wakeup(task);
+}
+
+/**
+ * wake the longest waiting sleeper, safe from interrupt handlers
+ */
+void waitq_wake_one(WAITQ *wq) {
+    uint32 flags = task_lock();
+    WAITQ_ENTRY *entry = wq->head;
+
+    if (entry) {
+        wq->head = entry->next;
+        waitq_wake_entry(entry);
+    }
+    task_unlock(flags);
+}
+
+/**
+ * wake every sleeper, safe from interrupt handlers
+ */
+void waitq_wake_all(WAITQ *wq) {
+    uint32 flags = task_lock();
+    WAITQ_ENTRY *entry = wq->head;
+
+    wq->head = NULL;
+    while (entry) {
+        WAITQ_ENTRY *next = entry->next;
+        waitq_wake_entry(entry);
+        entry = next;
+    }
+    task_unlock(flags);
+}
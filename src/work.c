@@ -0,0 +1,239 @@
+/**
+ * Work pool
+ * the deques follow Chase and Lev, "Dynamic Circular Work-Stealing Deque",
+ * with a fixed size array. the owning cpu pushes and pops at the bottom with
+ * interrupts off, so interrupt handlers can submit too; thieves take from
+ * the top and race for it with a compare and swap
+ */
+
+#include "work.h"
+#include "task.h"
+#include "smp.h"
+#include "string.h"
+#include "utils.h"
+
+#define WORK_MAX_CHUNKS     32
+
+typedef struct {
+    volatile sint32 top;
+    volatile sint32 bottom;
+    WORK * volatile items[WORK_DEQUE_SIZE];
+    uint32 run;
+    uint32 stolen;
+} WORK_DEQUE;
+
+// one chunk of a parallel for
+typedef struct {
+    WORK work;
+    uint32 begin, end;
+    WORK_RANGE_FN fn;
+    void *arg;
+} WORK_RANGE;
+
+static WORK_DEQUE g_deques[CPU_MAX];
+// idle workers sleep here until a job is submitted anywhere
+static WAITQ g_work_idle;
+
+static BOOL work_push(WORK_DEQUE *deque, WORK *work) {
+    sint32 bottom = deque->bottom;
+
+    if (bottom - deque->top >= WORK_DEQUE_SIZE)
+        return FALSE;
+    deque->items[bottom & (WORK_DEQUE_SIZE - 1)] = work;
+    // stores aren't reordered on x86, the item is visible before the new bottom
+    deque->bottom = bottom + 1;
+    return TRUE;
+}
+
+static WORK *work_pop(WORK_DEQUE *deque) {
+    sint32 bottom = deque->bottom - 1;
+    sint32 top;
+    WORK *work;
+
+    deque->bottom = bottom;
+    // the load of top must not pass the store of bottom
+    __sync_synchronize();
+    top = deque->top;
+
+    if (top > bottom) {
+        deque->bottom = top;
+        return NULL;
+    }
+    work = deque->items[bottom & (WORK_DEQUE_SIZE - 1)];
+    if (top == bottom) {
+        // the last item, a thief may be taking it right now
+        if (!__sync_bool_compare_and_swap(&deque->top, top, top + 1))
+            work = NULL;
+        deque->bottom = top + 1;
+    }
+    return work;
+}
+
+static WORK *work_steal(WORK_DEQUE *deque) {
+    sint32 top = deque->top;
+    sint32 bottom = deque->bottom;
+    WORK *work;
+
+    if (top >= bottom)
+        return NULL;
+    work = deque->items[top & (WORK_DEQUE_SIZE - 1)];
+    if (!__sync_bool_compare_and_swap(&deque->top, top, top + 1))
+        return NULL;
+    return work;
+}
+
+static BOOL work_pending(void) {
+    uint32 i;
+
+    for (i = 0; i < smp_cpu_count(); i++) {
+        if (g_deques[i].bottom > g_deques[i].top)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static void work_run(WORK *work) {
+    uint32 flags;
+
+    work->fn(work->arg);
+
+    // the waiter may free work as soon as it sees done, mark and wake in one go
+    flags = task_lock();
+    work->done = TRUE;
+    waitq_wake_all(&work->waiters);
+    task_unlock(flags);
+}
+
+// run one job of this cpu, or one stolen from another cpu, FALSE if there was none
+static BOOL work_run_one(void) {
+    uint32 cpu = smp_cpu_index();
+    uint32 count = smp_cpu_count();
+    uint32 flags, i;
+    WORK *work;
+
+    flags = irq_save();
+    work = work_pop(&g_deques[cpu]);
+    irq_restore(flags);
+
+    for (i = 1; !work && i < count; i++) {
+        work = work_steal(&g_deques[(cpu + i) % count]);
+        if (work)
+            g_deques[cpu].stolen++;
+    }
+    if (!work)
+        return FALSE;
+
+    g_deques[cpu].run++;
+    work_run(work);
+    return TRUE;
+}
+
+static void work_worker(void *arg) {
+    (void)arg;
+    for (;;) {
+        if (!work_run_one())
+            waitq_wait_event(&g_work_idle, work_pending());
+    }
+}
+
+/**
+ * start a worker thread on every cpu
+ */
+void work_init(void) {
+    char name[TASK_NAME_LEN];
+    uint32 i;
+
+    waitq_init(&g_work_idle);
+    for (i = 0; i < smp_cpu_count(); i++) {
+        strcpy(name, "work0");
+        name[4] += i;
+        task_create_kernel_on(smp_cpu(i), name, work_worker, NULL);
+    }
+}
+
+/**
+ * prepare work to run fn(arg)
+ */
+void work_setup(WORK *work, WORK_FN fn, void *arg) {
+    work->fn = fn;
+    work->arg = arg;
+    work->done = FALSE;
+    waitq_init(&work->waiters);
+}
+
+/**
+ * queue work on this cpu, safe from interrupt handlers.
+ * runs it right away when the deque is full
+ */
+void work_submit(WORK *work) {
+    uint32 flags = irq_save();
+    BOOL queued = work_push(&g_deques[smp_cpu_index()], work);
+
+    irq_restore(flags);
+    if (queued)
+        waitq_wake_one(&g_work_idle);
+    else
+        work_run(work);
+}
+
+/**
+ * wait until work has run, running queued jobs meanwhile
+ */
+void work_wait(WORK *work) {
+    while (!work->done && work_run_one())
+        ;
+    waitq_wait_event(&work->waiters, work->done);
+}
+
+static void work_range(void *arg) {
+    WORK_RANGE *range = (WORK_RANGE *)arg;
+
+    range->fn(range->begin, range->end, range->arg);
+}
+
+/**
+ * call fn over [begin, end) in chunks of at least grain indices
+ * spread over the workers, returns once every chunk is done
+ */
+void work_parallel_for(uint32 begin, uint32 end, uint32 grain, WORK_RANGE_FN fn, void *arg) {
+    WORK_RANGE ranges[WORK_MAX_CHUNKS];
+    uint32 count, chunks, size, i;
+
+    if (begin >= end)
+        return;
+    count = end - begin;
+    if (grain == 0)
+        grain = 1;
+    // a few chunks per cpu leave room to balance uneven ones
+    chunks = smp_cpu_count() * 4;
+    if (chunks > WORK_MAX_CHUNKS)
+        chunks = WORK_MAX_CHUNKS;
+    if (chunks > (count + grain - 1) / grain)
+        chunks = (count + grain - 1) / grain;
+    size = (count + chunks - 1) / chunks;
+    chunks = (count + size - 1) / size;
+
+    for (i = 0; i < chunks; i++) {
+        WORK_RANGE *range = &ranges[i];
+
+        range->begin = begin + i * size;
+        range->end = range->begin + size > end ? end : range->begin + size;
+        range->fn = fn;
+        range->arg = arg;
+        work_setup(&range->work, work_range, range);
+    }
+    // the caller takes the first chunk itself
+    for (i = 1; i < chunks; i++)
+        work_submit(&ranges[i].work);
+    work_range(&ranges[0]);
+    for (i = 1; i < chunks; i++)
+        work_wait(&ranges[i].work);
+}
+
+/**
+ * jobs run and jobs stolen from other cpus by the workers of cpu
+ */
+void work_stats(uint32 cpu, uint32 *run, uint32 *stolen) {
+    *run = cpu < CPU_MAX ? g_deques[cpu].run : 0;
+    *stolen = cpu < CPU_MAX ? g_deques[cpu].stolen : 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * Host microbenchmarks of the kernel libraries, nanoseconds per operation.
+ * Only a quick comparison between two versions of a function, the bench
+ * shell command has the numbers that count
+ */
+
+#include <time.h>
+#include "string.h"
+#include "utils.h"
+#include "filesystem.h"
+#include "console.h"
+
+#define HOST_BENCH_OPS  200000
+
+static uint8 g_src[4096];
+static uint8 g_dst[4096];
+static char g_str1[] = "the quick brown fox jumps over!!";
+static char g_str2[] = "the quick brown fox jumps over!!";
+
+static char g_long[256];
+
+static uint64 now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void report(const char *name, uint64 start, uint32 ops) {
+    uint64 ns = now_ns() - start;
+
+    printf("%s %d.%d ns/op\n", name, (int)(ns / ops), (int)(ns * 10 / ops % 10));
+}
+
+// every variant of the string scans on 255 bytes, SIMD against the byte loops
+static void bench_string_variants(void) {
+    static const char *scans[] = { "strlen", "strcmp", "strchr", "strstr" };
+    volatile uint32 sink = 0;
+    char name[32];
+    uint32 r, s, v, i;
+    uint64 start;
+
+    memset(g_long, 'x', sizeof(g_long) - 1);
+    strcpy(g_long + sizeof(g_long) - 16, "quick brown fox");
+
+    for (r = 0; r < g_string_dispatch_count; r++) {
+        const CPU_DISPATCH *dispatch = &g_string_dispatch[r];
+
+        for (s = 0; s < 4 && strcmp(dispatch->name, scans[s]) != 0; s++)
+            ;
+        for (v = 0; s < 4 && v < dispatch->variant_count; v++) {
+            void *fn = dispatch->variants[v].fn;
+
+            start = now_ns();
+            for (i = 0; i < HOST_BENCH_OPS; i++) {
+                if (s == 0)
+                    sink += ((int (*)(const char *))fn)(g_long);
+                else if (s == 1)
+                    sink += ((int (*)(const char *, const char *))fn)(g_long, g_long);
+                else if (s == 2)
+                    sink += ((char *(*)(const char *, char))fn)(g_long, 'q') != NULL;
+                else
+                    sink += ((char *(*)(const char *, const char *))fn)(g_long, "quick brown") != NULL;
+            }
+            strcpy(name, dispatch->name);
+            strcat(name, "_255/");
+            strcat(name, dispatch->variants[v].name);
+            while (strlen(name) < 18)
+                strcat(name, " ");
+            report(name, start, HOST_BENCH_OPS);
+        }
+    }
+    (void)sink;
+}
+
+int main(void) {
+    volatile int sink = 0;
+    uint64 start;
+    uint32 i;
+
+    fs_init();
+    fs_mkdir("bin");
+    fs_create_file("/bin/hello");
+
+    start = now_ns();
+    for (i = 0; i < HOST_BENCH_OPS; i++)
+        heap_free(heap_alloc(32));
+    report("heap_alloc_free_32", start, HOST_BENCH_OPS);
+
+    start = now_ns();
+    for (i = 0; i < HOST_BENCH_OPS; i++)
+        memcpy(g_dst, g_src, 64);
+    report("memcpy_64         ", start, HOST_BENCH_OPS);
+
+    start = now_ns();
+    for (i = 0; i < HOST_BENCH_OPS / 16; i++)
+        memcpy(g_dst, g_src, sizeof(g_src));
+    report("memcpy_4k         ", start, HOST_BENCH_OPS / 16);
+
+    start = now_ns();
+    for (i = 0; i < HOST_BENCH_OPS; i++)
+        sink += strcmp(g_str1, g_str2);
+    report("strcmp_32         ", start, HOST_BENCH_OPS);
+
+    start = now_ns();
+    for (i = 0; i < HOST_BENCH_OPS; i++)
+        sink += fs_path_to_node("/bin/hello") != NULL;
+    report("fs_path_to_node   ", start, HOST_BENCH_OPS);
+
+    bench_string_variants();
+
+    (void)sink;
+    return 0;
+}
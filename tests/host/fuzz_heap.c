@@ -0,0 +1,71 @@
+/**
+ * Fuzzes the heap of utils.c: every two input bytes allocate or free a
+ * block. Live blocks are filled with their own byte and checked, so blocks
+ * that overlap or get clobbered by the free list show up
+ */
+
+#include <stdint.h>
+#include "string.h"
+#include "utils.h"
+#include "test.h"
+
+#define FUZZ_SLOTS      32
+
+typedef struct {
+    uint8 *ptr;
+    uint32 size;
+} FUZZ_BLOCK;
+
+// the ends of every block after each step, all of it with full set
+static void check_blocks(FUZZ_BLOCK *blocks, BOOL full) {
+    uint32 i, j;
+
+    for (i = 0; i < FUZZ_SLOTS; i++) {
+        uint8 fill = (uint8)(i + 1);
+
+        if (!blocks[i].ptr || blocks[i].size == 0)
+            continue;
+        CHECK(blocks[i].ptr[0] == fill && blocks[i].ptr[blocks[i].size - 1] == fill);
+        for (j = 1; full && j < blocks[i].size - 1; j++) {
+            if (blocks[i].ptr[j] != fill) {
+                CHECK(blocks[i].ptr[j] == fill);
+                break;
+            }
+        }
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    FUZZ_BLOCK blocks[FUZZ_SLOTS];
+    size_t i;
+
+    memset(blocks, 0, sizeof(blocks));
+    for (i = 0; i + 1 < size; i += 2) {
+        FUZZ_BLOCK *block = &blocks[data[i] % FUZZ_SLOTS];
+
+        if (block->ptr) {
+            heap_free(block->ptr);
+            block->ptr = NULL;
+        } else {
+            // mostly small blocks, now and then one of up to 16 KB
+            block->size = data[i] & 0x80 ? (uint32)data[i + 1] << 6 : data[i + 1];
+            block->ptr = heap_alloc(block->size);
+            if (block->ptr) {
+                CHECK((uint32)block->ptr >= HEAP_START);
+                CHECK((uint32)block->ptr + block->size <= HEAP_END);
+                CHECK(((uint32)block->ptr & 3) == 0);
+                memset(block->ptr, (uint8)(block - blocks + 1), block->size);
+            }
+        }
+        check_blocks(blocks, FALSE);
+    }
+    check_blocks(blocks, TRUE);
+
+    // leave the heap empty for the next input, the tail block last so
+    // everything merges again
+    for (i = FUZZ_SLOTS; i > 0; i--) {
+        if (blocks[i - 1].ptr)
+            heap_free(blocks[i - 1].ptr);
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+/**
+ * Driver for the fuzz harnesses without libFuzzer: runs the files given as
+ * arguments (as AFL does with @@), or else a fixed number of pseudo-random
+ * inputs. A failed check makes the exit code non-zero
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "test.h"
+
+#ifndef FUZZ_RUNS
+#define FUZZ_RUNS       20000
+#endif
+#define FUZZ_INPUT_MAX  512
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int main(int argc, char **argv) {
+    static uint8_t input[FUZZ_INPUT_MAX];
+    uint32_t seed = 0x2545F491;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        FILE *file = fopen(argv[i], "rb");
+
+        if (!file) {
+            perror(argv[i]);
+            return 2;
+        }
+        LLVMFuzzerTestOneInput(input, fread(input, 1, sizeof(input), file));
+        fclose(file);
+    }
+
+    for (i = 0; argc == 1 && i < FUZZ_RUNS; i++) {
+        size_t size, j;
+
+        // xorshift32, the same inputs on every run
+        for (j = 0; j <= FUZZ_INPUT_MAX; j++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            if (j == 0)
+                size = seed % FUZZ_INPUT_MAX;
+            else
+                input[j - 1] = (uint8_t)seed;
+        }
+        LLVMFuzzerTestOneInput(input, size);
+    }
+    return test_summary(argv[0]);
+}
@@ -0,0 +1,72 @@
+/**
+ * Fuzzes the path handling of filesystem.c: the input is a path, its first
+ * byte picks what is done with it. After every input the tree must still
+ * be well formed
+ */
+
+#include <stdint.h>
+#include "string.h"
+#include "filesystem.h"
+#include "test.h"
+
+#define FUZZ_PATH_MAX   (MAX_PATH * 2)
+
+// every child points back at its parent, names are terminated
+static void check_tree(FileNode *dir, uint32 depth) {
+    uint32 i;
+
+    CHECK(dir->child_count <= MAX_FILES);
+    CHECK(strlen(dir->name) < MAX_FILENAME);
+    if (depth > MAX_PATH)
+        return;
+    for (i = 0; i < dir->child_count && i < MAX_FILES; i++) {
+        CHECK(dir->children[i] != NULL);
+        CHECK(dir->children[i]->parent == dir);
+        if (dir->children[i]->is_directory)
+            check_tree(dir->children[i], depth + 1);
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static FileNode *root = NULL;
+    char path[FUZZ_PATH_MAX + 1];
+    FileNode *node;
+    uint8 op;
+
+    if (!root) {
+        fs_init();
+        root = fs_get_current_dir();
+        fs_mkdir("bin");
+        fs_create_file("/bin/hello");
+    }
+    if (size == 0)
+        return 0;
+
+    op = data[0];
+    size = size - 1 > FUZZ_PATH_MAX ? FUZZ_PATH_MAX : size - 1;
+    memcpy(path, data + 1, size);
+    path[size] = '\0';
+
+    switch (op % 4) {
+    case 0:
+        node = fs_path_to_node(path);
+        CHECK(node == NULL || node->child_count <= MAX_FILES);
+        break;
+    case 1:
+        node = fs_create_file(path);
+        CHECK(node == NULL || !node->is_directory);
+        // -1 once the heap is full
+        if (node)
+            CHECK(fs_write(node, path, size, TRUE) == (int)size || node->size + size > node->capacity);
+        break;
+    case 2:
+        fs_mkdir(path);
+        break;
+    case 3:
+        fs_cd(path);
+        break;
+    }
+    check_tree(root, 0);
+    fs_cd("/");
+    return 0;
+}
@@ -0,0 +1,77 @@
+/**
+ * What the kernel libraries need from the rest of the kernel, on the host.
+ * Built without host.h, this is the one file that uses the C library by name
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "test.h"
+
+// must match include/utils.h, the heap lives at a fixed address
+#define HEAP_START 0x400000
+#define HEAP_SIZE  0x400000
+
+void *heap_alloc(unsigned int size);
+void heap_free(void *ptr);
+
+static int g_checks = 0;
+static int g_failures = 0;
+
+// runs before main(), utils.c writes to the heap's first block right away
+__attribute__((constructor))
+static void shim_map_heap(void) {
+    void *heap = mmap((void *)HEAP_START, HEAP_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+    if (heap != (void *)HEAP_START) {
+        fprintf(stderr, "shim: can't map the kernel heap at 0x%x, is the binary PIE?\n", HEAP_START);
+        exit(2);
+    }
+}
+
+// the kernel's printf knows a subset of the C library's
+void kernel_printf(const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+// kmem.c sits in front of the heap in the kernel, the tests go to the heap
+void *kernel_malloc(unsigned int size) {
+    return heap_alloc(size);
+}
+
+void kernel_free(void *ptr) {
+    heap_free(ptr);
+}
+
+unsigned int smp_cpu_index(void) {
+    return 0;
+}
+
+// the host process owns its xmm registers, string.c declares them clobbered
+void fpu_kernel_begin(void *state) {
+    (void)state;
+}
+
+void fpu_kernel_end(void *state) {
+    (void)state;
+}
+
+void test_check(int ok, const char *expr, const char *file, int line) {
+    g_checks++;
+    if (!ok) {
+        g_failures++;
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    }
+}
+
+int test_summary(const char *suite) {
+    fprintf(stderr, "%s: %d checks, %d failed\n", suite, g_checks, g_failures);
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+/**
+ * Forced into every file of the host build (gcc -include). The kernel's
+ * string functions, allocator and printf get their own names here, so
+ * they don't replace the C library's, or the sanitizers' interceptors
+ */
+
+#ifndef HOST_H
+#define HOST_H
+
+// before types.h, which then keeps the C library's NULL
+#include <stddef.h>
+
+#define memset      kernel_memset
+#define memcpy      kernel_memcpy
+#define memmove     kernel_memmove
+#define memcmp      kernel_memcmp
+#define strlen      kernel_strlen
+#define strcmp      kernel_strcmp
+#define strncmp     kernel_strncmp
+#define strcpy      kernel_strcpy
+#define strncpy     kernel_strncpy
+#define strcat      kernel_strcat
+#define strtok      kernel_strtok
+#define strchr      kernel_strchr
+#define strstr      kernel_strstr
+#define isspace     kernel_isspace
+#define isalpha     kernel_isalpha
+#define upper       kernel_upper
+#define lower       kernel_lower
+#define itoa        kernel_itoa
+#define atoi        kernel_atoi
+#define abs         kernel_abs
+#define malloc      kernel_malloc
+#define free        kernel_free
+#define printf      kernel_printf
+
+#endif
@@ -0,0 +1,26 @@
+/**
+ * Host stand-in for include/spinlock.h: the tests run on one thread and
+ * cli would fault in user mode, so locking does nothing
+ */
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "types.h"
+
+typedef struct {
+    const char *name;
+} SPINLOCK;
+
+#define SPINLOCK_INIT(name)     { name }
+
+static inline uint32 irq_save(void) { return 0; }
+static inline void irq_restore(uint32 flags) { (void)flags; }
+static inline void spin_init(SPINLOCK *lock, const char *name) { lock->name = name; }
+static inline void spin_lock(SPINLOCK *lock) { (void)lock; }
+static inline BOOL spin_trylock(SPINLOCK *lock) { (void)lock; return TRUE; }
+static inline void spin_unlock(SPINLOCK *lock) { (void)lock; }
+static inline uint32 spin_lock_irqsave(SPINLOCK *lock) { (void)lock; return 0; }
+static inline void spin_unlock_irqrestore(SPINLOCK *lock, uint32 flags) { (void)lock; (void)flags; }
+
+#endif
@@ -0,0 +1,17 @@
+/**
+ * Checks for the host tests, see shim.c
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#define CHECK(cond)     test_check((cond) ? 1 : 0, #cond, __FILE__, __LINE__)
+
+void test_check(int ok, const char *expr, const char *file, int line);
+
+/**
+ * print the counts, returns the exit code for main()
+ */
+int test_summary(const char *suite);
+
+#endif
@@ -0,0 +1,370 @@
+/**
+ * Unit tests of string.c, the heap of utils.c, filesystem.c and inet.c
+ */
+
+#include <sys/mman.h>
+
+#include "string.h"
+#include "utils.h"
+#include "filesystem.h"
+#include "inet.h"
+#include "test.h"
+
+static void test_memory(void) {
+    char buf[16];
+
+    memset(buf, 'a', sizeof(buf));
+    CHECK(buf[0] == 'a' && buf[15] == 'a');
+
+    memcpy(buf, "0123456789", 11);
+    CHECK(strcmp(buf, "0123456789") == 0);
+
+    // overlapping moves in both directions
+    memmove(buf + 2, buf, 8);
+    CHECK(memcmp((uint8 *)buf, (uint8 *)"0101234567", 10) == 0);
+    memmove(buf, buf + 2, 8);
+    CHECK(memcmp((uint8 *)buf, (uint8 *)"01234567", 8) == 0);
+
+    CHECK(memcmp((uint8 *)"abc", (uint8 *)"abd", 3) < 0);
+    CHECK(memcmp((uint8 *)"abd", (uint8 *)"abc", 3) > 0);
+    CHECK(memcmp((uint8 *)"abc", (uint8 *)"abd", 2) == 0);
+}
+
+// every variant of the dispatched routines, not just the one bound
+static const CPU_VARIANT *variant(const char *routine, uint32 i) {
+    uint32 r;
+
+    for (r = 0; r < g_string_dispatch_count; r++) {
+        if (strcmp(g_string_dispatch[r].name, routine) == 0)
+            return i < g_string_dispatch[r].variant_count ? &g_string_dispatch[r].variants[i] : NULL;
+    }
+    return NULL;
+}
+
+// long strings take the SIMD loops, and strings ending on a page before an
+// unmapped one show whether any variant reads past the end
+static void test_string_scans(void) {
+    static char long1[300], long2[300], plain[300];
+    uint8 *pages = mmap(NULL, 8192, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    const CPU_VARIANT *v;
+    char *edge;
+    uint32 i, n;
+
+    CHECK(pages != MAP_FAILED && mprotect(pages + 4096, 4096, PROT_NONE) == 0);
+    memset(long1, 'a', sizeof(long1));
+    long1[299] = '\0';
+    long1[250] = 'b';
+    long1[251] = 'c';
+    memcpy(long2, long1, sizeof(long1));
+    memset(plain, 'a', sizeof(plain));
+    plain[299] = '\0';
+
+    for (i = 0; (v = variant("strlen", i)) != NULL; i++) {
+        int (*fn)(const char *) = (int (*)(const char *))v->fn;
+
+        CHECK(fn(long1) == 299 && fn(long1 + 5) == 294);
+        for (n = 0; n < 200; n += 13) {
+            edge = (char *)pages + 4095 - n;
+            memset(edge, 'x', n);
+            edge[n] = '\0';
+            CHECK(fn(edge) == (int)n);
+        }
+    }
+    for (i = 0; (v = variant("strcmp", i)) != NULL; i++) {
+        int (*fn)(const char *, const char *) = (int (*)(const char *, const char *))v->fn;
+
+        CHECK(fn(long1, long2) == 0);
+        CHECK(fn(long1 + 1, long2 + 3) < 0);
+        long2[280] = 'z';
+        CHECK(fn(long1, long2) < 0 && fn(long2, long1) > 0);
+        long2[280] = 'a';
+        // one string runs up to the unmapped page, the other doesn't
+        for (n = 70; n < 200; n += 7) {
+            edge = (char *)pages + 4095 - n;
+            memset(edge, 'a', n);
+            edge[n] = '\0';
+            CHECK(fn(edge, plain + 299 - n) == 0);
+            CHECK(fn(plain + 299 - n - 1, edge) > 0);
+        }
+    }
+    for (i = 0; (v = variant("strchr", i)) != NULL; i++) {
+        char *(*fn)(const char *, char) = (char *(*)(const char *, char))v->fn;
+
+        CHECK(fn(long1, 'b') == long1 + 250 && fn(long1 + 3, 'c') == long1 + 251);
+        CHECK(fn(long1, 'q') == NULL && fn(long1, '\0') == NULL);
+        edge = (char *)pages + 4095 - 150;
+        memset(edge, 'x', 150);
+        edge[150] = '\0';
+        CHECK(fn(edge, 'q') == NULL);
+        edge[149] = 'q';
+        CHECK(fn(edge, 'q') == edge + 149);
+    }
+    for (i = 0; (v = variant("strstr", i)) != NULL; i++) {
+        char *(*fn)(const char *, const char *) = (char *(*)(const char *, const char *))v->fn;
+
+        CHECK(fn(long1, "abc") == long1 + 249);
+        CHECK(fn(long1, "aaab") == long1 + 247);
+        CHECK(fn(long1, "ca") == long1 + 251);
+        CHECK(fn(long1, "cb") == NULL && fn(long1, "") == long1);
+        CHECK(fn(long1 + 260, "ab") == NULL);
+        edge = (char *)pages + 4095 - 150;
+        memset(edge, 'x', 150);
+        edge[150] = '\0';
+        CHECK(fn(edge, "xxy") == NULL);
+        edge[148] = 'y';
+        CHECK(fn(edge, "xyx") == edge + 147);
+    }
+    munmap(pages, 8192);
+}
+
+static void test_dispatch(void) {
+    static uint8 src[64], dst[64];
+    // the dword strlen reads whole aligned words, keep them inside the array
+    static char str[64] __attribute__((aligned(4)));
+    const CPU_VARIANT *v;
+    uint32 i, n, start;
+
+    for (i = 0; i < sizeof(src); i++)
+        src[i] = i * 7 + 1;
+
+    for (i = 0; (v = variant("memcpy", i)) != NULL; i++) {
+        for (n = 0; n < 20; n++) {
+            memset(dst, 0xEE, sizeof(dst));
+            ((void *(*)(void *, const void *, uint32))v->fn)(dst + 1, src + 3, n);
+            CHECK(memcmp(dst + 1, src + 3, n) == 0 && dst[0] == 0xEE && dst[n + 1] == 0xEE);
+        }
+    }
+    for (i = 0; (v = variant("memset", i)) != NULL; i++) {
+        for (n = 0; n < 20; n++) {
+            memset(dst, 0xEE, sizeof(dst));
+            ((void *(*)(void *, int, uint32))v->fn)(dst + 1, 0x1A5, n);
+            for (start = 1; start <= n && dst[start] == 0xA5; start++)
+                ;
+            CHECK(start == n + 1 && dst[0] == 0xEE && dst[n + 1] == 0xEE);
+        }
+    }
+    for (i = 0; (v = variant("strlen", i)) != NULL; i++) {
+        for (start = 0; start < 4; start++) {
+            for (n = 0; n < 12; n++) {
+                memset(str, 'x', sizeof(str));
+                str[start + n] = '\0';
+                CHECK(((int (*)(const char *))v->fn)(str + start) == (int)n);
+            }
+        }
+    }
+    test_string_scans();
+
+    // the example of RFC 1071 section 3, and an odd length
+    src[0] = 0x00; src[1] = 0x01; src[2] = 0xF2; src[3] = 0x03;
+    src[4] = 0xF4; src[5] = 0xF5; src[6] = 0xF6; src[7] = 0xF7;
+    for (i = 0; (v = variant("ip_checksum", i)) != NULL; i++) {
+        uint16 (*fn)(const void *, uint32) = (uint16 (*)(const void *, uint32))v->fn;
+        uint16 sum = fn(src, 8);
+
+        CHECK(((uint8 *)&sum)[0] == 0x22 && ((uint8 *)&sum)[1] == 0x0D);
+        CHECK(fn(src, 9) == ip_checksum(src, 9));
+        // a checksum over data that includes it comes out zero
+        memcpy(dst, src, 8);
+        memcpy(dst + 8, &sum, 2);
+        CHECK(fn(dst, 10) == 0);
+    }
+}
+
+static void test_strings(void) {
+    char buf[32];
+    char line[] = "//bin//hello/";
+
+    CHECK(strlen("") == 0);
+    CHECK(strlen("hello") == 5);
+
+    CHECK(strcmp("abc", "abc") == 0);
+    CHECK(strcmp("abc", "abd") < 0);
+    CHECK(strcmp("abc", "ab") > 0);
+    CHECK(strcmp("", "a") < 0);
+    CHECK(strncmp("hello", "help", 3) == 0);
+    CHECK(strncmp("hello", "help", 4) != 0);
+
+    CHECK(strcpy(buf, "bin") == 3);
+    strcat(buf, "/hello");
+    CHECK(strcmp(buf, "bin/hello") == 0);
+
+    strncpy(buf, "ab", 4);
+    CHECK(buf[0] == 'a' && buf[1] == 'b' && buf[2] == 0 && buf[3] == 0);
+
+    CHECK(strchr("hello", 'l') != NULL && *strchr("hello", 'l') == 'l');
+    CHECK(strchr("hello", 'z') == NULL);
+    CHECK(strstr("hello world", "wor") != NULL);
+    CHECK(strcmp(strstr("hello world", "wor"), "world") == 0);
+    CHECK(strstr("hello", "") != NULL);
+    CHECK(strstr("hello", "worlds") == NULL);
+
+    CHECK(strcmp(strtok(line, "/"), "bin") == 0);
+    CHECK(strcmp(strtok(NULL, "/"), "hello") == 0);
+    CHECK(strtok(NULL, "/") == NULL);
+
+    CHECK(upper('a') == 'A' && upper('A') == 'A' && upper('1') == '1');
+    CHECK(lower('Z') == 'z' && lower('z') == 'z');
+    CHECK(isspace(' ') && isspace('\t') && !isspace('x'));
+}
+
+static void test_numbers(void) {
+    char buf[16];
+
+    itoa(buf, 'd', 0);
+    CHECK(strcmp(buf, "0") == 0);
+    itoa(buf, 'd', -42);
+    CHECK(strcmp(buf, "-42") == 0);
+    itoa(buf, 'd', (int)0x80000000);
+    CHECK(strcmp(buf, "-2147483648") == 0);
+    itoa(buf, 'u', -1);
+    CHECK(strcmp(buf, "4294967295") == 0);
+    itoa(buf, 'x', 0xBEEF);
+    CHECK(strcmp(buf, "beef") == 0);
+    itoa(buf, 'x', -1);
+    CHECK(strcmp(buf, "ffffffff") == 0);
+
+    CHECK(atoi("123") == 123);
+    CHECK(atoi("  -7") == -7);
+    CHECK(atoi("+5x") == 5);
+    CHECK(atoi("x") == 0);
+}
+
+static void test_inet(void) {
+    // 10.0.2.15:5555 to 10.0.2.2:40000, "hi!" makes the segment odd
+    static uint8 segment[12] = { 0x15, 0xB3, 0x9C, 0x40, 0x00, 0x0B, 0x00, 0x00, 'h', 'i', '!' };
+    IP_ADDR src = IP4(10, 0, 2, 15), dst = IP4(10, 0, 2, 2);
+    IP_ADDR addr;
+    uint16 sum;
+
+    CHECK(ip_parse("10.0.2.15", &addr) && addr == src);
+    CHECK(ip_parse("255.255.255.255", &addr) && addr == IP_BROADCAST);
+    CHECK(ip_parse("0.0.0.0", &addr) && addr == 0);
+    CHECK(!ip_parse("", &addr));
+    CHECK(!ip_parse("10.0.2", &addr));
+    CHECK(!ip_parse("10.0.2.15.1", &addr));
+    CHECK(!ip_parse("10..2.15", &addr));
+    CHECK(!ip_parse("10.0.2.256", &addr));
+    CHECK(!ip_parse("10.0.2.99999999999", &addr));
+    CHECK(!ip_parse("10.0.2.15 ", &addr));
+    CHECK(!ip_parse("-1.0.2.15", &addr));
+
+    // the pad byte of an odd segment counts as 0, whatever is there
+    sum = ip_pseudo_checksum(src, dst, IP_PROTO_UDP, segment, 11);
+    CHECK(((uint8 *)&sum)[0] == 0xAC && ((uint8 *)&sum)[1] == 0x6A);
+    segment[11] = 0xFF;
+    CHECK(ip_pseudo_checksum(src, dst, IP_PROTO_UDP, segment, 11) == sum);
+    CHECK(udp_checksum(src, dst, segment, 11) == sum);
+    // the receiver's sum over the filled in field comes out zero
+    memcpy(segment + 6, &sum, 2);
+    CHECK(ip_pseudo_checksum(src, dst, IP_PROTO_UDP, segment, 11) == 0);
+
+    // payload making the sum 0, which UDP sends as 0xFFFF instead
+    segment[6] = segment[7] = 0;
+    segment[8] = segment[9] = 0;
+    sum = ip_pseudo_checksum(src, dst, IP_PROTO_UDP, segment, 11);
+    memcpy(segment + 8, &sum, 2);
+    CHECK(ip_pseudo_checksum(src, dst, IP_PROTO_UDP, segment, 11) == 0);
+    sum = udp_checksum(src, dst, segment, 11);
+    CHECK(sum == 0xFFFF);
+    memcpy(segment + 6, &sum, 2);
+    CHECK(ip_pseudo_checksum(src, dst, IP_PROTO_UDP, segment, 11) == 0);
+}
+
+static BOOL in_heap(void *ptr) {
+    return (uint32)ptr >= HEAP_START && (uint32)ptr < HEAP_END;
+}
+
+static void test_heap(void) {
+    uint8 *a = heap_alloc(10);
+    uint8 *b = heap_alloc(100);
+    uint8 *c = heap_alloc(1);
+    uint8 *big;
+
+    CHECK(a && b && c);
+    CHECK(in_heap(a) && in_heap(b) && in_heap(c));
+    CHECK(((uint32)a & 3) == 0 && ((uint32)b & 3) == 0 && ((uint32)c & 3) == 0);
+    // sizes round up to 4 bytes, blocks don't overlap
+    CHECK(b >= a + 12 || a >= b + 100);
+    CHECK(c >= b + 100 || b >= c + 4);
+
+    memset(a, 0xAA, 10);
+    memset(b, 0xBB, 100);
+    memset(c, 0xCC, 1);
+    CHECK(a[9] == 0xAA && b[0] == 0xBB && b[99] == 0xBB && c[0] == 0xCC);
+
+    // a freed block is handed out again
+    heap_free(b);
+    CHECK(heap_alloc(100) == b);
+
+    // freed in reverse, the blocks merge with the free space behind them
+    heap_free(c);
+    heap_free(b);
+    heap_free(a);
+    big = heap_alloc(HEAP_SIZE / 2);
+    CHECK(big != NULL);
+    heap_free(big);
+
+    CHECK(heap_alloc(HEAP_SIZE) == NULL);
+
+    // pointers outside the heap are ignored
+    heap_free(NULL);
+    heap_free((void *)(HEAP_END + 64));
+}
+
+static void test_files(void) {
+    char buf[64];
+    FileNode *bin, *file;
+
+    fs_init();
+    CHECK(fs_get_current_dir() != NULL);
+    CHECK(fs_path_to_node("/") == fs_get_current_dir());
+
+    CHECK(fs_mkdir("bin"));
+    bin = fs_path_to_node("/bin");
+    CHECK(bin != NULL && bin->is_directory);
+    CHECK(fs_path_to_node("bin") == bin);
+    CHECK(fs_path_to_node("./bin/.") == bin);
+    CHECK(fs_path_to_node("bin/..") == fs_path_to_node("/"));
+    CHECK(fs_path_to_node("nope") == NULL);
+
+    file = fs_create_file("/bin/hello");
+    CHECK(file != NULL && !file->is_directory && file->parent == bin);
+    CHECK(fs_create_file("/bin/hello") == file);
+    CHECK(fs_create_file("/bin") == NULL);
+    CHECK(fs_create_file("/nope/file") == NULL);
+    CHECK(fs_create_file("/bin/") == NULL);
+
+    // absolute paths start at the root wherever the current directory is
+    CHECK(fs_cd("bin") == bin);
+    CHECK(fs_path_to_node("/bin/hello") == file);
+    CHECK(fs_path_to_node("hello") == file);
+    CHECK(fs_cd("..") == fs_path_to_node("/"));
+
+    CHECK(fs_write(file, "hello", 5, FALSE) == 5);
+    CHECK(fs_write(file, " world", 6, TRUE) == 6);
+    CHECK(file->size == 11);
+    CHECK(fs_read(file, 0, buf, sizeof(buf)) == 11);
+    CHECK(memcmp((uint8 *)buf, (uint8 *)"hello world", 11) == 0);
+    CHECK(fs_read(file, 6, buf, 3) == 3);
+    CHECK(memcmp((uint8 *)buf, (uint8 *)"wor", 3) == 0);
+    CHECK(fs_read(file, 11, buf, 1) == 0);
+
+    // writes past the end start at the end
+    CHECK(fs_write_at(file, 100, "!", 1) == 1);
+    CHECK(file->size == 12);
+    CHECK(fs_write(file, "x", 1, FALSE) == 1 && file->size == 1);
+
+    CHECK(fs_read(bin, 0, buf, 1) == -1);
+    CHECK(fs_write(bin, "x", 1, FALSE) == -1);
+}
+
+int main(void) {
+    test_memory();
+    test_dispatch();
+    test_strings();
+    test_numbers();
+    test_inet();
+    test_heap();
+    test_files();
+    return test_summary("unit");
+}
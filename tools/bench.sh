@@ -0,0 +1,59 @@
+#!/bin/sh
+# Boot the kernel in QEMU with `bench` on its command line, keep the serial
+# output under bench/results and compare the medians with the previous run.
+#
+#   tools/bench.sh [threshold percent, default 10]
+#
+# QEMU, SMP and TIMEOUT can be set in the environment.
+
+set -e
+
+QEMU=${QEMU:-qemu-system-i386}
+SMP=${SMP:-2}
+TIMEOUT=${TIMEOUT:-300}
+THRESHOLD=${1:-10}
+RESULTS=bench/results
+KERNEL=out/isodir/boot/Smetana.bin
+MODULE=out/isodir/boot/hello.elf
+
+make
+mkdir -p $RESULTS
+
+previous=$(ls $RESULTS/*.log 2>/dev/null | tail -n 1)
+log=$RESULTS/$(date +%Y%m%d-%H%M%S)-$(git rev-parse --short HEAD).log
+
+# the kernel powers off once the suite is done
+timeout $TIMEOUT $QEMU -kernel $KERNEL -append bench -initrd "$MODULE hello" \
+    -smp $SMP -m 128 -display none -no-reboot -serial file:$log
+
+if ! grep -q '^bench-end' $log; then
+    echo "bench: no complete run in $log" >&2
+    exit 1
+fi
+grep '^bench name=' $log
+
+[ -n "$previous" ] || exit 0
+echo "compared with $previous:"
+# medians of both runs keyed by name, a rise above the threshold fails
+awk -v threshold=$THRESHOLD '
+    function field(key,   i) {
+        for (i = 1; i <= NF; i++)
+            if (index($i, key "=") == 1)
+                return substr($i, length(key) + 2)
+    }
+    /^bench name=/ {
+        name = field("name")
+        if (FNR == NR) {
+            old[name] = field("median")
+            next
+        }
+        new = field("median")
+        if (!(name in old) || old[name] == 0)
+            next
+        change = (new - old[name]) * 100 / old[name]
+        printf "%-20s %10d %10d %+6.1f%%\n", name, old[name], new, change
+        if (change > threshold)
+            regressed++
+    }
+    END { exit regressed > 0 }
+' $previous $log || { echo "bench: regression above $THRESHOLD%" >&2; exit 1; }
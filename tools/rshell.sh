@@ -0,0 +1,14 @@
+#!/bin/sh
+# Talk to the remote shell of a kernel running in QEMU with user networking
+# and its UDP port forwarded, one command per line:
+#
+#   qemu-system-i386 -cdrom out/Smetana.iso \
+#       -netdev user,id=n0,hostfwd=udp::2323-:2323 -device e1000,netdev=n0
+#   tools/rshell.sh [host, default localhost] [port, default 2323]
+#
+# needs nc with UDP support (netcat-openbsd, ncat or busybox)
+
+HOST=${1:-localhost}
+PORT=${2:-2323}
+
+exec nc -u $HOST $PORT
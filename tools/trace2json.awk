@@ -0,0 +1,56 @@
+# Turns the `trace dump` lines of a serial log into Chrome trace JSON,
+# for chrome://tracing or ui.perfetto.dev:
+#
+#   awk -f tools/trace2json.awk serial.log > trace.json
+#
+# irqs become slices on the track of their cpu, the other events instants
+
+function hex(s,   i, n) {
+    n = 0
+    for (i = 1; i <= length(s); i++)
+        n = n * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+    return n
+}
+
+function emit(json) {
+    printf "%s\n    %s", count++ ? "," : "", json
+}
+
+BEGIN {
+    n = 0
+    printf "{\"displayTimeUnit\": \"ns\", \"traceEvents\": ["
+}
+
+# the serial port sends \r\n, which would stay on the last field
+{
+    sub(/\r$/, "")
+}
+
+/^trace-begin/ {
+    khz = $2
+}
+
+# the rings are dumped one cpu after the other, so the earliest
+# timestamp is only known at the end
+$1 == "T" && khz > 0 {
+    tsc[n] = $3 * 4294967296 + $4
+    if (n == 0 || tsc[n] < start)
+        start = tsc[n]
+    cpu[n] = $2; event[n] = $5; a[n] = $6; b[n] = $7
+    n++
+}
+
+END {
+    for (i = 0; i < n; i++) {
+        head = "\"pid\": 0, \"tid\": " cpu[i] ", \"ts\": " sprintf("%.3f", (tsc[i] - start) * 1000 / khz)
+        if (event[i] == "irq_enter")
+            emit("{\"name\": \"irq " hex(a[i]) "\", \"ph\": \"B\", " head ", \"args\": {\"eip\": \"0x" b[i] "\"}}")
+        else if (event[i] == "irq_exit")
+            emit("{\"name\": \"irq " hex(a[i]) "\", \"ph\": \"E\", " head "}")
+        else if (event[i] == "switch")
+            emit("{\"name\": \"switch\", \"ph\": \"i\", \"s\": \"t\", " head ", \"args\": {\"prev\": " hex(a[i]) ", \"next\": " hex(b[i]) "}}")
+        else
+            emit("{\"name\": \"" event[i] "\", \"ph\": \"i\", \"s\": \"t\", " head ", \"args\": {\"a\": \"0x" a[i] "\", \"b\": \"0x" b[i] "\"}}")
+    }
+    print "\n]}"
+}